@@ -37,6 +37,7 @@ PyObject *masking        = NULL; // The masking Python module
 PyObject *iterator       = NULL; // The iterator Python module
 int bh_sync_warn         = 0;    // Boolean: should we warn when copying from Bohrium to NumPy
 int bh_mem_warn          = 0;    // Boolean: should we warn when about memory problems
+int bh_mem_zero_copy     = 0;    // Boolean: should we hand over the NumPy data to Bohrium without copying
 
 
 // Called when module exits
@@ -986,6 +987,12 @@ PyMODINIT_FUNC init_bh(void)
         bh_mem_warn = 1;
     }
 
+    // Check the 'BH_MEM_ZERO_COPY' flag
+    value = getenv("BH_MEM_ZERO_COPY");
+    if (value != NULL) {
+        bh_mem_zero_copy = 1;
+    }
+
     // Initialize the signal handler
     bh_mem_signal_init();
 
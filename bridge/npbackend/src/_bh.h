@@ -69,6 +69,7 @@ extern PyObject *masking;        // The masking Python module
 extern PyObject *iterator;       // The iterator Python module
 extern int bh_sync_warn;         // Boolean flag: should we warn when copying from Bohrium to NumPy
 extern int bh_mem_warn;          // Boolean flag: should we warn when about memory problems
+extern int bh_mem_zero_copy;     // Boolean flag: should we hand over the NumPy data to Bohrium without copying
 
 // Help function that creates a simple new array.
 // We parse to PyArray_NewFromDescr(), a new protected memory allocation
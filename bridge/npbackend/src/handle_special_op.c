@@ -256,6 +256,14 @@ void *get_data_pointer(BhArray *ary, bhc_bool copy2host, bhc_bool force_alloc, b
     return ret;
 }
 
+void set_data_pointer(BhArray *ary, bhc_bool host_ptr, void *mem_ptr) {
+    void *ary_ptr = bharray_bhc(ary);
+    bhc_dtype dtype = dtype_np2bhc(PyArray_DESCR((PyArrayObject*) ary)->type_num);
+    bhc_sync(dtype, ary_ptr);
+    bhc_flush();
+    bhc_data_set(dtype, ary_ptr, host_ptr, mem_ptr);
+}
+
 PyObject* PyGetDataPointer(PyObject *self, PyObject *args, PyObject *kwds) {
     PyObject *ary;
     npy_bool copy2host = 1;
@@ -301,12 +309,7 @@ PyObject* PySetDataPointer(PyObject *self, PyObject *args, PyObject *kwds) {
     if (PyErr_Occurred() != NULL) {
         return NULL;
     }
-
-    void *ary_ptr = bharray_bhc((BhArray *) ary);
-    bhc_dtype dtype = dtype_np2bhc(PyArray_DESCR((PyArrayObject*) ary)->type_num);
-    bhc_sync(dtype, ary_ptr);
-    bhc_flush();
-    bhc_data_set(dtype, ary_ptr, host_ptr, mem_ptr);
+    set_data_pointer((BhArray *) ary, host_ptr, mem_ptr);
     Py_RETURN_NONE;
 }
 
@@ -73,6 +73,15 @@ void *get_data_pointer(BhArray *ary, bhc_bool copy2host, bhc_bool force_alloc, b
  */
 PyObject* PyGetDataPointer(PyObject *self, PyObject *args, PyObject *kwds);
 
+/** Set the data pointer of `ary`
+ *  NB: The data will be deallocate when the bhc array is freed
+ *
+ * @param ary       The bharray in question
+ * @param host_ptr  When true, the pointer points to the host memory (main memory) as opposed to device memory
+ * @param mem_ptr   The new data pointer
+ */
+void set_data_pointer(BhArray *ary, bhc_bool host_ptr, void *mem_ptr);
+
 /** Set the data pointer of `ary`
  *  NB: The data will be deallocate when the bhc array is freed
  *
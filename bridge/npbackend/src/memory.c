@@ -58,6 +58,48 @@ static void _mremap_data(void *dst, void *src, npy_intp size) {
 #endif
 }
 
+// Help function that hands over the pages of the NumPy part of 'ary' to bhc without copying them, which leaves
+// the NumPy part readable and writable but without any pages.
+// Returns 0 when bhc already has data (which is overwritten by copying) or the pages cannot be moved.
+static int _move_np_part2bhc(BhArray *ary) {
+#if MREMAP_FIXED
+    if (get_data_pointer(ary, 1, 0, 0) != NULL) {
+        return 0;
+    }
+    void *src = PyArray_DATA((PyArrayObject*) ary);
+    const npy_intp size = ary_nbytes(ary);
+    void *dst = mem_map(size); // Reserve the new address of the pages
+    int moved = 0;
+#ifdef MREMAP_DONTUNMAP
+    // Keep the NumPy part mapped thus no other mapping can take its address in the meantime (Linux 5.7+)
+    moved = mremap(src, size, size, MREMAP_FIXED|MREMAP_MAYMOVE|MREMAP_DONTUNMAP, dst) != MAP_FAILED;
+#endif
+    if (!moved) {
+        if(mremap(src, size, size, MREMAP_FIXED|MREMAP_MAYMOVE, dst) == MAP_FAILED) {
+            mem_unmap(dst, size);
+            return 0;
+        }
+        // Let's map new memory where the NumPy part was
+        if(mmap(src, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED, -1, 0) == MAP_FAILED) {
+            int errsv = errno; // mmap() sets the errno.
+            fprintf(stderr,
+                    "Fatal error: _move_np_part2bhc() could not mmap the NumPy part: %p (size: %ld). "
+                    "Returned error code by mmap: %s.\n",
+                    src, size,
+                    strerror(errsv));
+            assert(1 == 2);
+            exit(-1);
+        }
+    }
+    // NB: like the memory allocated by Bohrium, the pages are page aligned anonymous memory thus Bohrium
+    //     can free them when the bhc array is freed
+    set_data_pointer(ary, 1, dst);
+    return 1;
+#else
+    return 0;
+#endif
+}
+
 int mem_access_callback(void *addr, void *id) {
     PyObject *ary = (PyObject *) id;
 
@@ -87,12 +129,55 @@ int mem_access_callback(void *addr, void *id) {
     return 1;
 }
 
+// Help function that returns the bhc data of 'ary' when its lazy NumPy part is touched the first time.
+// NB: like `mem_access_callback()`, this function is called by the touching thread, which might not hold the GIL.
+//     Threads that touch the NumPy part concurrently might call this function more than once.
+static void *mem_lazy_source(void *id) {
+    BhArray *ary = (BhArray *) id;
+
+    PyGILState_STATE GIL = PyGILState_Ensure();
+    void *data = get_data_pointer(ary, 1, 0, 0);
+    // From now on, the NumPy part has the data, which is copied from bhc one page at a time when touched
+    ary->data_in_bhc = 0;
+    PyGILState_Release(GIL);
+    return data;
+}
+
+// Help function that attaches the NumPy part of 'ary' as a lazy memory segment (see `BH_MEM_LAZY`).
+// Returns 0 when lazy memory segments aren't available, in which case the NumPy part is left protected.
+static int _attach_lazy_np_part(BhArray *ary) {
+    if (!bh_mem_signal_lazy_enabled()) {
+        return 0;
+    }
+    // The NumPy part must be readable and writable but without any pages
+    _munprotect(ary->base.data, ary_nbytes(ary));
+    if (madvise(ary->base.data, ary_nbytes(ary), MADV_DONTNEED) == 0 &&
+        bh_mem_signal_attach_lazy(ary, ary->base.data, ary_nbytes(ary), mem_lazy_source)) {
+        return 1;
+    }
+    if(mprotect(ary->base.data, ary_nbytes(ary), PROT_NONE) == -1) {
+        int errsv = errno; // mprotect() sets the errno.
+        fprintf(stderr,
+                "Fatal error: _attach_lazy_np_part() could not protect a data region. "
+                "Returned error code by mprotect: %s.\n",
+                strerror(errsv));
+        assert(1 == 2);
+        exit(-1);
+    }
+    return 0;
+}
+
 // Help function for protecting the memory of the NumPy part of 'ary'
 static void _mprotect_np_part(BhArray *ary) {
     assert(get_base((PyObject*) ary) == ary); // `ary` must be a base
     assert(ary->mmap_allocated);
     assert(PyArray_CHKFLAGS((PyArrayObject*) ary, NPY_ARRAY_OWNDATA));
 
+    // When possible, the NumPy part is copied from bhc one page at a time instead of protected
+    if (_attach_lazy_np_part(ary)) {
+        return;
+    }
+
     // Finally, we memory protect the NumPy data
     if(mprotect(ary->base.data, ary_nbytes(ary), PROT_NONE) == -1) {
         int errsv = errno; // mprotect() sets the errno.
@@ -156,11 +241,17 @@ void protected_malloc(BhArray *ary) {
     ary->npy_data = ary->base.data;
     ary->base.data = addr;
     assert(((BhArray*) ary)->data_in_bhc);
-    bh_mem_signal_attach(ary, ary->base.data, ary_nbytes(ary), mem_access_callback);
+    if (!_attach_lazy_np_part(ary)) {
+        bh_mem_signal_attach(ary, ary->base.data, ary_nbytes(ary), mem_access_callback);
+    }
     ary->data_in_bhc = 1;
 }
 
 void mem_signal_attach(void *idx, void *addr, uint64_t nbytes) {
+    // When possible, the NumPy part is copied from bhc one page at a time instead of protected
+    if (ary_nbytes((BhArray*) idx) == (int64_t) nbytes && _attach_lazy_np_part((BhArray*) idx)) {
+        return;
+    }
     bh_mem_signal_attach(idx, addr, nbytes, mem_access_callback);
 }
 
@@ -197,15 +288,18 @@ void mem_np2bhc(BhArray *base_array) {
     }
     base_array->data_in_bhc = 1;
 
-    // Let's detach the signal
+    // Let's copy the untouched pages of a lazy NumPy part and detach the signal
+    bh_mem_signal_populate(PyArray_DATA((PyArrayObject*) base_array));
     bh_mem_signal_detach(PyArray_DATA((PyArrayObject*) base_array));
 
     // Then we unprotect the NumPy memory part
     _munprotect(PyArray_DATA((PyArrayObject*) base_array), ary_nbytes((BhArray*) base_array));
 
-    // Copy the data from the NumPy part to the bhc part
-    void *data = get_data_pointer((BhArray*) base_array, 1, 1, 0);
-    memmove(data, PyArray_DATA((PyArrayObject*) base_array), PyArray_NBYTES((PyArrayObject*) base_array));
+    // Move the pages of the NumPy part to the bhc part (see `BH_MEM_ZERO_COPY`) or copy the data when we cannot
+    if (!bh_mem_zero_copy || !_move_np_part2bhc(base_array)) {
+        void *data = get_data_pointer((BhArray*) base_array, 1, 1, 0);
+        memmove(data, PyArray_DATA((PyArrayObject*) base_array), PyArray_NBYTES((PyArrayObject*) base_array));
+    }
 
     // Finally, we memory protect the NumPy part of 'base' again
     _mprotect_np_part((BhArray*) base_array);
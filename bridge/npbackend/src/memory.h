@@ -44,9 +44,9 @@ void mem_unmap(void *addr, npy_intp size);
  */
 void protected_malloc(BhArray *ary);
 
-/** Attach signal handler to the memory
+/** Attach signal handler to the memory, which is attached as a lazy memory segment when possible (see `BH_MEM_LAZY`)
  *
- * @param idx  Id to identify the memory segment when executing `mem_access_callback()`.
+ * @param idx  Id to identify the memory segment when executing `mem_access_callback()`, which must be the array.
  * @param addr Start address of memory segment.
  * @param size Size of memory segment in bytes
  */
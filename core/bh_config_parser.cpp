@@ -273,6 +273,17 @@ vector<boost::filesystem::path> ConfigParser::getListOfPaths(const std::string &
     return ret;
 }
 
+map<string, string> ConfigParser::getOptions(const std::string &section) const {
+    map<string, string> ret;
+    const auto child = _config.get_child_optional(section);
+    if (child) {
+        for (const auto &option: *child) {
+            ret[option.first] = lookup(section, option.first);
+        }
+    }
+    return ret;
+}
+
 string ConfigParser::getChildLibraryPath() const {
     // Do we have a child?
     if (static_cast<int>(_stack_list.size()) <= stack_level+1) {
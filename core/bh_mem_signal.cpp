@@ -21,16 +21,40 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <cassert>
+#include <cerrno>
 #include <stdexcept>
-#include <set>
+#include <atomic>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <vector>
 #include <iostream>
 #include <sigsegv.h>
 #include <bh_mem_signal.h>
-#include <bh_util.hpp>
+
+// Lazy memory segments are implemented using Linux' userfaultfd
+#if defined(__linux__) && defined(__has_include)
+#  if __has_include(<linux/userfaultfd.h>)
+#    define BH_MEM_SIGNAL_USERFAULTFD
+#  endif
+#endif
+
+#ifdef BH_MEM_SIGNAL_USERFAULTFD
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/userfaultfd.h>
+#endif
 
 using namespace std;
 
+// NB: the mutex only serializes the writers (attach and detach) and the fault-handling thread of the lazy
+//     segments, the readers (the signal handler and `bh_mem_signal_exist()`) use the lock-free page table below.
 static pthread_mutex_t signal_mutex = PTHREAD_MUTEX_INITIALIZER;
 static bool initialized = false;
 static bool mem_warn = false;
@@ -42,41 +66,19 @@ struct Segment {
     uint64_t size;
     //Id to identify the memory segment when executing the callback function.
     const void *idx;
-    //The callback function to call
+    //The callback function to call (nullptr when the segment is lazy)
     bh_mem_signal_callback_t callback;
-    //sigsegv ticket of a registered memory range
-    void *ticket;
-
-    //Some constructors
-    Segment() {};
+    //The source of a lazy segment (nullptr when the segment isn't lazy)
+    bh_mem_signal_source_t source = nullptr;
+    //The data returned by `source` and whether `source` has been called
+    const void *source_data = nullptr;
+    bool fetched = false;
 
-    Segment(const void *addr) : addr(addr), size(1), idx(nullptr), callback(nullptr), ticket(nullptr) {};
+    Segment(const void *addr, uint64_t size, const void *idx, bh_mem_signal_callback_t callback) :
+            addr(addr), size(size), idx(idx), callback(callback) {};
 
-    Segment(const void *addr, uint64_t size) : addr(addr), size(size), idx(nullptr),
-                                               callback(nullptr), ticket(nullptr) {};
-
-    Segment(const void *addr, uint64_t size, const void *idx) : addr(addr), size(size), idx(idx),
-                                                                callback(nullptr), ticket(nullptr) {};
-
-    void add_callback_and_ticket(bh_mem_signal_callback_t callback, void *ticket) {
-        this->callback = callback;
-        this->ticket = ticket;
-    }
-
-    bool operator<(const Segment &other) const {
-        const uint64_t a_begin = (uint64_t) addr;
-        const uint64_t b_begin = (uint64_t) other.addr;
-        const uint64_t a_end = a_begin + size - 1;
-        const uint64_t b_end = b_begin + other.size - 1;
-
-        //When the two segments overlaps we return false such that
-        //overlapping segments are identical in a set
-        if ((a_begin <= b_end) and (a_end >= b_begin)) {
-            return false;
-        } else { //Else we simple compare the begin address
-            return a_begin < b_begin;
-        }
-    }
+    Segment(const void *addr, uint64_t size, const void *idx, bh_mem_signal_source_t source) :
+            addr(addr), size(size), idx(idx), callback(nullptr), source(source) {};
 
     //Read begin and end memory address
     const void *addr_begin() const {
@@ -86,53 +88,435 @@ struct Segment {
     const void *addr_end() const {
         return (const void *) (((uint64_t) addr + size));
     }
+
+    //Returns true when `address` is within this memory segment
+    bool contains(const void *address) const {
+        return address >= addr_begin() and address < addr_end();
+    }
 };
 
 //Pretty print of Segment
 ostream &operator<<(ostream &out, const Segment &segment) {
-    out << segment.idx << "{addr: " << segment.addr_begin() << " - "
-        << segment.addr_end() << ", ticket: " << segment.ticket << "}";
+    out << segment.idx << "{addr: " << segment.addr_begin() << " - " << segment.addr_end() << "}";
     return out;
 }
 
-ostream &operator<<(ostream &out, const set<Segment> &segments) {
-    out << "bh_mem_signal contains: " << endl;
-    for (const Segment &seg: segments) {
-        out << seg << endl;
+namespace {
+
+/* The page table that maps each page of the address space to the memory segment it belongs to.
+ *
+ * The table has two levels: a directory of leaf tables that each covers 1 GB of the 48-bit address space.
+ * Leaf tables are allocated when a segment is attached to their range and never freed thus a reader never
+ * sees a dangling leaf table. Detached segments are retired and freed once all readers have been inactive since
+ * the retirement, which makes it safe for readers to dereference a segment they find in the table.
+ *
+ * NB: two memory segments cannot share a page, which is always the case for mmap'ed memory.
+ */
+constexpr int PAGE_BITS = 12;
+constexpr int ADDRESS_BITS = 48;
+constexpr int LEAF_BITS = 18;
+constexpr int DIRECTORY_BITS = ADDRESS_BITS - PAGE_BITS - LEAF_BITS;
+constexpr uint64_t LEAF_SIZE = 1ull << LEAF_BITS;
+
+typedef atomic<const Segment*> Entry;
+atomic<Entry*> directory[1ull << DIRECTORY_BITS];
+
+// The number of readers currently looking up segments (the low 32 bits) and the reader epoch (the high 32 bits),
+// which the last reader to leave increments. Both are updated by one atomic operation thus a new epoch means that
+// all readers have been inactive at some point since the previous epoch.
+// NB: readers run in the signal handler thus they must stay lock-free
+atomic<uint64_t> readers{0};
+constexpr uint64_t READERS_MASK = 0xffffffffull;
+constexpr uint64_t READERS_EPOCH = 1ull << 32;
+
+// Scoped registration of a reader
+struct ReaderGuard {
+    ReaderGuard() { readers.fetch_add(1); }
+    ~ReaderGuard() {
+        uint64_t old = readers.load();
+        uint64_t next;
+        do {
+            next = (old & READERS_MASK) == 1 ? (old & ~READERS_MASK) + READERS_EPOCH : old - 1;
+        } while (not readers.compare_exchange_weak(old, next));
     }
-    return out;
+};
+
+// All registered memory segments by start address (only accessed by writers)
+map<const void*, unique_ptr<Segment> > segments;
+// Detached segments that readers might still see and the reader epoch when they were retired
+vector<pair<uint64_t, unique_ptr<Segment> > > retired;
+
+inline uint64_t page_of(const void *addr) {
+    return ((uint64_t) addr) >> PAGE_BITS;
+}
+
+inline bool page_in_range(uint64_t page) {
+    return (page >> (DIRECTORY_BITS + LEAF_BITS)) == 0;
+}
+
+// Returns the entry of `page` or nullptr when no leaf table covers `page`. NB: must be async-signal-safe
+inline Entry *find_entry(uint64_t page) {
+    if (not page_in_range(page)) {
+        return nullptr;
+    }
+    Entry *leaf = directory[page >> LEAF_BITS].load(memory_order_acquire);
+    if (leaf == nullptr) {
+        return nullptr;
+    }
+    return &leaf[page & (LEAF_SIZE - 1)];
+}
+
+// Returns the segment that contains `addr` or nullptr. NB: the caller must hold a `ReaderGuard` or the mutex
+const Segment *lookup(const void *addr) {
+    const Entry *entry = find_entry(page_of(addr));
+    if (entry == nullptr) {
+        return nullptr;
+    }
+    const Segment *segment = entry->load();
+    if (segment != nullptr and segment->contains(addr)) {
+        return segment;
+    }
+    return nullptr;
+}
+
+// Returns the entry of `page` and allocates its leaf table when needed. NB: the caller must hold the mutex
+Entry &get_entry(uint64_t page) {
+    atomic<Entry*> &slot = directory[page >> LEAF_BITS];
+    Entry *leaf = slot.load(memory_order_relaxed);
+    if (leaf == nullptr) {
+        // We use calloc() since the OS can hand out zeroed pages without touching them
+        leaf = static_cast<Entry*>(calloc(LEAF_SIZE, sizeof(Entry)));
+        if (leaf == nullptr) {
+            throw runtime_error("mem_signal: could not allocate the page table");
+        }
+        slot.store(leaf, memory_order_release);
+    }
+    return leaf[page & (LEAF_SIZE - 1)];
+}
+
+// Set the entries of all pages of `segment` to `value`. NB: the caller must hold the mutex
+void set_entries(const Segment &segment, const Segment *value) {
+    const uint64_t last = page_of((const char*) segment.addr_end() - 1);
+    for (uint64_t page = page_of(segment.addr_begin()); page <= last; ++page) {
+        get_entry(page).store(value);
+    }
+}
+
+// Returns the first segment that shares a page with `segment` or nullptr. NB: the caller must hold the mutex
+const Segment *find_conflict(const Segment &segment) {
+    const uint64_t last = page_of((const char*) segment.addr_end() - 1);
+    for (uint64_t page = page_of(segment.addr_begin()); page <= last; ++page) {
+        const Entry *entry = find_entry(page);
+        if (entry != nullptr and entry->load() != nullptr) {
+            return entry->load();
+        }
+    }
+    return nullptr;
+}
+
+// Returns an error message when `segment` cannot be attached or the empty string. NB: the caller must hold the mutex
+string attach_error(const Segment &segment) {
+    const Segment *conflict = find_conflict(segment);
+    if (conflict == nullptr and page_in_range(page_of((const char*) segment.addr_end() - 1))) {
+        return "";
+    }
+    stringstream ss;
+    ss << "mem_signal: Could not attach signal, memory segment (" \
+       << segment.addr_begin() << " to " << segment.addr_end() << ") ";
+    if (conflict != nullptr) {
+        ss << "is in conflict with already attached memory segment (" \
+           << conflict->addr_begin() << " to " << conflict->addr_end() << ")" << endl;
+    } else {
+        ss << "is outside the supported address space" << endl;
+    }
+    return ss.str();
+}
+
+// Free the retired segments if no reader can see them. NB: the caller must hold the mutex
+void free_retired() {
+    // The entries of the retired segments have been cleared before this load thus readers that
+    // register after the load cannot find the retired segments
+    const uint64_t state = readers.load();
+    if ((state & READERS_MASK) == 0) {
+        retired.clear();
+    } else {
+        // Readers that registered before the retirement of a segment have left when the epoch changed
+        const uint64_t epoch = state & ~READERS_MASK;
+        retired.erase(std::remove_if(retired.begin(), retired.end(),
+                                     [epoch](const pair<uint64_t, unique_ptr<Segment> > &r) {
+                                         return r.first != epoch;
+                                     }), retired.end());
+    }
+}
+
+/* Lazy memory segments
+ *
+ * The pages of a lazy segment are registered with a userfaultfd. When a missing page is touched, the kernel
+ * blocks the faulting thread and notifies the fault-handling thread, which copies the page from the source
+ * of the segment and wakes the faulting thread. Thus, only the touched pages are copied.
+ */
+#ifdef BH_MEM_SIGNAL_USERFAULTFD
+// The userfaultfd of the lazy segments or -1 when lazy segments are disabled
+int uffd = -1;
+// The pipe that stops the fault-handling thread
+int uffd_stop[2] = {-1, -1};
+pthread_t uffd_thread;
+const uint64_t page_size = (uint64_t) sysconf(_SC_PAGESIZE);
+
+inline uint64_t round_up_to_page(uint64_t nbytes) {
+    return (nbytes + page_size - 1) / page_size * page_size;
+}
+
+// Copy the pages of `segment` within the page aligned offsets [begin, end) from its source.
+// Pages already populated are skipped. Returns false on error. NB: the caller must hold the mutex
+bool populate(const Segment &segment, uint64_t begin, uint64_t end) {
+    assert(segment.fetched);
+    const uint64_t base = (uint64_t) segment.addr;
+    const uint64_t full_end = segment.size / page_size * page_size; // The end of the pages fully within the segment
+    vector<char> last_page; // The last page, which is only partly within the segment
+    while (begin < end) {
+        uint64_t len;
+        const char *src;
+        if (begin < full_end) {
+            len = min(end, full_end) - begin;
+            src = (const char *) segment.source_data + begin;
+        } else {
+            if (segment.source_data != nullptr and last_page.empty()) {
+                last_page.resize(page_size, 0);
+                memcpy(last_page.data(), (const char *) segment.source_data + full_end, segment.size - full_end);
+            }
+            len = page_size;
+            src = last_page.data();
+        }
+        int ret;
+        int64_t done;
+        if (segment.source_data == nullptr) { // Without a source, the pages are zero
+            struct uffdio_zeropage zeropage;
+            zeropage.range.start = base + begin;
+            zeropage.range.len = len;
+            zeropage.mode = 0;
+            ret = ioctl(uffd, UFFDIO_ZEROPAGE, &zeropage);
+            done = zeropage.zeropage;
+        } else {
+            struct uffdio_copy copy;
+            copy.dst = base + begin;
+            copy.src = (uint64_t) src;
+            copy.len = len;
+            copy.mode = 0;
+            copy.copy = 0;
+            ret = ioctl(uffd, UFFDIO_COPY, &copy);
+            done = copy.copy;
+        }
+        if (ret == 0) {
+            begin += len;
+        } else if (done > 0) {
+            begin += done;
+        } else if (errno == EEXIST) {
+            begin += page_size; // The page is already populated
+        } else if (errno != EAGAIN) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The fault-handling thread
+void *uffd_handler(void *) {
+    struct pollfd fds[2];
+    fds[0].fd = uffd;
+    fds[0].events = POLLIN;
+    fds[1].fd = uffd_stop[0];
+    fds[1].events = POLLIN;
+    while (true) {
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents != 0) {
+            break;
+        }
+        struct uffd_msg msg;
+        if (read(uffd, &msg, sizeof(msg)) != sizeof(msg) or msg.event != UFFD_EVENT_PAGEFAULT) {
+            continue;
+        }
+        const uint64_t address = msg.arg.pagefault.address;
+        pthread_mutex_lock(&signal_mutex);
+        Segment *segment = const_cast<Segment*>(lookup((const void *) address));
+        if (segment != nullptr and segment->source != nullptr and not segment->fetched) {
+            // The source might call back into the application, e.g. Python that requires the GIL, which the
+            // faulting thread might hold. Thus, we memory protect the segment and wake the faulting thread, which
+            // then fetches the source itself when its retry of the access raises a SIGSEGV (see `fetch_source()`)
+            if (mprotect(const_cast<void*>(segment->addr), round_up_to_page(segment->size), PROT_NONE) == -1) {
+                cerr << "Fatal error: mem_signal could not protect a lazy memory segment: " << strerror(errno) << endl;
+                abort();
+            }
+            struct uffdio_range range;
+            range.start = address / page_size * page_size;
+            range.len = page_size;
+            ioctl(uffd, UFFDIO_WAKE, &range);
+        } else if (segment != nullptr and segment->source != nullptr) {
+            const uint64_t offset = (address - (uint64_t) segment->addr) / page_size * page_size;
+            if (not populate(*segment, offset, offset + page_size)) {
+                cerr << "Fatal error: mem_signal could not populate the page " << (void *) address \
+                     << " of a lazy memory segment: " << strerror(errno) << endl;
+                abort();
+            }
+        } else {
+            // The segment has been detached, which wakes the faulting thread but let's make sure
+            struct uffdio_range range;
+            range.start = address / page_size * page_size;
+            range.len = page_size;
+            ioctl(uffd, UFFDIO_WAKE, &range);
+        }
+        pthread_mutex_unlock(&signal_mutex);
+    }
+    return nullptr;
 }
 
+// Fetch the source of the lazy segment at `address`, which the fault-handling thread memory protects on the first
+// touch thus the source is called by the touching thread (see `uffd_handler()`). Returns 1 when the touching thread
+// may retry the access.
+int fetch_source(const void *address, bh_mem_signal_source_t source, const void *idx) {
+    pthread_mutex_lock(&signal_mutex);
+    Segment *segment = const_cast<Segment*>(lookup(address));
+    const bool fetched = segment == nullptr or segment->fetched;
+    pthread_mutex_unlock(&signal_mutex);
+    if (fetched) {
+        return 1; // Another thread fetched the source or detached the segment meanwhile
+    }
+
+    // NB: the source is called without the mutex since it might attach or detach segments
+    const void *data = source(const_cast<void*>(idx));
+
+    pthread_mutex_lock(&signal_mutex);
+    segment = const_cast<Segment*>(lookup(address));
+    if (segment != nullptr and segment->source != nullptr and not segment->fetched) {
+        segment->source_data = data;
+        segment->fetched = true;
+        // From now on, the fault-handling thread copies the pages one at a time when they are touched
+        if (mprotect(const_cast<void*>(segment->addr), round_up_to_page(segment->size), PROT_READ | PROT_WRITE) == -1) {
+            cerr << "Fatal error: mem_signal could not unprotect a lazy memory segment: " << strerror(errno) << endl;
+            abort();
+        }
+    }
+    pthread_mutex_unlock(&signal_mutex);
+    return 1;
+}
+
+// Enable lazy segments when the system supports them. Returns an error message on failure
+string lazy_init() {
+    int fd = -1;
+#ifdef UFFD_USER_MODE_ONLY
+    // We only handle faults from user-space, which unprivileged processes are allowed to
+    fd = (int) syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY);
+#endif
+    if (fd == -1) {
+        fd = (int) syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK);
+    }
+    if (fd == -1) {
+        return string("userfaultfd(): ") + strerror(errno);
+    }
+    struct uffdio_api api;
+    api.api = UFFD_API;
+    api.features = 0;
+    if (ioctl(fd, UFFDIO_API, &api) == -1) {
+        close(fd);
+        return string("UFFDIO_API: ") + strerror(errno);
+    }
+    if (pipe(uffd_stop) == -1) {
+        close(fd);
+        return string("pipe(): ") + strerror(errno);
+    }
+    uffd = fd;
+    const int err = pthread_create(&uffd_thread, nullptr, uffd_handler, nullptr);
+    if (err != 0) {
+        close(uffd_stop[0]);
+        close(uffd_stop[1]);
+        close(uffd);
+        uffd = -1;
+        return string("pthread_create(): ") + strerror(err);
+    }
+    return "";
+}
+
+// Stop the fault-handling thread. NB: the caller must not hold the mutex
+void lazy_shutdown() {
+    if (uffd == -1) {
+        return;
+    }
+    const char stop = 1;
+    if (write(uffd_stop[1], &stop, 1) == 1) {
+        pthread_join(uffd_thread, nullptr);
+    }
+    close(uffd_stop[0]);
+    close(uffd_stop[1]);
+    close(uffd);
+    uffd = -1;
+}
+#endif
+
 // sigsegv boilerplate
-static sigsegv_dispatcher dispatcher;
-static int handler(void *fault_address, int serious) {
+int handler(void *fault_address, int serious) {
     // We only handle serious faults and not potential faults such as stack overflows
-    if (serious == 1) {
-        return sigsegv_dispatch(&dispatcher, fault_address);
-    } else {
+    if (serious != 1) {
         return 0;
     }
+    bh_mem_signal_callback_t callback;
+    bh_mem_signal_source_t source;
+    const void *idx;
+    {
+        ReaderGuard guard;
+        const Segment *segment = lookup(fault_address);
+        if (segment == nullptr) {
+            return 0;
+        }
+        callback = segment->callback;
+        source = segment->source;
+        idx = segment->idx;
+    }
+    // NB: the callback and the source are called without the reader guard since they might detach the segment
+    if (callback == nullptr) {
+#ifdef BH_MEM_SIGNAL_USERFAULTFD
+        return fetch_source(fault_address, source, idx);
+#else
+        return 0; // Lazy segments are never memory protected
+#endif
+    }
+    return callback(fault_address, const_cast<void*>(idx));
 }
 
-// All registered memory segments
-// NB: never insert overlapping memory segments into this set
-static set<Segment> segments;
+}
 
 void bh_mem_signal_init(void) {
     mem_warn = getenv("BH_MEM_WARN") != nullptr;
 
     pthread_mutex_lock(&signal_mutex);
     if (!initialized) {
-        sigsegv_init (&dispatcher);
         if (sigsegv_install_handler(&handler) == -1) {
             throw runtime_error("System cannot catch SIGSEGV");
         }
+        const char *lazy = getenv("BH_MEM_LAZY");
+        if (lazy != nullptr and strcmp(lazy, "0") != 0 and strcmp(lazy, "false") != 0) {
+#ifdef BH_MEM_SIGNAL_USERFAULTFD
+            const string err = lazy_init();
+#else
+            const string err = "userfaultfd isn't supported by this system";
+#endif
+            if (not err.empty() and mem_warn) {
+                cout << "MEM_WARN: bh_mem_signal_init() - lazy memory segments are disabled (" << err << ")" << endl;
+            }
+        }
     }
     initialized = true;
     pthread_mutex_unlock(&signal_mutex);
 }
 
 void bh_mem_signal_shutdown(void) {
+#ifdef BH_MEM_SIGNAL_USERFAULTFD
+    lazy_shutdown();
+#endif
     pthread_mutex_lock(&signal_mutex);
     if (not segments.empty()) {
         if (mem_warn) {
@@ -150,49 +534,118 @@ void bh_mem_signal_attach(void *idx, void *addr, uint64_t size, bh_mem_signal_ca
     pthread_mutex_lock(&signal_mutex);
 
     // Create new memory segment that we will attach
-    Segment segment(addr, size, idx);
+    unique_ptr<Segment> segment(new Segment(addr, size, idx, callback));
 
     // Let's check for double attachments
-    if (util::exist(segments, segment)) {
-        auto conflict = segments.find(Segment(addr, size));
-        stringstream ss;
-        ss << "mem_signal: Could not attach signal, memory segment (" \
-           << segment.addr_begin() << " to " << segment.addr_end() \
-           << ") is in conflict with already attached memory segment (" \
-           << conflict->addr_begin() << " to " << conflict->addr_end() << ")" << endl;
+    const string err = attach_error(*segment);
+    if (not err.empty()) {
         pthread_mutex_unlock(&signal_mutex);
-        throw runtime_error(ss.str());
+        throw runtime_error(err);
     }
     assert(((size_t) addr) % SIGSEGV_FAULT_ADDRESS_ALIGNMENT == 0);
     assert(size % SIGSEGV_FAULT_ADDRESS_ALIGNMENT == 0);
-    // Let's register it in sigsegv and save it in the segment
-    void *ticket = sigsegv_register(&dispatcher, addr, size, callback, idx);
-    segment.add_callback_and_ticket(callback, ticket);
+    assert(size > 0);
+
+    // Finally, let's publish the new segment
+    set_entries(*segment, segment.get());
+    segments[addr] = std::move(segment);
+    pthread_mutex_unlock(&signal_mutex);
+}
+
+int bh_mem_signal_lazy_enabled(void) {
+#ifdef BH_MEM_SIGNAL_USERFAULTFD
+    return uffd != -1;
+#else
+    return 0;
+#endif
+}
+
+int bh_mem_signal_attach_lazy(void *idx, void *addr, uint64_t size, bh_mem_signal_source_t source) {
+#ifdef BH_MEM_SIGNAL_USERFAULTFD
+    if (uffd == -1) {
+        return 0;
+    }
+    pthread_mutex_lock(&signal_mutex);
+
+    // Create new memory segment that we will attach
+    unique_ptr<Segment> segment(new Segment(addr, size, idx, source));
+
+    // Let's check for double attachments
+    const string err = attach_error(*segment);
+    if (not err.empty()) {
+        pthread_mutex_unlock(&signal_mutex);
+        throw runtime_error(err);
+    }
+    assert(((uint64_t) addr) % page_size == 0);
+    assert(size > 0);
+
+    // Let's register the pages with the userfaultfd, which fails if the memory isn't private anonymous memory
+    struct uffdio_register reg;
+    reg.range.start = (uint64_t) addr;
+    reg.range.len = round_up_to_page(size);
+    reg.mode = UFFDIO_REGISTER_MODE_MISSING;
+    if (ioctl(uffd, UFFDIO_REGISTER, &reg) == -1) {
+        pthread_mutex_unlock(&signal_mutex);
+        return 0;
+    }
+
+    // Finally, let's publish the new segment
+    set_entries(*segment, segment.get());
+    segments[addr] = std::move(segment);
+    pthread_mutex_unlock(&signal_mutex);
+    return 1;
+#else
+    return 0;
+#endif
+}
 
-    // Finally, let's insert the new segment
-    segments.insert(segment);
+void bh_mem_signal_populate(const void *addr) {
+#ifdef BH_MEM_SIGNAL_USERFAULTFD
+    pthread_mutex_lock(&signal_mutex);
+    const Segment *segment = lookup(addr);
+    if (segment != nullptr and segment->source != nullptr and segment->fetched) {
+        if (not populate(*segment, 0, round_up_to_page(segment->size))) {
+            const string err = strerror(errno);
+            pthread_mutex_unlock(&signal_mutex);
+            throw runtime_error("mem_signal: Could not populate lazy memory segment: " + err);
+        }
+    }
     pthread_mutex_unlock(&signal_mutex);
+#endif
 }
 
 void bh_mem_signal_detach(const void *addr) {
     pthread_mutex_lock(&signal_mutex);
-    auto it = segments.find(addr);
-    if (it != segments.end()) {
-        assert(it->ticket != nullptr);
-        sigsegv_unregister(&dispatcher, it->ticket);
+    const Segment *segment = lookup(addr);
+    if (segment != nullptr) {
+        auto it = segments.find(segment->addr_begin());
+        assert(it != segments.end());
+#ifdef BH_MEM_SIGNAL_USERFAULTFD
+        if (segment->source != nullptr) {
+            // NB: this fails when the memory has been unmapped, which also unregisters it
+            struct uffdio_range range;
+            range.start = (uint64_t) segment->addr;
+            range.len = round_up_to_page(segment->size);
+            ioctl(uffd, UFFDIO_UNREGISTER, &range);
+        }
+#endif
+        set_entries(*segment, nullptr);
+        retired.emplace_back(readers.load() & ~READERS_MASK, std::move(it->second));
         segments.erase(it);
     }
+    free_retired();
     pthread_mutex_unlock(&signal_mutex);
 }
 
 int bh_mem_signal_exist(const void *addr) {
-    int ret;
-    pthread_mutex_lock(&signal_mutex);
-    ret = util::exist(segments, addr);
-    pthread_mutex_unlock(&signal_mutex);
-    return ret;
+    ReaderGuard guard;
+    return lookup(addr) != nullptr;
 }
 
 void bh_mem_signal_pprint_db(void) {
-    cout << segments << endl;
+    cout << "bh_mem_signal contains: " << endl;
+    for (const auto &segment: segments) {
+        cout << *segment.second << endl;
+    }
+    cout << endl;
 }
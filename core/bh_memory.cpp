@@ -1,67 +1,435 @@
-/*
-This file is part of Bohrium and copyright (c) 2012 the Bohrium
-team <http://www.bh107.org>.
-
-Bohrium is free software: you can redistribute it and/or modify
-it under the terms of the GNU Lesser General Public License as
-published by the Free Software Foundation, either version 3
-of the License, or (at your option) any later version.
-
-Bohrium is distributed in the hope that it will be useful,
-but WITHOUT ANY WARRANTY; without even the implied warranty of
-MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-GNU General Public License for more details.
-
-You should have received a copy of the
-GNU Lesser General Public License along with Bohrium.
-
-If not, see <http://www.gnu.org/licenses/>.
-*/
-
-#ifdef _WIN32
-#include <malloc.h>
-#else
-#include <sys/mman.h>
-#endif
-#include <cstddef>
-
-#include <bh_memory.h>
-#include <bh_win.h>
-
-/* Allocate an alligned contigous block of memory,
- * does not apply any initialization
- *
- * @size  The size of the allocated block
- * @return A pointer to data, and NULL on error
- */
-void* bh_memory_malloc(int64_t size)
-{
-#ifdef _WIN32
-    return _aligned_malloc(size, 16);
-#else
-    //Allocate page-size aligned memory.
-    //The MAP_PRIVATE and MAP_ANONYMOUS flags is not 100% portable. See:
-    //<http://stackoverflow.com/questions/4779188/how-to-use-mmap-to-allocate-a-memory-in-heap>
-    void* data = mmap(0, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
-    if(data == MAP_FAILED)
-        return NULL;
-    else
-        return data;
-#endif
-}
-
-/* Frees a previously allocated data block
- *
- * @data  The pointer returned from a call to bh_memory_malloc
- * @size  The size of the allocated block
- * @return A pointer to data, and NULL on error
- */
-int64_t bh_memory_free(void* data, int64_t size)
-{
-#ifdef _WIN32
-	_aligned_free(data);
-	return 0;
-#else
-	return munmap(data, size);
-#endif
-}
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <bh_memory.h>
+#include <bh_win.h>
+
+#ifndef _WIN32
+namespace {
+
+/* The mapper maps new data blocks using normal pages, huge pages, or files in a spill directory.
+ * The blocks backed by spill files are mapped shared thus the kernel writes their pages to disk, rather
+ * than to swap, under memory pressure. This way, arrays larger than the physical memory can be computed.
+ */
+class Mapper {
+private:
+    // The size of the huge pages (the default on both x86-64 and AArch64 with 4 KiB pages)
+    static constexpr uint64_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    std::mutex _mutex;
+    std::unordered_map<void*, uint64_t> _unpooled_blocks; // Blocks mapped with MAP_HUGETLB or spill files => length
+    int _policy = BH_HUGEPAGES_NONE;
+    int64_t _threshold = 0;
+    std::string _spill_dir;
+    int64_t _spill_threshold = -1;
+
+    static uint64_t round_up(uint64_t size, uint64_t alignment) {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    static void* map_normal(int64_t size) {
+        //The MAP_PRIVATE and MAP_ANONYMOUS flags is not 100% portable. See:
+        //<http://stackoverflow.com/questions/4779188/how-to-use-mmap-to-allocate-a-memory-in-heap>
+        void* data = mmap(0, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        return data == MAP_FAILED ? NULL : data;
+    }
+
+    // Transparent huge pages only back the parts of a mapping that are aligned to huge pages, thus we
+    // map an extra huge page and unmap the unaligned head and the tail
+    static void* map_transparent(int64_t size) {
+        const uint64_t page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+        const uint64_t nbytes = round_up(static_cast<uint64_t>(size), page_size);
+        char *raw = static_cast<char*>(map_normal(nbytes + HUGE_PAGE_SIZE));
+        if (raw == NULL) {
+            return NULL;
+        }
+        char *data = reinterpret_cast<char*>(round_up(reinterpret_cast<uintptr_t>(raw), HUGE_PAGE_SIZE));
+        if (data > raw) {
+            munmap(raw, data - raw);
+        }
+        const uint64_t tail = (raw + nbytes + HUGE_PAGE_SIZE) - (data + nbytes);
+        if (tail > 0) {
+            munmap(data + nbytes, tail);
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(data, nbytes, MADV_HUGEPAGE);
+#endif
+        return data;
+    }
+
+    // Map an anonymous spill file in `dir`. The file is unlinked right away, thus its disk space is
+    // released when the block is unmapped (or when the process dies).
+    static void* map_spill(const std::string &dir, int64_t size) {
+        std::vector<char> path(dir.begin(), dir.end());
+        const char name[] = "/bh_spill_XXXXXX";
+        path.insert(path.end(), name, name + sizeof(name)); // NB: incl. the null terminator
+        const int fd = mkstemp(path.data());
+        if (fd == -1) {
+            return NULL;
+        }
+        unlink(path.data());
+        void *data = MAP_FAILED;
+        if (ftruncate(fd, size) == 0) {
+            data = mmap(0, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        close(fd); // The mapping keeps the file open
+        return data == MAP_FAILED ? NULL : data;
+    }
+
+public:
+    void config(int policy, int64_t threshold) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _policy = policy;
+        _threshold = threshold;
+    }
+
+    void spill_config(const char *dir, int64_t threshold) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _spill_dir = dir == NULL ? "" : dir;
+        _spill_threshold = threshold;
+    }
+
+    void* map(int64_t size) {
+        int policy;
+        std::string spill_dir;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            policy = size >= _threshold ? _policy : BH_HUGEPAGES_NONE;
+            if (not _spill_dir.empty() and _spill_threshold >= 0 and size >= _spill_threshold) {
+                spill_dir = _spill_dir;
+            }
+        }
+        if (not spill_dir.empty()) {
+            void *data = map_spill(spill_dir, size);
+            if (data != NULL) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _unpooled_blocks[data] = static_cast<uint64_t>(size);
+                return data;
+            }
+            // The spill directory isn't writable or is full, let's use the memory instead
+        }
+#ifdef MAP_HUGETLB
+        if (policy == BH_HUGEPAGES_EXPLICIT) {
+            // The length of MAP_HUGETLB blocks must be a multiple of the huge page size
+            const uint64_t length = round_up(static_cast<uint64_t>(size), HUGE_PAGE_SIZE);
+            void *data = mmap(0, length, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+            if (data != MAP_FAILED) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _unpooled_blocks[data] = length;
+                return data;
+            }
+            // No huge pages are reserved, let's use transparent huge pages instead
+            policy = BH_HUGEPAGES_TRANSPARENT;
+        }
+#endif
+        if (policy == BH_HUGEPAGES_TRANSPARENT) {
+            return map_transparent(size);
+        }
+        return map_normal(size);
+    }
+
+    // Returns true when `data` is mapped with MAP_HUGETLB or a spill file, which the memory pool must leave to `unmap()`
+    bool is_unpooled(void *data) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return not _unpooled_blocks.empty() and _unpooled_blocks.find(data) != _unpooled_blocks.end();
+    }
+
+    int unmap(void *data, int64_t size) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto it = _unpooled_blocks.find(data);
+            if (it != _unpooled_blocks.end()) {
+                const uint64_t length = it->second;
+                _unpooled_blocks.erase(it);
+                return munmap(data, length);
+            }
+        }
+        return munmap(data, size);
+    }
+};
+
+/* The memory pool recycles the freed data blocks by size class, which saves the
+ * `mmap()`/`munmap()` syscalls and the page faults of zeroing new pages.
+ * A size class is a number of pages, thus a block can only be reused by an allocation
+ * that maps the same number of pages as `munmap()` would have unmapped.
+ */
+class MemoryPool {
+private:
+    struct Block {
+        void *data;
+        bool trimmed; // The pages of a trimmed block might have been reclaimed
+    };
+    std::mutex _mutex;
+    std::unordered_map<uint64_t, std::vector<Block> > _free_blocks; // Size class => free blocks
+    uint64_t _page_size;
+    int64_t _max_bytes = 0;
+    int64_t _trim_bytes = 256 * 1024 * 1024;
+    uint64_t _untrimmed_bytes = 0; // Bytes in the pool that aren't trimmed
+    bh_memory_pool_stats _stats = {0, 0, 0, 0, 0};
+
+    // Returns the size class of `size` bytes, which is the number of pages
+    uint64_t size_class(int64_t size) const {
+        return (static_cast<uint64_t>(size) + _page_size - 1) / _page_size;
+    }
+
+    // Let the kernel reclaim the pages of `data` under memory pressure. Until then, the pages (and their content)
+    // stay mapped. NB: trimming costs a syscall and a page fault per page on reuse, thus we only trim the blocks
+    // that exceed `_trim_bytes`.
+    static void trim(void *data, uint64_t nbytes) {
+#ifdef MADV_FREE
+        if (madvise(data, nbytes, MADV_FREE) == 0) {
+            return;
+        }
+#endif
+        // MADV_FREE requires Linux 4.5, older kernels discard the pages right away
+        madvise(data, nbytes, MADV_DONTNEED);
+    }
+
+public:
+    MemoryPool() : _page_size(static_cast<uint64_t>(sysconf(_SC_PAGESIZE))) {}
+
+    void config(int64_t max_bytes, int64_t trim_bytes) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _max_bytes = max_bytes;
+        _trim_bytes = trim_bytes;
+    }
+
+    bh_memory_pool_stats stats() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _stats;
+    }
+
+    // Returns a block of `size` bytes from the pool or NULL when the pool has none
+    void* get(int64_t size) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _free_blocks.find(size_class(size));
+        if (it == _free_blocks.end() or it->second.empty()) {
+            ++_stats.misses;
+            return NULL;
+        }
+        const Block block = it->second.back();
+        it->second.pop_back();
+        const uint64_t nbytes = it->first * _page_size;
+        _stats.bytes_retained -= nbytes;
+        if (block.trimmed) {
+            _stats.bytes_trimmed -= nbytes;
+        } else {
+            _untrimmed_bytes -= nbytes;
+        }
+        ++_stats.hits;
+        return block.data;
+    }
+
+    // Put the block `data` of `size` bytes into the pool. Returns false when the pool is full
+    bool put(void *data, int64_t size) {
+        // Blocks that `munmap()` would reject (e.g. not page aligned) are left to `munmap()` to report
+        if (size <= 0 or reinterpret_cast<uintptr_t>(data) % _page_size != 0) {
+            return false;
+        }
+        const uint64_t sclass = size_class(size);
+        const uint64_t nbytes = sclass * _page_size;
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_max_bytes <= 0 or _stats.bytes_retained + nbytes > static_cast<uint64_t>(_max_bytes)) {
+            return false;
+        }
+        Block block = {data, false};
+        if (_trim_bytes >= 0 and _untrimmed_bytes + nbytes > static_cast<uint64_t>(_trim_bytes)) {
+            trim(data, nbytes);
+            block.trimmed = true;
+            _stats.bytes_trimmed += nbytes;
+        } else {
+            _untrimmed_bytes += nbytes;
+        }
+        _free_blocks[sclass].push_back(block);
+        _stats.bytes_retained += nbytes;
+        if (_stats.bytes_retained > _stats.max_bytes_retained) {
+            _stats.max_bytes_retained = _stats.bytes_retained;
+        }
+        return true;
+    }
+
+    // Unmap all blocks in the pool
+    void release() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto &sclass: _free_blocks) {
+            for (const Block &block: sclass.second) {
+                munmap(block.data, sclass.first * _page_size);
+            }
+        }
+        _free_blocks.clear();
+        _stats.bytes_retained = 0;
+        _stats.bytes_trimmed = 0;
+        _untrimmed_bytes = 0;
+    }
+};
+
+// NB: the pool and the mapper are never destroyed since base arrays might be freed by
+//     the destructors of other static objects
+MemoryPool &pool() {
+    static MemoryPool *ret = new MemoryPool();
+    return *ret;
+}
+
+Mapper &mapper() {
+    static Mapper *ret = new Mapper();
+    return *ret;
+}
+
+} // Anonymous Namespace
+#endif
+
+namespace {
+
+// The bytes allocated by `bh_memory_malloc()` and not yet freed, and the maximum hereof
+std::atomic<int64_t> bytes_in_use{0};
+std::atomic<int64_t> max_bytes_in_use{0};
+
+void record_malloc(int64_t size) {
+    const int64_t in_use = bytes_in_use += size;
+    int64_t max = max_bytes_in_use.load();
+    while (in_use > max and not max_bytes_in_use.compare_exchange_weak(max, in_use)) {}
+}
+
+void record_free(int64_t size) {
+    // NB: arrays handed over by NumPy were never allocated by us, thus we never go below zero
+    int64_t in_use = bytes_in_use.load();
+    while (not bytes_in_use.compare_exchange_weak(in_use, in_use > size ? in_use - size : 0)) {}
+}
+
+} // Anonymous Namespace
+
+/* Allocate an alligned contigous block of memory,
+ * does not apply any initialization
+ *
+ * @size  The size of the allocated block
+ * @return A pointer to data, and NULL on error
+ */
+void* bh_memory_malloc(int64_t size)
+{
+#ifdef _WIN32
+    void* data = _aligned_malloc(size, 16);
+#else
+    void* data = pool().get(size);
+    if(data == NULL)
+        data = mapper().map(size); //Allocate page-size aligned memory.
+#endif
+    if(data != NULL)
+        record_malloc(size);
+    return data;
+}
+
+/* Frees a previously allocated data block
+ *
+ * @data  The pointer returned from a call to bh_memory_malloc
+ * @size  The size of the allocated block
+ * @return A pointer to data, and NULL on error
+ */
+int64_t bh_memory_free(void* data, int64_t size)
+{
+	record_free(size);
+#ifdef _WIN32
+	_aligned_free(data);
+	return 0;
+#else
+	if(not mapper().is_unpooled(data) and pool().put(data, size))
+		return 0;
+	return mapper().unmap(data, size);
+#endif
+}
+
+/* Configure the use of huge pages
+ *
+ * @policy     One of the BH_HUGEPAGES_* policies
+ * @threshold  The minimum size in bytes of the blocks that use huge pages
+ */
+void bh_memory_hugepages_config(int policy, int64_t threshold)
+{
+#ifndef _WIN32
+    mapper().config(policy, threshold);
+#endif
+}
+
+/* Configure the spilling of data blocks to disk
+ *
+ * @dir        The directory of the spill files (NULL or empty disables spilling)
+ * @threshold  The minimum size in bytes of the blocks that are backed by spill files (-1 disables spilling)
+ */
+void bh_memory_spill_config(const char *dir, int64_t threshold)
+{
+#ifndef _WIN32
+    mapper().spill_config(dir, threshold);
+#endif
+}
+
+/* Configure the memory pool
+ *
+ * @max_bytes   The maximum number of bytes the pool retains (0 disables the pool)
+ * @trim_bytes  The number of bytes in the pool above which the kernel may reclaim
+ *              the pages of the freed blocks (-1 means never)
+ */
+void bh_memory_pool_config(int64_t max_bytes, int64_t trim_bytes)
+{
+#ifndef _WIN32
+    pool().config(max_bytes, trim_bytes);
+    if(max_bytes <= 0)
+        pool().release();
+#endif
+}
+
+/* Get the statistics of the memory pool
+ *
+ * @return The statistics
+ */
+bh_memory_pool_stats bh_memory_pool_get_stats(void)
+{
+#ifdef _WIN32
+    bh_memory_pool_stats ret = {0, 0, 0, 0, 0};
+    return ret;
+#else
+    return pool().stats();
+#endif
+}
+
+/* Get the number of bytes allocated by bh_memory_malloc() and not yet freed
+ *
+ * @return The usage statistics
+ */
+bh_memory_usage_stats bh_memory_get_usage(void)
+{
+    bh_memory_usage_stats ret = {static_cast<uint64_t>(bytes_in_use.load()),
+                                 static_cast<uint64_t>(max_bytes_in_use.load())};
+    return ret;
+}
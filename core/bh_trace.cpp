@@ -0,0 +1,182 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdexcept>
+
+#include <bh_trace.hpp>
+
+using namespace std;
+
+namespace bohrium {
+
+namespace {
+const char MAGIC[] = "BHTRACE";
+constexpr uint32_t FORMAT_VERSION = 2;
+constexpr uint8_t RECORD_BHIR = 'B';
+constexpr uint8_t RECORD_EXTMETHOD = 'E';
+
+template<typename T>
+void write_pod(ofstream &file, const T &value) {
+    file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+T read_pod(ifstream &file) {
+    T ret;
+    file.read(reinterpret_cast<char *>(&ret), sizeof(T));
+    if (not file) {
+        throw runtime_error("TraceReader: unexpected end of trace");
+    }
+    return ret;
+}
+}
+
+TraceWriter::TraceWriter(const boost::filesystem::path &filename) :
+        _file(filename.string(), ofstream::binary | ofstream::trunc) {
+    if (not _file) {
+        throw runtime_error("TraceWriter: cannot open " + filename.string());
+    }
+    _file.write(MAGIC, sizeof(MAGIC));
+    write_pod(_file, FORMAT_VERSION);
+}
+
+void TraceWriter::write(BhIR &bhir, bool with_data) {
+    vector<bh_base *> new_data;
+    const vector<char> archive = bhir.writeSerializedArchive(_known_base_arrays, new_data);
+    write_pod(_file, RECORD_BHIR);
+    write_pod<uint64_t>(_file, archive.size());
+    _file.write(archive.data(), archive.size());
+    write_pod<uint8_t>(_file, with_data);
+    if (with_data) {
+        for (const bh_base *base: new_data) {
+            const uint64_t nbytes = static_cast<uint64_t>(bh_base_size(base));
+            write_pod(_file, nbytes);
+            _file.write(static_cast<const char *>(base->data), nbytes);
+        }
+    }
+    _file.flush();
+    if (not _file) {
+        throw runtime_error("TraceWriter: failed writing the trace");
+    }
+
+    // Freed base arrays are unknown to the trace from now on since their pointers might be reused
+    for (const bh_instruction &instr: bhir.instr_list) {
+        if (instr.opcode == BH_FREE) {
+            _known_base_arrays.erase(instr.operand[0].base);
+        }
+    }
+}
+
+void TraceWriter::writeExtmethod(const std::string &name, bh_opcode opcode) {
+    write_pod(_file, RECORD_EXTMETHOD);
+    write_pod<int64_t>(_file, opcode);
+    write_pod<uint64_t>(_file, name.size());
+    _file.write(name.data(), name.size());
+    _file.flush();
+    if (not _file) {
+        throw runtime_error("TraceWriter: failed writing the trace");
+    }
+}
+
+TraceReader::TraceReader(const boost::filesystem::path &filename) : _file(filename.string(), ifstream::binary) {
+    if (not _file) {
+        throw runtime_error("TraceReader: cannot open " + filename.string());
+    }
+    char magic[sizeof(MAGIC)];
+    _file.read(magic, sizeof(MAGIC));
+    if (not _file or string(magic, sizeof(MAGIC)) != string(MAGIC, sizeof(MAGIC))) {
+        throw runtime_error("TraceReader: " + filename.string() + " is not a Bohrium trace");
+    }
+    if (read_pod<uint32_t>(_file) != FORMAT_VERSION) {
+        throw runtime_error("TraceReader: unsupported trace version of " + filename.string());
+    }
+}
+
+TraceReader::~TraceReader() {
+    for (auto &base: _remote2local) {
+        bh_data_free(&base.second);
+    }
+}
+
+unique_ptr<BhIR> TraceReader::read(bool load_data, vector<bh_base *> &data_recv,
+                                   vector<pair<string, bh_opcode> > &extmethods) {
+    // Let's release the base arrays freed by the previous BhIR
+    for (const bh_base *base: _frees) {
+        bh_data_free(&_remote2local[base]);
+        _remote2local.erase(base);
+    }
+    _frees.clear();
+
+    extmethods.clear();
+    uint8_t record_type;
+    while (true) {
+        // Notice, the end of the trace is only legal between records
+        _file.read(reinterpret_cast<char *>(&record_type), sizeof(record_type));
+        if (_file.eof() and _file.gcount() == 0) {
+            return nullptr;
+        }
+        if (not _file or record_type == RECORD_BHIR) {
+            break;
+        } else if (record_type == RECORD_EXTMETHOD) {
+            const bh_opcode opcode = read_pod<int64_t>(_file);
+            string name(read_pod<uint64_t>(_file), '\0');
+            _file.read(&name[0], name.size());
+            extmethods.push_back(make_pair(name, opcode));
+        } else {
+            throw runtime_error("TraceReader: corrupted trace");
+        }
+    }
+    const uint64_t archive_size = read_pod<uint64_t>(_file);
+    if (archive_size == 0) {
+        throw runtime_error("TraceReader: corrupted trace");
+    }
+    vector<char> archive(archive_size);
+    _file.read(archive.data(), archive_size);
+    if (not _file) {
+        throw runtime_error("TraceReader: unexpected end of trace");
+    }
+    data_recv.clear();
+    unique_ptr<BhIR> ret(new BhIR(archive, _remote2local, data_recv, _frees));
+
+    // The data pointers of the new base arrays are pointers of the recording process
+    const bool with_data = read_pod<uint8_t>(_file) != 0;
+    for (bh_base *base: data_recv) {
+        base->data = nullptr;
+        if (not with_data) {
+            continue;
+        }
+        const uint64_t nbytes = read_pod<uint64_t>(_file);
+        if (nbytes != static_cast<uint64_t>(bh_base_size(base))) {
+            throw runtime_error("TraceReader: corrupted trace");
+        }
+        if (load_data) {
+            bh_data_malloc(base);
+            _file.read(static_cast<char *>(base->data), nbytes);
+        } else {
+            _file.seekg(nbytes, ios_base::cur);
+        }
+        if (not _file) {
+            throw runtime_error("TraceReader: unexpected end of trace");
+        }
+    }
+    return ret;
+}
+
+} // namespace bohrium
@@ -19,6 +19,8 @@ If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <cassert>
+#include <thread>
+#include <unistd.h>
 
 #include <jitk/apply_fusion.hpp>
 #include <jitk/graph.hpp>
@@ -43,6 +45,17 @@ vector<Block> apply_pre_fusion(const ConfigParser &config, const vector<bh_instr
     }
 }
 
+// Returns the cache size in bytes that the 'tile' transformer targets, which is the config option 'tile_cache_size'
+// in KB or the size of the L2 cache when the option is zero
+uint64_t tile_cache_bytes(const ConfigParser &config) {
+    uint64_t ret = config.defaultGet<uint64_t>("tile_cache_size", 0) * 1024;
+    if (ret == 0) {
+        const long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        ret = l2 > 0 ? static_cast<uint64_t>(l2) : 256 * 1024;
+    }
+    return ret;
+}
+
 // Apply the list of tranformers specified by the names in 'transformer_names'
 // 'avoid_rank0_sweep' will avoid fusion of sweeped and non-sweeped blocks at the root level
 void apply_transformers(const ConfigParser &config, vector<Block> &block_list, const vector<string> &transformer_names,
@@ -53,6 +66,10 @@ void apply_transformers(const ConfigParser &config, vector<Block> &block_list, c
             push_reductions_inwards(block_list);
         } else if (*it == "split_for_threading") {
             split_for_threading(block_list);
+        } else if (*it == "push_unit_strides_inwards") {
+            push_unit_strides_inwards(block_list);
+        } else if (*it == "tile") {
+            tile(block_list, tile_cache_bytes(config), std::max(std::thread::hardware_concurrency(), 1u));
         } else if (*it == "collapse_redundant_axes") {
             collapse_redundant_axes(block_list);
         } else if (*it == "serial") {
@@ -63,6 +80,8 @@ void apply_transformers(const ConfigParser &config, vector<Block> &block_list, c
             fuser_reshapable_first(block_list, avoid_rank0_sweep);
         } else if (*it == "greedy") {
             fuser_greedy(config, block_list, avoid_rank0_sweep);
+        } else if (*it == "optimal") {
+            fuser_optimal(config, block_list, avoid_rank0_sweep);
         } else {
             cout << "Unknown transformer: \"" << *it << "\"" << endl;
             throw runtime_error("Unknown transformer!");
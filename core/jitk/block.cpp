@@ -18,6 +18,7 @@ GNU Lesser General Public License along with Bohrium.
 If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <sstream>
 #include <cassert>
 
@@ -508,6 +509,65 @@ pair<uint64_t, uint64_t> parallel_ranks(const LoopB &block, unsigned int max_dep
     return ret;
 }
 
+pair<uint64_t, uint64_t> allocs_and_frees(const Block &block, const set<const bh_base*> &allocated) {
+    pair<uint64_t, uint64_t> ret = make_pair(0, 0);
+    if (block.isInstr()) {
+        return ret;
+    }
+    const set<bh_base *> non_temps = block.getLoop().getAllNonTemps();
+    for (const bh_base *base: non_temps) {
+        if (base->data == nullptr and not util::exist(allocated, base)) {
+            ret.first += bh_base_size(base);
+        }
+    }
+    for (const bh_base *base: block.getLoop().getAllFrees()) {
+        if (base->data != nullptr or util::exist(allocated, base) or util::exist_nconst(non_temps, base)) {
+            ret.second += bh_base_size(base);
+        }
+    }
+    return ret;
+}
+
+uint64_t peak_memory(const vector<Block> &block_list) {
+    set<const bh_base*> allocated;
+    int64_t live = 0, peak = 0;
+    for (const Block &block: block_list) {
+        const pair<uint64_t, uint64_t> bytes = allocs_and_frees(block, allocated);
+        live += bytes.first;
+        peak = std::max(peak, live);
+        live -= bytes.second;
+        if (not block.isInstr()) {
+            for (const bh_base *base: block.getLoop().getAllNonTemps()) {
+                allocated.insert(base);
+            }
+            for (const bh_base *base: block.getLoop().getAllFrees()) {
+                allocated.erase(base);
+            }
+        }
+    }
+    return static_cast<uint64_t>(peak);
+}
+
+uint64_t peak_memory(const vector<bh_instruction*> &instr_list) {
+    set<const bh_base*> allocated;
+    int64_t live = 0, peak = 0;
+    for (const bh_instruction *instr: instr_list) {
+        const bh_base *base = instr->operand.empty() ? nullptr : instr->operand[0].base;
+        if (instr->opcode == BH_FREE) {
+            if (base->data != nullptr or util::exist(allocated, base)) {
+                live -= bh_base_size(base);
+                allocated.erase(base);
+            }
+        } else if (not bh_opcode_is_system(instr->opcode) and base->data == nullptr and
+                   not util::exist(allocated, base)) {
+            live += bh_base_size(base);
+            peak = std::max(peak, live);
+            allocated.insert(base);
+        }
+    }
+    return static_cast<uint64_t>(peak);
+}
+
 void get_first_loop_blocks(const LoopB &block, vector<const LoopB*> &out) {
     out.push_back(&block);
     if (not block._block_list.empty() and not block._block_list[0].isInstr()) {
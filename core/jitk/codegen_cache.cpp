@@ -20,8 +20,12 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include <vector>
 #include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
 
 #include <jitk/codegen_cache.hpp>
+#include <jitk/codegen_util.hpp>
 
 using namespace std;
 
@@ -30,108 +34,158 @@ namespace jitk {
 
 namespace {
 
+constexpr uint64_t SEP_INSTR = UINT64_MAX;
+constexpr uint64_t SEP_VIEW = UINT64_MAX - 1;
+constexpr uint64_t SEP_CONSTANT = UINT64_MAX - 2;
+constexpr uint64_t SEP_BLOCK = UINT64_MAX - 3;
+constexpr uint64_t SEP_FREED = UINT64_MAX - 4;
+constexpr uint64_t SEP_BLOCK_LIST = UINT64_MAX - 5;
+
 /* The View hash consists of the following fields:
- * <view_id><start><ndim>[<shape><stride><SEP_SHAPE>...]<SEP_OP>
+ * <SEP_VIEW><dtype><base_id>[<strides_id>|<start>[<shape><stride>...]][<index_id><is-1-elem>]
  */
-void hash_stream(const bh_view &view, const SymbolTable &symbols, std::stringstream &ss) {
-    ss << "dtype: " << static_cast<uint32_t>(view.base->type);
-    ss << "baseid: " << symbols.baseID(view.base);
+void hash_stream(const bh_view &view, const SymbolTable &symbols, util::Hasher &hasher) {
+    hasher << SEP_VIEW << view.base->type << symbols.baseID(view.base);
 
     if (symbols.strides_as_var) {
-        ss << "strideid: " << symbols.offsetStridesID(view);
+        hasher << symbols.offsetStridesID(view);
     } else {
-        ss << "vstart: " << view.start;
+        hasher << view.start << view.ndim;
         for (int j = 0; j < view.ndim; ++j) {
-            ss << "dim: " << j;
-            ss << "shape: " << view.shape[j];
-            ss << "stride: " << view.stride[j];
+            hasher << view.shape[j] << view.stride[j];
         }
     }
     if (symbols.index_as_var) {
-        ss << "indexid: " << symbols.idxID(view);
-        if (bh_is_scalar(&view)) { // We optimize indexes into 1-sized arrays, which we need the hash to reflect
-            ss << "is-1-elem: " << endl;
-        }
+        // We optimize indexes into 1-sized arrays, which we need the hash to reflect
+        hasher << symbols.idxID(view) << bh_is_scalar(&view);
+    }
+}
+
+/* The Constant hash consists of the following fields:
+ * <SEP_CONSTANT><dtype>[<const_id>|<value>...]
+ */
+void hash_stream(const bh_instruction &instr, const SymbolTable &symbols, util::Hasher &hasher) {
+    const bh_constant &constant = instr.constant;
+    hasher << SEP_CONSTANT << constant.type;
+    const int64_t id = symbols.constID(instr);
+    if (id >= 0 and symbols.const_as_var) {
+        hasher << id;
+    } else {
+        // The value is hashed as the raw bits of its type thus the unused bytes of the union are ignored
+        uint64_t words[2] = {0, 0};
+        const int size = bh_type_size(constant.type);
+        assert(size <= static_cast<int>(sizeof(words)));
+        memcpy(words, &constant.value, static_cast<size_t>(size));
+        hasher << words[0] << words[1];
     }
 }
 
 /* The Instruction hash consists of the following fields:
- * <opcode[<hash_view>...]<sweep_axis()><SEP_INSTR>
+ * <opcode>[<hash_view>|<hash_constant>...]<sweep_axis()><SEP_INSTR>
  */
-void hash_stream(const bh_instruction &instr, const SymbolTable &symbols, std::stringstream &ss) {
-    ss << "opcode: " << instr.opcode;
+void hash_instr(const bh_instruction &instr, const SymbolTable &symbols, util::Hasher &hasher) {
+    hasher << instr.opcode;
     for (const bh_view &op: instr.operand) {
         if (bh_is_constant(&op)) {
-            int64_t id = symbols.constID(instr);
-            if (id >= 0 and symbols.const_as_var) {
-                ss << "const: " << symbols.constID(instr);
-            } else {
-                ss << "const: " << instr.constant;
-            }
-            ss << "const dtype: " << static_cast<uint32_t >(instr.constant.type);
+            hash_stream(instr, symbols, hasher);
         } else {
-            hash_stream(op, symbols,  ss);
+            hash_stream(op, symbols, hasher);
         }
     }
-    ss << "sweep: " << instr.sweep_axis();
+    hasher << instr.sweep_axis() << SEP_INSTR;
 }
 
 /* The Block hash consists of the following fields:
- * <block_rank><instr_hash><SEP_BLOCK>
+ * <hash_instr> or <SEP_BLOCK><block_rank><size><SEP_FREED>[<freed_base_id>...][<block_hash>...]<SEP_BLOCK>
  */
-void hash_stream(const Block &block, const SymbolTable &symbols, std::stringstream &ss) {
+void hash_stream(const Block &block, const SymbolTable &symbols, util::Hasher &hasher) {
     if (block.isInstr()) {
         if (block.getInstr()->opcode != BH_FREE) {
-            hash_stream(*block.getInstr(), symbols, ss);
+            hash_instr(*block.getInstr(), symbols, hasher);
         }
     } else {
-        ss << "rank: " << block.rank();
-        ss << "size: " << block.getLoop().size;
+        hasher << SEP_BLOCK << block.rank() << block.getLoop().size << SEP_FREED;
         {  // The order of BH_FREE within a block doesn't matter, thus we sort the freed base IDs here
-            ss << "freed: ";
-            set<uint64_t >sorted_freed_bases;
+            vector<uint64_t> sorted_freed_bases;
+            sorted_freed_bases.reserve(block.getLoop()._frees.size());
             for (const bh_base *b: block.getLoop()._frees) {
-                sorted_freed_bases.insert(symbols.baseID(b));
+                sorted_freed_bases.push_back(symbols.baseID(b));
             }
-            for(uint64_t b_id: sorted_freed_bases) {
-                ss << b_id << ",";
+            std::sort(sorted_freed_bases.begin(), sorted_freed_bases.end());
+            for (uint64_t b_id: sorted_freed_bases) {
+                hasher << b_id;
             }
         }
         for (const Block &b: block.getLoop()._block_list) {
-            hash_stream(b, symbols, ss);
+            hash_stream(b, symbols, hasher);
         }
+        hasher << SEP_BLOCK;
     }
 }
 
 /* The Block list hash consists of the following fields:
- * <block_rank><SEP_BLOCK>
+ * [<block_hash><SEP_BLOCK_LIST>...]
+ * NB: the 'variant' seeds the hash
  */
-uint64_t block_list_hash(const std::vector<Block> &block_list, const SymbolTable &symbols) {
-    stringstream ss;
+uint64_t block_list_hash(const std::vector<Block> &block_list, const SymbolTable &symbols, uint64_t variant) {
+    util::Hasher hasher(variant);
     for (const Block &b: block_list) {
-        hash_stream(b, symbols, ss);
-        ss << "<block>";
+        hash_stream(b, symbols, hasher);
+        hasher << SEP_BLOCK_LIST;
     }
-    return util::hash(ss.str());
+    return hasher.digest();
 }
 } // Anonymous Namespace
 
-std::pair<std::string, uint64_t> CodegenCache::get(const std::vector<Block> &block_list, const SymbolTable &symbols) {
+bool CodegenCache::load(uint64_t lookup_hash) {
+    if (_store == nullptr) {
+        return false;
+    }
+    const string filename = hash_filename(_store_salt, lookup_hash, ".codegen");
+    if (not _store->lookup(filename)) {
+        return false;
+    }
+    ifstream file(_store->path(filename).string(), ios::binary);
+    stringstream ss;
+    ss << file.rdbuf();
+    if (file.fail() or ss.str().empty()) {
+        cout << "Warning: couldn't load " << _store->path(filename) << endl;
+        return false;
+    }
+    _cache[lookup_hash] = ss.str();
+    ++stat.codegen_cache_loads;
+    return true;
+}
+
+std::pair<const std::string *, uint64_t> CodegenCache::get(const std::vector<Block> &block_list,
+                                                           const SymbolTable &symbols, uint64_t variant) {
     ++stat.codegen_cache_lookups;
-    const uint64_t lookup_hash = block_list_hash(block_list, symbols);
+    const uint64_t lookup_hash = block_list_hash(block_list, symbols, variant);
     auto lookup = _cache.find(lookup_hash);
+    if (lookup == _cache.end() and load(lookup_hash)) {
+        lookup = _cache.find(lookup_hash);
+    }
     if (lookup != _cache.end()) { // Cache hit!
-        return make_pair(lookup->second, lookup_hash);
+        return make_pair(&lookup->second, lookup_hash);
     } else {
         ++stat.codegen_cache_misses;
-        return make_pair("", lookup_hash);
+        return make_pair(nullptr, lookup_hash);
     }
 }
 
-void CodegenCache::insert(std::string source, const std::vector<Block> &block_list, const SymbolTable &symbols) {
-    const uint64_t lookup_hash = block_list_hash(block_list, symbols);
+const std::string &CodegenCache::insert(std::string source, const std::vector<Block> &block_list,
+                                        const SymbolTable &symbols, uint64_t variant) {
+    const uint64_t lookup_hash = block_list_hash(block_list, symbols, variant);
     assert(_cache.find(lookup_hash) == _cache.end()); // The source shouldn't exist in the cache already
-    _cache[lookup_hash] = std::move(source);
+    if (_store != nullptr) {
+        try {
+            _store->publish(source.data(), source.size(), hash_filename(_store_salt, lookup_hash, ".codegen"));
+        } catch (const std::exception &e) {
+            cout << "Warning: couldn't save the codegen cache entry. " << e.what() << endl;
+        }
+    }
+    // NB: an existing source is never replaced since `get()` hands out pointers to it
+    return _cache.emplace(lookup_hash, std::move(source)).first->second;
 }
 
 } // jitk
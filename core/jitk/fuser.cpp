@@ -379,14 +379,21 @@ void fuser_greedy(const ConfigParser &config, vector<Block> &block_list, bool av
 
     graph::DAG dag = graph::from_block_list(block_list);
 
-    size_t greedy_threshold = config.defaultGet<size_t>("greedy_threshold", 10000);
+    size_t greedy_threshold = config.defaultGet<size_t>("greedy_threshold", 100000);
     if (boost::num_edges(dag) > greedy_threshold) {
         fuser_reshapable_first(block_list, avoid_rank0_sweep);
         return;
     }
 
     graph::greedy(dag, avoid_rank0_sweep);
-    vector<Block> ret = graph::fill_block_list(dag);
+
+    // The order of the blocks only affects the memory usage at the outermost level
+    const bool min_peak_memory = config.defaultGet<bool>("min_peak_memory", false) and
+                                 not block_list.empty() and block_list.front().rank() == 0;
+    vector<Block> ret = graph::fill_block_list(dag, min_peak_memory);
+    if (min_peak_memory) {
+        graph::free_after_last_access(ret);
+    }
 
     // Let's fuse at the next rank level
     for (Block &b: ret) {
@@ -397,5 +404,49 @@ void fuser_greedy(const ConfigParser &config, vector<Block> &block_list, bool av
     block_list = ret;
 }
 
+namespace {
+// Returns the total cost of the blocks in 'block_list' (see `graph::block_cost()`)
+uint64_t total_cost(const vector<Block> &block_list) {
+    uint64_t ret = 0;
+    for (const Block &b: block_list) {
+        ret += graph::block_cost(b);
+    }
+    return ret;
+}
+}
+
+void fuser_optimal(const ConfigParser &config, vector<Block> &block_list, bool avoid_rank0_sweep) {
+
+    graph::DAG dag = graph::from_block_list(block_list);
+
+    const size_t optimal_threshold = config.defaultGet<size_t>("optimal_threshold", 100);
+    if (boost::num_vertices(dag) > optimal_threshold) {
+        fuser_greedy(config, block_list, avoid_rank0_sweep);
+        return;
+    }
+
+    // The search only sees the outermost level, but fusing the next rank levels turns more arrays into temporary
+    // arrays. Thus, the greedy fusion of all levels might still be cheaper in the end, in which case we use it.
+    vector<Block> greedy_list = block_list;
+    fuser_greedy(config, greedy_list, avoid_rank0_sweep);
+
+    graph::optimal(dag, avoid_rank0_sweep, config.defaultGet<uint64_t>("optimal_time_budget", 1000));
+
+    const bool min_peak_memory = config.defaultGet<bool>("min_peak_memory", false) and
+                                 not block_list.empty() and block_list.front().rank() == 0;
+    vector<Block> ret = graph::fill_block_list(dag, min_peak_memory);
+    if (min_peak_memory) {
+        graph::free_after_last_access(ret);
+    }
+
+    // The next rank levels are fused greedily
+    for (Block &b: ret) {
+        if (not b.isInstr()) {
+            fuser_greedy(config, b.getLoop()._block_list, avoid_rank0_sweep);
+        }
+    }
+    block_list = total_cost(ret) < total_cost(greedy_list) ? ret : greedy_list;
+}
+
 } // jitk
 } // bohrium
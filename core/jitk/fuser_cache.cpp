@@ -20,8 +20,15 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include <vector>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/array.hpp>
 
 #include <jitk/fuser_cache.hpp>
+#include <jitk/codegen_util.hpp>
 
 
 using namespace std;
@@ -31,79 +38,122 @@ namespace jitk {
 
 namespace {
 
-// Handling view IDs
+// Handling view IDs using a flat hash table with linear probing.
+// NB: the table points to the views of the instruction list, which must outlive the ViewDB
 class ViewDB {
 private:
+    struct Entry {
+        const bh_view *view;
+        uint64_t hash;
+        size_t id;
+    };
     size_t maxid;
-    std::map<bh_view,size_t> _map;
+    size_t _mask;
+    std::vector<Entry> _table;
+
+    static uint64_t hash_of(const bh_view &v) {
+        util::Hasher hasher;
+        hasher << reinterpret_cast<uintptr_t>(v.base) << v.start << v.ndim;
+        for (int64_t i = 0; i < v.ndim; ++i) {
+            hasher << v.shape[i] << v.stride[i];
+        }
+        return hasher.digest();
+    }
+
+    // Double the size of the table
+    void grow() {
+        std::vector<Entry> old(_table.size() * 2, Entry{nullptr, 0, 0});
+        old.swap(_table);
+        _mask = _table.size() - 1;
+        for (const Entry &e: old) {
+            if (e.view != nullptr) {
+                size_t i = e.hash & _mask;
+                while (_table[i].view != nullptr) {
+                    i = (i + 1) & _mask;
+                }
+                _table[i] = e;
+            }
+        }
+    }
+
 public:
-    ViewDB() : maxid(0) {}
+    // Create a view DB that has room for at least `num_views` views without growing
+    explicit ViewDB(size_t num_views) : maxid(0) {
+        size_t capacity = 16;
+        while (capacity < num_views * 2) {
+            capacity *= 2;
+        }
+        _mask = capacity - 1;
+        _table.resize(capacity, Entry{nullptr, 0, 0});
+    }
 
     // Insert an object
     std::pair<size_t,bool> insert(const bh_view &v) {
-        auto it = _map.find(v);
-        if (it == _map.end()) {
-            size_t id = maxid++;
-            _map.insert(std::make_pair(v,id));
-            return std::make_pair(id,true);
-
-        } else {
-            return  std::make_pair(it->second,false);
+        if (maxid * 2 >= _table.size()) {
+            grow();
+        }
+        const uint64_t hash = hash_of(v);
+        for (size_t i = hash & _mask; ; i = (i + 1) & _mask) {
+            Entry &e = _table[i];
+            if (e.view == nullptr) {
+                e = Entry{&v, hash, maxid++};
+                return std::make_pair(e.id, true);
+            }
+            if (e.hash == hash and *e.view == v) {
+                return std::make_pair(e.id, false);
+            }
         }
     }
 };
 
 
-constexpr size_t SEP_INSTR = SIZE_MAX;
-constexpr size_t SEP_OP = SIZE_MAX - 1;
-constexpr size_t SEP_SHAPE = SIZE_MAX - 2;
-constexpr size_t SEP_CONSTANT = SIZE_MAX - 3;
+constexpr uint64_t SEP_INSTR = UINT64_MAX;
+constexpr uint64_t SEP_OP = UINT64_MAX - 1;
+constexpr uint64_t SEP_CONSTANT = UINT64_MAX - 2;
+constexpr uint64_t SEP_SLIDE = UINT64_MAX - 3;
 
-/* The Instruction hash consists of the following fields:
- * <view_id><start><ndim>[<shape><stride><SEP_SHAPE>...]<SEP_OP>
+/* The View hash consists of the following fields:
+ * <view_id>[<start>|<SEP_SLIDE>]<ndim>[<shape><stride>...]<SEP_OP>
  */
-void hash_view(const bh_view &view, ViewDB &views, std::stringstream &ss) {
+void hash_view(const bh_view &view, ViewDB &views, util::Hasher &hasher) {
     if (not bh_is_constant(&view)) {
-        size_t view_id = views.insert(view).first;
-        ss << view_id;
+        hasher << views.insert(view).first;
         // Sliding views has identical hashes across iterations
         if (view.slide.empty()) {
-            ss << view.start;
+            hasher << view.start;
+        } else {
+            hasher << SEP_SLIDE;
         }
-
-        ss << view.ndim;
+        hasher << view.ndim;
         for (int j = 0; j < view.ndim; ++j) {
-            ss << view.shape[j];
-            ss << view.stride[j];
-            ss << SEP_SHAPE;
+            hasher << view.shape[j] << view.stride[j];
         }
-        ss << SEP_OP;
+        hasher << SEP_OP;
     } else {
         // Notice, we can ignore the value of the constant but we need to hash the location of the constant
-        ss << SEP_CONSTANT;
+        hasher << SEP_CONSTANT;
     }
 }
 
 /* The Instruction hash consists of the following fields:
- * <opcode[<hash_view>...]<sweep_axis()><SEP_INSTR>
+ * <opcode>[<hash_view>...]<sweep_axis()><SEP_INSTR>
  */
-void hash_instr(const bh_instruction &instr, ViewDB &views, std::stringstream &ss) {
-    ss << instr.opcode; // <opcode>
+void hash_instr(const bh_instruction &instr, ViewDB &views, util::Hasher &hasher) {
+    hasher << instr.opcode;
     for(const bh_view &op: instr.operand) {
-        hash_view(op, views, ss);
+        hash_view(op, views, hasher);
     }
-    ss << instr.sweep_axis();
-    ss << SEP_INSTR;
+    hasher << instr.sweep_axis() << SEP_INSTR;
 }
 
 // Hash of an instruction list
 size_t hash_instr_list(const vector<bh_instruction *> &instr_list) {
-    stringstream ss;
-    ViewDB views;
+    util::Hasher hasher;
+    ViewDB views(instr_list.size() * 3);
     for (const bh_instruction *instr: instr_list) {
-        hash_instr(*instr, views, ss);
+        hash_instr(*instr, views, hasher);
     }
-    return util::hash(ss.str());
+    return hasher.digest();
 }
 
 // Replace the cached values of constants and bases arrays in `instr` with their original values
@@ -113,7 +163,14 @@ void update_with_origin(bh_instruction &instr, const bh_instruction *origin,
     assert(instr.opcode == origin->opcode);
     for (size_t i = 0; i < instr.operand.size(); ++i) {
         if (not instr.operand[i].slide.empty()) {
-            instr.operand[i].start = origin->operand[i].start;
+            // NB: the hash ignores how the views slide thus we also need the slides of the origin
+            const bh_view &view = origin->operand[i];
+            instr.operand[i].start = view.start;
+            instr.operand[i].slide = view.slide;
+            instr.operand[i].slide_dim = view.slide_dim;
+            instr.operand[i].slide_dim_shape_change = view.slide_dim_shape_change;
+            instr.operand[i].slide_dim_stride = view.slide_dim_stride;
+            instr.operand[i].slide_dim_shape = view.slide_dim_shape;
         }
 
         if (bh_is_constant(&instr.operand[i])) {
@@ -165,13 +222,186 @@ std::vector<bh_base*> calc_base_ids(const vector<bh_instruction *> &instr_list)
     }
     return ret;
 }
+
+// The version of the serialized payloads, which must be incremented when the format changes
+constexpr uint32_t SERIALIZE_VERSION = 1;
+
+// Serialize 'view' where the base array is written as its base ID
+void save_view(boost::archive::binary_oarchive &ar, const bh_view &view, const map<bh_base*, uint64_t> &base2id) {
+    const bool constant = bh_is_constant(&view);
+    ar << constant;
+    if (not constant) {
+        const uint64_t base_id = base2id.at(view.base);
+        ar << base_id << view.start << view.ndim;
+        for (int64_t i = 0; i < view.ndim; ++i) {
+            ar << view.shape[i] << view.stride[i];
+        }
+        ar << view.slide << view.slide_dim << view.slide_dim_shape_change << view.slide_dim_stride
+           << view.slide_dim_shape;
+    }
+}
+
+void load_view(boost::archive::binary_iarchive &ar, bh_view &view, const vector<bh_base*> &id2base) {
+    bool constant;
+    ar >> constant;
+    if (constant) {
+        view.base = nullptr;
+        return;
+    }
+    uint64_t base_id;
+    ar >> base_id >> view.start >> view.ndim;
+    view.base = id2base.at(base_id);
+    if (view.ndim < 0 or view.ndim >= BH_MAXDIM) {
+        throw runtime_error("invalid number of dimensions");
+    }
+    for (int64_t i = 0; i < view.ndim; ++i) {
+        ar >> view.shape[i] >> view.stride[i];
+    }
+    ar >> view.slide >> view.slide_dim >> view.slide_dim_shape_change >> view.slide_dim_stride
+       >> view.slide_dim_shape;
+}
+
+void save_instr(boost::archive::binary_oarchive &ar, const bh_instruction &instr,
+                const map<bh_base*, uint64_t> &base2id) {
+    bh_constant constant = instr.constant;
+    const uint64_t noperands = instr.operand.size();
+    ar << instr.opcode << instr.constructor << instr.origin_id;
+    ar << boost::serialization::make_array(&constant, 1);
+    ar << noperands;
+    for (const bh_view &view: instr.operand) {
+        save_view(ar, view, base2id);
+    }
+}
+
+void load_instr(boost::archive::binary_iarchive &ar, bh_instruction &instr, const vector<bh_base*> &id2base) {
+    uint64_t noperands;
+    ar >> instr.opcode >> instr.constructor >> instr.origin_id;
+    ar >> boost::serialization::make_array(&instr.constant, 1);
+    ar >> noperands;
+    if (noperands > 4) { // NB: BH_COND_SCATTER has four operands
+        throw runtime_error("invalid number of operands");
+    }
+    instr.operand.resize(noperands);
+    for (bh_view &view: instr.operand) {
+        load_view(ar, view, id2base);
+    }
+}
+
+void save_block(boost::archive::binary_oarchive &ar, const Block &block, const map<bh_base*, uint64_t> &base2id) {
+    const bool is_instr = block.isInstr();
+    const int rank = block.rank();
+    ar << is_instr << rank;
+    if (is_instr) {
+        save_instr(ar, *block.getInstr(), base2id);
+    } else {
+        const LoopB &loop = block.getLoop();
+        const uint64_t nfrees = loop._frees.size();
+        const uint64_t nblocks = loop._block_list.size();
+        ar << loop.size << nfrees;
+        for (bh_base *base: loop._frees) {
+            const uint64_t base_id = base2id.at(base);
+            ar << base_id;
+        }
+        ar << nblocks;
+        for (const Block &b: loop._block_list) {
+            save_block(ar, b, base2id);
+        }
+    }
+}
+
+Block load_block(boost::archive::binary_iarchive &ar, const vector<bh_base*> &id2base) {
+    bool is_instr;
+    int rank;
+    ar >> is_instr >> rank;
+    if (is_instr) {
+        bh_instruction instr;
+        load_instr(ar, instr, id2base);
+        return Block(instr, rank);
+    }
+    LoopB loop;
+    uint64_t nfrees, nblocks;
+    loop.rank = rank;
+    ar >> loop.size >> nfrees;
+    for (uint64_t i = 0; i < nfrees; ++i) {
+        uint64_t base_id;
+        ar >> base_id;
+        loop._frees.insert(id2base.at(base_id));
+    }
+    ar >> nblocks;
+    for (uint64_t i = 0; i < nblocks; ++i) {
+        loop._block_list.push_back(load_block(ar, id2base));
+    }
+    loop.metadataUpdate();
+    return Block(std::move(loop));
+}
 } // Anon namespace
 
+string FuseCache::filename(size_t lookup_hash) const {
+    return hash_filename(_store_salt, lookup_hash, ".fuse");
+}
+
+bool FuseCache::load(size_t lookup_hash) {
+    if (_store == nullptr or not _store->lookup(filename(lookup_hash))) {
+        return false;
+    }
+    try {
+        ifstream file(_store->path(filename(lookup_hash)).string(), ios::binary);
+        boost::archive::binary_iarchive ar(file);
+        uint32_t version;
+        uint64_t hash, nbases, nblocks;
+        ar >> version >> hash;
+        if (version != SERIALIZE_VERSION or hash != lookup_hash) {
+            return false;
+        }
+        // The cached base arrays are never dereferenced, they only identify the base IDs of new lookups
+        // thus we use the (non-null) base IDs as pointers
+        CachePayload payload;
+        ar >> nbases;
+        for (uint64_t i = 0; i < nbases; ++i) {
+            payload.base_ids.push_back(reinterpret_cast<bh_base*>(i + 1));
+        }
+        ar >> nblocks;
+        for (uint64_t i = 0; i < nblocks; ++i) {
+            payload.block_list.push_back(load_block(ar, payload.base_ids));
+        }
+        _cache.insert(make_pair(lookup_hash, std::move(payload)));
+    } catch (const std::exception &e) {
+        cout << "Warning: couldn't load " << _store->path(filename(lookup_hash)) << ". " << e.what() << endl;
+        return false;
+    }
+    ++stat.fuser_cache_loads;
+    return true;
+}
+
+void FuseCache::save(size_t lookup_hash, const CachePayload &payload) const {
+    try {
+        map<bh_base*, uint64_t> base2id;
+        for (uint64_t i = 0; i < payload.base_ids.size(); ++i) {
+            base2id[payload.base_ids[i]] = i;
+        }
+        stringstream ss;
+        {
+            boost::archive::binary_oarchive ar(ss);
+            const uint64_t hash = lookup_hash;
+            const uint64_t nbases = payload.base_ids.size();
+            const uint64_t nblocks = payload.block_list.size();
+            ar << SERIALIZE_VERSION << hash << nbases << nblocks;
+            for (const Block &block: payload.block_list) {
+                save_block(ar, block, base2id);
+            }
+        }
+        const string data = ss.str();
+        _store->publish(data.data(), data.size(), filename(lookup_hash));
+    } catch (const std::exception &e) {
+        cout << "Warning: couldn't save the fuse cache entry " << filename(lookup_hash) << ". " << e.what() << endl;
+    }
+}
+
 pair<vector<Block>, bool> FuseCache::get(const vector<bh_instruction *> &instr_list) {
     const size_t lookup_hash = hash_instr_list(instr_list);
     ++stat.fuser_cache_lookups;
 
-    if (_cache.find(lookup_hash) != _cache.end()) { // Cache hit!
+    if (_cache.find(lookup_hash) != _cache.end() or load(lookup_hash)) { // Cache hit!
         // Create a map: 'origin_id' => instruction for updating the constants
         map<int64_t, const bh_instruction *> origin_id_to_instr;
         for(const bh_instruction *instr: instr_list) {
@@ -204,6 +434,9 @@ pair<vector<Block>, bool> FuseCache::get(const vector<bh_instruction *> &instr_l
 void FuseCache::insert(const vector<bh_instruction *> &instr_list, vector<Block> block_list) {
     const size_t lookup_hash = hash_instr_list(instr_list);
     CachePayload payload = {std::move(block_list), calc_base_ids(instr_list)};
+    if (_store != nullptr) {
+        save(lookup_hash, payload);
+    }
     _cache.insert(make_pair(lookup_hash, std::move(payload)));
 }
 
@@ -24,13 +24,17 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <boost/graph/graphviz.hpp>
 #include <boost/graph/topological_sort.hpp>
 #include <boost/foreach.hpp>
+#include <boost/dynamic_bitset.hpp>
+#include <chrono>
 #include <fstream>
 #include <numeric>
 #include <queue>
+#include <tuple>
 #include <cassert>
 
 #include <jitk/graph.hpp>
 #include <jitk/block.hpp>
+#include <bh_util.hpp>
 
 using namespace std;
 
@@ -122,31 +126,168 @@ DAG from_block_list(const vector<Block> &block_list) {
     return graph;
 }
 
-vector<Block> fill_block_list(const DAG &dag) {
+vector<Block> fill_block_list(const DAG &dag, bool min_peak_memory) {
     vector<Block> ret;
     vector<Vertex> topological_order;
     boost::topological_sort(dag, back_inserter(topological_order));
     BOOST_REVERSE_FOREACH(const Vertex &v, topological_order) {
         ret.push_back(dag[v]);
     }
+    if (not min_peak_memory or ret.size() < 3) {
+        return ret;
+    }
+
+    // We schedule the blocks in a list: of the blocks ready for execution, we pick the system blocks (frees) first,
+    // then the block that allocates the fewest bytes net. Ties are broken by the regular topological order.
+    const size_t num_vertices = boost::num_vertices(dag);
+    vector<size_t> position(num_vertices), in_degree(num_vertices);
+    for (size_t i = 0; i < topological_order.size(); ++i) {
+        position[topological_order[i]] = topological_order.size() - i - 1;
+    }
+    vector<Vertex> ready;
+    BOOST_FOREACH(Vertex v, boost::vertices(dag)) {
+        in_degree[v] = boost::in_degree(v, dag);
+        if (in_degree[v] == 0) {
+            ready.push_back(v);
+        }
+    }
+    vector<Block> memory_order;
+    memory_order.reserve(ret.size());
+    set<const bh_base*> allocated;
+    while (not ready.empty()) {
+        // NB: the net allocation of a block depends on the arrays allocated by the blocks scheduled so far
+        typedef tuple<bool, int64_t, size_t> Priority; // (not system only, net allocation, position)
+        auto best = ready.end();
+        Priority best_priority;
+        for (auto it = ready.begin(); it != ready.end(); ++it) {
+            const pair<uint64_t, uint64_t> bytes = allocs_and_frees(dag[*it], allocated);
+            const Priority priority = make_tuple(not dag[*it].isSystemOnly(),
+                                                 static_cast<int64_t>(bytes.first) - static_cast<int64_t>(bytes.second),
+                                                 position[*it]);
+            if (best == ready.end() or priority < best_priority) {
+                best = it;
+                best_priority = priority;
+            }
+        }
+        const Vertex v = *best;
+        ready.erase(best);
+        const Block &block = dag[v];
+        memory_order.push_back(block);
+        if (not block.isInstr()) {
+            for (const bh_base *base: block.getLoop().getAllNonTemps()) {
+                allocated.insert(base);
+            }
+            for (const bh_base *base: block.getLoop().getAllFrees()) {
+                allocated.erase(base);
+            }
+        }
+        BOOST_FOREACH(Vertex child, boost::adjacent_vertices(v, dag)) {
+            if (--in_degree[child] == 0) {
+                ready.push_back(child);
+            }
+        }
+    }
+    assert(memory_order.size() == ret.size());
+
+    // The list scheduling is a heuristic thus we fall back to the regular order when it isn't better
+    if (peak_memory(memory_order) < peak_memory(ret)) {
+        return memory_order;
+    }
     return ret;
 }
 
-uint64_t weight(const Block &b1, const Block &b2) {
-    if (b1.isInstr() or b2.isInstr()) {
-        return 0; // Instruction blocks cannot be fused
+namespace {
+// Help function that removes 'base' from the frees of 'loop' and all its sub-blocks
+void remove_free(LoopB &loop, bh_base *base) {
+    loop._frees.erase(base);
+    for (Block &b: loop._block_list) {
+        if (not b.isInstr()) {
+            remove_free(b.getLoop(), base);
+        }
     }
-    const set<bh_base *> news = b1.getLoop().getAllNews();
-    const set<bh_base *> frees = b2.getLoop().getAllFrees();
-    vector<bh_base *> new_temps;
-    set_intersection(news.begin(), news.end(), frees.begin(), frees.end(), back_inserter(new_temps));
+    loop.metadataUpdate();
+}
+}
 
+void free_after_last_access(vector<Block> &block_list) {
+    // The index of the last block that accesses each array
+    map<const bh_base*, int64_t> last_access;
+    // The arrays to free after each block (index -1 means before the first block)
+    map<int64_t, vector<bh_base*> > moved_frees;
+    set<int64_t> moved_from;
+    for (int64_t i = 0; i < static_cast<int64_t>(block_list.size()); ++i) {
+        Block &block = block_list[i];
+        if (block.isInstr()) {
+            continue;
+        }
+        const set<const bh_base*> bases = block.getAllBases();
+        for (bh_base *base: block.getLoop().getAllFrees()) {
+            if (not util::exist_nconst(bases, base)) {
+                auto it = last_access.find(base);
+                const int64_t last = it == last_access.end() ? -1 : it->second;
+                if (last < i - 1 or not block.isSystemOnly()) {
+                    remove_free(block.getLoop(), base);
+                    moved_frees[last].push_back(base);
+                    moved_from.insert(i);
+                }
+            }
+        }
+        for (const bh_base *base: bases) {
+            last_access[base] = i;
+        }
+    }
+    if (moved_frees.empty()) {
+        return;
+    }
+
+    // Let's create a system block for each moved free
+    auto push_frees = [&](vector<Block> &out, int64_t index) {
+        auto it = moved_frees.find(index);
+        if (it != moved_frees.end()) {
+            for (bh_base *base: it->second) {
+                LoopB loop;
+                loop.rank = 0;
+                loop.size = base->nelem;
+                loop._frees.insert(base);
+                loop.metadataUpdate();
+                out.emplace_back(std::move(loop));
+            }
+        }
+    };
+    vector<Block> ret;
+    push_frees(ret, -1);
+    for (int64_t i = 0; i < static_cast<int64_t>(block_list.size()); ++i) {
+        // Blocks that only freed moved arrays are now empty
+        const Block &block = block_list[i];
+        if (not util::exist(moved_from, i) or not block.isSystemOnly() or not block.getLoop().getAllFrees().empty()) {
+            ret.push_back(std::move(block_list[i]));
+        }
+        push_frees(ret, i);
+    }
+    block_list = std::move(ret);
+}
+
+namespace {
+// Returns the total size of the arrays in both 'news' and 'frees'
+uint64_t temps_size(const set<bh_base *> &news, const set<bh_base *> &frees) {
+    const set<bh_base *> &smaller = news.size() < frees.size() ? news : frees;
+    const set<bh_base *> &larger = news.size() < frees.size() ? frees : news;
     uint64_t totalsize = 0;
-    for (const bh_base *base: new_temps) {
-        totalsize += bh_base_size(base);
+    for (const bh_base *base: smaller) {
+        if (util::exist_nconst(larger, base)) {
+            totalsize += bh_base_size(base);
+        }
     }
     return totalsize;
 }
+}
+
+uint64_t weight(const Block &b1, const Block &b2) {
+    if (b1.isInstr() or b2.isInstr()) {
+        return 0; // Instruction blocks cannot be fused
+    }
+    return temps_size(b1.getLoop().getAllNews(), b2.getLoop().getAllFrees());
+}
 
 uint64_t block_cost(const Block &block) {
     std::vector<bh_base*> non_temps;
@@ -312,52 +453,549 @@ void pprint(const DAG &dag, const char *filename, bool avoid_rank0_sweep) {
     file.close();
 }
 
+namespace {
+
+// Replace 'dag' with a DAG of the vertices that aren't 'removed'
+// NB: we avoid `boost::remove_vertex()`, which is linear in the size of the graph
+void remove_vertices(DAG &dag, const vector<bool> &removed) {
+    DAG ret;
+    vector<Vertex> new_vertex(boost::num_vertices(dag));
+    BOOST_FOREACH(Vertex v, boost::vertices(dag)) {
+        if (not removed[v]) {
+            new_vertex[v] = boost::add_vertex(std::move(dag[v]), ret);
+        }
+    }
+    BOOST_FOREACH(Edge e, boost::edges(dag)) {
+        boost::add_edge(new_vertex[source(e, dag)], new_vertex[target(e, dag)], ret);
+    }
+    dag = std::move(ret);
+}
+
+/* The state of the greedy fuser.
+ *
+ * The edges are kept in a priority queue by their weight. Merging the vertices of an edge only changes the edges
+ * of the merged vertex thus we only re-insert the edges of the merged vertex that changed weight and leave the
+ * stale entries in the queue. Whether an edge is fusible is checked when it is popped from the queue.
+ *
+ * The vertices are kept in a topological order, which we maintain when merging vertices using the dynamic
+ * topological sort of Pearce and Kelly ("A Dynamic Topological Sort Algorithm for Directed Acyclic Graphs", 2007).
+ * Because a path from 'a' to 'b' can only visit vertices between 'a' and 'b' in the topological order,
+ * the search for paths is limited to the neighbourhood of the edge.
+ */
+class GreedyFuser {
+private:
+    DAG &_dag;
+    const bool _avoid_rank0_sweep;
+    // The position of each vertex in the topological order
+    vector<uint64_t> _order;
+    // Vertices that have been merged into other vertices
+    vector<bool> _removed;
+    // The new and freed arrays of each vertex
+    vector<set<bh_base *> > _news, _frees;
+    // The vertices visited by the current search, which is identified by `_visit_count`
+    vector<uint64_t> _visited;
+    uint64_t _visit_count = 0;
+    // Stack of the searches
+    vector<Vertex> _stack;
+
+    // The edges of the DAG
+    struct EdgeInfo {
+        uint64_t position; // The position in the edge list of the DAG, which is used to break ties
+        uint64_t weight;
+        bool queued;       // The edge has an entry in the queue with the current weight
+    };
+    map<pair<Vertex, Vertex>, EdgeInfo> _edges;
+    uint64_t _num_edges_added = 0;
+
+    // An entry in the queue, which is stale when the edge has been removed or has changed weight
+    struct Candidate {
+        uint64_t weight;
+        uint64_t position;
+        Vertex src, dst;
+
+        // The greatest weight has the highest priority. Ties are broken by the position in the edge list.
+        bool operator<(const Candidate &other) const {
+            if (weight != other.weight) {
+                return weight < other.weight;
+            }
+            return position > other.position;
+        }
+    };
+    priority_queue<Candidate> _queue;
+
+    // Update the news and frees of 'v'
+    void updateArrays(Vertex v) {
+        _news[v].clear();
+        _frees[v].clear();
+        if (not _dag[v].isInstr()) {
+            _dag[v].getLoop().getAllNews(_news[v]);
+            _dag[v].getLoop().getAllFrees(_frees[v]);
+        }
+    }
+
+    // Register that the edge 'src' to 'dst' is appended to the edge list of the DAG (if it doesn't exist already)
+    void addEdge(Vertex src, Vertex dst) {
+        if (not boost::edge(src, dst, _dag).second) {
+            _edges[make_pair(src, dst)] = {_num_edges_added++, 0, false};
+        }
+    }
+
+    // Insert the edge 'src' to 'dst' into the queue unless it is in the queue already with the same weight
+    void push(Vertex src, Vertex dst) {
+        EdgeInfo &edge = _edges.at(make_pair(src, dst));
+        const uint64_t w = temps_size(_news[src], _frees[dst]);
+        if (not edge.queued or edge.weight != w) {
+            edge.weight = w;
+            edge.queued = true;
+            _queue.push({w, edge.position, src, dst});
+        }
+    }
+
+    // Start a new search
+    void newSearch() {
+        ++_visit_count;
+        _stack.clear();
+    }
+
+    // Visit 'v' in the current search, which returns false if 'v' has been visited already
+    bool visit(Vertex v) {
+        if (_visited[v] == _visit_count) {
+            return false;
+        }
+        _visited[v] = _visit_count;
+        return true;
+    }
+
+    // Determines whether there exist a path of length greater than one from 'a' to 'b'
+    bool longPathExist(Vertex a, Vertex b) {
+        newSearch();
+        BOOST_FOREACH(Vertex child, boost::adjacent_vertices(a, _dag)) {
+            if (child != b and _order[child] < _order[b] and visit(child)) {
+                _stack.push_back(child);
+            }
+        }
+        while (not _stack.empty()) {
+            const Vertex v = _stack.back();
+            _stack.pop_back();
+            BOOST_FOREACH(Vertex child, boost::adjacent_vertices(v, _dag)) {
+                if (child == b) {
+                    return true;
+                }
+                if (_order[child] < _order[b] and visit(child)) {
+                    _stack.push_back(child);
+                }
+            }
+        }
+        return false;
+    }
+
+    // Returns the vertices reachable from 'v' (incl. 'v') that are before 'bound' in the topological order.
+    // When 'forward' is false, the vertices that reaches 'v' and are after 'bound' are returned.
+    vector<Vertex> reachable(Vertex v, uint64_t bound, bool forward) {
+        vector<Vertex> ret = {v};
+        newSearch();
+        visit(v);
+        _stack.push_back(v);
+        while (not _stack.empty()) {
+            const Vertex u = _stack.back();
+            _stack.pop_back();
+            auto within = [&](Vertex w) {
+                if ((forward ? _order[w] < bound : _order[w] > bound) and visit(w)) {
+                    ret.push_back(w);
+                    _stack.push_back(w);
+                }
+            };
+            if (forward) {
+                BOOST_FOREACH(Vertex w, boost::adjacent_vertices(u, _dag)) {
+                    within(w);
+                }
+            } else {
+                BOOST_FOREACH(Vertex w, boost::inv_adjacent_vertices(u, _dag)) {
+                    within(w);
+                }
+            }
+        }
+        return ret;
+    }
+
+    // Restore the topological order after the insertion of the edge 'src' to 'dst' (Pearce and Kelly)
+    void reorder(Vertex src, Vertex dst) {
+        if (_order[src] < _order[dst]) {
+            return; // The order is still topological
+        }
+        // The affected region is the vertices between 'dst' and 'src' in the topological order
+        vector<Vertex> forward = reachable(dst, _order[src], true);
+        vector<Vertex> backward = reachable(src, _order[dst], false);
+        assert(std::find(forward.begin(), forward.end(), src) == forward.end()); // No cycles
+        auto by_order = [&](Vertex v1, Vertex v2) { return _order[v1] < _order[v2]; };
+        std::sort(forward.begin(), forward.end(), by_order);
+        std::sort(backward.begin(), backward.end(), by_order);
+
+        // The vertices that reaches 'src' are placed before the vertices reachable from 'dst' using the same
+        // positions in the topological order
+        vector<Vertex> affected = std::move(backward);
+        affected.insert(affected.end(), forward.begin(), forward.end());
+        vector<uint64_t> positions;
+        positions.reserve(affected.size());
+        for (Vertex v: affected) {
+            positions.push_back(_order[v]);
+        }
+        std::sort(positions.begin(), positions.end());
+        for (size_t i = 0; i < affected.size(); ++i) {
+            _order[affected[i]] = positions[i];
+        }
+    }
+
+    // Merge 'b' into 'a' and update the queue and the topological order
+    void merge(Vertex a, Vertex b) {
+        // NB: like `merge_vertices()`, we add the edges to the children of 'b' before the edges from the parents
+        BOOST_FOREACH(Vertex child, boost::adjacent_vertices(b, _dag)) {
+            addEdge(a, child);
+            _edges.erase(make_pair(b, child));
+        }
+        vector<Vertex> parents;
+        BOOST_FOREACH(Vertex parent, boost::inv_adjacent_vertices(b, _dag)) {
+            if (parent != a) {
+                addEdge(parent, a);
+                parents.push_back(parent);
+            }
+            _edges.erase(make_pair(parent, b));
+        }
+        merge_vertices(_dag, a, b, false);
+        _removed[b] = true;
+        updateArrays(a);
+        _news[b].clear();
+        _frees[b].clear();
+
+        // The children of 'b' are after 'a' already but the parents of 'b' might not be before 'a'
+        for (Vertex parent: parents) {
+            reorder(parent, a);
+        }
+
+        // Finally, the edges of 'a' are re-inserted if their weight changed or they were found not fusible
+        BOOST_FOREACH(Vertex child, boost::adjacent_vertices(a, _dag)) {
+            push(a, child);
+        }
+        BOOST_FOREACH(Vertex parent, boost::inv_adjacent_vertices(a, _dag)) {
+            push(parent, a);
+        }
+    }
+
+public:
+    GreedyFuser(DAG &dag, bool avoid_rank0_sweep) : _dag(dag), _avoid_rank0_sweep(avoid_rank0_sweep) {
+        const size_t num_vertices = boost::num_vertices(dag);
+        _order.resize(num_vertices);
+        _removed.resize(num_vertices, false);
+        _news.resize(num_vertices);
+        _frees.resize(num_vertices);
+        _visited.resize(num_vertices, 0);
+        vector<Vertex> topological_order;
+        boost::topological_sort(dag, back_inserter(topological_order));
+        for (size_t i = 0; i < topological_order.size(); ++i) {
+            _order[topological_order[i]] = topological_order.size() - i - 1;
+        }
+        BOOST_FOREACH(Vertex v, boost::vertices(dag)) {
+            updateArrays(v);
+        }
+        BOOST_FOREACH(Edge e, boost::edges(dag)) {
+            _edges[make_pair(source(e, dag), target(e, dag))] = {_num_edges_added++, 0, false};
+        }
+        BOOST_FOREACH(Edge e, boost::edges(dag)) {
+            push(source(e, dag), target(e, dag));
+        }
+    }
+
+    // Merge the greatest weight edge until no fusible edges are left
+    void run() {
+        while (not _queue.empty()) {
+            const Candidate c = _queue.top();
+            _queue.pop();
+            auto it = _edges.find(make_pair(c.src, c.dst));
+            if (it == _edges.end() or it->second.position != c.position or it->second.weight != c.weight) {
+                continue; // The edge has changed since it was inserted
+            }
+            it->second.queued = false;
+            // Merging the vertices of a transitive edge would introduce a cycle. The edge stays transitive thus
+            // we remove it.
+            if (longPathExist(c.src, c.dst)) {
+                boost::remove_edge(c.src, c.dst, _dag);
+                _edges.erase(it);
+                continue;
+            }
+            // NB: the edge is inserted again when one of its vertices changes
+            if (mergeable(_dag[c.src], _dag[c.dst], _avoid_rank0_sweep)) {
+                merge(c.src, c.dst);
+            }
+        }
+    }
+
+    // Replace the DAG with a DAG of the vertices that haven't been merged into other vertices
+    void compact() {
+        remove_vertices(_dag, _removed);
+    }
+};
+}
+
 void greedy(DAG &dag, bool avoid_rank0_sweep) {
-    while(1) {
-        // First we find all fusible edges
-        vector<Edge> fusibles;
-        {
-            auto edges = boost::edges(dag);
-            for (auto it = edges.first; it != edges.second;) {
-                Edge e = *it; ++it; // NB: we iterate here because boost::remove_edge() invalidates 'it'
-                Vertex v1 = source(e, dag);
-                Vertex v2 = target(e, dag);
-                // Remove transitive edges
-                if(path_exist(v1, v2, dag, true)) {
-                    boost::remove_edge(e, dag);
-                } else {
-                    const Block &b1 = dag[v1];
-                    const Block &b2 = dag[v2];
-                    if (mergeable(b1, b2, avoid_rank0_sweep)) {
-                        fusibles.push_back(e);
+    GreedyFuser fuser(dag, avoid_rank0_sweep);
+    fuser.run();
+    fuser.compact();
+    assert(validate(dag));
+}
+
+namespace {
+
+/* Branch-and-bound search for the merging of vertices that minimizes the total cost of the blocks.
+ *
+ * A node of the search picks a pair of vertices that might be merged, i.e. vertices connected by an edge or
+ * vertices that access a common array without a path between them, and branches into merging the pair and
+ * forbidding the pair to ever end up in the same block.
+ *
+ * The cost of a node is bounded from below by the arrays it accesses: an array that is created and freed within
+ * the DAG costs nothing as long as all blocks accessing it might end up in the same block and its size otherwise.
+ * Any other array costs its size once or twice when the blocks accessing it cannot end up in the same block.
+ */
+class BranchAndBound {
+private:
+    const bool _avoid_rank0_sweep;
+    const chrono::steady_clock::time_point _deadline;
+    // Arrays created and freed within the DAG
+    set<const bh_base *> _temps;
+    // The best merging found so far
+    uint64_t _best_cost;
+    DAG _best_dag;
+    vector<bool> _best_removed;
+    bool _timeout = false;
+
+    // A node of the search
+    struct State {
+        DAG dag;
+        // Vertices that have been merged into other vertices
+        vector<bool> removed;
+        // Pairs of vertices (lowest first) that must not be merged
+        set<pair<Vertex, Vertex> > forbidden;
+    };
+
+    // A pair of vertices that might be merged. When the vertices are connected, the edge goes from 'a' to 'b'.
+    struct Candidate {
+        Vertex a, b;
+        uint64_t saving; // The size of the arrays accessed by both vertices, which orders the search
+    };
+
+    static uint64_t bases_size(const vector<const bh_base *> &bases) {
+        uint64_t ret = 0;
+        for (const bh_base *base: bases) {
+            ret += bh_base_size(base);
+        }
+        return ret;
+    }
+
+    static vector<const bh_base *> common_bases(const set<const bh_base *> &b1, const set<const bh_base *> &b2) {
+        vector<const bh_base *> ret;
+        set_intersection(b1.begin(), b1.end(), b2.begin(), b2.end(), back_inserter(ret));
+        return ret;
+    }
+
+    // Returns the total cost of the blocks in 'state'
+    static uint64_t cost(const State &state) {
+        uint64_t ret = 0;
+        BOOST_FOREACH(Vertex v, boost::vertices(state.dag)) {
+            if (not state.removed[v]) {
+                ret += block_cost(state.dag[v]);
+            }
+        }
+        return ret;
+    }
+
+    // Returns a lower bound of the cost of the blocks in 'state' and any merging of them
+    uint64_t lowerBound(const State &state, const vector<set<const bh_base *> > &bases) const {
+        // Arrays whose accessing vertices cannot end up in the same block
+        set<const bh_base *> split;
+        map<const bh_base *, Vertex> first_access;
+        BOOST_FOREACH(Vertex v, boost::vertices(state.dag)) {
+            if (state.removed[v]) {
+                continue;
+            }
+            for (const bh_base *base: bases[v]) {
+                auto it = first_access.find(base);
+                if (it == first_access.end()) {
+                    first_access.insert(make_pair(base, v));
+                } else if (state.dag[v].isInstr() or state.dag[it->second].isInstr()) {
+                    split.insert(base); // Instruction blocks are never merged
+                }
+            }
+        }
+        for (const pair<Vertex, Vertex> &p: state.forbidden) {
+            for (const bh_base *base: common_bases(bases[p.first], bases[p.second])) {
+                split.insert(base);
+            }
+        }
+        uint64_t ret = 0;
+        for (const auto &access: first_access) {
+            const bool is_split = util::exist(split, access.first);
+            const uint64_t size = bh_base_size(access.first);
+            if (util::exist(_temps, access.first)) {
+                ret += is_split ? size : 0;
+            } else {
+                ret += is_split ? 2 * size : size;
+            }
+        }
+        return ret;
+    }
+
+    // Returns the candidates of 'state'
+    vector<Candidate> candidates(const State &state, const vector<set<const bh_base *> > &bases) const {
+        const DAG &dag = state.dag;
+        // The vertices reachable from each vertex, which we find in reverse topological order
+        vector<Vertex> topological_order;
+        boost::topological_sort(dag, back_inserter(topological_order));
+        vector<boost::dynamic_bitset<> > reach(boost::num_vertices(dag),
+                                               boost::dynamic_bitset<>(boost::num_vertices(dag)));
+        for (Vertex v: topological_order) {
+            BOOST_FOREACH(Vertex child, boost::adjacent_vertices(v, dag)) {
+                reach[v].set(child);
+                reach[v] |= reach[child];
+            }
+        }
+
+        vector<Candidate> ret;
+        BOOST_FOREACH(Vertex v1, boost::vertices(dag)) {
+            if (state.removed[v1] or dag[v1].isInstr()) {
+                continue;
+            }
+            for (Vertex v2 = v1 + 1; v2 < boost::num_vertices(dag); ++v2) {
+                const pair<Vertex, Vertex> pair_of_vertices(v1, v2);
+                if (state.removed[v2] or dag[v2].isInstr() or util::exist(state.forbidden, pair_of_vertices)) {
+                    continue;
+                }
+                const uint64_t saving = bases_size(common_bases(bases[v1], bases[v2]));
+                Vertex a = v1, b = v2;
+                if (boost::edge(v2, v1, dag).second) {
+                    swap(a, b);
+                }
+                if (boost::edge(a, b, dag).second) {
+                    // Merging the vertices of a transitive edge would introduce a cycle
+                    bool transitive = false;
+                    BOOST_FOREACH(Vertex child, boost::adjacent_vertices(a, dag)) {
+                        transitive = transitive or (child != b and reach[child].test(b));
                     }
+                    if (transitive) {
+                        continue;
+                    }
+                } else if (saving == 0 or reach[a].test(b) or reach[b].test(a)) {
+                    continue;
+                }
+                if (mergeable(dag[a], dag[b], _avoid_rank0_sweep)) {
+                    ret.push_back({a, b, saving});
                 }
             }
         }
-        // Any more vertices to fuse?
-        if (fusibles.size() == 0) {
-            break;
+        return ret;
+    }
+
+    // Search the merging of the vertices in 'state'
+    void search(State &state) {
+        while (true) {
+            if (chrono::steady_clock::now() > _deadline) {
+                _timeout = true;
+                return;
+            }
+            vector<set<const bh_base *> > bases(boost::num_vertices(state.dag));
+            BOOST_FOREACH(Vertex v, boost::vertices(state.dag)) {
+                if (not state.removed[v]) {
+                    bases[v] = state.dag[v].getAllBases();
+                }
+            }
+            if (lowerBound(state, bases) >= _best_cost) {
+                return;
+            }
+            const vector<Candidate> cands = candidates(state, bases);
+            if (cands.empty()) {
+                const uint64_t c = cost(state);
+                if (c < _best_cost) {
+                    _best_cost = c;
+                    _best_dag = state.dag;
+                    _best_removed = state.removed;
+                }
+                return;
+            }
+            const Candidate &cand = *std::max_element(cands.begin(), cands.end(),
+                                                      [](const Candidate &c1, const Candidate &c2) {
+                                                          return c1.saving < c2.saving;
+                                                      });
+            // First, we merge the pair
+            {
+                State merged = state;
+                merge_vertices(merged.dag, cand.a, cand.b, false);
+                merged.removed[cand.b] = true;
+                // The merged vertex inherits the forbidden pairs of 'b'
+                set<pair<Vertex, Vertex> > forbidden;
+                for (const pair<Vertex, Vertex> &p: merged.forbidden) {
+                    const Vertex v1 = p.first == cand.b ? cand.a : p.first;
+                    const Vertex v2 = p.second == cand.b ? cand.a : p.second;
+                    forbidden.insert(make_pair(min(v1, v2), max(v1, v2)));
+                }
+                merged.forbidden = std::move(forbidden);
+                search(merged);
+                if (_timeout) {
+                    return;
+                }
+            }
+            // Then, we forbid the pair
+            state.forbidden.insert(make_pair(min(cand.a, cand.b), max(cand.a, cand.b)));
         }
+    }
 
-        // Let's find the greatest weight edge.
-        Edge greatest = fusibles.front();
-        uint64_t greatest_weight = weight(dag[source(greatest, dag)], dag[target(greatest, dag)]);
-        for (Edge e: fusibles) {
-            const uint64_t w = weight(dag[source(e, dag)], dag[target(e, dag)]);
-            if (w > greatest_weight) {
-                greatest = e;
-                greatest_weight = w;
+public:
+    // Search the merging of the vertices in 'dag' that costs less than 'upper_bound' within 'time_budget'
+    BranchAndBound(bool avoid_rank0_sweep, chrono::milliseconds time_budget, uint64_t upper_bound) :
+            _avoid_rank0_sweep(avoid_rank0_sweep), _deadline(chrono::steady_clock::now() + time_budget),
+            _best_cost(upper_bound) {}
+
+    // Runs the search and returns true when the search completed within the time budget
+    bool run(const DAG &dag) {
+        set<bh_base *> news, frees;
+        BOOST_FOREACH(Vertex v, boost::vertices(dag)) {
+            if (not dag[v].isInstr()) {
+                dag[v].getLoop().getAllNews(news);
+                dag[v].getLoop().getAllFrees(frees);
             }
         }
-        Vertex v1 = source(greatest, dag);
-        Vertex v2 = target(greatest, dag);
-//        cout << "merge: " << v1 << ", " << v2 << endl;
+        set_intersection(news.begin(), news.end(), frees.begin(), frees.end(), inserter(_temps, _temps.begin()));
+        State state{dag, vector<bool>(boost::num_vertices(dag), false), {}};
+        search(state);
+        return not _timeout;
+    }
 
-        assert(not path_exist(v1, v2, dag, true)); // Transitive edges should have been removed by now
+    // Replace 'dag' with the best merging found, which returns false if nothing cheaper than the upper bound
+    // was found
+    bool result(DAG &dag) {
+        if (_best_removed.empty()) {
+            return false;
+        }
+        dag = std::move(_best_dag);
+        remove_vertices(dag, _best_removed);
+        return true;
+    }
+};
+}
+
+bool optimal(DAG &dag, bool avoid_rank0_sweep, uint64_t time_budget) {
+    // The greedy merging is the upper bound of the search and the result if nothing cheaper is found
+    DAG greedy_dag = dag;
+    greedy(greedy_dag, avoid_rank0_sweep);
+    uint64_t greedy_cost = 0;
+    BOOST_FOREACH(Vertex v, boost::vertices(greedy_dag)) {
+        greedy_cost += block_cost(greedy_dag[v]);
+    }
 
-        merge_vertices(dag, v1, v2, true);
+    BranchAndBound search(avoid_rank0_sweep, chrono::milliseconds(time_budget), greedy_cost);
+    const bool completed = search.run(dag);
+    if (not search.result(dag)) {
+        dag = std::move(greedy_dag);
     }
     assert(validate(dag));
+    return completed;
 }
 
 } // graph
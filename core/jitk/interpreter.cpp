@@ -0,0 +1,862 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <array>
+#include <cmath>
+#include <cassert>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+
+#include <bh_base.hpp>
+#include <jitk/interpreter.hpp>
+
+using namespace std;
+
+namespace bohrium {
+namespace jitk {
+
+namespace {
+
+// A strided operand: a data pointer, the offset of the first element, and a stride for each dimension.
+// NB: the offset and the strides are in elements not bytes
+struct Operand {
+    void *data;
+    int64_t start;
+    int64_t stride[BH_MAXDIM];
+};
+
+// Returns the operand of the array 'view'
+Operand array_operand(const bh_view &view) {
+    Operand ret;
+    ret.data = view.base->data;
+    ret.start = view.start;
+    std::copy(view.stride, view.stride + view.ndim, ret.stride);
+    return ret;
+}
+
+// Returns an operand that broadcasts the scalar at 'value' to all elements
+Operand scalar_operand(void *value) {
+    Operand ret;
+    ret.data = value;
+    ret.start = 0;
+    std::fill(ret.stride, ret.stride + BH_MAXDIM, 0);
+    return ret;
+}
+
+// Returns the 'index' slice of 'op' along 'axis' thus the returned operand has one dimension less
+Operand slice(const Operand &op, int64_t ndim, int64_t axis, int64_t index) {
+    Operand ret;
+    ret.data = op.data;
+    ret.start = op.start + index * op.stride[axis];
+    std::copy(op.stride, op.stride + axis, ret.stride);
+    std::copy(op.stride + axis + 1, op.stride + ndim, ret.stride + axis);
+    return ret;
+}
+
+// Returns the element at 'offset' in 'op'
+template <typename T>
+inline T &at(const Operand &op, int64_t offset) {
+    return static_cast<T *>(op.data)[offset];
+}
+
+// Convert the constant 'c' to the type 'T'
+template <typename T>
+T constant_value(const bh_constant &c) {
+    switch (c.type) {
+        case bh_type::BOOL:    return static_cast<T>(c.value.bool8);
+        case bh_type::INT8:    return static_cast<T>(c.value.int8);
+        case bh_type::INT16:   return static_cast<T>(c.value.int16);
+        case bh_type::INT32:   return static_cast<T>(c.value.int32);
+        case bh_type::INT64:   return static_cast<T>(c.value.int64);
+        case bh_type::UINT8:   return static_cast<T>(c.value.uint8);
+        case bh_type::UINT16:  return static_cast<T>(c.value.uint16);
+        case bh_type::UINT32:  return static_cast<T>(c.value.uint32);
+        case bh_type::UINT64:  return static_cast<T>(c.value.uint64);
+        case bh_type::FLOAT32: return static_cast<T>(c.value.float32);
+        case bh_type::FLOAT64: return static_cast<T>(c.value.float64);
+        default:
+            throw runtime_error("Interpreter: unsupported constant type");
+    }
+}
+
+// Returns the operand of the input 'instr.operand[idx]'.
+// If the operand is a constant, 'scalar' is used as storage of the constant value.
+template <typename T>
+Operand input_operand(const bh_instruction &instr, size_t idx, T &scalar) {
+    if (bh_is_constant(&instr.operand[idx])) {
+        scalar = constant_value<T>(instr.constant);
+        return scalar_operand(&scalar);
+    }
+    return array_operand(instr.operand[idx]);
+}
+
+/* Calls 'row(offsets, strides, n)' for each row of the 'ndim'-dimensional 'shape' where a row is 'n' elements
+ * along the innermost dimension, 'offsets[i]' is the element offset of the row into the i'th operand in 'ops',
+ * and 'strides[i]' is the stride of the row in the i'th operand. A zero-dimensional 'shape' is a single element.
+ * NB: the elements are visited in row-major order but dimensions that are contiguous in all operands are
+ *     collapsed, which makes the rows as long as possible.
+ */
+template <size_t N, typename Func>
+void row_loop(int64_t ndim, const int64_t *shape, const array<Operand, N> &ops, Func row) {
+    int64_t cshape[BH_MAXDIM];
+    int64_t cstride[N][BH_MAXDIM];
+    int64_t cndim = 0;
+    for (int64_t d = 0; d < ndim; ++d) {
+        if (shape[d] <= 0) {
+            return;
+        }
+        if (shape[d] == 1) {
+            continue;
+        }
+        bool contiguous = cndim > 0;
+        for (size_t o = 0; o < N and contiguous; ++o) {
+            contiguous = cstride[o][cndim - 1] == ops[o].stride[d] * shape[d];
+        }
+        if (contiguous) {
+            cshape[cndim - 1] *= shape[d];
+        } else {
+            cshape[cndim++] = shape[d];
+        }
+        for (size_t o = 0; o < N; ++o) {
+            cstride[o][cndim - 1] = ops[o].stride[d];
+        }
+    }
+
+    int64_t offsets[N], strides[N];
+    for (size_t o = 0; o < N; ++o) {
+        offsets[o] = ops[o].start;
+        strides[o] = cndim == 0 ? 0 : cstride[o][cndim - 1];
+    }
+    if (cndim == 0) {
+        row(static_cast<const int64_t *>(offsets), static_cast<const int64_t *>(strides), 1);
+        return;
+    }
+    const int64_t inner = cndim - 1;
+    int64_t coord[BH_MAXDIM] = {0};
+    while (true) {
+        row(static_cast<const int64_t *>(offsets), static_cast<const int64_t *>(strides), cshape[inner]);
+        // Move to the next row
+        int64_t d = inner - 1;
+        for (; d >= 0; --d) {
+            for (size_t o = 0; o < N; ++o) {
+                offsets[o] += cstride[o][d];
+            }
+            if (++coord[d] < cshape[d]) {
+                break;
+            }
+            for (size_t o = 0; o < N; ++o) {
+                offsets[o] -= cstride[o][d] * cshape[d];
+            }
+            coord[d] = 0;
+        }
+        if (d < 0) {
+            return;
+        }
+    }
+}
+
+/* Calls 'func(offsets)' for each element in the 'ndim'-dimensional 'shape' where 'offsets[i]' is
+ * the element offset into the i'th operand in 'ops'. The elements are visited in row-major order.
+ */
+template <size_t N, typename Func>
+void strided_loop(int64_t ndim, const int64_t *shape, const array<Operand, N> &ops, Func func) {
+    row_loop(ndim, shape, ops, [&](const int64_t *row, const int64_t *strides, int64_t n) {
+        int64_t offsets[N];
+        std::copy(row, row + N, offsets);
+        for (int64_t i = 0; i < n; ++i) {
+            func(static_cast<const int64_t *>(offsets));
+            for (size_t o = 0; o < N; ++o) {
+                offsets[o] += strides[o];
+            }
+        }
+    });
+}
+
+/* Computes 'out[i] = func(in[i])' or 'out[i] = func(in1[i], in2[i])' for the 'n' elements of a row.
+ * Rows that are contiguous or broadcast an input get loops of their own, which the compiler vectorizes.
+ */
+template <typename TO, typename TI, typename Func>
+inline void map_row(TO *out, int64_t out_stride, const TI *in, int64_t in_stride, int64_t n, Func func) {
+    if (out_stride == 1 and in_stride == 1) {
+        for (int64_t i = 0; i < n; ++i) {
+            out[i] = func(in[i]);
+        }
+    } else if (out_stride == 1 and in_stride == 0) {
+        const TI a = *in;
+        for (int64_t i = 0; i < n; ++i) {
+            out[i] = func(a);
+        }
+    } else {
+        for (int64_t i = 0; i < n; ++i) {
+            out[i * out_stride] = func(in[i * in_stride]);
+        }
+    }
+}
+
+template <typename TO, typename TI, typename Func>
+inline void map_row(TO *out, int64_t out_stride, const TI *in1, int64_t in1_stride, const TI *in2, int64_t in2_stride,
+                    int64_t n, Func func) {
+    if (out_stride == 1 and in1_stride == 1 and in2_stride == 1) {
+        for (int64_t i = 0; i < n; ++i) {
+            out[i] = func(in1[i], in2[i]);
+        }
+    } else if (out_stride == 1 and in1_stride == 1 and in2_stride == 0) {
+        const TI b = *in2;
+        for (int64_t i = 0; i < n; ++i) {
+            out[i] = func(in1[i], b);
+        }
+    } else if (out_stride == 1 and in1_stride == 0 and in2_stride == 1) {
+        const TI a = *in1;
+        for (int64_t i = 0; i < n; ++i) {
+            out[i] = func(a, in2[i]);
+        }
+    } else if (out_stride == 0 and in1_stride == 0 and static_cast<const void *>(out) == in1) { // Reduction of a row
+        TO acc = *out;
+        for (int64_t i = 0; i < n; ++i) {
+            acc = func(acc, in2[i * in2_stride]);
+        }
+        *out = acc;
+    } else {
+        for (int64_t i = 0; i < n; ++i) {
+            out[i * out_stride] = func(in1[i * in1_stride], in2[i * in2_stride]);
+        }
+    }
+}
+
+// Returns a pointer to the element at 'offset' in 'op'
+template <typename T>
+inline T *ptr(const Operand &op, int64_t offset) {
+    return static_cast<T *>(op.data) + offset;
+}
+
+// Returns 'shape' without 'axis'
+vector<int64_t> remove_axis(const bh_view &view, int64_t axis) {
+    vector<int64_t> ret(view.shape, view.shape + view.ndim);
+    ret.erase(ret.begin() + axis);
+    return ret;
+}
+
+[[noreturn]] void unsupported(const bh_instruction &instr) {
+    stringstream ss;
+    ss << "Interpreter: instruction not supported: " << instr;
+    throw runtime_error(ss.str());
+}
+
+/* The element operations, which must match the semantic of `write_operation()` in instruction.cpp */
+
+template <typename T>
+using is_signed_int = integral_constant<bool, is_integral<T>::value and is_signed<T>::value>;
+
+#define UNARY_OP(NAME, EXPR) struct NAME { template <typename T> static T apply(T a) { return EXPR; } };
+#define BINARY_OP(NAME, EXPR) struct NAME { template <typename T> static T apply(T a, T b) { return EXPR; } };
+#define COMPARE_OP(NAME, EXPR) struct NAME { template <typename T> static bool apply(T a, T b) { return EXPR; } };
+
+BINARY_OP(Add, a + b)
+BINARY_OP(Subtract, a - b)
+BINARY_OP(Power, static_cast<T>(std::pow(a, b)))
+BINARY_OP(Maximum, a > b ? a : b)
+BINARY_OP(Minimum, a < b ? a : b)
+BINARY_OP(LogicalAnd, a && b)
+BINARY_OP(LogicalOr, a || b)
+BINARY_OP(LogicalXor, !a != !b)
+BINARY_OP(BitwiseAnd, a & b)
+BINARY_OP(BitwiseOr, a | b)
+BINARY_OP(BitwiseXor, a ^ b)
+BINARY_OP(RightShift, a >> b)
+BINARY_OP(Arctan2, std::atan2(a, b))
+
+// NB: like the C kernels, the result of a boolean multiply, shift, and sign is converted back to bool
+struct Multiply {
+    static bool apply(bool a, bool b) {
+        return a and b;
+    }
+    template <typename T>
+    static T apply(T a, T b) {
+        return a * b;
+    }
+};
+
+struct LeftShift {
+    static bool apply(bool a, bool) {
+        return a;
+    }
+    template <typename T>
+    static T apply(T a, T b) {
+        return a << b;
+    }
+};
+
+struct Divide { // Python/NumPy signed integer division
+    template <typename T>
+    static typename enable_if<is_signed_int<T>::value, T>::type apply(T a, T b) {
+        return ((a > 0) != (b > 0) and (a % b) != 0) ? (a / b - 1) : (a / b);
+    }
+    template <typename T>
+    static typename enable_if<not is_signed_int<T>::value, T>::type apply(T a, T b) {
+        return a / b;
+    }
+};
+
+struct Mod {
+    template <typename T>
+    static typename enable_if<is_floating_point<T>::value, T>::type apply(T a, T b) {
+        return std::fmod(a, b);
+    }
+    template <typename T>
+    static typename enable_if<is_integral<T>::value, T>::type apply(T a, T b) {
+        return a % b;
+    }
+};
+
+struct Remainder { // Python/NumPy remainder
+    template <typename T>
+    static typename enable_if<is_floating_point<T>::value, T>::type apply(T a, T b) {
+        return a - std::floor(a / b) * b;
+    }
+    template <typename T>
+    static typename enable_if<is_signed_int<T>::value, T>::type apply(T a, T b) {
+        return ((a > 0) == (b > 0) or (a % b) == 0) ? (a % b) : (a % b) + b;
+    }
+    template <typename T>
+    static typename enable_if<is_unsigned<T>::value, T>::type apply(T a, T b) {
+        return a % b;
+    }
+};
+
+COMPARE_OP(Greater, a > b)
+COMPARE_OP(GreaterEqual, a >= b)
+COMPARE_OP(Less, a < b)
+COMPARE_OP(LessEqual, a <= b)
+COMPARE_OP(Equal, a == b)
+COMPARE_OP(NotEqual, a != b)
+
+UNARY_OP(LogicalNot, !a)
+UNARY_OP(Cos, std::cos(a))
+UNARY_OP(Sin, std::sin(a))
+UNARY_OP(Tan, std::tan(a))
+UNARY_OP(Cosh, std::cosh(a))
+UNARY_OP(Sinh, std::sinh(a))
+UNARY_OP(Tanh, std::tanh(a))
+UNARY_OP(Arcsin, std::asin(a))
+UNARY_OP(Arccos, std::acos(a))
+UNARY_OP(Arctan, std::atan(a))
+UNARY_OP(Arcsinh, std::asinh(a))
+UNARY_OP(Arccosh, std::acosh(a))
+UNARY_OP(Arctanh, std::atanh(a))
+UNARY_OP(Exp, std::exp(a))
+UNARY_OP(Exp2, std::exp2(a))
+UNARY_OP(Expm1, std::expm1(a))
+UNARY_OP(Log, std::log(a))
+UNARY_OP(Log2, std::log2(a))
+UNARY_OP(Log10, std::log10(a))
+UNARY_OP(Log1p, std::log1p(a))
+UNARY_OP(Sqrt, std::sqrt(a))
+UNARY_OP(Ceil, std::ceil(a))
+UNARY_OP(Trunc, std::trunc(a))
+UNARY_OP(Floor, std::floor(a))
+UNARY_OP(Rint, std::rint(a))
+
+struct Sign {
+    static bool apply(bool a) {
+        return a;
+    }
+    template <typename T>
+    static T apply(T a) {
+        return (a > 0) - (0 > a);
+    }
+};
+
+struct Absolute {
+    static bool apply(bool) {
+        return true;
+    }
+    template <typename T>
+    static typename enable_if<is_floating_point<T>::value, T>::type apply(T a) {
+        return std::fabs(a);
+    }
+    template <typename T>
+    static typename enable_if<is_signed_int<T>::value, T>::type apply(T a) {
+        return a < 0 ? -a : a;
+    }
+    template <typename T>
+    static typename enable_if<is_unsigned<T>::value and not is_same<T, bool>::value, T>::type apply(T a) {
+        return a;
+    }
+};
+
+struct Invert {
+    static bool apply(bool a) {
+        return !a;
+    }
+    template <typename T>
+    static T apply(T a) {
+        return ~a;
+    }
+};
+
+struct IsNan {
+    template <typename T>
+    static typename enable_if<is_floating_point<T>::value, bool>::type apply(T a) { return std::isnan(a); }
+    template <typename T>
+    static typename enable_if<is_integral<T>::value, bool>::type apply(T) { return false; }
+};
+
+struct IsInf {
+    template <typename T>
+    static typename enable_if<is_floating_point<T>::value, bool>::type apply(T a) { return std::isinf(a); }
+    template <typename T>
+    static typename enable_if<is_integral<T>::value, bool>::type apply(T) { return false; }
+};
+
+struct IsFinite {
+    template <typename T>
+    static typename enable_if<is_floating_point<T>::value, bool>::type apply(T a) { return std::isfinite(a); }
+    template <typename T>
+    static typename enable_if<is_integral<T>::value, bool>::type apply(T) { return true; }
+};
+
+/* The kernels, which execute an instruction where 'T' is the element type */
+
+// Elementwise 'out = Op(in)' where all operands are of type 'T'
+template <typename Op>
+struct Unary {
+    template <typename T>
+    static void run(const bh_instruction &instr) {
+        const bh_view &out = instr.operand[0];
+        T scalar;
+        const array<Operand, 2> ops = {{array_operand(out), input_operand<T>(instr, 1, scalar)}};
+        row_loop(out.ndim, out.shape, ops, [&](const int64_t *offsets, const int64_t *strides, int64_t n) {
+            map_row(ptr<T>(ops[0], offsets[0]), strides[0], ptr<T>(ops[1], offsets[1]), strides[1], n,
+                    [](T a) { return static_cast<T>(Op::apply(a)); });
+        });
+    }
+};
+
+// Elementwise 'out = Op(in1, in2)' where all operands are of type 'T'
+template <typename Op>
+struct Binary {
+    template <typename T>
+    static void run(const bh_instruction &instr) {
+        const bh_view &out = instr.operand[0];
+        T scalar;
+        const array<Operand, 3> ops = {{array_operand(out), input_operand<T>(instr, 1, scalar),
+                                        input_operand<T>(instr, 2, scalar)}};
+        row_loop(out.ndim, out.shape, ops, [&](const int64_t *offsets, const int64_t *strides, int64_t n) {
+            map_row(ptr<T>(ops[0], offsets[0]), strides[0], ptr<T>(ops[1], offsets[1]), strides[1],
+                    ptr<T>(ops[2], offsets[2]), strides[2], n,
+                    [](T a, T b) { return static_cast<T>(Op::apply(a, b)); });
+        });
+    }
+};
+
+// Elementwise 'out = Op(in1, in2)' where the output is a boolean and the inputs are of type 'T'
+template <typename Op>
+struct Compare {
+    template <typename T>
+    static void run(const bh_instruction &instr) {
+        const bh_view &out = instr.operand[0];
+        T scalar;
+        const array<Operand, 3> ops = {{array_operand(out), input_operand<T>(instr, 1, scalar),
+                                        input_operand<T>(instr, 2, scalar)}};
+        row_loop(out.ndim, out.shape, ops, [&](const int64_t *offsets, const int64_t *strides, int64_t n) {
+            map_row(ptr<bool>(ops[0], offsets[0]), strides[0], ptr<T>(ops[1], offsets[1]), strides[1],
+                    ptr<T>(ops[2], offsets[2]), strides[2], n,
+                    [](T a, T b) { return Op::apply(a, b); });
+        });
+    }
+};
+
+// Elementwise 'out = Op(in)' where the output is a boolean and the input is of type 'T'
+template <typename Op>
+struct Predicate {
+    template <typename T>
+    static void run(const bh_instruction &instr) {
+        const bh_view &out = instr.operand[0];
+        T scalar;
+        const array<Operand, 2> ops = {{array_operand(out), input_operand<T>(instr, 1, scalar)}};
+        row_loop(out.ndim, out.shape, ops, [&](const int64_t *offsets, const int64_t *strides, int64_t n) {
+            map_row(ptr<bool>(ops[0], offsets[0]), strides[0], ptr<T>(ops[1], offsets[1]), strides[1], n,
+                    [](T a) { return Op::apply(a); });
+        });
+    }
+};
+
+// Type conversion 'out = in' where the output is of type 'TO' and the input is of type 'T'
+template <typename TO>
+struct IdentityFrom {
+    template <typename T>
+    static void run(const bh_instruction &instr) {
+        const bh_view &out = instr.operand[0];
+        T scalar;
+        const array<Operand, 2> ops = {{array_operand(out), input_operand<T>(instr, 1, scalar)}};
+        row_loop(out.ndim, out.shape, ops, [&](const int64_t *offsets, const int64_t *strides, int64_t n) {
+            map_row(ptr<TO>(ops[0], offsets[0]), strides[0], ptr<T>(ops[1], offsets[1]), strides[1], n,
+                    [](T a) { return static_cast<TO>(a); });
+        });
+    }
+};
+
+// Reduction of the input over the sweep axis. The first element along the sweep axis is
+// copied (i.e. the loop is "peeled") thus we need no neutral element.
+template <typename Op>
+struct Reduce {
+    template <typename T>
+    static void run(const bh_instruction &instr) {
+        const bh_view &out = instr.operand[0];
+        const bh_view &in = instr.operand[1];
+        const int64_t axis = instr.sweep_axis();
+
+        // We give the output a zero stride at the sweep axis, which makes it align with the input
+        Operand out_op;
+        out_op.data = out.base->data;
+        out_op.start = out.start;
+        for (int64_t d = 0, o = 0; d < in.ndim; ++d) {
+            out_op.stride[d] = (d == axis or in.ndim == 1) ? 0 : out.stride[o++];
+        }
+        const Operand in_op = array_operand(in);
+        if (in.shape[axis] <= 0) {
+            return;
+        }
+
+        // Copy the first element along the sweep axis
+        const vector<int64_t> shape = remove_axis(in, axis);
+        const array<Operand, 2> first = {{slice(out_op, in.ndim, axis, 0), slice(in_op, in.ndim, axis, 0)}};
+        row_loop(shape.size(), shape.data(), first, [&](const int64_t *offsets, const int64_t *strides, int64_t n) {
+            map_row(ptr<T>(first[0], offsets[0]), strides[0], ptr<T>(first[1], offsets[1]), strides[1], n,
+                    [](T a) { return a; });
+        });
+
+        // And reduce the rest into the output, which is either rows of elements or rows of a single element
+        vector<int64_t> rest(in.shape, in.shape + in.ndim);
+        rest[axis] -= 1;
+        Operand in_rest = in_op;
+        in_rest.start += in_op.stride[axis];
+        const array<Operand, 3> ops = {{out_op, out_op, in_rest}};
+        row_loop(in.ndim, rest.data(), ops, [&](const int64_t *offsets, const int64_t *strides, int64_t n) {
+            map_row(ptr<T>(ops[0], offsets[0]), strides[0], ptr<T>(ops[1], offsets[1]), strides[1],
+                    ptr<T>(ops[2], offsets[2]), strides[2], n,
+                    [](T a, T b) { return static_cast<T>(Op::apply(a, b)); });
+        });
+    }
+};
+
+// Accumulation (scan) of the input over the sweep axis
+template <typename Op>
+struct Accumulate {
+    template <typename T>
+    static void run(const bh_instruction &instr) {
+        const bh_view &out = instr.operand[0];
+        const bh_view &in = instr.operand[1];
+        const int64_t axis = instr.sweep_axis();
+        const Operand out_op = array_operand(out);
+        const Operand in_op = array_operand(in);
+        const vector<int64_t> shape = remove_axis(in, axis);
+
+        for (int64_t i = 0; i < in.shape[axis]; ++i) {
+            if (i == 0) {
+                const array<Operand, 2> ops = {{slice(out_op, in.ndim, axis, i), slice(in_op, in.ndim, axis, i)}};
+                row_loop(shape.size(), shape.data(), ops,
+                         [&](const int64_t *offsets, const int64_t *strides, int64_t n) {
+                    map_row(ptr<T>(ops[0], offsets[0]), strides[0], ptr<T>(ops[1], offsets[1]), strides[1], n,
+                            [](T a) { return a; });
+                });
+            } else {
+                const array<Operand, 3> ops = {{slice(out_op, in.ndim, axis, i), slice(out_op, in.ndim, axis, i - 1),
+                                                slice(in_op, in.ndim, axis, i)}};
+                row_loop(shape.size(), shape.data(), ops,
+                         [&](const int64_t *offsets, const int64_t *strides, int64_t n) {
+                    map_row(ptr<T>(ops[0], offsets[0]), strides[0], ptr<T>(ops[1], offsets[1]), strides[1],
+                            ptr<T>(ops[2], offsets[2]), strides[2], n,
+                            [](T a, T b) { return static_cast<T>(Op::apply(a, b)); });
+                });
+            }
+        }
+    }
+};
+
+// Writes the flatten index of each output element, e.g. 'out[i] = i'
+struct Range {
+    template <typename T>
+    static void run(const bh_instruction &instr) {
+        const bh_view &out = instr.operand[0];
+        const array<Operand, 1> ops = {{array_operand(out)}};
+        uint64_t index = 0;
+        strided_loop(out.ndim, out.shape, ops, [&](const int64_t *offsets) {
+            at<T>(ops[0], offsets[0]) = static_cast<T>(index++);
+        });
+    }
+};
+
+// Format of GATHER: out[<loop-indexes>] = in1[in1.start + in2[<loop-indexes>]]
+struct Gather {
+    template <typename T>
+    static void run(const bh_instruction &instr) {
+        const bh_view &out = instr.operand[0];
+        const bh_view &in = instr.operand[1];
+        const array<Operand, 2> ops = {{array_operand(out), array_operand(instr.operand[2])}};
+        strided_loop(out.ndim, out.shape, ops, [&](const int64_t *offsets) {
+            at<T>(ops[0], offsets[0]) = static_cast<T *>(in.base->data)[in.start + at<uint64_t>(ops[1], offsets[1])];
+        });
+    }
+};
+
+// Format of SCATTER: out[out.start + in2[<loop-indexes>]] = in1[<loop-indexes>]
+// and COND_SCATTER, which only writes when in3[<loop-indexes>] is true
+struct Scatter {
+    template <typename T>
+    static void run(const bh_instruction &instr) {
+        const bh_view &out = instr.operand[0];
+        const bh_view &index = instr.operand[2];
+        T *out_data = static_cast<T *>(out.base->data);
+        if (instr.opcode == BH_COND_SCATTER) {
+            const array<Operand, 3> ops = {{array_operand(instr.operand[1]), array_operand(index),
+                                            array_operand(instr.operand[3])}};
+            strided_loop(index.ndim, index.shape, ops, [&](const int64_t *offsets) {
+                if (at<bool>(ops[2], offsets[2])) {
+                    out_data[out.start + at<uint64_t>(ops[1], offsets[1])] = at<T>(ops[0], offsets[0]);
+                }
+            });
+        } else {
+            const array<Operand, 2> ops = {{array_operand(instr.operand[1]), array_operand(index)}};
+            strided_loop(index.ndim, index.shape, ops, [&](const int64_t *offsets) {
+                out_data[out.start + at<uint64_t>(ops[1], offsets[1])] = at<T>(ops[0], offsets[0]);
+            });
+        }
+    }
+};
+
+/* Type dispatching: calls 'Kernel::run<T>(instr)' where 'T' is the C++ type of 'dtype' */
+
+template <typename Kernel>
+void dispatch_integer(bh_type dtype, const bh_instruction &instr) {
+    switch (dtype) {
+        case bh_type::BOOL:   Kernel::template run<bool>(instr);     break;
+        case bh_type::INT8:   Kernel::template run<int8_t>(instr);   break;
+        case bh_type::INT16:  Kernel::template run<int16_t>(instr);  break;
+        case bh_type::INT32:  Kernel::template run<int32_t>(instr);  break;
+        case bh_type::INT64:  Kernel::template run<int64_t>(instr);  break;
+        case bh_type::UINT8:  Kernel::template run<uint8_t>(instr);  break;
+        case bh_type::UINT16: Kernel::template run<uint16_t>(instr); break;
+        case bh_type::UINT32: Kernel::template run<uint32_t>(instr); break;
+        case bh_type::UINT64: Kernel::template run<uint64_t>(instr); break;
+        default: unsupported(instr);
+    }
+}
+
+template <typename Kernel>
+void dispatch_float(bh_type dtype, const bh_instruction &instr) {
+    switch (dtype) {
+        case bh_type::FLOAT32: Kernel::template run<float>(instr);  break;
+        case bh_type::FLOAT64: Kernel::template run<double>(instr); break;
+        default: unsupported(instr);
+    }
+}
+
+template <typename Kernel>
+void dispatch_real(bh_type dtype, const bh_instruction &instr) {
+    if (dtype == bh_type::FLOAT32 or dtype == bh_type::FLOAT64) {
+        dispatch_float<Kernel>(dtype, instr);
+    } else {
+        dispatch_integer<Kernel>(dtype, instr);
+    }
+}
+
+// The output type of BH_IDENTITY is dispatched first and then the input type
+struct Identity {
+    template <typename TO>
+    static void run(const bh_instruction &instr) {
+        dispatch_real<IdentityFrom<TO> >(instr.operand_type(1), instr);
+    }
+};
+
+} // Anonymous namespace
+
+bool interpretable(const bh_instruction &instr) {
+    if (bh_opcode_is_system(instr.opcode)) {
+        return true;
+    }
+    for (size_t i = 0; i < instr.operand.size(); ++i) {
+        const bh_type t = instr.operand_type(static_cast<int>(i));
+        if (t == bh_type::COMPLEX64 or t == bh_type::COMPLEX128 or t == bh_type::R123) {
+            return false;
+        }
+    }
+    switch (instr.opcode) {
+        case BH_ADD: case BH_SUBTRACT: case BH_MULTIPLY: case BH_DIVIDE: case BH_POWER: case BH_ABSOLUTE:
+        case BH_GREATER: case BH_GREATER_EQUAL: case BH_LESS: case BH_LESS_EQUAL: case BH_EQUAL: case BH_NOT_EQUAL:
+        case BH_LOGICAL_AND: case BH_LOGICAL_OR: case BH_LOGICAL_XOR: case BH_LOGICAL_NOT:
+        case BH_MAXIMUM: case BH_MINIMUM: case BH_BITWISE_AND: case BH_BITWISE_OR: case BH_BITWISE_XOR:
+        case BH_INVERT: case BH_LEFT_SHIFT: case BH_RIGHT_SHIFT:
+        case BH_COS: case BH_SIN: case BH_TAN: case BH_COSH: case BH_SINH: case BH_TANH:
+        case BH_ARCSIN: case BH_ARCCOS: case BH_ARCTAN: case BH_ARCSINH: case BH_ARCCOSH: case BH_ARCTANH:
+        case BH_ARCTAN2: case BH_EXP: case BH_EXP2: case BH_EXPM1: case BH_LOG: case BH_LOG2: case BH_LOG10:
+        case BH_LOG1P: case BH_SQRT: case BH_CEIL: case BH_TRUNC: case BH_FLOOR: case BH_RINT:
+        case BH_MOD: case BH_REMAINDER: case BH_ISNAN: case BH_ISINF: case BH_ISFINITE: case BH_IDENTITY:
+        case BH_SIGN:
+        case BH_ADD_REDUCE: case BH_MULTIPLY_REDUCE: case BH_MINIMUM_REDUCE: case BH_MAXIMUM_REDUCE:
+        case BH_LOGICAL_AND_REDUCE: case BH_LOGICAL_OR_REDUCE: case BH_LOGICAL_XOR_REDUCE:
+        case BH_BITWISE_AND_REDUCE: case BH_BITWISE_OR_REDUCE: case BH_BITWISE_XOR_REDUCE:
+        case BH_ADD_ACCUMULATE: case BH_MULTIPLY_ACCUMULATE:
+        case BH_RANGE: case BH_GATHER: case BH_SCATTER: case BH_COND_SCATTER:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool interpretable(const vector<Block> &block_list) {
+    for (const Block &block: block_list) {
+        for (const InstrPtr &instr: block.getAllInstr()) {
+            if (not interpretable(*instr)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool interpretable(const vector<bh_instruction*> &instr_list) {
+    for (const bh_instruction *instr: instr_list) {
+        if (not interpretable(*instr)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t total_work(const vector<bh_instruction*> &instr_list) {
+    uint64_t ret = 0;
+    for (const bh_instruction *instr: instr_list) {
+        if (not bh_opcode_is_system(instr->opcode)) {
+            uint64_t nelem = 1;
+            for (int64_t size: instr->shape()) {
+                nelem *= size;
+            }
+            ret += nelem;
+        }
+    }
+    return ret;
+}
+
+void interpret(const bh_instruction &instr) {
+    if (bh_opcode_is_system(instr.opcode)) {
+        return;
+    }
+    for (const bh_view *view: instr.get_views()) {
+        bh_data_malloc(view->base);
+    }
+
+    const bh_type t0 = instr.operand_type(0);
+    const bh_type t1 = instr.operand.size() > 1 ? instr.operand_type(1) : t0;
+    switch (instr.opcode) {
+        case BH_ADD:                dispatch_real<Binary<Add> >(t0, instr);            break;
+        case BH_SUBTRACT:           dispatch_real<Binary<Subtract> >(t0, instr);       break;
+        case BH_MULTIPLY:           dispatch_real<Binary<Multiply> >(t0, instr);       break;
+        case BH_DIVIDE:             dispatch_real<Binary<Divide> >(t0, instr);         break;
+        case BH_POWER:              dispatch_real<Binary<Power> >(t0, instr);          break;
+        case BH_MAXIMUM:            dispatch_real<Binary<Maximum> >(t0, instr);        break;
+        case BH_MINIMUM:            dispatch_real<Binary<Minimum> >(t0, instr);        break;
+        case BH_MOD:                dispatch_real<Binary<Mod> >(t0, instr);            break;
+        case BH_REMAINDER:          dispatch_real<Binary<Remainder> >(t0, instr);      break;
+        case BH_LOGICAL_AND:        dispatch_real<Binary<LogicalAnd> >(t0, instr);     break;
+        case BH_LOGICAL_OR:         dispatch_real<Binary<LogicalOr> >(t0, instr);      break;
+        case BH_LOGICAL_XOR:        dispatch_real<Binary<LogicalXor> >(t0, instr);     break;
+        case BH_BITWISE_AND:        dispatch_integer<Binary<BitwiseAnd> >(t0, instr);  break;
+        case BH_BITWISE_OR:         dispatch_integer<Binary<BitwiseOr> >(t0, instr);   break;
+        case BH_BITWISE_XOR:        dispatch_integer<Binary<BitwiseXor> >(t0, instr);  break;
+        case BH_LEFT_SHIFT:         dispatch_integer<Binary<LeftShift> >(t0, instr);   break;
+        case BH_RIGHT_SHIFT:        dispatch_integer<Binary<RightShift> >(t0, instr);  break;
+        case BH_ARCTAN2:            dispatch_float<Binary<Arctan2> >(t0, instr);       break;
+        case BH_GREATER:            dispatch_real<Compare<Greater> >(t1, instr);       break;
+        case BH_GREATER_EQUAL:      dispatch_real<Compare<GreaterEqual> >(t1, instr);  break;
+        case BH_LESS:               dispatch_real<Compare<Less> >(t1, instr);          break;
+        case BH_LESS_EQUAL:         dispatch_real<Compare<LessEqual> >(t1, instr);     break;
+        case BH_EQUAL:              dispatch_real<Compare<Equal> >(t1, instr);         break;
+        case BH_NOT_EQUAL:          dispatch_real<Compare<NotEqual> >(t1, instr);      break;
+        case BH_ISNAN:              dispatch_real<Predicate<IsNan> >(t1, instr);       break;
+        case BH_ISINF:              dispatch_real<Predicate<IsInf> >(t1, instr);       break;
+        case BH_ISFINITE:           dispatch_real<Predicate<IsFinite> >(t1, instr);    break;
+        case BH_LOGICAL_NOT:        dispatch_real<Unary<LogicalNot> >(t0, instr);      break;
+        case BH_ABSOLUTE:           dispatch_real<Unary<Absolute> >(t0, instr);        break;
+        case BH_SIGN:               dispatch_real<Unary<Sign> >(t0, instr);            break;
+        case BH_INVERT:             dispatch_integer<Unary<Invert> >(t0, instr);       break;
+        case BH_COS:                dispatch_float<Unary<Cos> >(t0, instr);            break;
+        case BH_SIN:                dispatch_float<Unary<Sin> >(t0, instr);            break;
+        case BH_TAN:                dispatch_float<Unary<Tan> >(t0, instr);            break;
+        case BH_COSH:               dispatch_float<Unary<Cosh> >(t0, instr);           break;
+        case BH_SINH:               dispatch_float<Unary<Sinh> >(t0, instr);           break;
+        case BH_TANH:               dispatch_float<Unary<Tanh> >(t0, instr);           break;
+        case BH_ARCSIN:             dispatch_float<Unary<Arcsin> >(t0, instr);         break;
+        case BH_ARCCOS:             dispatch_float<Unary<Arccos> >(t0, instr);         break;
+        case BH_ARCTAN:             dispatch_float<Unary<Arctan> >(t0, instr);         break;
+        case BH_ARCSINH:            dispatch_float<Unary<Arcsinh> >(t0, instr);        break;
+        case BH_ARCCOSH:            dispatch_float<Unary<Arccosh> >(t0, instr);        break;
+        case BH_ARCTANH:            dispatch_float<Unary<Arctanh> >(t0, instr);        break;
+        case BH_EXP:                dispatch_float<Unary<Exp> >(t0, instr);            break;
+        case BH_EXP2:               dispatch_float<Unary<Exp2> >(t0, instr);           break;
+        case BH_EXPM1:              dispatch_float<Unary<Expm1> >(t0, instr);          break;
+        case BH_LOG:                dispatch_float<Unary<Log> >(t0, instr);            break;
+        case BH_LOG2:               dispatch_float<Unary<Log2> >(t0, instr);           break;
+        case BH_LOG10:              dispatch_float<Unary<Log10> >(t0, instr);          break;
+        case BH_LOG1P:              dispatch_float<Unary<Log1p> >(t0, instr);          break;
+        case BH_SQRT:               dispatch_float<Unary<Sqrt> >(t0, instr);           break;
+        case BH_CEIL:               dispatch_float<Unary<Ceil> >(t0, instr);           break;
+        case BH_TRUNC:              dispatch_float<Unary<Trunc> >(t0, instr);          break;
+        case BH_FLOOR:              dispatch_float<Unary<Floor> >(t0, instr);          break;
+        case BH_RINT:               dispatch_float<Unary<Rint> >(t0, instr);           break;
+        case BH_IDENTITY:           dispatch_real<Identity>(t0, instr);                break;
+        case BH_ADD_REDUCE:         dispatch_real<Reduce<Add> >(t0, instr);            break;
+        case BH_MULTIPLY_REDUCE:    dispatch_real<Reduce<Multiply> >(t0, instr);       break;
+        case BH_MINIMUM_REDUCE:     dispatch_real<Reduce<Minimum> >(t0, instr);        break;
+        case BH_MAXIMUM_REDUCE:     dispatch_real<Reduce<Maximum> >(t0, instr);        break;
+        case BH_LOGICAL_AND_REDUCE: dispatch_real<Reduce<LogicalAnd> >(t0, instr);     break;
+        case BH_LOGICAL_OR_REDUCE:  dispatch_real<Reduce<LogicalOr> >(t0, instr);      break;
+        case BH_LOGICAL_XOR_REDUCE: dispatch_real<Reduce<LogicalXor> >(t0, instr);     break;
+        case BH_BITWISE_AND_REDUCE: dispatch_integer<Reduce<BitwiseAnd> >(t0, instr);  break;
+        case BH_BITWISE_OR_REDUCE:  dispatch_integer<Reduce<BitwiseOr> >(t0, instr);   break;
+        case BH_BITWISE_XOR_REDUCE: dispatch_integer<Reduce<BitwiseXor> >(t0, instr);  break;
+        case BH_ADD_ACCUMULATE:     dispatch_real<Accumulate<Add> >(t0, instr);        break;
+        case BH_MULTIPLY_ACCUMULATE:dispatch_real<Accumulate<Multiply> >(t0, instr);   break;
+        case BH_RANGE:              dispatch_integer<Range>(t0, instr);                break;
+        case BH_GATHER:             dispatch_real<Gather>(t0, instr);                  break;
+        case BH_SCATTER:
+        case BH_COND_SCATTER:       dispatch_real<Scatter>(t0, instr);                 break;
+        default:
+            unsupported(instr);
+    }
+}
+
+void interpret(const vector<Block> &block_list) {
+    for (const Block &block: block_list) {
+        for (const InstrPtr &instr: block.getAllInstr()) {
+            interpret(*instr);
+        }
+    }
+}
+
+void interpret(const vector<bh_instruction*> &instr_list) {
+    for (const bh_instruction *instr: instr_list) {
+        interpret(*instr);
+    }
+}
+
+} // jitk
+} // bohrium
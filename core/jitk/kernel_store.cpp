@@ -0,0 +1,315 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <fcntl.h>
+#include <cerrno>
+#include <unistd.h>
+#include <ctime>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+#include <jitk/kernel_store.hpp>
+#include <jitk/codegen_util.hpp>
+#include <bh_util.hpp>
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+namespace bohrium {
+namespace jitk {
+
+namespace {
+
+// The number of kernel compile locks
+constexpr size_t NUM_COMPILE_LOCKS = 64;
+
+// An entry of the index
+struct Entry {
+    uint64_t bytes;
+    uint64_t last_use;
+};
+
+// Read the index at 'path' where the latest line of each filename wins.
+// Torn lines, which a process leaves behind when it crashes while appending to the index, are skipped.
+map<string, Entry> read_index(const fs::path &path, int64_t &num_lines) {
+    map<string, Entry> ret;
+    num_lines = 0;
+    ifstream file(path.string());
+    string line;
+    while (getline(file, line)) {
+        ++num_lines;
+        istringstream ss(line);
+        string filename;
+        Entry entry;
+        if (ss >> filename >> entry.bytes >> entry.last_use) {
+            Entry &e = ret[filename];
+            e.bytes = entry.bytes;
+            e.last_use = std::max(e.last_use, entry.last_use);
+        }
+    }
+    return ret;
+}
+
+// Returns true when 'filename' is a kernel (and not the index, a lock, or a temporary file)
+bool is_kernel_file(const fs::path &path) {
+    const string filename = path.filename().string();
+    return fs::is_regular_file(path) and not filename.empty() and filename[0] != '.' and
+           filename != "index" and filename != "index.lock";
+}
+
+// Returns the mutex of the lock file 'path', which serializes the threads of this process.
+// NB: the mutexes are never destructed since a KernelStore might be destructed after the static objects
+mutex &thread_mutex(const fs::path &path) {
+    static mutex *registry_mutex = new mutex();
+    static map<string, unique_ptr<mutex> > *registry = new map<string, unique_ptr<mutex> >();
+    lock_guard<mutex> guard(*registry_mutex);
+    unique_ptr<mutex> &ret = (*registry)[path.string()];
+    if (not ret) {
+        ret.reset(new mutex());
+    }
+    return *ret;
+}
+
+// Returns the size of 'path' or -1 when 'path' doesn't exist
+int64_t file_size_or_none(const fs::path &path) {
+    boost::system::error_code ec;
+    const uintmax_t size = fs::file_size(path, ec);
+    return ec ? -1 : static_cast<int64_t>(size);
+}
+
+} // Anonymous namespace
+
+KernelStore::Lock::Lock(const fs::path &path) : _thread_lock(thread_mutex(path)) {
+    _fd = ::open(path.string().c_str(), O_RDWR | O_CREAT, 0666);
+    if (_fd < 0) {
+        throw runtime_error("KernelStore: cannot open lock file " + path.string());
+    }
+    // A traditional fcntl() lock belongs to the process, which loses all its locks of a file when any of its
+    // threads closes a descriptor of the file. Open file description locks belong to the descriptor.
+#ifdef F_OFD_SETLKW
+    const int cmd = F_OFD_SETLKW;
+#else
+    const int cmd = F_SETLKW;
+#endif
+    struct flock fl = {};
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    while (fcntl(_fd, cmd, &fl) == -1) {
+        if (errno != EINTR) {
+            ::close(_fd);
+            throw runtime_error("KernelStore: cannot lock " + path.string());
+        }
+    }
+}
+
+KernelStore::Lock::~Lock() {
+    ::close(_fd); // Closing the file releases the lock
+}
+
+KernelStore::KernelStore(fs::path dir, int64_t max_files, int64_t max_bytes) : _dir(std::move(dir)),
+                                                                               _max_files(max_files),
+                                                                               _max_bytes(max_bytes) {
+    if (not enabled()) {
+        return;
+    }
+    jitk::create_directories(_dir / "locks");
+    Lock index_lock(_dir / "index.lock");
+    const fs::path index = _dir / "index";
+    if (fs::exists(index)) {
+        for (const auto &kernel: read_index(index, _num_lines)) {
+            ++_num_files;
+            _num_bytes += kernel.second.bytes;
+        }
+    } else {
+        // A cache dir without an index (e.g. from an older version of Bohrium) is indexed once
+        const uint64_t now = static_cast<uint64_t>(std::time(nullptr));
+        ofstream file(index.string(), ofstream::app);
+        for (fs::directory_iterator it(_dir), end; it != end; ++it) {
+            if (is_kernel_file(it->path())) {
+                const uint64_t bytes = fs::file_size(it->path());
+                file << it->path().filename().string() << " " << bytes << " " << now << "\n";
+                ++_num_files;
+                ++_num_lines;
+                _num_bytes += bytes;
+            }
+        }
+    }
+}
+
+KernelStore::~KernelStore() {
+    if (not enabled()) {
+        return;
+    }
+    try {
+        Lock index_lock(_dir / "index.lock");
+        unique_lock<mutex> guard(_mutex);
+        if (not _uses.empty()) {
+            const uint64_t now = static_cast<uint64_t>(std::time(nullptr));
+            ofstream file((_dir / "index").string(), ofstream::app);
+            for (const auto &use: _uses) {
+                file << use.first << " " << use.second << " " << now << "\n";
+                ++_num_lines;
+            }
+        }
+        if (_num_lines > 2 * _num_files + 1000 or exceedsLimits()) {
+            compactIndex();
+        }
+    } catch (const std::exception &e) {
+        cout << "Warning: couldn't update the kernel cache index in " << _dir << ". " << e.what() << endl;
+    }
+}
+
+bool KernelStore::lookup(const string &filename) {
+    if (not enabled()) {
+        return false;
+    }
+    boost::system::error_code ec;
+    const uint64_t bytes = fs::file_size(path(filename), ec);
+    if (ec) {
+        return false;
+    }
+    unique_lock<mutex> guard(_mutex);
+    _uses[filename] = bytes;
+    return true;
+}
+
+unique_ptr<KernelStore::Lock> KernelStore::lock(const string &filename) const {
+    if (not enabled()) {
+        return nullptr;
+    }
+    stringstream ss;
+    ss << "locks/" << (util::hash(filename) % NUM_COMPILE_LOCKS) << ".lock";
+    return unique_ptr<Lock>(new Lock(_dir / ss.str()));
+}
+
+fs::path KernelStore::tmpPath(const string &filename) const {
+    static std::atomic<uint64_t> count(0);
+    stringstream ss;
+    ss << "." << filename << "." << getpid() << "." << count++ << ".tmp";
+    return _dir / ss.str();
+}
+
+void KernelStore::publish(const fs::path &file, const string &filename) {
+    if (not enabled()) {
+        return;
+    }
+    const fs::path tmp = tmpPath(filename);
+    fs::copy_file(file, tmp);
+    const uint64_t bytes = fs::file_size(tmp);
+    const int64_t replaced_bytes = file_size_or_none(path(filename));
+    fs::rename(tmp, path(filename)); // Notice, rename() is atomic
+    appendIndex(filename, bytes, replaced_bytes);
+}
+
+void KernelStore::publish(const char *data, size_t size, const string &filename) {
+    if (not enabled()) {
+        return;
+    }
+    const fs::path tmp = tmpPath(filename);
+    {
+        ofstream file(tmp.string(), ofstream::out | ofstream::binary);
+        file.write(data, size);
+        if (not file) {
+            fs::remove(tmp);
+            throw runtime_error("KernelStore: cannot write " + tmp.string());
+        }
+    }
+    const int64_t replaced_bytes = file_size_or_none(path(filename));
+    fs::rename(tmp, path(filename)); // Notice, rename() is atomic
+    appendIndex(filename, size, replaced_bytes);
+}
+
+void KernelStore::appendIndex(const string &filename, uint64_t bytes, int64_t replaced_bytes) {
+    Lock index_lock(_dir / "index.lock");
+    unique_lock<mutex> guard(_mutex);
+    {
+        ofstream file((_dir / "index").string(), ofstream::app);
+        file << filename << " " << bytes << " " << static_cast<uint64_t>(std::time(nullptr)) << "\n";
+    }
+    if (replaced_bytes == -1) {
+        ++_num_files;
+    } else {
+        _num_bytes -= replaced_bytes;
+    }
+    ++_num_lines;
+    _num_bytes += bytes;
+    if (exceedsLimits()) {
+        compactIndex();
+    }
+}
+
+void KernelStore::compactIndex() {
+    const fs::path index = _dir / "index";
+    map<string, Entry> entries = read_index(index, _num_lines);
+
+    // Kernels that are missing in the index (e.g. their line was torn) are indexed by their modification time
+    for (fs::directory_iterator it(_dir), end; it != end; ++it) {
+        const string filename = it->path().filename().string();
+        if (entries.find(filename) == entries.end() and is_kernel_file(it->path())) {
+            boost::system::error_code ec1, ec2;
+            const uintmax_t bytes = fs::file_size(it->path(), ec1);
+            const time_t last_use = fs::last_write_time(it->path(), ec2);
+            if (not ec1 and not ec2) {
+                entries[filename] = Entry{bytes, static_cast<uint64_t>(last_use)};
+            }
+        }
+    }
+
+    // The kernels sorted by their last use (the most recently used first)
+    vector<pair<string, Entry> > kernels;
+    kernels.reserve(entries.size());
+    for (const auto &kernel: entries) {
+        if (fs::exists(_dir / kernel.first)) { // Another process might have removed the file
+            kernels.push_back(kernel);
+        }
+    }
+    std::sort(kernels.begin(), kernels.end(), [](const pair<string, Entry> &a, const pair<string, Entry> &b) {
+        return a.second.last_use > b.second.last_use;
+    });
+
+    // Keep the most recently used kernels
+    _num_files = 0;
+    _num_bytes = 0;
+    const fs::path tmp = tmpPath("index");
+    {
+        ofstream file(tmp.string());
+        for (const auto &kernel: kernels) {
+            const bool full = (_max_files != -1 and _num_files + 1 > _max_files) or
+                              (_max_bytes != -1 and _num_bytes + static_cast<int64_t>(kernel.second.bytes) > _max_bytes);
+            if (full) {
+                boost::system::error_code ec;
+                fs::remove(_dir / kernel.first, ec);
+            } else {
+                file << kernel.first << " " << kernel.second.bytes << " " << kernel.second.last_use << "\n";
+                ++_num_files;
+                _num_bytes += kernel.second.bytes;
+            }
+        }
+    }
+    fs::rename(tmp, index);
+    _num_lines = _num_files;
+}
+
+}} // namespace
@@ -0,0 +1,76 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <jitk/thread_pool.hpp>
+
+using namespace std;
+
+namespace bohrium {
+namespace jitk {
+
+ThreadPool::ThreadPool(unsigned int num_threads) {
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    _workers.reserve(num_threads);
+    for (unsigned int i = 0; i < num_threads; ++i) {
+        _workers.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        unique_lock<mutex> lock(_mutex);
+        _stop = true;
+    }
+    _cond.notify_all();
+    for (thread &worker: _workers) {
+        worker.join();
+    }
+}
+
+shared_future<void> ThreadPool::submit(function<void()> job) {
+    packaged_task<void()> task(std::move(job));
+    shared_future<void> ret = task.get_future().share();
+    {
+        unique_lock<mutex> lock(_mutex);
+        _jobs.push(std::move(task));
+    }
+    _cond.notify_one();
+    return ret;
+}
+
+void ThreadPool::work() {
+    while (true) {
+        packaged_task<void()> task;
+        {
+            unique_lock<mutex> lock(_mutex);
+            _cond.wait(lock, [this] { return _stop or not _jobs.empty(); });
+            if (_jobs.empty()) { // Notice, we finish all queued jobs before stopping
+                return;
+            }
+            task = std::move(_jobs.front());
+            _jobs.pop();
+        }
+        task(); // Exceptions are stored in the future of the task
+    }
+}
+
+}} // namespace
@@ -18,6 +18,12 @@ GNU Lesser General Public License along with Bohrium.
 If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <set>
+
+#include <bh_util.hpp>
 #include <jitk/transformer.hpp>
 
 using namespace std;
@@ -139,6 +145,109 @@ bool collapse_loop_with_child(LoopB &loop) {
     }
     return false;
 }
+
+// Help function that returns true when 'opcode' depends on the global index or accesses its input arrays arbitrarily
+bool index_dependent(bh_opcode opcode) {
+    switch (opcode) {
+        case BH_RANGE:
+        case BH_RANDOM:
+        case BH_GATHER:
+        case BH_SCATTER:
+        case BH_COND_SCATTER:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Help function that returns true when the outer dimension of 'instr' can be split into tiles of rows
+// that are computed independently of each other
+bool tileable(const bh_instruction &instr, int64_t size) {
+    if (bh_opcode_is_system(instr.opcode)) {
+        return true;
+    }
+    if (index_dependent(instr.opcode)) {
+        return false;
+    }
+    if (instr.sweep_axis() == 0) {
+        return false;
+    }
+    for (const bh_view &view: instr.operand) {
+        if (not bh_is_constant(&view)) {
+            if (not view.slide.empty() or view.ndim < 1 or view.shape[0] != size) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Help function that returns true when the rows of the outer dimension of 'view' never overlap
+bool disjoint_rows(const bh_view &view) {
+    int64_t row_extent = 0;
+    for (int64_t i = 1; i < view.ndim; ++i) {
+        if (view.stride[i] < 0) {
+            return false;
+        }
+        row_extent += (view.shape[i] - 1) * view.stride[i];
+    }
+    return row_extent < std::abs(view.stride[0]);
+}
+
+// Help function that narrows the outer dimension of all views in 'block' to the rows from 'begin' to 'end' (excl.)
+void narrow_outer(Block &block, int64_t begin, int64_t end) {
+    if (block.isInstr()) {
+        if (not bh_opcode_is_system(block.getInstr()->opcode)) {
+            bh_instruction instr(*block.getInstr());
+            for (bh_view &view: instr.operand) {
+                if (not bh_is_constant(&view)) {
+                    view.start += begin * view.stride[0];
+                    view.shape[0] = end - begin;
+                }
+            }
+            block.setInstr(instr);
+        }
+    } else {
+        LoopB &loop = block.getLoop();
+        if (loop.rank == 0) {
+            loop.size = end - begin;
+        }
+        for (Block &b: loop._block_list) {
+            narrow_outer(b, begin, end);
+        }
+        loop.metadataUpdate();
+    }
+}
+
+// Help function that returns true when 'loop' is a perfect nest of loops without sweeps, i.e. all instructions
+// are in the innermost loop and all their views have the shape of the nest. The loop sizes are appended to 'shape'.
+bool perfect_nest(const LoopB &loop, vector<int64_t> &shape) {
+    if (not loop._sweeps.empty() or loop._block_list.empty()) {
+        return false;
+    }
+    shape.push_back(loop.size);
+    if (not loop._block_list[0].isInstr()) {
+        return loop._block_list.size() == 1 and perfect_nest(loop._block_list[0].getLoop(), shape);
+    }
+    for (const Block &b: loop._block_list) {
+        if (not b.isInstr()) {
+            return false;
+        }
+        const bh_instruction &instr = *b.getInstr();
+        if (bh_opcode_is_system(instr.opcode) or index_dependent(instr.opcode)) {
+            return false;
+        }
+        for (const bh_view &view: instr.operand) {
+            if (not bh_is_constant(&view)) {
+                if (not view.slide.empty() or view.ndim != static_cast<int64_t>(shape.size()) or
+                    not std::equal(shape.begin(), shape.end(), view.shape)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
 }
 
 void push_reductions_inwards(vector<Block> &block_list) {
@@ -247,6 +356,215 @@ void collapse_redundant_axes(vector<Block> &block_list) {
     }
     block_list = ret;
 }
+
+void push_unit_strides_inwards(vector<Block> &block_list) {
+    for (Block &block: block_list) {
+        vector<int64_t> shape;
+        if (block.isInstr() or not perfect_nest(block.getLoop(), shape) or shape.size() < 2) {
+            continue;
+        }
+        const LoopB &loop = block.getLoop();
+        const vector<InstrPtr> instr_list = loop.getAllInstr();
+        const set<bh_base *> temps = loop.getAllTemps();
+
+        // The number of bytes moved through views that has unit stride in each dimension
+        const int64_t ndim = static_cast<int64_t>(shape.size());
+        vector<uint64_t> unit_bytes(ndim, 0);
+        for (const InstrPtr &instr: instr_list) {
+            for (const bh_view &view: instr->operand) {
+                if (bh_is_constant(&view) or util::exist(temps, view.base)) {
+                    continue;
+                }
+                const uint64_t nbytes = bh_nelements_nbcast(&view) * bh_type_size(view.base->type);
+                for (int64_t i = 0; i < ndim; ++i) {
+                    if (std::abs(view.stride[i]) == 1) {
+                        unit_bytes[i] += nbytes;
+                    }
+                }
+            }
+        }
+        // We keep the current innermost dimension unless another dimension moves more bytes with unit stride
+        const auto best = std::max_element(unit_bytes.rbegin(), unit_bytes.rend());
+        const int64_t axis = ndim - 1 - (best - unit_bytes.rbegin());
+        if (axis == ndim - 1) {
+            continue;
+        }
+        // The dimension becomes innermost while the order of the other dimensions is kept
+        vector<InstrPtr> transposed = instr_list;
+        for (int64_t i = axis; i < ndim - 1; ++i) {
+            transposed = swap_axis(transposed, i, i + 1);
+        }
+        block = create_nested_block(transposed, 0, loop.getAllFrees());
+    }
+}
+
+void tile(vector<Block> &block_list, uint64_t cache_bytes, uint64_t min_tiles) {
+    vector<Block> ret;
+    for (const Block &block: block_list) {
+        vector<int64_t> shape;
+        if (block.isInstr() or not perfect_nest(block.getLoop(), shape) or shape.size() < 2 or
+            static_cast<int64_t>(shape.size()) >= BH_MAXDIM - 1) {
+            ret.push_back(block);
+            continue;
+        }
+        const LoopB &loop = block.getLoop();
+        const vector<InstrPtr> instr_list = loop.getAllInstr();
+        const set<bh_base *> temps = loop.getAllTemps();
+
+        // Tiling only pays off when the rows of an array are accessed by more than one view (e.g. a stencil),
+        // in which case the rows can be reused from the cache by the next iteration of the outermost loop
+        map<const bh_base *, set<bh_view> > views;
+        for (const InstrPtr &instr: instr_list) {
+            for (const bh_view &view: instr->operand) {
+                if (not bh_is_constant(&view) and not util::exist(temps, view.base)) {
+                    views[view.base].insert(view);
+                }
+            }
+        }
+        bool reuse = false;
+        uint64_t element_bytes = 0; // The bytes of one element of each array
+        for (const auto &base_views: views) {
+            reuse = reuse or base_views.second.size() > 1;
+            element_bytes += bh_type_size(base_views.first->type);
+        }
+        if (not reuse) {
+            ret.push_back(block);
+            continue;
+        }
+
+        // The tile size makes three rows of the tiles of each array fit in the cache, which covers the neighbouring
+        // rows of a stencil. Whole rows that fit already are reused without tiles.
+        // The tiles are parallelized thus we need at least 'min_tiles' of them.
+        uint64_t inner = 1;
+        for (size_t i = 2; i < shape.size(); ++i) {
+            inner *= shape[i];
+        }
+        int64_t tile_size = static_cast<int64_t>(cache_bytes / (3 * inner * element_bytes));
+        if (tile_size >= shape[1]) {
+            ret.push_back(block);
+            continue;
+        }
+        tile_size = std::min(tile_size, shape[1] / static_cast<int64_t>(std::max(min_tiles, uint64_t{1})));
+        tile_size -= tile_size % 8; // Keep the innermost loops vectorizable
+        if (tile_size < 8 or tile_size >= shape[1]) {
+            ret.push_back(block);
+            continue;
+        }
+
+        // The second dimension of all views is split into a new outermost dimension of tiles and a dimension within
+        // a tile. The rest of the second dimension that doesn't fill a tile gets its own block.
+        const int64_t num_tiles = shape[1] / tile_size;
+        const int64_t tiled = num_tiles * tile_size;
+        vector<InstrPtr> tiled_list, rest_list;
+        for (const InstrPtr &instr: instr_list) {
+            bh_instruction tiled_instr(*instr), rest_instr(*instr);
+            for (size_t i = 0; i < instr->operand.size(); ++i) {
+                if (not bh_is_constant(&instr->operand[i])) {
+                    const int64_t stride = instr->operand[i].stride[1];
+                    bh_view &tiled_view = tiled_instr.operand[i];
+                    tiled_view.insert_axis(0, num_tiles, tile_size * stride);
+                    tiled_view.shape[2] = tile_size;
+                    bh_view &rest_view = rest_instr.operand[i];
+                    rest_view.start += tiled * stride;
+                    rest_view.shape[1] = shape[1] - tiled;
+                }
+            }
+            tiled_list.push_back(std::make_shared<bh_instruction>(tiled_instr));
+            rest_list.push_back(std::make_shared<bh_instruction>(rest_instr));
+        }
+        // Both blocks free the temporary arrays, which makes them temporary in both blocks, whereas the other arrays
+        // are freed by the last block
+        const set<bh_base *> frees = loop.getAllFrees();
+        if (tiled == shape[1]) {
+            ret.push_back(create_nested_block(tiled_list, 0, frees));
+        } else {
+            set<bh_base *> temp_frees;
+            std::set_intersection(frees.begin(), frees.end(), temps.begin(), temps.end(),
+                                  std::inserter(temp_frees, temp_frees.begin()));
+            ret.push_back(create_nested_block(tiled_list, 0, temp_frees));
+            ret.push_back(create_nested_block(rest_list, 0, frees));
+        }
+    }
+    block_list = std::move(ret);
+}
+
+int64_t outer_tile_rows(const vector<Block> &block_list, uint64_t tile_bytes) {
+    if (tile_bytes == 0) {
+        return 0;
+    }
+    // All computing blocks must have the same outer loop size
+    int64_t size = -1;
+    vector<InstrPtr> instr_list;
+    set<bh_base*> non_temps;
+    for (const Block &block: block_list) {
+        if (block.isSystemOnly()) {
+            continue;
+        }
+        const LoopB &loop = block.getLoop();
+        if (size == -1) {
+            size = loop.size;
+        } else if (size != loop.size) {
+            return 0;
+        }
+        loop.getAllInstr(instr_list);
+        loop.getAllNonTemps(non_temps);
+    }
+    if (size < 2) {
+        return 0;
+    }
+
+    // A written array must be accessed through views with the same rows, otherwise a tile might access rows of
+    // another tile
+    map<const bh_base*, set<bh_view> > views;
+    set<const bh_base*> written;
+    for (const InstrPtr &instr: instr_list) {
+        if (not tileable(*instr, size)) {
+            return 0;
+        }
+        if (bh_opcode_is_system(instr->opcode)) {
+            continue;
+        }
+        for (size_t i = 0; i < instr->operand.size(); ++i) {
+            const bh_view &view = instr->operand[i];
+            if (not bh_is_constant(&view)) {
+                views[view.base].insert(view);
+                if (i == 0) {
+                    written.insert(view.base);
+                }
+            }
+        }
+    }
+    uint64_t total_bytes = 0;
+    for (const auto &base_views: views) {
+        if (util::exist(written, base_views.first)) {
+            const bh_view &first = *base_views.second.begin();
+            for (const bh_view &view: base_views.second) {
+                if (not disjoint_rows(view) or view.start != first.start or view.stride[0] != first.stride[0]) {
+                    return 0;
+                }
+            }
+        }
+        if (util::exist_nconst(non_temps, base_views.first)) {
+            int64_t nbytes = 0;
+            for (const bh_view &view: base_views.second) {
+                nbytes = std::max(nbytes, bh_nelements_nbcast(&view) * bh_type_size(view.base->type));
+            }
+            total_bytes += nbytes;
+        }
+    }
+    const uint64_t row_bytes = std::max(total_bytes / size, uint64_t{1});
+    const auto rows = static_cast<int64_t>(std::max(tile_bytes / row_bytes, uint64_t{1}));
+    return rows < size ? rows : 0;
+}
+
+vector<Block> outer_tile(const vector<Block> &block_list, int64_t begin, int64_t end) {
+    vector<Block> ret(block_list);
+    for (Block &block: ret) {
+        narrow_outer(block, begin, end);
+    }
+    return ret;
+}
+
 } // jitk
 } // bohrium
 
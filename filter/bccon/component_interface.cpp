@@ -36,7 +36,8 @@ public:
                                        config.defaultGet<bool>("reduction", false),
                                        config.defaultGet<bool>("stupidmath", false),
                                        config.defaultGet<bool>("collect", false),
-                                       config.defaultGet<bool>("muladd", false)) {};
+                                       config.defaultGet<bool>("muladd", false),
+                                       config.defaultGet<bool>("reuse", false)) {};
 
     ~Impl() {}; // NB: a destructor implementation must exist
     void execute(BhIR *bhir) {
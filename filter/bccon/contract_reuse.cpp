@@ -0,0 +1,192 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <map>
+#include <unordered_map>
+
+#include <bh_util.hpp>
+
+#include "contracter.hpp"
+
+using namespace std;
+
+namespace bohrium {
+namespace filter {
+namespace bccon {
+
+namespace {
+
+// The live range of a base array within the instruction list
+struct Liveness {
+    int64_t first = -1;          // The first instruction that accesses the base
+    int64_t last = -1;           // The last instruction that accesses the base (not counting BH_FREE)
+    int64_t free = -1;           // The BH_FREE of the base
+    bool first_is_write = false; // The first access only writes to the base
+};
+
+// Returns true when 'a' and 'b' access the same elements (their bases are ignored)
+bool same_geometry(const bh_view &a, const bh_view &b) {
+    if (a.start != b.start or a.ndim != b.ndim or not a.slide.empty() or not b.slide.empty()) {
+        return false;
+    }
+    for (int64_t i = 0; i < a.ndim; ++i) {
+        if (a.shape[i] != b.shape[i] or a.stride[i] != b.stride[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns the base that 'base' has been renamed to
+bh_base *resolve(const unordered_map<bh_base*, bh_base*> &rename, bh_base *base) {
+    auto it = rename.find(base);
+    while (it != rename.end()) {
+        base = it->second;
+        it = rename.find(base);
+    }
+    return base;
+}
+
+}
+
+/* Let the arrays of this flush share storage.
+ *
+ * A temporary array 'A' that is created and freed within the flush hands over its storage to an array 'B' of
+ * the same type and size that is created after the last access of 'A'. We do that by renaming 'A' to 'B' and
+ * removing the BH_FREE of 'A' thus 'B' is allocated once and 'A' is never allocated.
+ * When 'B' is computed elementwise from 'A' and 'A' dies at that instruction, 'B = f(A)' becomes 'B = f(B)'
+ * as long as the two views access the same elements.
+ *
+ * NB: the renaming extends the live range of 'B', which prevents the fuser from contracting 'A' into a
+ *     scalar if 'A' and 'B' end up in different kernels. Therefore, this pass should only be enabled when
+ *     the temporary arrays cannot be contracted anyway.
+ */
+void Contracter::reuse(BhIR &bhir)
+{
+    if (bhir.getNRepeats() > 1) {
+        return; // The arrays might be live across the iterations
+    }
+
+    unordered_map<bh_base*, Liveness> liveness;
+    for (size_t pc = 0; pc < bhir.instr_list.size(); ++pc) {
+        const bh_instruction &instr = bhir.instr_list[pc];
+        if (instr.opcode == BH_NONE) {
+            continue;
+        }
+        if (instr.opcode == BH_FREE) {
+            liveness[instr.operand[0].base].free = pc;
+            continue;
+        }
+        for (size_t i = 0; i < instr.operand.size(); ++i) {
+            const bh_view &view = instr.operand[i];
+            if (bh_is_constant(&view)) {
+                continue;
+            }
+            Liveness &l = liveness[view.base];
+            if (l.first == -1) {
+                l.first = pc;
+                l.first_is_write = i == 0 and not bh_opcode_is_system(instr.opcode);
+            } else if (l.first == static_cast<int64_t>(pc)) {
+                l.first_is_write = false; // The instruction also reads the base
+            }
+            l.last = pc;
+        }
+    }
+
+    // Arrays that are created here and freed without anybody else seeing their data
+    auto is_temp = [&](bh_base *base) -> bool {
+        const Liveness &l = liveness.at(base);
+        return base->data == nullptr and l.first_is_write and l.free > l.last and
+               not util::exist(bhir._syncs, base) and base != bhir.getRepeatCondition();
+    };
+
+    // Temporaries whose live range has ended, by type and size
+    map<pair<bh_type, int64_t>, vector<bh_base*> > pool;
+    unordered_map<bh_base*, bh_base*> rename;
+    for (size_t pc = 0; pc < bhir.instr_list.size(); ++pc) {
+        bh_instruction &instr = bhir.instr_list[pc];
+        if (instr.opcode == BH_NONE or instr.opcode == BH_FREE or bh_opcode_is_system(instr.opcode) or
+            bh_is_constant(&instr.operand[0])) {
+            continue;
+        }
+        bh_base *out = instr.operand[0].base;
+        const Liveness &l = liveness.at(out);
+        if (out->data == nullptr and l.first == static_cast<int64_t>(pc) and l.first_is_write) {
+            // In-place: a temporary that dies at this instruction hands over its storage to the output
+            bool in_place = false;
+            if (bh_opcode_is_elementwise(instr.opcode)) {
+                for (size_t i = 1; i < instr.operand.size() and not in_place; ++i) {
+                    const bh_view &view = instr.operand[i];
+                    if (bh_is_constant(&view) or view.base->type != out->type or view.base->nelem != out->nelem or
+                        liveness.at(view.base).last != static_cast<int64_t>(pc) or not is_temp(view.base)) {
+                        continue;
+                    }
+                    // All accesses of the temporary must match the output element by element
+                    in_place = true;
+                    for (size_t j = 1; j < instr.operand.size(); ++j) {
+                        const bh_view &other = instr.operand[j];
+                        if (not bh_is_constant(&other) and other.base == view.base) {
+                            in_place = in_place and same_geometry(other, instr.operand[0]);
+                        }
+                    }
+                    if (in_place) {
+                        rename[view.base] = out;
+                    }
+                }
+            }
+            // Otherwise, we use the storage of an earlier temporary
+            if (not in_place) {
+                auto it = pool.find(make_pair(out->type, out->nelem));
+                if (it != pool.end() and not it->second.empty()) {
+                    rename[it->second.back()] = out;
+                    it->second.pop_back();
+                }
+            }
+        }
+
+        // Temporaries that die at this instruction can be reused from the next instruction
+        for (const bh_view &view: instr.operand) {
+            if (not bh_is_constant(&view) and liveness.at(view.base).last == static_cast<int64_t>(pc) and
+                not util::exist(rename, view.base) and is_temp(view.base)) {
+                vector<bh_base*> &bases = pool[make_pair(view.base->type, view.base->nelem)];
+                if (not util::exist_linearly(bases, view.base)) {
+                    bases.push_back(view.base);
+                }
+            }
+        }
+    }
+    if (rename.empty()) {
+        return;
+    }
+
+    for (bh_instruction &instr: bhir.instr_list) {
+        if (instr.opcode == BH_FREE and util::exist(rename, instr.operand[0].base)) {
+            instr.opcode = BH_NONE; // The storage now belongs to the renamed array
+            continue;
+        }
+        for (bh_view &view: instr.operand) {
+            if (not bh_is_constant(&view)) {
+                view.base = resolve(rename, view.base);
+            }
+        }
+    }
+    verbose_print("[Reuse] Reused the storage of " + std::to_string(rename.size()) + " arrays");
+}
+
+}}}
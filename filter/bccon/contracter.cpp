@@ -32,12 +32,14 @@ Contracter::Contracter(
     bool reduction,
     bool stupidmath,
     bool collect,
-    bool muladd)
+    bool muladd,
+    bool reuse)
     : repeats_(repeats),
       reduction_(reduction),
       stupidmath_(stupidmath),
       collect_(collect),
-      muladd_(muladd) {
+      muladd_(muladd),
+      reuse_(reuse) {
             __verbose = verbose;
       }
 
@@ -49,6 +51,7 @@ void Contracter::contract(BhIR& bhir)
     if(stupidmath_) stupidmath(bhir);
     if(collect_)    collect(bhir);
     if(muladd_)     muladd(bhir);
+    if(reuse_)      reuse(bhir);
 }
 
 void verbose_print(std::string str)
@@ -12,7 +12,7 @@ extern void verbose_print(std::string str);
 class Contracter
 {
 public:
-    Contracter(bool verbose, bool repeats, bool reduction, bool stupidmath, bool collect, bool muladd);
+    Contracter(bool verbose, bool repeats, bool reduction, bool stupidmath, bool collect, bool muladd, bool reuse);
 
     ~Contracter(void);
 
@@ -22,12 +22,14 @@ public:
     void stupidmath(BhIR& bhir);
     void collect(BhIR& bhir);
     void muladd(BhIR& bhir);
+    void reuse(BhIR& bhir);
 private:
     bool repeats_;
     bool reduction_;
     bool stupidmath_;
     bool collect_;
     bool muladd_;
+    bool reuse_;
 };
 
 }}}
@@ -0,0 +1,75 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+#include <bh_component.hpp>
+#include <bh_trace.hpp>
+
+using namespace bohrium;
+using namespace component;
+using namespace std;
+
+namespace {
+
+// Returns the trace filename of the config where "{PID}" is replaced with the process ID
+string trace_filename(const ConfigParser &config) {
+    string ret = config.defaultGet<string>("filename", "bh-{PID}.trace");
+    const size_t pos = ret.find("{PID}");
+    if (pos != string::npos) {
+        stringstream ss;
+        ss << getpid();
+        ret.replace(pos, 5, ss.str());
+    }
+    return ret;
+}
+
+class Impl : public ComponentImplWithChild {
+  private:
+    const string filename;
+    const bool with_data;
+    TraceWriter writer;
+  public:
+    Impl(int stack_level) : ComponentImplWithChild(stack_level),
+                            filename(trace_filename(config)),
+                            with_data(config.defaultGet<bool>("with_data", true)),
+                            writer(filename) {
+        cout << "trace-filter: writing trace('" << filename << "')." << endl;
+    };
+    ~Impl() {}; // NB: a destructor implementation must exist
+    void execute(BhIR *bhir) {
+        writer.write(*bhir, with_data);
+        child.execute(bhir);
+    };
+    void extmethod(const string &name, bh_opcode opcode) {
+        writer.writeExtmethod(name, opcode);
+        child.extmethod(name, opcode);
+    };
+};
+} //Unnamed namespace
+
+extern "C" ComponentImpl* create(int stack_level) {
+    return new Impl(stack_level);
+}
+extern "C" void destroy(ComponentImpl* self) {
+    delete self;
+}
@@ -0,0 +1,144 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* bh_trace_replay: replays a BhIR trace recorded by the trace filter.
+ *
+ * The BhIRs of the trace are executed by the stack specified by BH_STACK (as if the replayer was the bridge)
+ * in the recorded order using the recorded array data. The execution time of each flush is reported, which
+ * makes it possible to benchmark the fuser and the engines offline on recorded workloads.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+
+#include <bh_component.hpp>
+#include <bh_trace.hpp>
+#include <bh_util.hpp>
+
+using namespace bohrium;
+using namespace component;
+using namespace std;
+
+namespace {
+
+struct Options {
+    string trace;
+    uint64_t repeats = 1;   // Number of times to replay the trace
+    bool per_flush = true;  // Report the time of each flush
+    bool checksum = false;  // Report a checksum of the sync'ed arrays
+};
+
+// Returns the hash of the data of 'base', which the replayer reads through 'runtime' like a bridge would
+uint64_t checksum(ComponentFace &runtime, bh_base &base) {
+    const void *data = runtime.getMemoryPointer(base, true, false, false);
+    if (data == nullptr) {
+        return 0;
+    }
+    return util::hash(string(static_cast<const char *>(data), static_cast<size_t>(bh_base_size(&base))));
+}
+
+// Replay the trace once and returns the total execution time
+chrono::duration<double> replay(ComponentFace &runtime, const Options &opts, uint64_t iteration) {
+    TraceReader reader(opts.trace);
+    chrono::duration<double> total{0};
+    vector<bh_base*> data_recv;
+    vector<pair<string, bh_opcode> > extmethods;
+    uint64_t flush = 0;
+    while (unique_ptr<BhIR> bhir = reader.read(true, data_recv, extmethods)) {
+        for (const auto &ext: extmethods) {
+            runtime.extmethod(ext.first, ext.second);
+        }
+        const size_t num_instrs = bhir->instr_list.size();
+        const auto tstart = chrono::steady_clock::now();
+        runtime.execute(bhir.get());
+        const chrono::duration<double> time = chrono::steady_clock::now() - tstart;
+        total += time;
+
+        if (opts.per_flush) {
+            cout << "[" << iteration << "] flush " << setw(5) << flush << ": " << setw(6) << num_instrs
+                 << " instructions, " << bhir->getNRepeats() << " repeats, " << scientific << setprecision(6)
+                 << time.count() << "s" << defaultfloat;
+            if (opts.checksum) {
+                cout << ", syncs:";
+                for (bh_base *base: bhir->getSyncs()) {
+                    cout << " " << hex << checksum(runtime, *base) << dec;
+                }
+            }
+            cout << "\n";
+        }
+        ++flush;
+    }
+    cout << "[" << iteration << "] " << flush << " flushes executed in " << total.count() << "s" << endl;
+    return total;
+}
+
+void usage(const char *name) {
+    cout << "Usage: " << name << " [-n <repeats>] [-q] [-c] <trace>\n\n"
+         << "Replays the BhIR trace on the stack specified by BH_STACK and reports the execution time.\n"
+         << "  -n <repeats>  replay the trace <repeats> times (default: 1)\n"
+         << "  -q            only report the total time of each replay\n"
+         << "  -c            report a checksum of the sync'ed arrays of each flush" << endl;
+}
+}
+
+int main(int argc, char *argv[]) {
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 and i + 1 < argc) {
+            opts.repeats = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "-q") == 0) {
+            opts.per_flush = false;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            opts.checksum = true;
+        } else if (strcmp(argv[i], "-h") == 0 or strcmp(argv[i], "--help") == 0) {
+            usage(argv[0]);
+            return 0;
+        } else if (argv[i][0] == '-' or not opts.trace.empty()) {
+            usage(argv[0]);
+            return 1;
+        } else {
+            opts.trace = argv[i];
+        }
+    }
+    if (opts.trace.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    try {
+        const ConfigParser config(-1); // Stack level -1 is the bridge
+        ComponentFace runtime(config.getChildLibraryPath(), 0); // and its child is stack level 0
+        chrono::duration<double> total{0};
+        for (uint64_t i = 0; i < opts.repeats; ++i) {
+            total += replay(runtime, opts, i);
+        }
+        if (opts.repeats > 1) {
+            cout << "Replayed " << opts.repeats << " times in " << total.count() << "s" << endl;
+        }
+    } catch (const std::exception &e) {
+        cerr << argv[0] << ": " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -22,6 +22,7 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <boost/property_tree/ptree.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/filesystem.hpp>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -233,6 +234,18 @@ class ConfigParser {
         return defaultGetList(_default_section, option, default_value);
     }
 
+    /* Get all options within the 'section' and their values (incl.
+     * the values overwritten by environment variables)
+     *
+     * @section        The ini section e.g. [gpu]. If omitted, the
+     *                 default section is used.
+     * @return         Map of option names to values
+     */
+    std::map<std::string, std::string> getOptions(const std::string &section) const;
+    std::map<std::string, std::string> getOptions() const {
+        return getOptions(_default_section);
+    }
+
     /* Return the path to the library that implements
      * the calling component's child.
      *
@@ -33,6 +33,14 @@ extern "C" {
  */
 typedef int (*bh_mem_signal_callback_t) (void* fault_address, void* segment_idx);
 
+/** Source function type of lazy memory segments
+ *  The function is called with the memory segment idx the first time the segment is touched and must return
+ *  a pointer to the data of the segment (or NULL, which makes the data zero).
+ *  NB: like a callback, the function is called by the faulting thread from the signal handler. Threads that touch
+ *      the segment concurrently might call the function more than once, in which case the first result is used.
+ */
+typedef void* (*bh_mem_signal_source_t) (void* segment_idx);
+
 /** Init arrays and signal handler
  *
  * @param void
@@ -50,9 +58,39 @@ void bh_mem_signal_shutdown(void);
  * @param callback - Callback function which is executed when segfault hits in the memory
  *                   segment. The function is called with the address pointer and the memory segment idx.
  *                   NB: the function must return non-zero on success
+ *
+ * NB: two memory segments cannot share a page, which is never the case for mmap'ed memory.
  */
 void bh_mem_signal_attach(void *idx, void *addr, uint64_t size, bh_mem_signal_callback_t callback);
 
+/** Check if lazy memory segments are enabled
+ *  Lazy memory segments requires Linux' userfaultfd and are enabled by the environment variable `BH_MEM_LAZY`.
+ *
+ * @return - Non-zero when `bh_mem_signal_attach_lazy()` is available
+ */
+int bh_mem_signal_lazy_enabled(void);
+
+/** Attach lazy memory segment
+ *  Instead of calling a callback on the first access, the pages of a lazy memory segment are copied one at a time
+ *  from the data returned by `source` when they are touched.
+ *  NB: the memory must be private anonymous memory that is readable, writable, and without any pages,
+ *      e.g. new mmap'ed memory or memory released by `madvise(MADV_DONTNEED)`.
+ *
+ * @param idx - Id to identify the memory segment when calling `source`.
+ * @param addr - Start address of memory segment, which must be page aligned.
+ * @param size - Size of memory segment in bytes
+ * @param source - Function that returns the data of the segment, which is called the first time the segment is touched
+ * @return - Non-zero on success, zero when the segment cannot be lazy (use `bh_mem_signal_attach()` instead)
+ */
+int bh_mem_signal_attach_lazy(void *idx, void *addr, uint64_t size, bh_mem_signal_source_t source);
+
+/** Copy all untouched pages of a lazy memory segment from its source
+ *  Nothing happens if the segment isn't lazy or hasn't been touched yet.
+ *
+ * @param addr - Start address of memory segment.
+ */
+void bh_mem_signal_populate(const void *addr);
+
 /** Detach signal
  *
  * @param addr - Start address of memory segment.
@@ -60,6 +98,7 @@ void bh_mem_signal_attach(void *idx, void *addr, uint64_t size, bh_mem_signal_ca
 void bh_mem_signal_detach(const void *addr);
 
 /** Check if signal exist
+ * NB: this function is lock-free thus it can be called concurrently with attach and detach
  *
  * @param addr - Start address of memory segment.
  */
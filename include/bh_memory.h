@@ -1,46 +1,106 @@
-/*
-This file is part of Bohrium and copyright (c) 2012 the Bohrium
-team <http://www.bh107.org>.
-
-Bohrium is free software: you can redistribute it and/or modify
-it under the terms of the GNU Lesser General Public License as
-published by the Free Software Foundation, either version 3
-of the License, or (at your option) any later version.
-
-Bohrium is distributed in the hope that it will be useful,
-but WITHOUT ANY WARRANTY; without even the implied warranty of
-MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-GNU General Public License for more details.
-
-You should have received a copy of the
-GNU Lesser General Public License along with Bohrium.
-
-If not, see <http://www.gnu.org/licenses/>.
-*/
-#pragma once
-
-#include <bh_type.hpp>
-
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-/* Allocate an alligned contigous block of memory,
- * without any initialization
- *
- * @size  The size of the allocated block
- * @return A pointer to data, and NULL on error
- */
-void* bh_memory_malloc(int64_t size);
-
-/* Frees a previously allocated data block
- *
- * @data  The pointer returned from a call to bh_memory_malloc
- * @size  The size of the allocated block
- * @return A pointer to data, and NULL on error
- */
-int64_t bh_memory_free(void* data, int64_t size);
-
-#ifdef __cplusplus
-}
-#endif
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <bh_type.hpp>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Allocate an alligned contigous block of memory,
+ * without any initialization
+ *
+ * @size  The size of the allocated block
+ * @return A pointer to data, and NULL on error
+ */
+void* bh_memory_malloc(int64_t size);
+
+/* Frees a previously allocated data block
+ *
+ * @data  The pointer returned from a call to bh_memory_malloc
+ * @size  The size of the allocated block
+ * @return A pointer to data, and NULL on error
+ */
+int64_t bh_memory_free(void* data, int64_t size);
+
+/* The huge page policies of bh_memory_malloc(), which apply to blocks above a size threshold */
+#define BH_HUGEPAGES_NONE        0 // Normal pages
+#define BH_HUGEPAGES_TRANSPARENT 1 // Transparent huge pages using madvise(MADV_HUGEPAGE)
+#define BH_HUGEPAGES_EXPLICIT    2 // Reserved huge pages using MAP_HUGETLB (falls back to transparent huge pages)
+
+/* Configure the use of huge pages
+ *
+ * @policy     One of the BH_HUGEPAGES_* policies
+ * @threshold  The minimum size in bytes of the blocks that use huge pages
+ */
+void bh_memory_hugepages_config(int policy, int64_t threshold);
+
+/* Configure the spilling of data blocks to disk. Blocks above a size threshold are backed by
+ * (unlinked) files in the spill directory instead of anonymous memory, thus the kernel can
+ * page them out to the files when the arrays are larger than the physical memory.
+ *
+ * @dir        The directory of the spill files (NULL or empty disables spilling)
+ * @threshold  The minimum size in bytes of the blocks that are backed by spill files (-1 disables spilling)
+ */
+void bh_memory_spill_config(const char *dir, int64_t threshold);
+
+/* The freed data blocks are kept in a memory pool for reuse by later allocations of the same
+ * number of pages. The pool retains at most a configurable number of bytes.
+ */
+typedef struct
+{
+    uint64_t hits;               // Allocations served by the pool
+    uint64_t misses;             // Allocations that had to map new memory
+    uint64_t bytes_retained;     // Bytes currently in the pool
+    uint64_t max_bytes_retained; // Maximum bytes in the pool at any time
+    uint64_t bytes_trimmed;      // Bytes currently in the pool that the kernel may reclaim
+} bh_memory_pool_stats;
+
+/* Configure the memory pool
+ *
+ * @max_bytes   The maximum number of bytes the pool retains (0 disables the pool)
+ * @trim_bytes  The number of bytes in the pool above which the kernel may reclaim
+ *              the pages of the freed blocks (-1 means never)
+ */
+void bh_memory_pool_config(int64_t max_bytes, int64_t trim_bytes);
+
+/* Get the statistics of the memory pool
+ *
+ * @return The statistics
+ */
+bh_memory_pool_stats bh_memory_pool_get_stats(void);
+
+/* The data blocks allocated by bh_memory_malloc() and not yet freed (excl. the freed blocks in the memory pool) */
+typedef struct
+{
+    uint64_t bytes_in_use;       // Bytes currently in use
+    uint64_t max_bytes_in_use;   // Maximum bytes in use at any time
+} bh_memory_usage_stats;
+
+/* Get the number of bytes allocated by bh_memory_malloc() and not yet freed
+ *
+ * @return The usage statistics
+ */
+bh_memory_usage_stats bh_memory_get_usage(void);
+
+#ifdef __cplusplus
+}
+#endif
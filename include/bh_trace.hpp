@@ -0,0 +1,96 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <set>
+#include <map>
+#include <vector>
+#include <memory>
+#include <string>
+#include <fstream>
+#include <boost/filesystem/path.hpp>
+
+#include <bh_ir.hpp>
+
+namespace bohrium {
+
+/* A trace is a file of recorded BhIRs, which makes it possible to re-run the instructions of
+ * an application without the application e.g. to warm up the kernel cache or to replay a flush.
+ *
+ * The file starts with the magic string "BHTRACE" and a format version followed by records that
+ * start with a record type (uint8):
+ *   - 'B': a BhIR, which consist of
+ *       - The size of the archive (uint64) and the archive created by `BhIR::writeSerializedArchive()`
+ *       - A flag (uint8) that indicates whether the array data of the new base arrays are recorded
+ *       - If so, the size (uint64) and the data of each base array in `new_data` (see `writeSerializedArchive()`)
+ *   - 'E': the registration of an extension method, which consist of the opcode (int64), the size of
+ *          the name (uint64), and the name
+ * NB: the integers are written in the byte order of the recording machine.
+ */
+
+// Write BhIRs to a trace file
+class TraceWriter {
+public:
+    explicit TraceWriter(const boost::filesystem::path &filename);
+
+    // Append 'bhir' to the trace. If 'with_data', the data of the base arrays new to the trace is recorded.
+    void write(BhIR &bhir, bool with_data);
+
+    // Append the registration of the extension method 'name' as 'opcode' to the trace
+    void writeExtmethod(const std::string &name, bh_opcode opcode);
+
+private:
+    std::ofstream _file;
+    // Base arrays already in the trace
+    std::set<bh_base *> _known_base_arrays;
+};
+
+// Read BhIRs from a trace file
+class TraceReader {
+public:
+    explicit TraceReader(const boost::filesystem::path &filename);
+
+    // Free all base arrays of the trace that are still allocated
+    ~TraceReader();
+
+    /** Read the next BhIR of the trace. Returns nullptr at the end of the trace.
+     *
+     * \param load_data If true, the recorded data of the new base arrays is read into newly allocated memory.
+     *                  Otherwise, the data is skipped and all base arrays have `data == nullptr`.
+     * \param data_recv On return, contains the new base arrays that had data when the trace was recorded.
+     * \param extmethods On return, contains the extension methods (name and opcode) registered before the BhIR.
+     * \note The base arrays freed by the BhIR are released by the next call to `read()`
+     */
+    std::unique_ptr<BhIR> read(bool load_data, std::vector<bh_base *> &data_recv,
+                               std::vector<std::pair<std::string, bh_opcode> > &extmethods);
+    std::unique_ptr<BhIR> read(bool load_data, std::vector<bh_base *> &data_recv) {
+        std::vector<std::pair<std::string, bh_opcode> > extmethods;
+        return read(load_data, data_recv, extmethods);
+    }
+
+private:
+    std::ifstream _file;
+    // Maps recorded (remote) base arrays to the base arrays of this process
+    std::map<const bh_base *, bh_base> _remote2local;
+    // Recorded base arrays freed by the latest BhIR
+    std::set<bh_base *> _frees;
+};
+
+} // namespace bohrium
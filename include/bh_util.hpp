@@ -82,4 +82,45 @@ void remove_old_files(const boost::filesystem::path &dir, int64_t num_of_newest_
 uint64_t hash(const char* s, uint64_t seed = 0);
 uint64_t hash(const std::string &s, uint64_t seed = 0);
 
+// An incremental hash of a stream of integers, which avoids building a string of the fields to hash.
+// Each integer is mixed in as a 64-bit word (like the rounds of MurmurHash3 and xxHash64), thus
+// this hash is persistent between different compilers and architectures (incl. 32 and 64-bit)
+class Hasher {
+private:
+    uint64_t _state;
+    uint64_t _count = 0;
+
+    static constexpr uint64_t K1 = 0x87c37b91114253d5ULL;
+    static constexpr uint64_t K2 = 0x4cf5ad432745937fULL;
+
+    static uint64_t rotl(uint64_t x, int r) {
+        return (x << r) | (x >> (64 - r));
+    }
+
+public:
+    explicit Hasher(uint64_t seed = 0) : _state(seed ^ 0x9e3779b97f4a7c15ULL) {}
+
+    // Mix the integer (or enum) `value` into the hash
+    template<typename T>
+    Hasher &operator<<(T value) {
+        static_assert(std::is_integral<T>::value or std::is_enum<T>::value, "Hasher only accepts integers");
+        uint64_t word = static_cast<uint64_t>(value) * K1;
+        _state ^= rotl(word, 31) * K2;
+        _state = rotl(_state, 27) * 5 + 0x52dce729;
+        ++_count;
+        return *this;
+    }
+
+    // Return the hash of the integers written so far
+    uint64_t digest() const {
+        uint64_t h = _state ^ _count;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+};
+
 } // util
@@ -35,6 +35,12 @@ namespace jitk {
 
 // Compare class for the OffsetAndStrides sets and maps
 struct OffsetAndStrides_less {
+    // Should views that slide differently be different? Only a repeat loop within the kernel needs this since it
+    // updates the offset of each sliding view
+    bool compare_slides;
+
+    explicit OffsetAndStrides_less(bool compare_slides = false) : compare_slides(compare_slides) {}
+
     // This compare is the same as view compare ('v1 < v2') but ignoring their bases
     bool operator() (const bh_view& v1, const bh_view& v2) const {
         if (v1.ndim < v2.ndim) return true;
@@ -45,7 +51,12 @@ struct OffsetAndStrides_less {
             if (v1.stride[i] < v2.stride[i]) return true;
             if (v2.stride[i] < v1.stride[i]) return false;
         }
-        return false;
+        if (not compare_slides or (v1.slide.empty() and v2.slide.empty())) {
+            return false;
+        }
+        if (v1.slide != v2.slide) return v1.slide < v2.slide;
+        if (v1.slide_dim_stride != v2.slide_dim_stride) return v1.slide_dim_stride < v2.slide_dim_stride;
+        return v1.slide_dim_shape < v2.slide_dim_shape;
     }
     bool operator() (const bh_view* v1, const bh_view* v2) const {
         return (*this)(*v1, *v2);
@@ -82,18 +93,24 @@ public:
     const bool index_as_var;
     // Should we use constants as variables?
     const bool const_as_var;
+    // Should views that slide differently get their own offset and index? (see `OffsetAndStrides_less`)
+    const bool slides_as_var;
 
     SymbolTable(const std::vector<InstrPtr> &instr_list,
                 const std::set<bh_base *> &non_temp_arrays,
                 bool use_volatile,
                 bool strides_as_var,
                 bool index_as_var,
-                bool const_as_var) :
+                bool const_as_var,
+                bool slides_as_var = false) :
+        _idx_map(OffsetAndStrides_less(slides_as_var)),
+        _offset_strides_map(OffsetAndStrides_less(slides_as_var)),
         _useRandom(false),
         use_volatile(use_volatile),
         strides_as_var(strides_as_var),
         index_as_var(index_as_var),
-        const_as_var(const_as_var) {
+        const_as_var(const_as_var),
+        slides_as_var(slides_as_var) {
         // NB: by assigning the IDs in the order they appear in the 'instr_list',
         //     the kernels can better be reused
         for (const InstrPtr &instr: instr_list) {
@@ -217,7 +234,8 @@ public:
           const Scope *parent,
           const std::set<bh_base *> &tmps,
           const T1 &scalar_replacements_rw,
-          const T2 &scalar_replacements_r) : symbols(symbols), parent(parent) {
+          const T2 &scalar_replacements_r) : symbols(symbols), parent(parent),
+                                             _declared_idx(OffsetAndStrides_less(symbols.slides_as_var)) {
         for(const bh_base* base: tmps) {
             if (not symbols.isAlwaysArray(base))
                 _tmps.insert(base);
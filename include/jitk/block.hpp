@@ -285,6 +285,17 @@ Block create_nested_block(const std::vector<InstrPtr> &instr_list, int rank, int
 // Use `max_depth` the limit the search depth (e.g. OpenCL and CUDA only supports parallelism in three dimensions)
 std::pair<uint64_t, uint64_t> parallel_ranks(const LoopB &block, unsigned int max_depth=3);
 
+// Returns the number of bytes that 'block' allocates and frees when executed after the blocks that allocated the
+// arrays in 'allocated'. NB: arrays that have data already are never allocated and temporary arrays are never in memory
+std::pair<uint64_t, uint64_t> allocs_and_frees(const Block &block, const std::set<const bh_base*> &allocated);
+
+// Returns the peak number of bytes allocated while executing 'block_list' in order (relative to the start)
+uint64_t peak_memory(const std::vector<Block> &block_list);
+
+// Returns the peak number of bytes allocated while executing 'instr_list' one instruction at a time, which is
+// how the interpreter executes (relative to the start)
+uint64_t peak_memory(const std::vector<bh_instruction*> &instr_list);
+
 // Return a list of `block` and all its first sub-blocks.
 // Use this function to easily access the blocks that makes up the parallel ranks.
 void get_first_loop_blocks(const LoopB &block, std::vector<const LoopB*> &out);
@@ -25,6 +25,7 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <bh_instruction.hpp>
 #include <jitk/block.hpp>
 #include <jitk/statistics.hpp>
+#include <jitk/kernel_store.hpp>
 
 
 namespace bohrium {
@@ -35,17 +36,34 @@ private:
     std::map<size_t, std::string> _cache;
     // Some statistics
     jitk::Statistics &stat;
+    // The persistent store of the cache (nullptr means no persistence) and the hash of the codegen configuration
+    KernelStore *_store = nullptr;
+    uint64_t _store_salt = 0;
+
+    // Load the source of 'lookup_hash' from the persistent store into the cache. Returns false if not found.
+    bool load(uint64_t lookup_hash);
 public:
     // The constructor takes the statistic object
     CodegenCache(jitk::Statistics &stat) : stat(stat) {}
 
+    // Make the cache persistent using 'store', which is shared with other processes.
+    // The 'salt' must identify everything else than the block list and symbol table that determines the source.
+    void persist(KernelStore &store, uint64_t salt) {
+        _store = &store;
+        _store_salt = salt;
+    }
+
     // Check the cache for a source code that matches 'instr_list'
     // Returns the source code and the hash of the source.
-    // On cache misses, the returned source is an empty string.
-    std::pair<std::string, uint64_t> get(const std::vector<Block> &block_list, const SymbolTable &symbols);
+    // On cache misses, the returned source is nullptr. Otherwise, it points to the source in the cache, which never
+    // changes or goes away thus the pointer is valid and identifies the source as long as the cache exists.
+    // The 'variant' distinguishes kernels of the same block list that differ otherwise (e.g. by a repeat loop).
+    std::pair<const std::string *, uint64_t> get(const std::vector<Block> &block_list, const SymbolTable &symbols,
+                                                 uint64_t variant = 0);
 
-    // Insert 'source' as a hit when requesting 'block_list'
-    void insert(std::string source, const std::vector<Block> &block_list, const SymbolTable &symbols);
+    // Insert 'source' as a hit when requesting 'block_list'. Returns the source in the cache.
+    const std::string &insert(std::string source, const std::vector<Block> &block_list, const SymbolTable &symbols,
+                              uint64_t variant = 0);
 };
 
 std::string block_list_string(const std::vector<Block> &block_list, const SymbolTable &symbols);
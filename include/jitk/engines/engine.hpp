@@ -19,12 +19,18 @@ If not, see <http://www.gnu.org/licenses/>.
 */
 #pragma once
 
+#include <set>
+#include <sstream>
+
 #include <bh_config_parser.hpp>
+#include <bh_util.hpp>
 #include <jitk/statistics.hpp>
+#include <jitk/kernel_store.hpp>
 
 #include <bh_view.hpp>
 #include <bh_component.hpp>
 #include <bh_instruction.hpp>
+#include <bh_memory.h>
 #include <boost/filesystem.hpp>
 
 namespace bohrium {
@@ -53,6 +59,9 @@ protected:
     // Path to the directory of the cached binary files (e.g. .so files)
     const boost::filesystem::path cache_bin_dir;
 
+    // The store of cached binary files in `cache_bin_dir`
+    KernelStore kernel_store;
+
     // The hash of the JIT compilation command
     uint64_t compilation_hash;
 
@@ -68,13 +77,22 @@ public:
       tmp_src_dir(tmp_dir / "src"),
       tmp_bin_dir(tmp_dir / "obj"),
       cache_bin_dir(config.defaultGet<boost::filesystem::path>("cache_dir", "")),
+      kernel_store(cache_bin_dir, cache_file_max, cache_size_max(config)),
       compilation_hash(0) {
         // Let's make sure that the directories exist
         jitk::create_directories(tmp_src_dir);
         jitk::create_directories(tmp_bin_dir);
 
-        if (not cache_bin_dir.empty()) {
-            jitk::create_directories(cache_bin_dir);
+        // The memory pool is shared by all components, thus the last engine to start decides its configuration
+        const int64_t trim_mb = config.defaultGet<int64_t>("memory_pool_trim", 256);
+        bh_memory_pool_config(config.defaultGet<int64_t>("memory_pool_max", 0) * 1024 * 1024,
+                              trim_mb == -1 ? -1 : trim_mb * 1024 * 1024);
+
+        // Let's save and load the fuse and codegen caches in `cache_bin_dir`
+        if (kernel_store.enabled() and config.defaultGet<bool>("persistent_cache", true)) {
+            const uint64_t salt = persistent_cache_salt(config);
+            fcache.persist(kernel_store, salt);
+            codegen_cache.persist(kernel_store, salt);
         }
     }
 
@@ -85,6 +103,34 @@ public:
     virtual void setConstructorFlag(std::vector<bh_instruction*> &instr_list) = 0;
 
 protected:
+    // Returns the maximum size of the cache dir in bytes (-1 means no maximum)
+    static int64_t cache_size_max(const ConfigParser &config) {
+        const int64_t mb = config.defaultGet<int64_t>("cache_size_max", -1);
+        return mb == -1 ? -1 : mb * 1024 * 1024;
+    }
+
+    // Returns the hash of the Bohrium version and the options that might affect the fusion and the generated code.
+    // The hash identifies the entries of the persistent fuse and codegen caches.
+    static uint64_t persistent_cache_salt(const ConfigParser &config) {
+        // Options that affect neither the fusion nor the generated code
+        static const std::set<std::string> ignored = {"impl", "verbose", "prof", "prof_filename", "graph", "tmp_dir",
+                                                      "cache_dir", "cache_file_max", "cache_size_max",
+                                                      "persistent_cache", "async_compile", "parallel_compile",
+                                                      "compile_threads", "interpreter_threshold",
+                                                      "memory_pool_max", "memory_pool_trim", "hugepages",
+                                                      "hugepages_threshold", "first_touch", "spill_dir",
+                                                      "spill_threshold", "out_of_core_tile",
+                                                      "device_memory_budget"};
+        std::stringstream ss;
+        ss << BH_VERSION_STRING << "\n" << config.getName() << "\n";
+        for (const auto &option: config.getOptions()) {
+            if (not util::exist(ignored, option.first)) {
+                ss << option.first << " = " << option.second << "\n";
+            }
+        }
+        return util::hash(ss.str());
+    }
+
     void writeKernelFunctionArguments(const jitk::SymbolTable &symbols,
                                       std::stringstream &ss,
                                       const char *array_type_prefix) {
@@ -23,6 +23,8 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include <bh_config_parser.hpp>
 #include <jitk/statistics.hpp>
+#include <jitk/interpreter.hpp>
+#include <jitk/transformer.hpp>
 
 #include <bh_view.hpp>
 #include <bh_component.hpp>
@@ -31,38 +33,92 @@ If not, see <http://www.gnu.org/licenses/>.
 namespace bohrium {
 namespace jitk {
 
+// A loop around all the blocks of a kernel, which executes the iterations of a BhIR with `nrepeats > 1`
+struct KernelRepeat {
+    // The number of iterations
+    uint64_t nrepeats;
+    // The array that stops the iterations when its first element is false (nullptr means no condition)
+    const bh_base *condition;
+    // The views that slide between iterations, one view per offset-and-strides variable
+    std::vector<const bh_view*> slides;
+
+    // Returns the hash of the loop, which together with the block list identifies the kernel
+    uint64_t hash(const SymbolTable &symbols) const {
+        util::Hasher hasher;
+        hasher << nrepeats << (condition == nullptr ? UINT64_MAX : symbols.baseID(condition));
+        for (const bh_view *view: slides) {
+            hasher << symbols.offsetStridesID(*view);
+            for (size_t i = 0; i < view->slide.size(); ++i) {
+                hasher << view->slide[i] << view->slide_dim_stride[i] << view->slide_dim_shape[i];
+            }
+        }
+        return hasher.digest();
+    }
+};
+
 class EngineCPU : public Engine {
+protected:
+    // Compile kernels in the background and interpret blocks while their kernel isn't ready
+    const bool async_compile;
+    // Start the compilation of all kernels in a flush before executing the first kernel
+    const bool parallel_compile;
+    // Flushes that compute at most this number of elements are interpreted instead of JIT-compiled (0 disables)
+    const uint64_t interpreter_threshold;
+    // Flushes that access more than this number of bytes are executed in tiles of outer rows (0 disables)
+    const uint64_t out_of_core_tile;
+    // Execute all the iterations of a repeated flush in one kernel
+    const bool repeat_in_kernel;
+    // The fuser minimizes the peak memory usage, which we then predict for the statistics
+    const bool min_peak_memory;
+
 public:
     EngineCPU(const ConfigParser &config, Statistics &stat) :
-      Engine(config, stat) {
+      Engine(config, stat),
+      async_compile(config.defaultGet<bool>("async_compile", false)),
+      parallel_compile(config.defaultGet<bool>("parallel_compile", true)),
+      interpreter_threshold(config.defaultGet<uint64_t>("interpreter_threshold", 0)),
+      out_of_core_tile(config.defaultGet<uint64_t>("out_of_core_tile", 0) * 1024 * 1024),
+      repeat_in_kernel(config.defaultGet<bool>("repeat_in_kernel", false)),
+      min_peak_memory(config.defaultGet<bool>("min_peak_memory", false)) {
+
+        // Arrays above the spill threshold are backed by files in the spill directory
+        const boost::filesystem::path spill_dir = config.defaultGet<boost::filesystem::path>("spill_dir", "");
+        if (not spill_dir.empty()) {
+            jitk::create_directories(spill_dir);
+        }
+        bh_memory_spill_config(spill_dir.string().c_str(),
+                               config.defaultGet<int64_t>("spill_threshold", 1024) * 1024 * 1024);
     }
 
     virtual ~EngineCPU() {}
 
+    // Write the kernel of 'block_list'. When 'repeat' isn't nullptr, the kernel loops over the blocks.
     virtual void writeKernel(const std::vector<Block> &block_list,
                              const SymbolTable &symbols,
                              const std::vector<bh_base*> &kernel_temps,
                              uint64_t codegen_hash,
-                             std::stringstream &ss) = 0;
+                             std::stringstream &ss,
+                             const KernelRepeat *repeat = nullptr) = 0;
 
-    virtual void execute(const std::string &source,
+    // Execute the kernel 'source'. When 'allow_fallback' is true and the kernel isn't compiled yet,
+    // the method returns false without executing anything and the caller must execute the kernel by other means.
+    // NB: 'source' is the source in `codegen_cache` of 'codegen_hash' thus its address identifies the source.
+    virtual bool execute(const std::string &source,
                          uint64_t codegen_hash,
                          const std::vector<bh_base*> &non_temps,
                          const std::vector<const bh_view*> &offset_strides,
-                         const std::vector<const bh_instruction*> &constants) = 0;
+                         const std::set<InstrPtr, Constant_less> &constants,
+                         bool allow_fallback) = 0;
+
+    // Start compiling the kernel 'source' in the background, if it isn't compiled already.
+    // A later call to `execute()` with the same 'source' picks up the compiled kernel.
+    virtual void compileAhead(const std::string &/* source */) {}
 
     virtual void handleExecution(BhIR *bhir) {
         using namespace std;
 
         const auto texecution = chrono::steady_clock::now();
 
-        map<string, bool> kernel_config = {
-            { "strides_as_var", config.defaultGet<bool>("strides_as_var", true) },
-            { "index_as_var",   config.defaultGet<bool>("index_as_var",   true) },
-            { "const_as_var",   config.defaultGet<bool>("const_as_var",   true) },
-            { "use_volatile",   config.defaultGet<bool>("use_volatile",  false) }
-        };
-
         // Some statistics
         stat.record(*bhir);
 
@@ -77,6 +133,18 @@ public:
             bh_data_free(base);
         }
 
+        // Tiny flushes are interpreted, which saves the fusion, code generation, and kernel launch
+        if (interpreter_threshold > 0 and total_work(instr_list) <= interpreter_threshold
+            and interpretable(instr_list)) {
+            if (min_peak_memory) {
+                stat.recordPredictedMemoryUsage(bh_memory_get_usage().bytes_in_use + peak_memory(instr_list));
+            }
+            executeInterpreter(instr_list);
+            stat.recordMemoryUsage(bh_memory_get_usage().max_bytes_in_use);
+            stat.time_total_execution += chrono::steady_clock::now() - texecution;
+            return;
+        }
+
         // Set the constructor flag
         if (config.defaultGet<bool>("array_contraction", true)) {
             setConstructorFlag(instr_list);
@@ -89,14 +157,55 @@ public:
         // Let's get the block list
         const vector<jitk::Block> block_list = get_block_list(instr_list, config, fcache, stat, false);
 
-        if (config.defaultGet<bool>("monolithic", false)) {
-            createMonolithicKernel(kernel_config, block_list);
-        } else {
-            createKernel(kernel_config, block_list);
+        // The predicted peak of the flush is the arrays allocated beforehand plus the peak of the blocks
+        if (min_peak_memory) {
+            stat.recordPredictedMemoryUsage(bh_memory_get_usage().bytes_in_use + peak_memory(block_list));
         }
+
+        createKernels(block_list, true);
+        stat.recordMemoryUsage(bh_memory_get_usage().max_bytes_in_use);
         stat.time_total_execution += chrono::steady_clock::now() - texecution;
     }
 
+    // Generate and compile the kernels of 'bhir' without executing anything, which fills the caches including
+    // the persistent caches in `cache_dir`. Since nothing is computed, the arrays in 'computed' are regarded as
+    // computed by previous BhIRs. On return, 'computed' is updated with the arrays computed and freed by 'bhir'.
+    void handleWarmup(BhIR *bhir, std::set<bh_base*> &computed) {
+        using namespace std;
+
+        set<bh_base*> frees;
+        vector<bh_instruction*> instr_list = jitk::remove_non_computed_system_instr(bhir->instr_list, frees);
+
+        // Like `handleExecution()`, tiny flushes are interpreted thus they have no kernels
+        if (not (interpreter_threshold > 0 and total_work(instr_list) <= interpreter_threshold
+                 and interpretable(instr_list))) {
+            // Set the constructor flag as if the arrays in 'computed' were allocated
+            if (config.defaultGet<bool>("array_contraction", true)) {
+                util_set_constructor_flag(instr_list, computed);
+            } else {
+                for (bh_instruction *instr: instr_list) {
+                    instr->constructor = false;
+                }
+            }
+
+            const vector<jitk::Block> block_list = get_block_list(instr_list, config, fcache, stat, false);
+            createKernels(block_list, false);
+        }
+        update_computed(instr_list, frees, computed);
+    }
+
+    // Warm up the kernel of all the iterations of 'bhir' like `handleRepeatedExecution()` would execute it.
+    // Extension methods are the opcodes above `BH_MAX_OPCODE_ID`. Returns false without compiling anything
+    // when the iterations must be warmed up one by one by `handleWarmup()`.
+    bool handleRepeatedWarmup(BhIR *bhir, std::set<bh_base*> &computed) {
+        for (const bh_instruction &instr: bhir->instr_list) {
+            if (instr.opcode >= BH_MAX_OPCODE_ID) {
+                return false;
+            }
+        }
+        return createRepeatedKernel(bhir, &computed);
+    }
+
     template <typename T>
     void handleExtmethod(T &comp, BhIR *bhir) {
         std::vector<bh_instruction> instr_list;
@@ -119,16 +228,278 @@ public:
         bhir->instr_list = instr_list;
     }
 
+    // Execute all the iterations of 'bhir' in one kernel, which loops over the blocks of the flush, checks the
+    // repeat condition, and slides the views between iterations. Thus, the flush is fused, compiled, and launched
+    // once. Returns false without executing anything when the iterations must be executed one by one.
+    template <typename T>
+    bool handleRepeatedExecution(T &comp, BhIR *bhir) {
+        for (const bh_instruction &instr: bhir->instr_list) {
+            if (util::exist(comp.extmethods, instr.opcode)) {
+                return false;
+            }
+        }
+        return createRepeatedKernel(bhir, nullptr);
+    }
+
 private:
-    void createKernel(std::map<std::string, bool> kernel_config, const std::vector<Block> &block_list) {
+    // Create and execute the kernel of all the iterations of 'bhir', which must contain no extension methods.
+    // If 'computed' isn't nullptr, the kernel is only compiled (ahead) and the constructor flags are set as if the
+    // arrays in 'computed' were allocated cf. `handleWarmup()`. Returns false when the iterations must be handled
+    // one by one.
+    bool createRepeatedKernel(BhIR *bhir, std::set<bh_base*> *computed) {
         using namespace std;
 
-        // When creating a regular kernels (a block-nest per shared library), we create one kernel at a time
+        if (not repeat_in_kernel or bhir->getNRepeats() < 2 or out_of_core_tile > 0) {
+            return false;
+        }
+        const bool strides_as_var = config.defaultGet<bool>("strides_as_var", true);
+        for (const bh_instruction &instr: bhir->instr_list) {
+            for (const bh_view &view: instr.operand) {
+                if (not view.slide.empty()) {
+                    // The kernel can only slide the offset of views, which must then be variables
+                    if (not strides_as_var) {
+                        return false;
+                    }
+                    for (int64_t change: view.slide_dim_shape_change) {
+                        if (change != 0) {
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
+
+        const auto texecution = chrono::steady_clock::now();
+
+        // Arrays freed by the flush must also be created by the flush, since the next iteration uses them again
+        set<bh_base*> frees;
+        vector<bh_instruction*> instr_list = jitk::remove_non_computed_system_instr(bhir->instr_list, frees);
+        if (not frees.empty()) {
+            return false;
+        }
+        if (not config.defaultGet<bool>("array_contraction", true)) {
+            for (bh_instruction *instr: instr_list) {
+                instr->constructor = false;
+            }
+        } else if (computed != nullptr) {
+            util_set_constructor_flag(instr_list, *computed);
+        } else {
+            setConstructorFlag(instr_list);
+        }
+        {
+            set<const bh_base*> constructors;
+            for (const bh_instruction *instr: instr_list) {
+                if (instr->constructor) {
+                    constructors.insert(instr->operand[0].base);
+                } else if (instr->opcode == BH_FREE and not util::exist(constructors, instr->operand[0].base)) {
+                    return false;
+                }
+            }
+        }
+
+        const vector<jitk::Block> block_list = get_block_list(instr_list, config, fcache, stat, false);
+        if (not slides_are_iteration_invariant(instr_list, block_list)) {
+            return false;
+        }
+
+        // Like the monolithic kernel, the kernel allocates the arrays that are created and freed between blocks
+        vector<InstrPtr> all_instr;
+        set<bh_base *> all_non_temps, all_freed;
+        bool kernel_is_computing = false;
         for(const Block &block: block_list) {
+            block.getAllInstr(all_instr);
+            block.getLoop().getAllNonTemps(all_non_temps);
+            block.getLoop().getAllFrees(all_freed);
+            if (not block.isSystemOnly()) {
+                kernel_is_computing = true;
+            }
+        }
+        vector<bh_base*> kernel_temps;
+        set<bh_base*> constructors;
+        for(const InstrPtr &instr: all_instr) {
+            if (instr->constructor) {
+                constructors.insert(instr->operand[0].base);
+            } else if (instr->opcode == BH_FREE and util::exist(constructors, instr->operand[0].base)) {
+                kernel_temps.push_back(instr->operand[0].base);
+                all_non_temps.erase(instr->operand[0].base);
+            }
+        }
+        const SymbolTable symbols(
+            all_instr,
+            all_non_temps,
+            config.defaultGet<bool>("use_volatile", false),
+            strides_as_var,
+            config.defaultGet<bool>("index_as_var", true),
+            config.defaultGet<bool>("const_as_var", true),
+            true
+        );
+
+        // The kernel reads the repeat condition, which must therefore be a boolean parameter of the kernel
+        const bh_base *cond = bhir->getRepeatCondition();
+        if (cond != nullptr and (cond->type != bh_type::BOOL or
+                                 not util::exist_linearly(symbols.getParams(), cond))) {
+            return false;
+        }
+        KernelRepeat repeat{bhir->getNRepeats(), cond, {}};
+        for (const bh_view *view: symbols.offsetStrideViews()) {
+            if (not view->slide.empty()) {
+                repeat.slides.push_back(view);
+            }
+        }
+
+        if (computed != nullptr) {
+            stat.record(symbols);
+            if (kernel_is_computing) {
+                ++stat.kernel_cache_lookups;
+                compileAhead(*generateKernel(block_list, symbols, kernel_temps, &repeat).first);
+            }
+            update_computed(instr_list, frees, *computed);
+            return true;
+        }
+
+        stat.record(*bhir);
+        stat.record(symbols);
+        if (kernel_is_computing) {
+            const auto kernel = generateKernel(block_list, symbols, kernel_temps, &repeat);
+            execute(*kernel.first, kernel.second, symbols.getParams(), symbols.offsetStrideViews(),
+                    symbols.constIDs(), false);
+        }
+        for(bh_base *base: all_freed) {
+            bh_data_free(base);
+        }
+        ++stat.num_repeat_kernels;
+        stat.recordMemoryUsage(bh_memory_get_usage().max_bytes_in_use);
+        stat.time_total_execution += chrono::steady_clock::now() - texecution;
+        return true;
+    }
+
+    // Update 'computed' with the arrays computed and freed by 'instr_list' and the arrays in 'frees'
+    static void update_computed(const std::vector<bh_instruction*> &instr_list, const std::set<bh_base*> &frees,
+                                std::set<bh_base*> &computed) {
+        for (const bh_instruction *instr: instr_list) {
+            if (instr->opcode == BH_FREE) {
+                computed.erase(instr->operand[0].base);
+            } else if (not bh_opcode_is_system(instr->opcode)) {
+                computed.insert(instr->operand[0].base);
+            }
+        }
+        for (bh_base *base: frees) {
+            computed.erase(base);
+        }
+    }
+
+    // Returns true when the fusion of the first iteration of a repeated flush is valid for all iterations.
+    // This is the case when sliding views keep their offset through the transformers and when the instructions
+    // of a block that writes to a base with a sliding view access the base through the same view, thus sliding
+    // never makes a block fuse instructions that access overlapping views. Additionally, no two views of a block
+    // may be equal in the first iteration but slide differently.
+    static bool slides_are_iteration_invariant(const std::vector<bh_instruction*> &instr_list,
+                                               const std::vector<Block> &block_list) {
+        using namespace std;
+
+        auto same_slide = [](const bh_view &v1, const bh_view &v2) -> bool {
+            return v1.slide == v2.slide and v1.slide_dim_stride == v2.slide_dim_stride and
+                   v1.slide_dim_shape == v2.slide_dim_shape;
+        };
+        set<const bh_base*> sliding_bases;
+        vector<const bh_view*> sliding_views;
+        for (const bh_instruction *instr: instr_list) {
+            for (const bh_view &view: instr->operand) {
+                if (not view.slide.empty()) {
+                    sliding_bases.insert(view.base);
+                    sliding_views.push_back(&view);
+                }
+            }
+        }
+        if (sliding_views.empty()) {
+            return true;
+        }
+
+        for (const Block &block: block_list) {
+            // The views of the bases with a sliding view and the instruction (index) that accesses them
+            map<const bh_base*, vector<pair<size_t, const bh_view*> > > views;
+            set<const bh_base*> outputs;
+            const vector<InstrPtr> block_instr = block.getAllInstr();
+            for (size_t i = 0; i < block_instr.size(); ++i) {
+                const InstrPtr &instr = block_instr[i];
+                if (bh_opcode_is_system(instr->opcode)) {
+                    continue;
+                }
+                for (const bh_view *view: instr->get_views()) {
+                    if (util::exist(sliding_bases, view->base)) {
+                        views[view->base].push_back(make_pair(i, view));
+                    }
+                }
+                if (util::exist(sliding_bases, instr->operand[0].base)) {
+                    outputs.insert(instr->operand[0].base);
+                }
+            }
+            for (const auto &base_views: views) {
+                const bool is_output = util::exist(outputs, base_views.first);
+                for (const auto &v1: base_views.second) {
+                    // The offset of a sliding view must be the offset of a sliding view of the flush
+                    bool found = v1.second->slide.empty();
+                    for (const bh_view *view: sliding_views) {
+                        if (view->base == v1.second->base and view->start == v1.second->start and
+                            same_slide(*view, *v1.second)) {
+                            found = true;
+                            break;
+                        }
+                    }
+                    if (not found) {
+                        return false;
+                    }
+                    for (const auto &v2: base_views.second) {
+                        const bool equal = *v1.second == *v2.second;
+                        if (equal and not same_slide(*v1.second, *v2.second)) {
+                            return false;
+                        }
+                        if (not equal and is_output and v1.first != v2.first) {
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    // Create and execute the kernels of 'block_list'. If not 'execute', the kernels are only compiled (ahead).
+    void createKernels(const std::vector<Block> &block_list, bool execute) {
+        std::map<std::string, bool> kernel_config = {
+            { "strides_as_var", config.defaultGet<bool>("strides_as_var", true) },
+            { "index_as_var",   config.defaultGet<bool>("index_as_var",   true) },
+            { "const_as_var",   config.defaultGet<bool>("const_as_var",   true) },
+            { "use_volatile",   config.defaultGet<bool>("use_volatile",  false) }
+        };
+
+        // Only flushes that access more than `out_of_core_tile` bytes are tiled
+        const int64_t tile_rows = outer_tile_rows(block_list, out_of_core_tile);
+
+        if (config.defaultGet<bool>("monolithic", false)) {
+            createMonolithicKernel(kernel_config, block_list, execute);
+        } else if (tile_rows > 0) {
+            createTiledKernels(kernel_config, block_list, tile_rows, execute);
+        } else {
+            createKernel(kernel_config, block_list, execute);
+        }
+    }
+
+    void createKernel(std::map<std::string, bool> kernel_config, const std::vector<Block> &block_list, bool execute) {
+        using namespace std;
+
+        // When creating a regular kernels (a block-nest per shared library), we create one kernel at a time.
+        // However, we generate the source code of all kernels up front thus missing kernels can be compiled
+        // concurrently by `compileAhead()` while the kernels are executed in order.
+        vector<SymbolTable> symbol_tables;
+        symbol_tables.reserve(block_list.size());
+        vector<pair<const string*, uint64_t> > kernels(block_list.size());
+        for(size_t i = 0; i < block_list.size(); ++i) {
+            const Block &block = block_list[i];
             assert(not block.isInstr());
 
             // Let's create the symbol table for the kernel
-            const SymbolTable symbols(
+            symbol_tables.emplace_back(
                 block.getAllInstr(),
                 block.getLoop().getAllNonTemps(),
                 kernel_config["use_volatile"],
@@ -136,12 +507,29 @@ private:
                 kernel_config["index_as_var"],
                 kernel_config["const_as_var"]
             );
+            stat.record(symbol_tables.back());
 
-            stat.record(symbols);
+            // We can skip this step if the kernel does no computation
+            if (not block.isSystemOnly()) {
+                kernels[i] = generateKernel({ block }, symbol_tables.back(), {});
+                if (not execute) {
+                    ++stat.kernel_cache_lookups;
+                    compileAhead(*kernels[i].first);
+                } else if (parallel_compile) {
+                    compileAhead(*kernels[i].first);
+                }
+            }
+        }
+        if (not execute) {
+            return;
+        }
+
+        for(size_t i = 0; i < block_list.size(); ++i) {
+            const Block &block = block_list[i];
 
             // Let's execute the kernel
-            if (not block.isSystemOnly()) { // We can skip this step if the kernel does no computation
-                executeKernel({ block }, symbols, {});
+            if (not block.isSystemOnly()) {
+                executeKernel({ block }, symbol_tables[i], kernels[i]);
             }
 
             // Finally, let's cleanup
@@ -151,7 +539,8 @@ private:
         }
     }
 
-    void createMonolithicKernel(std::map<std::string, bool> kernel_config, const std::vector<Block> &block_list) {
+    void createMonolithicKernel(std::map<std::string, bool> kernel_config, const std::vector<Block> &block_list,
+                                bool execute) {
         using namespace std;
 
         // When creating a monolithic kernel (all instructions in one shared library), we first combine
@@ -192,6 +581,15 @@ private:
         );
         stat.record(symbols);
 
+        if (not execute) {
+            if (kernel_is_computing) {
+                const auto kernel = generateKernel(block_list, symbols, kernel_temps);
+                ++stat.kernel_cache_lookups;
+                compileAhead(*kernel.first);
+            }
+            return;
+        }
+
         // Let's execute the kernel
         if (kernel_is_computing) { // We can skip this step if the kernel does no computation
             executeKernel(block_list, symbols, kernel_temps);
@@ -202,42 +600,129 @@ private:
             bh_data_free(base);
         }
     }
-private:
-    void executeKernel(const std::vector<Block> &block_list,
-                       const SymbolTable &symbols,
-                       std::vector<bh_base*> kernel_temps) {
-        using namespace std;
 
-        // Create the constant vector
-        vector<const bh_instruction*> constants;
-        constants.reserve(symbols.constIDs().size());
-        for (const InstrPtr &instr: symbols.constIDs()) {
-            constants.push_back(&(*instr));
+    // Execute 'block_list' in tiles of 'tile_rows' outer rows, thus all kernels compute a tile before moving on to
+    // the next tile. This way, only the rows of a tile need to be in memory when the arrays are spilled to disk.
+    // If not 'execute', the kernels are only compiled (ahead).
+    // NB: the arrays are freed after the last tile
+    void createTiledKernels(std::map<std::string, bool> kernel_config, const std::vector<Block> &block_list,
+                            int64_t tile_rows, bool execute) {
+        int64_t size = 0;
+        for (const Block &block: block_list) {
+            if (not block.isSystemOnly()) {
+                size = block.getLoop().size;
+                break;
+            }
+        }
+        for (int64_t begin = 0; begin < size; begin += tile_rows) {
+            // NB: all tiles but the last has the same shape thus they share kernels
+            if (not execute and begin > 0 and begin + tile_rows < size) {
+                continue;
+            }
+            for (const Block &block: outer_tile(block_list, begin, std::min(size, begin + tile_rows))) {
+                if (not block.isSystemOnly()) {
+                    const SymbolTable symbols(
+                        block.getAllInstr(),
+                        block.getLoop().getAllNonTemps(),
+                        kernel_config["use_volatile"],
+                        kernel_config["strides_as_var"],
+                        kernel_config["index_as_var"],
+                        kernel_config["const_as_var"]
+                    );
+                    stat.record(symbols);
+                    if (execute) {
+                        executeKernel({ block }, symbols, std::vector<bh_base*>{});
+                    } else {
+                        ++stat.kernel_cache_lookups;
+                        compileAhead(*generateKernel({ block }, symbols, {}).first);
+                    }
+                }
+            }
+            if (execute) {
+                ++stat.num_out_of_core_tiles;
+            }
+        }
+        if (not execute) {
+            return;
+        }
+        ++stat.num_out_of_core_flushes;
+
+        for (const Block &block: block_list) {
+            for (bh_base *base: block.getLoop().getAllFrees()) {
+                bh_data_free(base);
+            }
         }
+    }
+
+private:
+    // Return the source code and codegen hash of the kernel of 'block_list'
+    // NB: the source code is owned by `codegen_cache` thus it is never copied
+    std::pair<const std::string*, uint64_t> generateKernel(const std::vector<Block> &block_list,
+                                                           const SymbolTable &symbols,
+                                                           const std::vector<bh_base*> &kernel_temps,
+                                                           const KernelRepeat *repeat = nullptr) {
+        using namespace std;
 
-        const auto lookup = codegen_cache.get(block_list, symbols);
-        if(not lookup.first.empty()) {
+        const uint64_t variant = repeat == nullptr ? 0 : repeat->hash(symbols);
+        auto lookup = codegen_cache.get(block_list, symbols, variant);
+        if(lookup.first != nullptr) {
             // In debug mode, we check that the cached source code is correct
             #ifndef NDEBUG
                 stringstream ss;
-                writeKernel(block_list, symbols, kernel_temps, lookup.second, ss);
-                if (ss.str().compare(lookup.first) != 0) {
-                    cout << "\nCached source code: \n" << lookup.first;
+                writeKernel(block_list, symbols, kernel_temps, lookup.second, ss, repeat);
+                if (ss.str().compare(*lookup.first) != 0) {
+                    cout << "\nCached source code: \n" << *lookup.first;
                     cout << "\nReal source code: \n" << ss.str();
                     assert(1 == 2);
                 }
             #endif
-            execute(lookup.first, lookup.second, symbols.getParams(), symbols.offsetStrideViews(), constants);
         } else {
             const auto tcodegen = chrono::steady_clock::now();
             stringstream ss;
-            writeKernel(block_list, symbols, kernel_temps, lookup.second, ss);
-            string source = ss.str();
+            writeKernel(block_list, symbols, kernel_temps, lookup.second, ss, repeat);
             stat.time_codegen += chrono::steady_clock::now() - tcodegen;
+            lookup.first = &codegen_cache.insert(ss.str(), block_list, symbols, variant);
+        }
+        return lookup;
+    }
 
-            execute(source, lookup.second, symbols.getParams(), symbols.offsetStrideViews(), constants);
-            codegen_cache.insert(std::move(source), block_list, symbols);
+    void executeKernel(const std::vector<Block> &block_list,
+                       const SymbolTable &symbols,
+                       std::vector<bh_base*> kernel_temps) {
+        executeKernel(block_list, symbols, generateKernel(block_list, symbols, kernel_temps));
+    }
+
+    void executeKernel(const std::vector<Block> &block_list,
+                       const SymbolTable &symbols,
+                       const std::pair<const std::string*, uint64_t> &kernel) {
+        // Only blocks that the interpreter supports can be executed while the kernel is being compiled
+        const bool allow_fallback = async_compile and interpretable(block_list);
+
+        if (not execute(*kernel.first, kernel.second, symbols.getParams(), symbols.offsetStrideViews(),
+                        symbols.constIDs(), allow_fallback)) {
+            executeFallback(block_list);
+        }
+    }
+
+    // Execute 'block_list' using the interpreter, which we do while the kernel is being compiled
+    void executeFallback(const std::vector<Block> &block_list) {
+        const auto texec = std::chrono::steady_clock::now();
+        interpret(block_list);
+        stat.time_exec_fallback += std::chrono::steady_clock::now() - texec;
+        ++stat.num_fallback_kernels;
+    }
+
+    // Execute 'instr_list' using the interpreter and free the arrays it frees
+    void executeInterpreter(const std::vector<bh_instruction*> &instr_list) {
+        const auto texec = std::chrono::steady_clock::now();
+        interpret(instr_list);
+        for (const bh_instruction *instr: instr_list) {
+            if (instr->opcode == BH_FREE) {
+                bh_data_free(instr->operand[0].base);
+            }
         }
+        stat.time_exec_interpreter += std::chrono::steady_clock::now() - texec;
+        ++stat.num_interpreted_flushes;
     }
 };
 
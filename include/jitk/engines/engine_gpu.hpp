@@ -19,6 +19,9 @@ If not, see <http://www.gnu.org/licenses/>.
 */
 #pragma once
 
+#include <list>
+#include <map>
+
 #include "engine.hpp"
 
 #include <bh_config_parser.hpp>
@@ -46,6 +49,8 @@ public:
     const uint64_t num_threads;
     // Maximum number of thread to use
     const bool num_threads_round_robin;
+    // Maximum number of bytes of arrays on the device before evicting arrays to the host (0 means unlimited)
+    const uint64_t device_memory_budget;
 
     EngineGPU(const ConfigParser &config, Statistics &stat) :
       Engine(config, stat),
@@ -54,7 +59,8 @@ public:
       platform_no(config.defaultGet<int>("platform_no", -1)),
       prof(config.defaultGet<bool>("prof", false)),
       num_threads(config.defaultGet<uint64_t>("num_threads", 0)),
-      num_threads_round_robin(config.defaultGet<bool>("num_threads_round_robin", false)){
+      num_threads_round_robin(config.defaultGet<bool>("num_threads_round_robin", false)),
+      device_memory_budget(config.defaultGet<uint64_t>("device_memory_budget", 0) * 1024 * 1024) {
     }
 
     virtual ~EngineGPU() {}
@@ -63,6 +69,7 @@ public:
     virtual void copyAllBasesToHost() = 0;
     virtual void copyToDevice(const std::set<bh_base*> &base_list) = 0;
     virtual void delBuffer(bh_base* &base) = 0;
+    virtual bool isOnDevice(bh_base *base) const = 0;
     virtual void writeKernel(const Block &block,
                              const SymbolTable &symbols,
                              const std::vector<uint64_t> &thread_stack,
@@ -210,6 +217,53 @@ public:
     }
 
 private:
+    // The arrays that might be on the device ordered by their last use (the least recently used first)
+    std::list<bh_base*> _lru;
+    std::map<bh_base*, std::list<bh_base*>::iterator> _lru_pos;
+
+    // Evict the least recently used arrays to the host until the arrays on the device and 'bases' fit within
+    // the device memory budget. The evicted arrays are copied back to the device when a later kernel uses them.
+    // NB: a kernel that doesn't fit within the budget by itself is executed anyway
+    void reserveDeviceMemory(const std::set<bh_base*> &bases) {
+        if (device_memory_budget == 0) {
+            return;
+        }
+        // Let's mark 'bases' as the most recently used
+        for (bh_base *base: bases) {
+            auto it = _lru_pos.find(base);
+            if (it != _lru_pos.end()) {
+                _lru.splice(_lru.end(), _lru, it->second);
+            } else {
+                _lru_pos[base] = _lru.insert(_lru.end(), base);
+            }
+        }
+        // Let's forget the arrays that have left the device since last time (e.g. freed or synced arrays)
+        uint64_t resident = 0;
+        for (auto it = _lru.begin(); it != _lru.end();) {
+            if (util::exist(bases, *it) or isOnDevice(*it)) {
+                resident += bh_base_size(*it);
+                ++it;
+            } else {
+                _lru_pos.erase(*it);
+                it = _lru.erase(it);
+            }
+        }
+        // Since 'bases' are at the back of the list, we evict from the front until we reach them
+        std::set<bh_base*> evicted;
+        while (resident > device_memory_budget and not util::exist(bases, _lru.front())) {
+            bh_base *base = _lru.front();
+            resident -= bh_base_size(base);
+            stat.device_evicted_bytes += bh_base_size(base);
+            evicted.insert(base);
+            _lru_pos.erase(base);
+            _lru.pop_front();
+        }
+        if (not evicted.empty()) {
+            copyToHost(evicted);
+            stat.num_device_evictions += evicted.size();
+        }
+    }
+
     void cpuOffload(component::ComponentImplWithChild &comp,
                     BhIR *bhir,
                     const Block &block,
@@ -260,7 +314,9 @@ private:
         using namespace std;
         // We need a memory buffer on the device for each non-temporary array in the kernel
         const vector<bh_base*> v = symbols.getParams();
-        copyToDevice(set<bh_base*>(v.begin(), v.end()));
+        const set<bh_base*> non_temps(v.begin(), v.end());
+        reserveDeviceMemory(non_temps);
+        copyToDevice(non_temps);
 
         // Create the constant vector
         vector<const bh_instruction*> constants;
@@ -270,18 +326,18 @@ private:
         }
 
         const auto lookup = codegen_cache.get({ block }, symbols);
-        if(not lookup.first.empty()) {
+        if(lookup.first != nullptr) {
             // In debug mode, we check that the cached source code is correct
             #ifndef NDEBUG
                 stringstream ss;
                 writeKernel(block, symbols, thread_stack, lookup.second, ss);
-                if (ss.str().compare(lookup.first) != 0) {
-                    cout << "\nCached source code: \n" << lookup.first;
+                if (ss.str().compare(*lookup.first) != 0) {
+                    cout << "\nCached source code: \n" << *lookup.first;
                     cout << "\nReal source code: \n" << ss.str();
                     assert(1 == 2);
                 }
             #endif
-            execute(lookup.first, lookup.second, symbols.getParams(), thread_stack, symbols.offsetStrideViews(), constants);
+            execute(*lookup.first, lookup.second, symbols.getParams(), thread_stack, symbols.offsetStrideViews(), constants);
         } else {
             const auto tcodegen = chrono::steady_clock::now();
             stringstream ss;
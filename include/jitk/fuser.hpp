@@ -54,7 +54,17 @@ void fuser_reshapable_first(std::vector<Block> &block_list, bool avoid_rank0_swe
 
 // Fuses 'block_list' greedily
 // 'avoid_rank0_sweep' will avoid fusion of sweeped and non-sweeped blocks at the root level
+// When the config option 'min_peak_memory' is true, the fused blocks are ordered to minimize the peak memory usage
+// and arrays are freed right after their last access
 void fuser_greedy(const ConfigParser &config, std::vector<Block> &block_list, bool avoid_rank0_sweep);
 
+// Fuses 'block_list' such that the total cost of the blocks is minimized (see `graph::optimal()`), which is never
+// costlier than `fuser_greedy()`
+// The search is given 'optimal_time_budget' milliseconds (config option) and block lists of more than
+// 'optimal_threshold' blocks are fused greedily. Since the fuse cache saves the result, this is only worth
+// its cost for flushes that repeat many times.
+// 'avoid_rank0_sweep' will avoid fusion of sweeped and non-sweeped blocks at the root level
+void fuser_optimal(const ConfigParser &config, std::vector<Block> &block_list, bool avoid_rank0_sweep);
+
 } // jit
 } // bohrium
@@ -25,6 +25,7 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <bh_instruction.hpp>
 #include <jitk/block.hpp>
 #include <jitk/statistics.hpp>
+#include <jitk/kernel_store.hpp>
 
 
 namespace bohrium {
@@ -39,6 +40,16 @@ private:
     };
     // The hash to payload map
     std::map<size_t, CachePayload> _cache;
+    // The persistent store of the cache (nullptr means no persistence) and the hash of the fuser configuration
+    KernelStore *_store = nullptr;
+    uint64_t _store_salt = 0;
+
+    // Returns the filename of the payload of 'lookup_hash' in the persistent store
+    std::string filename(size_t lookup_hash) const;
+    // Load the payload of 'lookup_hash' from the persistent store into the cache. Returns false if not found.
+    bool load(size_t lookup_hash);
+    // Save the payload of 'lookup_hash' in the persistent store
+    void save(size_t lookup_hash, const CachePayload &payload) const;
 public:
     // Some statistics
     jitk::Statistics &stat;
@@ -46,6 +57,13 @@ public:
     // The constructor takes the statistic object
     FuseCache(jitk::Statistics &stat) : stat(stat) {}
 
+    // Make the cache persistent using 'store', which is shared with other processes.
+    // The 'salt' must identify everything else than the instruction list that determines the fusion.
+    void persist(KernelStore &store, uint64_t salt) {
+        _store = &store;
+        _store_salt = salt;
+    }
+
     // Check the cache for a block list that matches 'instr_list'
     std::pair<std::vector<Block>, bool> get(const std::vector<bh_instruction *> &instr_list);
     // Insert 'block_list' as a hit when requesting 'instr_list'
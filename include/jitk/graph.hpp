@@ -42,6 +42,15 @@ typedef uint64_t Vertex;
 // Validate the 'dag'
 bool validate(DAG &dag);
 
+// Determines whether there exist a path from 'a' to 'b' (of length greater than one when 'only_long_path')
+bool path_exist(Vertex a, Vertex b, const DAG &dag, bool only_long_path);
+
+// Returns the weight of merging 'b1' and 'b2', which is the total size of the arrays created by 'b1' and freed by 'b2'
+uint64_t weight(const Block &b1, const Block &b2);
+
+// Returns the cost of 'block', which is the total size of the non-temporary arrays it accesses
+uint64_t block_cost(const Block &block);
+
 /* Merge vertices 'a' and 'b' (in that order) into 'a'
  * If 'remove_b==false' than the 'b' vertex is only cleared not removed from graph 'dag'.
  * NB: 'a' and 'b' MUST be fusible
@@ -71,7 +80,13 @@ void pprint(const DAG &dag, const char *filename, bool avoid_rank0_sweep);
 DAG from_block_list(const std::vector <Block> &block_list);
 
 // Create a block list based on the 'dag'
-std::vector<Block> fill_block_list(const DAG &dag);
+// When 'min_peak_memory' is true, the topological order tries to minimize the peak memory usage by executing the
+// blocks that free memory as soon as possible (see `peak_memory()`)
+std::vector<Block> fill_block_list(const DAG &dag, bool min_peak_memory = false);
+
+// Move the frees of arrays in 'block_list' to new system blocks right after the last block that accesses the arrays.
+// NB: only frees of arrays that the freeing block doesn't access otherwise are moved
+void free_after_last_access(std::vector<Block> &block_list);
 
 // Merges the vertices in 'dag' topologically using 'Queue' as the Vertex queue.
 // 'Queue' is a collection of 'Vertex' that is constructed with the DAG and supports push(), pop(), and empty()
@@ -133,10 +148,19 @@ std::vector<Block> topological(DAG &dag, bool avoid_rank0_sweep) {
     return ret;
 }
 
-// Merges the vertices in 'dag' greedily.
+// Merges the vertices in 'dag' greedily, i.e. the fusible edge with the greatest weight is merged first.
+// The edges are kept in a priority queue and the vertices in an incremental topological order thus a merge only
+// updates the neighbourhood of the merged vertices.
 // 'avoid_rank0_sweep' will avoid fusion of sweeped and non-sweeped blocks at the root level
 void greedy(DAG &dag, bool avoid_rank0_sweep);
 
+// Merges the vertices in 'dag' such that the total cost of the blocks (see `block_cost()`) is minimized using a
+// branch-and-bound search, which is given 'time_budget' milliseconds. The search starts from the greedy merging
+// thus the result is never more costly than `greedy()`.
+// Returns true when the search completed within the time budget, i.e. no cheaper merging exists
+// 'avoid_rank0_sweep' will avoid fusion of sweeped and non-sweeped blocks at the root level
+bool optimal(DAG &dag, bool avoid_rank0_sweep, uint64_t time_budget);
+
 } // graph
 } // jit
 } // bohrium
@@ -0,0 +1,62 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+/* A generic (pre-compiled) interpreter of instructions and blocks.
+
+   The interpreter executes one instruction at a time using strided loops thus it is much
+   slower than a JIT-compiled kernel, but it requires no code generation or compilation.
+   Rows of elements that are contiguous (or broadcasted) have loops of their own, which the compiler vectorizes.
+   It supports all elementwise opcodes, reductions, accumulations, range, gather, and scatter
+   on the boolean, integer, and float data types. Complex numbers and BH_RANDOM are not supported.
+*/
+
+#include <vector>
+
+#include <bh_instruction.hpp>
+#include <jitk/block.hpp>
+
+namespace bohrium {
+namespace jitk {
+
+// Returns true when the interpreter supports 'instr'
+bool interpretable(const bh_instruction &instr);
+
+// Returns true when the interpreter supports all instructions in 'block_list'
+bool interpretable(const std::vector<Block> &block_list);
+
+// Returns true when the interpreter supports all instructions in 'instr_list'
+bool interpretable(const std::vector<bh_instruction*> &instr_list);
+
+// Returns the number of elements the instructions in 'instr_list' compute (system instructions compute nothing)
+uint64_t total_work(const std::vector<bh_instruction*> &instr_list);
+
+// Execute 'instr' using the interpreter. The arrays of 'instr' are allocated when needed.
+// NB: system instructions are ignored, e.g. BH_FREE must be handled by the caller
+void interpret(const bh_instruction &instr);
+
+// Execute all instructions in 'block_list' one at a time
+void interpret(const std::vector<Block> &block_list);
+
+// Execute all instructions in 'instr_list' one at a time
+void interpret(const std::vector<bh_instruction*> &instr_list);
+
+} // jitk
+} // bohrium
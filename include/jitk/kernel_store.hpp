@@ -0,0 +1,129 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <boost/filesystem.hpp>
+
+namespace bohrium {
+namespace jitk {
+
+/**
+ * The persistent store of compiled kernels (the `cache_dir`), which can be shared by concurrent processes.
+ *
+ *  - Kernels are content-addressed by their filename, see `hash_filename()`.
+ *  - Kernels are published atomically by writing a temporary file that is renamed into place.
+ *  - The file `index` records the size and last use of each kernel, which makes it possible to evict the least
+ *    recently used kernels without scanning the directory. New entries are appended to the index and the index
+ *    is compacted when it grows too large.
+ *  - The index and the compilation of a kernel are guarded by file locks (open file description locks of fcntl(2),
+ *    which also works on NFS) thus processes that miss the same kernel at the same time compile it only once.
+ *    Additionally, a mutex per lock file serializes the threads of a process.
+ */
+class KernelStore {
+public:
+    // An exclusive lock of a file, which excludes other processes as well as other threads of this process.
+    // The lock is released on destruction.
+    class Lock {
+    public:
+        explicit Lock(const boost::filesystem::path &path);
+        ~Lock();
+        Lock(const Lock &) = delete;
+        Lock &operator=(const Lock &) = delete;
+    private:
+        std::unique_lock<std::mutex> _thread_lock;
+        int _fd;
+    };
+
+    /**
+     *  Open the store at 'dir' (an empty 'dir' disables the store) that keeps a maximum of 'max_files' kernels
+     *  and 'max_bytes' bytes (-1 means no maximum)
+     */
+    KernelStore(boost::filesystem::path dir, int64_t max_files, int64_t max_bytes);
+
+    /**
+     *  Records the use of the looked up kernels in the index and evicts kernels if needed
+     */
+    ~KernelStore();
+
+    KernelStore(const KernelStore &) = delete;
+    KernelStore &operator=(const KernelStore &) = delete;
+
+    // Returns true when the store is enabled
+    bool enabled() const {
+        return not _dir.empty();
+    }
+
+    // Returns the path to 'filename' in the store (the file might not exist)
+    boost::filesystem::path path(const std::string &filename) const {
+        return _dir / filename;
+    }
+
+    // Returns true when 'filename' is in the store, in which case the use of 'filename' is recorded
+    bool lookup(const std::string &filename);
+
+    /**
+     *  Returns an exclusive lock of 'filename', which other processes compiling 'filename' should wait for.
+     *  Returns nullptr when the store is disabled.
+     *  NB: the locks are shared by a fixed number of filenames thus a lock might block an unrelated compilation
+     */
+    std::unique_ptr<Lock> lock(const std::string &filename) const;
+
+    // Publish a copy of 'file' as 'filename' in the store
+    void publish(const boost::filesystem::path &file, const std::string &filename);
+
+    // Publish 'data' of 'size' bytes as 'filename' in the store
+    void publish(const char *data, size_t size, const std::string &filename);
+
+private:
+    const boost::filesystem::path _dir;
+    const int64_t _max_files;
+    const int64_t _max_bytes;
+
+    // Guards the members below. Notice, file locks doesn't protect against threads of the same process.
+    std::mutex _mutex;
+    // Kernels looked up by this process
+    std::map<std::string, uint64_t> _uses;
+    // Estimate of the number of kernels, number of bytes, and number of lines in the index
+    int64_t _num_files = 0;
+    int64_t _num_bytes = 0;
+    int64_t _num_lines = 0;
+
+    // Append the kernel 'filename' of 'bytes' size to the index. When 'filename' replaced an existing file,
+    // 'replaced_bytes' is the size of the replaced file (otherwise -1).
+    void appendIndex(const std::string &filename, uint64_t bytes, int64_t replaced_bytes);
+
+    // Returns true when the store holds more kernels or bytes than allowed
+    bool exceedsLimits() const {
+        return (_max_files != -1 and _num_files > _max_files) or (_max_bytes != -1 and _num_bytes > _max_bytes);
+    }
+
+    // Rewrite the index and evict the least recently used kernels (requires the index lock)
+    void compactIndex();
+
+    // Returns a unique temporary path in the store
+    boost::filesystem::path tmpPath(const std::string &filename) const;
+};
+
+}} // namespace
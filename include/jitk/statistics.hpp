@@ -19,6 +19,8 @@ If not, see <http://www.gnu.org/licenses/>.
 */
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <string>
 #include <ostream>
@@ -30,6 +32,7 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <colors.hpp>
 #include <bh_ir.hpp>
 #include <bh_instruction.hpp>
+#include <bh_memory.h>
 #include <jitk/base_db.hpp>
 #include <bh_config_parser.hpp>
 
@@ -73,22 +76,39 @@ class Statistics {
     uint64_t num_temp_arrays           = 0;
     uint64_t num_syncs                 = 0;
     uint64_t max_memory_usage          = 0;
+    uint64_t max_memory_usage_predicted = 0;
     uint64_t totalwork                 = 0;
     uint64_t threading_below_threshold = 0;
     uint64_t fuser_cache_lookups       = 0;
     uint64_t fuser_cache_misses        = 0;
+    uint64_t fuser_cache_loads         = 0;
     uint64_t codegen_cache_lookups     = 0;
     uint64_t codegen_cache_misses      = 0;
+    uint64_t codegen_cache_loads       = 0;
     uint64_t kernel_cache_lookups      = 0;
     uint64_t kernel_cache_misses       = 0;
     uint64_t num_instrs_into_fuser     = 0;
     uint64_t num_blocks_out_of_fuser   = 0;
+    uint64_t num_fallback_kernels      = 0;
+    uint64_t num_interpreted_flushes   = 0;
+    uint64_t num_out_of_core_tiles     = 0;
+    uint64_t num_out_of_core_flushes   = 0;
+    uint64_t num_repeat_kernels        = 0;
+    uint64_t num_device_evictions      = 0;
+    uint64_t device_evicted_bytes      = 0;
+    uint64_t memory_pool_hits          = 0;
+    uint64_t memory_pool_misses        = 0;
+    uint64_t memory_pool_retained      = 0;
+    uint64_t memory_pool_max_retained  = 0;
+    uint64_t memory_pool_trimmed       = 0;
     std::chrono::duration<double> time_total_execution{0};
     std::chrono::duration<double> time_pre_fusion{0};
     std::chrono::duration<double> time_fusion{0};
     std::chrono::duration<double> time_codegen{0};
     std::chrono::duration<double> time_compile{0};
     std::chrono::duration<double> time_exec{0};
+    std::chrono::duration<double> time_exec_fallback{0};
+    std::chrono::duration<double> time_exec_interpreter{0};
     std::chrono::duration<double> time_offload{0};
     std::chrono::duration<double> time_copy2dev{0};
     std::chrono::duration<double> time_copy2host{0};
@@ -97,6 +117,10 @@ class Statistics {
     // key: kernel source filename, value: kernel statistics
     std::map<std::string, KernelStats> time_per_kernel;
 
+    // Identifies this statistics object, which changes when the statistics are reset by assigning a new object.
+    // Use it to find out whether pointers into e.g. `time_per_kernel` are still valid.
+    uint64_t generation = next_generation();
+
     std::chrono::duration<double> wallclock{0};
     std::chrono::time_point<std::chrono::steady_clock> time_started{std::chrono::steady_clock::now()};
 
@@ -121,15 +145,31 @@ class Statistics {
 
         if (enabled) {
             wallclock = chrono::steady_clock::now() - time_started;
+            recordMemoryPool();
 
             out << BLU << "[" << backend_name << "] Profiling: \n" << RST;
             out << "Fuse cache hits:                 " << GRN << fuseCacheHits()                     << "\n" << RST;
             out << "Codegen cache hits:              " << GRN << codegenCacheHits()                  << "\n" << RST;
             out << "Compilation cache hits:          " << GRN << kernelCacheHits()                   << "\n" << RST;
+            out << "Persistent cache loads:          " << GRN << fuser_cache_loads << " fuse, "
+                                                              << codegen_cache_loads << " codegen" << "\n" << RST;
             out << "Array contractions:              " << GRN << arrayContractions()                 << "\n" << RST;
             out << "Outer-fusion ratio:              " << GRN << outerFusionRatio()                  << "\n" << RST;
             out << "\n";
-            out << "Max memory usage:                " << GRN << memoryUsage() << " MB"              << "\n" << RST;
+            out << "Max memory usage:                " << GRN << memoryUsage() << " MB";
+            if (max_memory_usage_predicted > 0) { // Only predicted when `min_peak_memory` is enabled
+                out << " (predicted " << toMB(max_memory_usage_predicted) << " MB)";
+            }
+            out << "\n" << RST;
+            out << "Device evictions:                " << GRN << num_device_evictions << " ("
+                                                              << toMB(device_evicted_bytes) << " MB)" << "\n" << RST;
+            out << "Memory pool hits:                " << GRN << memoryPoolHits()                    << "\n" << RST;
+            out << "Memory pool retained:            " << GRN << toMB(memory_pool_retained) << " MB (max "
+                                                              << toMB(memory_pool_max_retained) << " MB, "
+                                                              << toMB(memory_pool_trimmed) << " MB trimmed)" << "\n" << RST;
+            out << "Out-of-core tiles:               " << GRN << num_out_of_core_tiles << " ("
+                                                              << num_out_of_core_flushes << " flushes)" << "\n" << RST;
+            out << "Repeat loops in kernels:         " << GRN << num_repeat_kernels                  << "\n" << RST;
             out << "Syncs to NumPy:                  " << GRN << num_syncs                           << "\n" << RST;
             out << "Total Work:                      " << GRN << totalwork << " operations"          << "\n" << RST;
             out << "Throughput:                      " << GRN << throughput() << "ops"               << "\n" << RST;
@@ -142,6 +182,10 @@ class Statistics {
             out << "  Codegen:                       " << YEL << time_codegen.count() << "s"         << "\n" << RST;
             out << "  Compilation:                   " << YEL << time_compile.count() << "s"         << "\n" << RST;
             out << "  Exec:                          " << YEL << time_exec.count() << "s"            << "\n" << RST;
+            out << "  Exec (fallback):               " << YEL << time_exec_fallback.count() << "s"
+                                                       << " (" << num_fallback_kernels << " kernels)"  << "\n" << RST;
+            out << "  Exec (interpreter):            " << YEL << time_exec_interpreter.count() << "s"
+                                                       << " (" << num_interpreted_flushes << " flushes)" << "\n" << RST;
             out << "  Copy2dev:                      " << YEL << time_copy2dev.count() << "s"        << "\n" << RST;
             out << "  Copy2host:                     " << YEL << time_copy2host.count() << "s"       << "\n" << RST;
             out << "  Offload:                       " << YEL << time_offload.count() << "s"         << "\n" << RST;
@@ -189,6 +233,7 @@ class Statistics {
 
         if (enabled) {
             wallclock = chrono::steady_clock::now() - time_started;
+            recordMemoryPool();
 
             ofstream file;
             file.open(filename);
@@ -198,9 +243,24 @@ class Statistics {
             file << "  fuse_cache_hits: "       << fuseCacheHits()                   << "\n";
             file << "  codegen_cache_hits: "    << codegenCacheHits()                << "\n";
             file << "  kernel_cache_hits: "     << kernelCacheHits()                 << "\n";
+            file << "  fuse_cache_loads: "      << fuser_cache_loads                 << "\n";
+            file << "  codegen_cache_loads: "   << codegen_cache_loads               << "\n";
             file << "  array_contractions: "    << arrayContractions()               << "\n";
             file << "  outer_fusion_ratio: "    << outerFusionRatio()                << "\n";
             file << "  memory_usage: "          << memoryUsage()                     << "\n"; // mb
+            file << "  memory_usage_predicted: " << toMB(max_memory_usage_predicted) << "\n"; // mb
+            file << "  device_evictions: "      << num_device_evictions              << "\n";
+            file << "  device_evicted: "        << toMB(device_evicted_bytes)        << "\n"; // mb
+            file << "  memory_pool:"                                                 << "\n";
+            file << "    hits: "                << memory_pool_hits                  << "\n";
+            file << "    misses: "              << memory_pool_misses                << "\n";
+            file << "    retained: "            << toMB(memory_pool_retained)        << "\n"; // mb
+            file << "    max_retained: "        << toMB(memory_pool_max_retained)    << "\n"; // mb
+            file << "    trimmed: "             << toMB(memory_pool_trimmed)         << "\n"; // mb
+            file << "  out_of_core:"                                                 << "\n";
+            file << "    tiles: "               << num_out_of_core_tiles             << "\n";
+            file << "    flushes: "             << num_out_of_core_flushes           << "\n";
+            file << "  repeat_kernels: "        << num_repeat_kernels                << "\n";
             file << "  syncs: "                 << num_syncs                         << "\n";
             file << "  total_work: "            << totalwork                         << "\n"; // ops
             file << "  throughput: "            << throughput()                      << "\n"; // ops
@@ -213,6 +273,10 @@ class Statistics {
             file << "    compile: "             << time_compile.count()              << "\n"; // s
             file << "    exec: "                                                     << "\n";
             file << "      total: "             << time_exec.count()                 << "\n"; // s
+            file << "      fallback: "          << time_exec_fallback.count()        << "\n"; // s
+            file << "      fallback_kernels: "  << num_fallback_kernels              << "\n";
+            file << "      interpreter: "       << time_exec_interpreter.count()     << "\n"; // s
+            file << "      interpreted_flushes: " << num_interpreted_flushes         << "\n";
             if (verbose) {
               file << "      per_kernel: "                                           << "\n";
               for (auto const& x : time_per_kernel) {
@@ -252,11 +316,36 @@ class Statistics {
       num_temp_arrays += symbols.getNumBaseArrays() - symbols.getParams().size();
     }
 
+    // Record the memory usage in bytes (the maximum is kept)
+    void recordMemoryUsage(uint64_t bytes) {
+        max_memory_usage = std::max(max_memory_usage, bytes);
+    }
+
+    // Record the predicted memory usage in bytes (the maximum is kept)
+    void recordPredictedMemoryUsage(uint64_t bytes) {
+        max_memory_usage_predicted = std::max(max_memory_usage_predicted, bytes);
+    }
+
     void addKernel(const std::string& kernel_name) {
       time_per_kernel.insert(std::make_pair(kernel_name, KernelStats()));
     }
 
   private:
+    static uint64_t next_generation() {
+        static std::atomic<uint64_t> count{0};
+        return ++count;
+    }
+
+    // The memory pool is shared by all components thus we read its counters when printing
+    void recordMemoryPool() {
+        const bh_memory_pool_stats pool = bh_memory_pool_get_stats();
+        memory_pool_hits = pool.hits;
+        memory_pool_misses = pool.misses;
+        memory_pool_retained = pool.bytes_retained;
+        memory_pool_max_retained = pool.max_bytes_retained;
+        memory_pool_trimmed = pool.bytes_trimmed;
+    }
+
     std::string fuseCacheHits() {
         return pprint_ratio(fuser_cache_lookups - fuser_cache_misses, fuser_cache_lookups);
     }
@@ -278,7 +367,15 @@ class Statistics {
     }
 
     double memoryUsage() {
-        return (double) max_memory_usage / 1024.0 / 1024.0;
+        return toMB(max_memory_usage);
+    }
+
+    std::string memoryPoolHits() {
+        return pprint_ratio(memory_pool_hits, memory_pool_hits + memory_pool_misses);
+    }
+
+    static double toMB(uint64_t bytes) {
+        return (double) bytes / 1024.0 / 1024.0;
     }
 
     double throughput() {
@@ -291,7 +388,7 @@ class Statistics {
 
     double timeOther() {
         return (time_total_execution - time_pre_fusion - time_fusion - time_codegen - time_compile - time_exec
-                - time_copy2dev - time_copy2host - time_offload).count();
+                - time_exec_fallback - time_exec_interpreter - time_copy2dev - time_copy2host - time_offload).count();
     }
 
     double unaccounted() {
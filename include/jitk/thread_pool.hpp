@@ -0,0 +1,83 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <future>
+#include <functional>
+#include <condition_variable>
+
+namespace bohrium {
+namespace jitk {
+
+/**
+ * A fixed-size pool of worker threads that executes jobs in FIFO order.
+ * It is used for background work such as JIT compilation thus a job should not
+ * touch Bohrium data structures that the main thread might modify concurrently.
+ */
+class ThreadPool {
+public:
+    /**
+     *  Spawns 'num_threads' worker threads (at least one)
+     */
+    explicit ThreadPool(unsigned int num_threads);
+
+    /**
+     *  Waits for all queued jobs to finish and joins the worker threads
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     *  Queue the 'job' for execution and return a future of its completion.
+     *  An exception thrown by 'job' is re-thrown by the future's get().
+     */
+    std::shared_future<void> submit(std::function<void()> job);
+
+    /**
+     *  Returns the number of worker threads
+     */
+    size_t size() const {
+        return _workers.size();
+    }
+
+private:
+    std::vector<std::thread> _workers;
+    std::queue<std::packaged_task<void()> > _jobs;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    bool _stop = false;
+
+    // The main loop of each worker thread
+    void work();
+};
+
+// Returns true when the 'future' is ready, i.e. get() will not block
+inline bool is_ready(const std::shared_future<void> &future) {
+    return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+}} // namespace
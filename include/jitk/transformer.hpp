@@ -38,5 +38,27 @@ void split_for_threading(std::vector<Block> &block_list, uint64_t min_threading=
 // Collapses redundant axes within the 'block_list'
 void collapse_redundant_axes(std::vector<Block> &block_list);
 
+// Permutes the loops of the blocks in 'block_list' such that the innermost loop is the dimension where the views
+// that move the most bytes have unit stride, e.g. the loops of `a.T + b.T` are transposed.
+// Only perfect loop nests without sweeps are permuted, which makes all orders of the loops valid.
+void push_unit_strides_inwards(std::vector<Block> &block_list);
+
+// Tiles the loops of the blocks in 'block_list' that reuse rows of their arrays (e.g. stencils), such that the
+// rows of a tile of the arrays fit in 'cache_bytes'. The second dimension is split into an outermost loop over
+// the tiles and a loop within a tile, which leaves the outermost loop with at least 'min_tiles' iterations.
+// Only perfect loop nests without sweeps are tiled.
+void tile(std::vector<Block> &block_list, uint64_t cache_bytes, uint64_t min_tiles=1);
+
+// Returns the number of outer rows per tile when executing 'block_list' one tile at a time, such that the
+// non-temporary arrays of a tile takes up about 'tile_bytes' bytes. Returns zero when the blocks cannot be tiled,
+// which requires that all blocks have the same outer loop size, no sweeps or index dependent instructions over the
+// outer dimension, and that the arrays written by 'block_list' are always accessed through the same rows.
+// Also returns zero when the blocks fit in one tile or when 'tile_bytes' is zero.
+int64_t outer_tile_rows(const std::vector<Block> &block_list, uint64_t tile_bytes);
+
+// Returns a copy of 'block_list' that only computes the outer rows from 'begin' to 'end' (excl.)
+// NB: 'block_list' must be tileable cf. `outer_tile_rows()`
+std::vector<Block> outer_tile(const std::vector<Block> &block_list, int64_t begin, int64_t end);
+
 } // jitk
 } // bohrium
@@ -0,0 +1,727 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* bh_benchmark_jitk: benchmarks of the stages of the JIT pipeline.
+ *
+ * The stages are benchmarked in isolation: the pre-fuser (`pre_fuser_lossy`), the greedy and the optimal fuser
+ * (`fuser_greedy` and `fuser_optimal`), lookups in the fuse cache and the codegen cache (cache hits), and the code
+ * generator of the OpenMP component (`writeKernel`). Additionally, the latency of a whole flush through the OpenMP
+ * component and the steady-state launch of compiled kernels (`EngineOpenMP::execute`) are measured. The fuser benchmarks report the size of the DAGs, the number of kernels and their total
+ * cost, and the number of flushes that are cheaper and costlier than the greedy fusion.
+ *
+ * The instruction lists are synthetic (a stencil, reductions, gather/scatter, chains of elementwise operations, and
+ * random operations) and the BhIRs of the traces given as arguments (see the `trace` filter):
+ *
+ *     bh_benchmark_jitk [--benchmark_filter=<regex>] [<trace>...]
+ *
+ * The config of the OpenMP component in the current stack is used (see BH_STACK and BH_CONFIG).
+ */
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <sstream>
+#include <cstdlib>
+#include <random>
+
+#include <benchmark/benchmark.h>
+#include <boost/filesystem/path.hpp>
+
+#include <bh_config_parser.hpp>
+#include <bh_trace.hpp>
+#include <jitk/fuser.hpp>
+#include <jitk/fuser_cache.hpp>
+#include <jitk/graph.hpp>
+#include <jitk/codegen_cache.hpp>
+#include <jitk/codegen_util.hpp>
+#include <jitk/instruction.hpp>
+#include <jitk/statistics.hpp>
+
+#include <engine_openmp.hpp>
+
+using namespace bohrium;
+using namespace std;
+
+namespace {
+
+// A kernel of a flush: the block it consist of, its symbol table, and its source code.
+// NB: a symbol table cannot be copied since it points into itself. The source stays in place like a source in the
+//     codegen cache, which `EngineOpenMP::execute()` relies on.
+struct Kernel {
+    const vector<jitk::Block> block_list;
+    const jitk::SymbolTable symbols;
+    string source;
+    uint64_t codegen_hash = 0;
+
+    // Like `EngineCPU::createKernel()`
+    Kernel(const jitk::Block &block, const ConfigParser &config) :
+        block_list{block},
+        symbols(block.getAllInstr(),
+                block.getLoop().getAllNonTemps(),
+                config.defaultGet<bool>("use_volatile", false),
+                config.defaultGet<bool>("strides_as_var", true),
+                config.defaultGet<bool>("index_as_var", true),
+                config.defaultGet<bool>("const_as_var", true)) {}
+};
+
+// A flush and the output of each stage of the JIT pipeline
+struct Flush {
+    vector<bh_instruction> instrs;      // The instructions of the flush (incl. system instructions)
+    set<bh_base*> syncs;                // The arrays sync'ed by the flush
+    vector<bh_instruction> computes;    // The instructions that `instr_list` points to
+    vector<bh_instruction*> instr_list; // The input of the fuser (origin IDs and constructor flags are set)
+    vector<jitk::Block> pre_fused;      // The output of the pre-fuser
+    vector<jitk::Block> fused;          // The output of the fuser
+    vector<unique_ptr<Kernel> > kernels; // The kernels of the non-system blocks in `fused`
+};
+
+// A workload is a sequence of flushes that owns its base arrays
+class Workload {
+public:
+    const string name;
+    // Is the workload executable? Recorded traces are not since their input data isn't loaded
+    const bool executable;
+    vector<unique_ptr<Flush> > flushes;
+
+    Workload(string name, bool executable) : name(std::move(name)), executable(executable) {}
+
+    ~Workload() {
+        for (const auto &base: _bases) {
+            bh_data_free(base.get());
+        }
+    }
+
+    // Returns a new base array
+    bh_base *newBase(bh_type type, int64_t nelem) {
+        _bases.emplace_back(new bh_base());
+        _bases.back()->type = type;
+        _bases.back()->nelem = nelem;
+        return _bases.back().get();
+    }
+
+    // Returns the total number of instructions given to the fuser
+    int64_t numInstrs() const {
+        int64_t ret = 0;
+        for (const auto &flush: flushes) {
+            ret += flush->instr_list.size();
+        }
+        return ret;
+    }
+
+    // Append a flush of 'instrs' and run it through the stages of the JIT pipeline of 'engine'.
+    // 'computed' contains the arrays computed by the previous flushes, which is updated with the arrays of this flush.
+    void addFlush(EngineOpenMP &engine, const ConfigParser &config, vector<bh_instruction> instrs,
+                  set<bh_base*> syncs, set<bh_base*> &computed) {
+        unique_ptr<Flush> flush(new Flush());
+        flush->instrs = std::move(instrs);
+        flush->syncs = std::move(syncs);
+        flush->computes = flush->instrs;
+
+        // Like `EngineCPU::handleExecution()` and `jitk::get_block_list()`
+        set<bh_base*> frees;
+        flush->instr_list = jitk::remove_non_computed_system_instr(flush->computes, frees);
+        if (flush->instr_list.empty()) {
+            return;
+        }
+        int64_t count = 0;
+        for (bh_instruction *instr: flush->instr_list) {
+            instr->origin_id = count++;
+        }
+        jitk::util_set_constructor_flag(flush->instr_list, computed);
+        flush->pre_fused = jitk::pre_fuser_lossy(flush->instr_list);
+        flush->fused = flush->pre_fused;
+        jitk::fuser_greedy(config, flush->fused, false);
+
+        jitk::Statistics stat(false, config);
+        jitk::CodegenCache codegen_cache(stat);
+        for (const jitk::Block &block: flush->fused) {
+            if (block.isSystemOnly()) {
+                continue;
+            }
+            unique_ptr<Kernel> kernel(new Kernel(block, config));
+            kernel->codegen_hash = codegen_cache.get(kernel->block_list, kernel->symbols).second;
+            stringstream ss;
+            engine.writeKernel(kernel->block_list, kernel->symbols, {}, kernel->codegen_hash, ss);
+            kernel->source = ss.str();
+            flush->kernels.push_back(std::move(kernel));
+        }
+
+        for (const bh_instruction *instr: flush->instr_list) {
+            if (instr->opcode == BH_FREE) {
+                computed.erase(instr->operand[0].base);
+            } else if (not bh_opcode_is_system(instr->opcode)) {
+                computed.insert(instr->operand[0].base);
+            }
+        }
+        for (bh_base *base: frees) {
+            computed.erase(base);
+        }
+        flushes.push_back(std::move(flush));
+    }
+
+private:
+    vector<unique_ptr<bh_base> > _bases;
+};
+
+/* Helper functions to create instructions */
+
+// Returns a view of 'base' with 'shape' that starts at 'start'. Without 'stride', the view is row-major contiguous.
+bh_view make_view(bh_base *base, const vector<int64_t> &shape, int64_t start = 0, vector<int64_t> stride = {}) {
+    if (stride.empty()) {
+        stride.resize(shape.size());
+        int64_t s = 1;
+        for (int64_t i = shape.size() - 1; i >= 0; --i) {
+            stride[i] = s;
+            s *= shape[i];
+        }
+    }
+    bh_view ret;
+    ret.base = base;
+    ret.start = start;
+    ret.ndim = shape.size();
+    for (size_t i = 0; i < shape.size(); ++i) {
+        ret.shape[i] = shape[i];
+        ret.stride[i] = stride[i];
+    }
+    return ret;
+}
+
+// Returns an instruction where the last operand is the constant 'value'
+template <typename T>
+bh_instruction make_instr(bh_opcode opcode, vector<bh_view> operands, T value) {
+    bh_view constant;
+    bh_flag_constant(&constant);
+    operands.push_back(constant);
+    bh_instruction ret(opcode, std::move(operands));
+    ret.constant = bh_constant(value);
+    return ret;
+}
+
+bh_instruction make_free(bh_base *base) {
+    return bh_instruction(BH_FREE, {make_view(base, {base->nelem})});
+}
+
+/* The synthetic workloads */
+
+// A five-point stencil on a 'n' x 'n' grid
+unique_ptr<Workload> stencil(EngineOpenMP &engine, const ConfigParser &config, int64_t n) {
+    unique_ptr<Workload> ret(new Workload("stencil", true));
+    bh_base *range = ret->newBase(bh_type::UINT64, n * n);
+    bh_base *grid = ret->newBase(bh_type::FLOAT64, n * n);
+    bh_base *out = ret->newBase(bh_type::FLOAT64, n * n);
+    const vector<int64_t> shape = {n - 2, n - 2};
+    const vector<int64_t> stride = {n, 1};
+    vector<bh_instruction> instrs = {
+        bh_instruction(BH_RANGE, {make_view(range, {n * n})}),
+        bh_instruction(BH_IDENTITY, {make_view(grid, {n * n}), make_view(range, {n * n})}),
+        make_free(range)
+    };
+    // The center, north, south, west, and east neighbours
+    const vector<int64_t> offsets = {n + 1, 1, 2 * n + 1, n, n + 2};
+    // The partial sum of the neighbours, which starts at the center of the grid
+    bh_base *sum = grid;
+    for (size_t i = 1; i < offsets.size(); ++i) {
+        bh_base *tmp = ret->newBase(bh_type::FLOAT64, (n - 2) * (n - 2));
+        instrs.emplace_back(BH_ADD, vector<bh_view>{make_view(tmp, shape),
+                                                    sum == grid ? make_view(grid, shape, offsets[0], stride)
+                                                                : make_view(sum, shape),
+                                                    make_view(grid, shape, offsets[i], stride)});
+        if (sum != grid) {
+            instrs.push_back(make_free(sum));
+        }
+        sum = tmp;
+    }
+    instrs.push_back(make_instr(BH_MULTIPLY, {make_view(out, shape, offsets[0], stride), make_view(sum, shape)}, 0.2));
+    instrs.push_back(make_free(sum));
+    instrs.push_back(make_free(grid));
+
+    set<bh_base*> computed;
+    ret->addFlush(engine, config, std::move(instrs), {out}, computed);
+    return ret;
+}
+
+// Reductions of a 'n' x 'n' x 'n' array to a vector followed by an accumulation
+unique_ptr<Workload> reduction(EngineOpenMP &engine, const ConfigParser &config, int64_t n) {
+    unique_ptr<Workload> ret(new Workload("reduction", true));
+    bh_base *range = ret->newBase(bh_type::UINT64, n * n * n);
+    bh_base *a = ret->newBase(bh_type::FLOAT64, n * n * n);
+    bh_base *b = ret->newBase(bh_type::FLOAT64, n * n);
+    bh_base *c = ret->newBase(bh_type::FLOAT64, n);
+    bh_base *out = ret->newBase(bh_type::FLOAT64, n);
+    vector<bh_instruction> instrs = {
+        bh_instruction(BH_RANGE, {make_view(range, {n * n * n})}),
+        bh_instruction(BH_IDENTITY, {make_view(a, {n, n, n}), make_view(range, {n, n, n})}),
+        make_free(range),
+        make_instr(BH_ADD_REDUCE, {make_view(b, {n, n}), make_view(a, {n, n, n})}, int64_t(2)),
+        make_free(a),
+        make_instr(BH_MAXIMUM_REDUCE, {make_view(c, {n}), make_view(b, {n, n})}, int64_t(0)),
+        make_free(b),
+        make_instr(BH_ADD_ACCUMULATE, {make_view(out, {n}), make_view(c, {n})}, int64_t(0)),
+        make_free(c)
+    };
+    set<bh_base*> computed;
+    ret->addFlush(engine, config, std::move(instrs), {out}, computed);
+    return ret;
+}
+
+// A gather and a scatter of 'n' elements using a permutation
+unique_ptr<Workload> gather_scatter(EngineOpenMP &engine, const ConfigParser &config, int64_t n) {
+    unique_ptr<Workload> ret(new Workload("gather_scatter", true));
+    bh_base *range = ret->newBase(bh_type::UINT64, n);
+    bh_base *idx = ret->newBase(bh_type::UINT64, n);
+    bh_base *a = ret->newBase(bh_type::FLOAT64, n);
+    bh_base *gathered = ret->newBase(bh_type::FLOAT64, n);
+    bh_base *out = ret->newBase(bh_type::FLOAT64, n);
+    vector<bh_instruction> instrs = {
+        bh_instruction(BH_RANGE, {make_view(range, {n})}),
+        make_instr(BH_MULTIPLY, {make_view(idx, {n}), make_view(range, {n})}, uint64_t(7)),
+        make_instr(BH_MOD, {make_view(idx, {n}), make_view(idx, {n})}, uint64_t(n)),
+        bh_instruction(BH_IDENTITY, {make_view(a, {n}), make_view(range, {n})}),
+        make_free(range),
+        bh_instruction(BH_GATHER, {make_view(gathered, {n}), make_view(a, {n}), make_view(idx, {n})}),
+        make_free(a),
+        make_instr(BH_IDENTITY, {make_view(out, {n})}, 0.0),
+        bh_instruction(BH_SCATTER, {make_view(out, {n}), make_view(gathered, {n}), make_view(idx, {n})}),
+        make_free(gathered),
+        make_free(idx)
+    };
+    set<bh_base*> computed;
+    ret->addFlush(engine, config, std::move(instrs), {out}, computed);
+    return ret;
+}
+
+// A chain of 'length' elementwise operations on 'n' elements where each operation creates a new array
+unique_ptr<Workload> elementwise_chain(EngineOpenMP &engine, const ConfigParser &config, int64_t n, int length) {
+    unique_ptr<Workload> ret(new Workload("chain" + std::to_string(length), true));
+    bh_base *range = ret->newBase(bh_type::UINT64, n);
+    bh_base *a = ret->newBase(bh_type::FLOAT64, n);
+    vector<bh_instruction> instrs = {
+        bh_instruction(BH_RANGE, {make_view(range, {n})}),
+        bh_instruction(BH_IDENTITY, {make_view(a, {n}), make_view(range, {n})}),
+        make_free(range)
+    };
+    bh_base *prev = a;
+    for (int i = 0; i < length; ++i) {
+        bh_base *next = ret->newBase(bh_type::FLOAT64, n);
+        switch (i % 4) {
+            case 0:
+                instrs.push_back(make_instr(BH_ADD, {make_view(next, {n}), make_view(prev, {n})}, 1.0));
+                break;
+            case 1:
+                instrs.push_back(make_instr(BH_MULTIPLY, {make_view(next, {n}), make_view(prev, {n})}, 0.5));
+                break;
+            case 2:
+                instrs.emplace_back(BH_SUBTRACT, vector<bh_view>{make_view(next, {n}), make_view(prev, {n}),
+                                                                 make_view(a, {n})});
+                break;
+            default:
+                instrs.emplace_back(BH_ABSOLUTE, vector<bh_view>{make_view(next, {n}), make_view(prev, {n})});
+        }
+        if (prev != a) {
+            instrs.push_back(make_free(prev));
+        }
+        prev = next;
+    }
+    instrs.push_back(make_free(a));
+    set<bh_base*> computed;
+    ret->addFlush(engine, config, std::move(instrs), {prev}, computed);
+    return ret;
+}
+
+// 'num_flushes' flushes of 'min_instrs' to 'max_instrs' random operations on 'n' x 'n' matrices and vectors of 'n'
+// elements: elementwise operations, broadcasts of vectors, and row reductions. Each flush starts with two matrices
+// and a vector computed by a previous flush. A few of the new arrays are synced, the rest are freed after their last
+// access thus they are temporary arrays if their accessing blocks are fused.
+unique_ptr<Workload> random_flushes(EngineOpenMP &engine, const ConfigParser &config, int64_t n, int num_flushes,
+                                    int min_instrs, int max_instrs, uint32_t seed) {
+    unique_ptr<Workload> ret(new Workload("random" + std::to_string(min_instrs) + "-" +
+                                          std::to_string(max_instrs), false));
+    // NB: the distributions of the standard library aren't portable thus we use the `mt19937` output directly
+    std::mt19937 rng(seed);
+    const vector<int64_t> matrix_shape = {n, n};
+    const vector<int64_t> vector_shape = {n};
+    for (int f = 0; f < num_flushes; ++f) {
+        vector<bh_base*> matrices = {ret->newBase(bh_type::FLOAT64, n * n), ret->newBase(bh_type::FLOAT64, n * n)};
+        vector<bh_base*> vectors = {ret->newBase(bh_type::FLOAT64, n)};
+        set<bh_base*> computed = {matrices[0], matrices[1], vectors[0]};
+        const auto pick = [&](const vector<bh_base*> &bases) { return bases[rng() % bases.size()]; };
+
+        vector<bh_instruction> computes;
+        const int num_instrs = min_instrs + rng() % (max_instrs - min_instrs + 1);
+        for (int i = 0; i < num_instrs; ++i) {
+            switch (rng() % 5) {
+                case 0: {
+                    bh_base *out = ret->newBase(bh_type::FLOAT64, n * n);
+                    computes.emplace_back(BH_ADD, vector<bh_view>{make_view(out, matrix_shape),
+                                                                  make_view(pick(matrices), matrix_shape),
+                                                                  make_view(pick(matrices), matrix_shape)});
+                    matrices.push_back(out);
+                    break;
+                }
+                case 1: {
+                    bh_base *out = ret->newBase(bh_type::FLOAT64, n * n);
+                    computes.push_back(make_instr(BH_MULTIPLY, {make_view(out, matrix_shape),
+                                                                make_view(pick(matrices), matrix_shape)}, 0.5));
+                    matrices.push_back(out);
+                    break;
+                }
+                case 2: {
+                    bh_base *out = ret->newBase(bh_type::FLOAT64, n * n);
+                    computes.emplace_back(BH_SUBTRACT, vector<bh_view>{make_view(out, matrix_shape),
+                                                                       make_view(pick(matrices), matrix_shape),
+                                                                       make_view(pick(vectors), matrix_shape, 0, {0, 1})});
+                    matrices.push_back(out);
+                    break;
+                }
+                case 3: {
+                    bh_base *out = ret->newBase(bh_type::FLOAT64, n);
+                    computes.push_back(make_instr(BH_ADD_REDUCE, {make_view(out, vector_shape),
+                                                                  make_view(pick(matrices), matrix_shape)}, int64_t(1)));
+                    vectors.push_back(out);
+                    break;
+                }
+                default: {
+                    bh_base *out = ret->newBase(bh_type::FLOAT64, n);
+                    computes.emplace_back(BH_MAXIMUM, vector<bh_view>{make_view(out, vector_shape),
+                                                                      make_view(pick(vectors), vector_shape),
+                                                                      make_view(pick(vectors), vector_shape)});
+                    vectors.push_back(out);
+                }
+            }
+        }
+
+        // Every fourth new array and the last array are synced, the rest are freed after their last access
+        map<bh_base*, size_t> last_access;
+        for (size_t i = 0; i < computes.size(); ++i) {
+            for (const bh_view &view: computes[i].operand) {
+                if (not bh_is_constant(&view)) {
+                    last_access[view.base] = i;
+                }
+            }
+        }
+        set<bh_base*> syncs = {computes.back().operand[0].base};
+        for (size_t i = 0; i < computes.size(); i += 4) {
+            syncs.insert(computes[i].operand[0].base);
+        }
+        vector<bh_instruction> instrs;
+        for (size_t i = 0; i < computes.size(); ++i) {
+            instrs.push_back(computes[i]);
+            for (const auto &access: last_access) {
+                if (access.second == i and computed.count(access.first) == 0 and syncs.count(access.first) == 0) {
+                    instrs.push_back(make_free(access.first));
+                }
+            }
+        }
+        ret->addFlush(engine, config, std::move(instrs), std::move(syncs), computed);
+    }
+    return ret;
+}
+
+// The BhIRs of the trace 'filename'
+unique_ptr<Workload> recorded(EngineOpenMP &engine, const ConfigParser &config, const string &filename) {
+    unique_ptr<Workload> ret(new Workload(boost::filesystem::path(filename).filename().string(), false));
+    TraceReader reader(filename);
+    // Maps the base arrays of the trace to the base arrays of the workload. Notice, the reader releases freed
+    // base arrays thus their addresses might be reused by later base arrays of the trace.
+    map<const bh_base*, bh_base*> trace2workload;
+    const auto translate = [&](bh_base *base) -> bh_base* {
+        auto it = trace2workload.find(base);
+        if (it == trace2workload.end()) {
+            it = trace2workload.insert(make_pair(base, ret->newBase(base->type, base->nelem))).first;
+        }
+        return it->second;
+    };
+
+    set<bh_base*> computed;
+    vector<bh_base*> data_recv;
+    while (unique_ptr<BhIR> bhir = reader.read(false, data_recv)) {
+        for (bh_base *base: data_recv) {
+            computed.insert(translate(base));
+        }
+        vector<bh_instruction> instrs;
+        set<bh_base*> frees;
+        for (const bh_instruction &instr: bhir->instr_list) {
+            // Extension methods are executed outside of the JIT pipeline
+            if (instr.opcode >= BH_MAX_OPCODE_ID) {
+                computed.insert(translate(instr.operand[0].base));
+                continue;
+            }
+            instrs.push_back(instr);
+            for (bh_view &view: instrs.back().operand) {
+                if (not bh_is_constant(&view)) {
+                    view.base = translate(view.base);
+                }
+            }
+            if (instr.opcode == BH_FREE) {
+                frees.insert(instr.operand[0].base);
+            }
+        }
+        set<bh_base*> syncs;
+        for (bh_base *base: bhir->getSyncs()) {
+            syncs.insert(translate(base));
+        }
+        ret->addFlush(engine, config, std::move(instrs), std::move(syncs), computed);
+        for (bh_base *base: frees) {
+            trace2workload.erase(base);
+        }
+    }
+    return ret;
+}
+
+// Returns the config of the component named 'name' in the current stack
+unique_ptr<ConfigParser> find_component(const string &name) {
+    for (int stack_level = 0; ; ++stack_level) {
+        unique_ptr<ConfigParser> config;
+        try {
+            config.reset(new ConfigParser(stack_level));
+        } catch (const ConfigError &) {
+            throw runtime_error("the current stack has no '" + name + "' component (see BH_STACK)");
+        }
+        if (config->getName() == name) {
+            return config;
+        }
+    }
+}
+
+/* The benchmarks */
+
+void pre_fuser_lossy(benchmark::State &state, const Workload *workload) {
+    for (auto _: state) {
+        for (const auto &flush: workload->flushes) {
+            benchmark::DoNotOptimize(jitk::pre_fuser_lossy(flush->instr_list));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * workload->numInstrs());
+}
+
+// Returns the total cost (see `graph::block_cost()`) of the blocks in 'block_list'
+uint64_t total_cost(const vector<jitk::Block> &block_list) {
+    uint64_t ret = 0;
+    for (const jitk::Block &block: block_list) {
+        ret += jitk::graph::block_cost(block);
+    }
+    return ret;
+}
+
+// Returns the number of kernels in 'block_list', i.e. the blocks that aren't system only
+int64_t num_kernels(const vector<jitk::Block> &block_list) {
+    int64_t ret = 0;
+    for (const jitk::Block &block: block_list) {
+        ret += block.isSystemOnly() ? 0 : 1;
+    }
+    return ret;
+}
+
+// Fuse the flushes of 'workload' using 'fuser' and report the number of edges of the DAGs of the pre-fused blocks,
+// the number of kernels, and their total cost. Besides, the number of flushes where the cost is lower and higher
+// than the cost of the greedy fuser is reported.
+template <void (*fuser)(const ConfigParser &, vector<jitk::Block> &, bool)>
+void fuse(benchmark::State &state, const Workload *workload, const ConfigParser *config) {
+    vector<vector<jitk::Block> > block_lists;
+    for (auto _: state) {
+        state.PauseTiming();
+        block_lists.clear();
+        for (const auto &flush: workload->flushes) {
+            block_lists.push_back(flush->pre_fused);
+        }
+        state.ResumeTiming();
+        for (vector<jitk::Block> &block_list: block_lists) {
+            fuser(*config, block_list, false);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * workload->numInstrs());
+
+    int64_t edges = 0, kernels = 0, cheaper = 0, costlier = 0;
+    uint64_t cost = 0;
+    for (size_t i = 0; i < block_lists.size(); ++i) {
+        edges += boost::num_edges(jitk::graph::from_block_list(workload->flushes[i]->pre_fused));
+        const uint64_t greedy_cost = total_cost(workload->flushes[i]->fused);
+        const uint64_t c = total_cost(block_lists[i]);
+        kernels += num_kernels(block_lists[i]);
+        cost += c;
+        cheaper += c < greedy_cost ? 1 : 0;
+        costlier += c > greedy_cost ? 1 : 0;
+    }
+    state.counters["edges"] = edges;
+    state.counters["kernels"] = kernels;
+    state.counters["cost"] = cost;
+    state.counters["cheaper"] = cheaper;
+    state.counters["costlier"] = costlier;
+}
+
+// When `hit` is false, the cache is empty thus the lookups measure the hashing of the instruction lists
+void fuse_cache_get(benchmark::State &state, const Workload *workload, const ConfigParser *config, bool hit) {
+    jitk::Statistics stat(false, *config);
+    jitk::FuseCache cache(stat);
+    if (hit) {
+        for (const auto &flush: workload->flushes) {
+            cache.insert(flush->instr_list, flush->fused);
+        }
+    }
+    for (auto _: state) {
+        for (const auto &flush: workload->flushes) {
+            benchmark::DoNotOptimize(cache.get(flush->instr_list));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * workload->numInstrs());
+}
+
+// When `hit` is false, the cache is empty thus the lookups measure the hashing of the kernels
+void codegen_cache_get(benchmark::State &state, const Workload *workload, const ConfigParser *config, bool hit) {
+    jitk::Statistics stat(false, *config);
+    jitk::CodegenCache cache(stat);
+    int64_t num_kernels = 0;
+    for (const auto &flush: workload->flushes) {
+        for (const auto &kernel: flush->kernels) {
+            if (hit) {
+                cache.insert(kernel->source, kernel->block_list, kernel->symbols);
+            }
+            ++num_kernels;
+        }
+    }
+    for (auto _: state) {
+        for (const auto &flush: workload->flushes) {
+            for (const auto &kernel: flush->kernels) {
+                benchmark::DoNotOptimize(cache.get(kernel->block_list, kernel->symbols));
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * num_kernels);
+}
+
+void write_kernel(benchmark::State &state, const Workload *workload, EngineOpenMP *engine) {
+    int64_t num_kernels = 0;
+    for (const auto &flush: workload->flushes) {
+        num_kernels += flush->kernels.size();
+    }
+    for (auto _: state) {
+        for (const auto &flush: workload->flushes) {
+            for (const auto &kernel: flush->kernels) {
+                stringstream ss;
+                engine->writeKernel(kernel->block_list, kernel->symbols, {}, kernel->codegen_hash, ss);
+                benchmark::DoNotOptimize(ss);
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * num_kernels);
+}
+
+// Launch the compiled kernels of 'workload' over and over again like an iterative solver, which measures the
+// overhead of `EngineOpenMP::execute()` when its launchers are reused
+void launch_latency(benchmark::State &state, const Workload *workload, EngineOpenMP *engine) {
+    int64_t num_kernels = 0;
+    for (const auto &flush: workload->flushes) {
+        for (const auto &kernel: flush->kernels) {
+            // The first launch compiles the kernel and allocates its arrays
+            engine->execute(kernel->source, kernel->codegen_hash, kernel->symbols.getParams(),
+                            kernel->symbols.offsetStrideViews(), kernel->symbols.constIDs(), false);
+            ++num_kernels;
+        }
+    }
+    for (auto _: state) {
+        for (const auto &flush: workload->flushes) {
+            for (const auto &kernel: flush->kernels) {
+                engine->execute(kernel->source, kernel->codegen_hash, kernel->symbols.getParams(),
+                                kernel->symbols.offsetStrideViews(), kernel->symbols.constIDs(), false);
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * num_kernels);
+}
+
+// Execute the flushes of 'workload' like `execute()` of the OpenMP component
+void execute_flushes(const Workload *workload, EngineOpenMP *engine) {
+    for (const auto &flush: workload->flushes) {
+        BhIR bhir(flush->instrs, flush->syncs);
+        engine->handleExecution(&bhir);
+    }
+}
+
+void flush_latency(benchmark::State &state, const Workload *workload, EngineOpenMP *engine) {
+    // The first flushes compile the kernels and allocate the arrays that outlive the flushes
+    for (int i = 0; i < 2; ++i) {
+        execute_flushes(workload, engine);
+    }
+    for (auto _: state) {
+        execute_flushes(workload, engine);
+    }
+    state.SetItemsProcessed(state.iterations() * workload->numInstrs());
+}
+}
+
+int main(int argc, char *argv[]) {
+    benchmark::Initialize(&argc, argv);
+    // The flush latency should measure compiled kernels and not the interpreter
+    setenv("BH_OPENMP_ASYNC_COMPILE", "false", 1);
+
+    try {
+        const unique_ptr<ConfigParser> config = find_component("openmp");
+        jitk::Statistics stat(false, *config);
+        EngineOpenMP engine(*config, stat);
+
+        vector<unique_ptr<Workload> > workloads;
+        workloads.push_back(stencil(engine, *config, 256));
+        workloads.push_back(reduction(engine, *config, 64));
+        workloads.push_back(gather_scatter(engine, *config, 1 << 16));
+        for (int length: {16, 64, 256}) {
+            workloads.push_back(elementwise_chain(engine, *config, 1 << 16, length));
+        }
+        workloads.push_back(random_flushes(engine, *config, 256, 50, 20, 80, 42));
+        workloads.push_back(random_flushes(engine, *config, 64, 1, 2000, 2000, 42));
+        // The remaining arguments are traces
+        for (int i = 1; i < argc; ++i) {
+            workloads.push_back(recorded(engine, *config, argv[i]));
+        }
+
+        for (const auto &w: workloads) {
+            const Workload *workload = w.get();
+            benchmark::RegisterBenchmark(("pre_fuser_lossy/" + workload->name).c_str(), pre_fuser_lossy, workload);
+            benchmark::RegisterBenchmark(("fuser_greedy/" + workload->name).c_str(), fuse<jitk::fuser_greedy>,
+                                         workload, config.get());
+            benchmark::RegisterBenchmark(("fuser_optimal/" + workload->name).c_str(), fuse<jitk::fuser_optimal>,
+                                         workload, config.get())->Unit(benchmark::kMillisecond);
+            benchmark::RegisterBenchmark(("FuseCache::get/" + workload->name).c_str(), fuse_cache_get, workload,
+                                         config.get(), true);
+            benchmark::RegisterBenchmark(("FuseCache::get_miss/" + workload->name).c_str(), fuse_cache_get,
+                                         workload, config.get(), false);
+            benchmark::RegisterBenchmark(("CodegenCache::get/" + workload->name).c_str(), codegen_cache_get,
+                                         workload, config.get(), true);
+            benchmark::RegisterBenchmark(("CodegenCache::get_miss/" + workload->name).c_str(), codegen_cache_get,
+                                         workload, config.get(), false);
+            benchmark::RegisterBenchmark(("writeKernel/" + workload->name).c_str(), write_kernel, workload,
+                                         &engine);
+            if (workload->executable) {
+                benchmark::RegisterBenchmark(("flush/" + workload->name).c_str(), flush_latency, workload,
+                                             &engine)->Unit(benchmark::kMicrosecond);
+                benchmark::RegisterBenchmark(("launch/" + workload->name).c_str(), launch_latency, workload,
+                                             &engine)->Unit(benchmark::kMicrosecond);
+            }
+        }
+        benchmark::RunSpecifiedBenchmarks();
+        benchmark::Shutdown();
+    } catch (const std::exception &e) {
+        cerr << argv[0] << ": " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
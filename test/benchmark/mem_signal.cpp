@@ -0,0 +1,164 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* bh_benchmark_mem_signal: benchmarks of the memory segments of `bh_mem_signal`.
+ *
+ * The throughput of attach/detach, lookups (`bh_mem_signal_exist()`), and the dispatch of faults to the callback
+ * of a segment is measured with an increasing number of attached segments, which correspond to the live
+ * NumPy arrays of the Python bridge. The lookups are also measured with concurrent readers.
+ *
+ *     bh_benchmark_mem_signal [--benchmark_filter=<regex>]
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <benchmark/benchmark.h>
+
+#include <bh_mem_signal.h>
+
+using namespace std;
+
+namespace {
+
+const uint64_t page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+
+// A mmap'ed region of pages, which are attached as segments of one page each
+class Pages {
+public:
+    char *data;
+    const uint64_t num_pages;
+
+    explicit Pages(uint64_t num_pages) : num_pages(num_pages) {
+        void *addr = mmap(nullptr, num_pages * page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED) {
+            cerr << "Fatal error: could not mmap " << num_pages << " pages" << endl;
+            exit(-1);
+        }
+        data = static_cast<char*>(addr);
+    }
+
+    ~Pages() {
+        munmap(data, num_pages * page_size);
+    }
+
+    char *page(uint64_t i) const {
+        return data + i * page_size;
+    }
+};
+
+int unprotect_callback(void *, void *segment_idx) {
+    return mprotect(segment_idx, page_size, PROT_READ | PROT_WRITE) == 0;
+}
+
+int noop_callback(void *, void *) {
+    return 0;
+}
+
+// Attach the first `num` pages of `pages` as segments
+void attach_pages(const Pages &pages, uint64_t num) {
+    for (uint64_t i = 0; i < num; ++i) {
+        bh_mem_signal_attach(pages.page(i), pages.page(i), page_size, noop_callback);
+    }
+}
+
+// Detach the first `num` pages of `pages`
+void detach_pages(const Pages &pages, uint64_t num) {
+    for (uint64_t i = 0; i < num; ++i) {
+        bh_mem_signal_detach(pages.page(i));
+    }
+}
+
+// Attach and detach a segment while `state.range(0)` other segments are attached
+void BM_attach_detach(benchmark::State &state) {
+    const uint64_t num_live = state.range(0);
+    Pages pages(num_live + 1);
+    attach_pages(pages, num_live);
+    char *extra = pages.page(num_live);
+    for (auto _ : state) {
+        bh_mem_signal_attach(extra, extra, page_size, noop_callback);
+        bh_mem_signal_detach(extra);
+    }
+    detach_pages(pages, num_live);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_attach_detach)->RangeMultiplier(16)->Range(1, 1 << 16);
+
+// The segments that the lookup benchmark shares between its threads
+unique_ptr<Pages> lookup_pages;
+
+// Look up random attached addresses while `state.range(0)` segments are attached
+void BM_lookup(benchmark::State &state) {
+    const uint64_t num_live = state.range(0);
+    if (state.thread_index() == 0) {
+        lookup_pages.reset(new Pages(num_live));
+        attach_pages(*lookup_pages, num_live);
+    }
+    // NB: Google Benchmark starts the timing of all threads after the setup of thread 0
+    mt19937_64 rng(state.thread_index());
+    uniform_int_distribution<uint64_t> dist(0, num_live * page_size - 1);
+    int64_t found = 0;
+    for (auto _ : state) {
+        found += bh_mem_signal_exist(lookup_pages->data + dist(rng));
+    }
+    if (found != state.iterations()) {
+        state.SkipWithError("an attached address wasn't found");
+    }
+    if (state.thread_index() == 0) {
+        detach_pages(*lookup_pages, num_live);
+        lookup_pages.reset();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_lookup)->RangeMultiplier(16)->Range(1, 1 << 16)->ThreadRange(1, 4);
+
+// Protect, attach, and touch a page thus the signal handler dispatches the fault to the callback of the segment
+// while `state.range(0)` other segments are attached
+void BM_fault(benchmark::State &state) {
+    const uint64_t num_live = state.range(0);
+    Pages pages(num_live + 1);
+    attach_pages(pages, num_live);
+    char *extra = pages.page(num_live);
+    for (auto _ : state) {
+        mprotect(extra, page_size, PROT_NONE);
+        bh_mem_signal_attach(extra, extra, page_size, unprotect_callback);
+        benchmark::DoNotOptimize(*static_cast<volatile char*>(extra));
+        bh_mem_signal_detach(extra);
+    }
+    detach_pages(pages, num_live);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_fault)->RangeMultiplier(16)->Range(1, 1 << 16);
+
+} // Unnamed namespace
+
+int main(int argc, char *argv[]) {
+    bh_mem_signal_init();
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    bh_mem_signal_shutdown();
+    return 0;
+}
@@ -0,0 +1,303 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* bh_test_mem_signal: tests of the memory segments of `bh_mem_signal`.
+ *
+ * - Threads attach and detach segments while other threads look up segments and fault on protected segments.
+ *   The lookups must never miss a segment that stays attached or find a segment that is never attached, and each
+ *   fault must be dispatched to the callback of its segment.
+ * - Touching one element of a large lazy segment fetches the source once and copies the touched pages only, and
+ *   populating the segment copies the remaining pages without overwriting the touched pages.
+ *
+ * The lazy segments require userfaultfd, which the test enables by setting BH_MEM_LAZY unless it is already set.
+ * When not available, the lazy test is skipped.
+ */
+
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <bh_mem_signal.h>
+
+#include "util.hpp"
+
+using namespace bohrium::test;
+using namespace std;
+
+namespace {
+
+const uint64_t page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+
+// A mmap'ed region of pages, which is unmapped on destruction
+class Pages {
+public:
+    char *data;
+    const uint64_t num_pages;
+
+    explicit Pages(uint64_t num_pages, int prot = PROT_READ | PROT_WRITE) : num_pages(num_pages) {
+        void *addr = mmap(nullptr, num_pages * page_size, prot, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED) {
+            throw runtime_error("could not mmap " + to_string(num_pages) + " pages");
+        }
+        data = static_cast<char*>(addr);
+    }
+
+    ~Pages() {
+        munmap(data, num_pages * page_size);
+    }
+
+    char *page(uint64_t i) const {
+        return data + i * page_size;
+    }
+};
+
+/* The tests */
+
+// Writers attach and detach segments while readers look up the segments that stay attached
+// and the pages that are never attached
+void concurrent_lookup() {
+    const string name = "concurrent_lookup";
+    const int num_writers = 4, num_readers = 4, num_iterations = 2000;
+    const uint64_t pages_per_writer = 64, num_stable = 64;
+    // The pages of the writers are interleaved with the stable and the unused pages, which makes them share the
+    // leaves of the page table
+    Pages pages((num_writers + 2) * pages_per_writer);
+    auto writer_page = [&](int writer, uint64_t i) { return pages.page(i * (num_writers + 2) + writer); };
+    auto stable_page = [&](uint64_t i) { return pages.page(i * (num_writers + 2) + num_writers); };
+    auto unused_page = [&](uint64_t i) { return pages.page(i * (num_writers + 2) + num_writers + 1); };
+
+    for (uint64_t i = 0; i < num_stable; ++i) {
+        bh_mem_signal_attach(stable_page(i), stable_page(i), page_size, nullptr);
+    }
+
+    atomic<int> writers_running(num_writers);
+    atomic<uint64_t> num_failures(0), num_lookups(0);
+    vector<thread> threads;
+    for (int w = 0; w < num_writers; ++w) {
+        threads.emplace_back([&, w]() {
+            for (int it = 0; it < num_iterations; ++it) {
+                // One of the pages of this writer, which are every (num_writers + 2)'th page
+                const uint64_t i = (it * 7 + w) % pages_per_writer;
+                char *addr = writer_page(w, i);
+                bh_mem_signal_attach(addr, addr, page_size, nullptr);
+                num_failures += bh_mem_signal_exist(addr + page_size - 1) ? 0 : 1;
+                bh_mem_signal_detach(addr);
+                num_failures += bh_mem_signal_exist(addr) ? 1 : 0;
+            }
+            --writers_running;
+        });
+    }
+    for (int r = 0; r < num_readers; ++r) {
+        threads.emplace_back([&, r]() {
+            uint64_t i = r;
+            do {
+                i = (i + 1) % num_stable;
+                num_failures += bh_mem_signal_exist(stable_page(i) + i) ? 0 : 1;
+                num_failures += bh_mem_signal_exist(unused_page(i)) ? 1 : 0;
+                ++num_lookups;
+            } while (writers_running > 0);
+        });
+    }
+    for (thread &t: threads) {
+        t.join();
+    }
+    check_equal(num_failures, 0, name, "the number of wrong lookups");
+    check(num_lookups > 0, name, "no lookups");
+
+    for (int w = 0; w < num_writers; ++w) {
+        for (uint64_t i = 0; i < pages_per_writer; ++i) {
+            check(not bh_mem_signal_exist(writer_page(w, i)), name, "a detached segment exists");
+        }
+    }
+    for (uint64_t i = 0; i < num_stable; ++i) {
+        bh_mem_signal_detach(stable_page(i));
+        check(not bh_mem_signal_exist(stable_page(i)), name, "a detached segment exists");
+    }
+}
+
+// The number of calls of `unprotect()` per page of the protected pages and the number of calls with a wrong address
+Pages *protected_pages = nullptr;
+vector<atomic<uint64_t> > *num_faults = nullptr;
+atomic<uint64_t> num_wrong_faults(0);
+
+// The callback of the protected pages, which unprotects the page (the segment ID)
+int unprotect(void *fault_address, void *segment_idx) {
+    char *page = static_cast<char*>(segment_idx);
+    if (fault_address < segment_idx or static_cast<char*>(fault_address) >= page + page_size) {
+        ++num_wrong_faults;
+    }
+    ++(*num_faults)[(page - protected_pages->data) / page_size];
+    return mprotect(page, page_size, PROT_READ | PROT_WRITE) == 0;
+}
+
+// Threads touch memory protected segments, whose faults must be dispatched to the callback of the segment,
+// while a writer attaches and detaches other segments
+void concurrent_faults() {
+    const string name = "concurrent_faults";
+    const int num_threads = 4;
+    const uint64_t num_pages = 256;
+    Pages pages(num_pages, PROT_NONE);
+    Pages churn(num_pages);
+    vector<atomic<uint64_t> > faults(num_pages);
+    protected_pages = &pages;
+    num_faults = &faults;
+
+    for (uint64_t i = 0; i < num_pages; ++i) {
+        faults[i] = 0;
+        bh_mem_signal_attach(pages.page(i), pages.page(i), page_size, &unprotect);
+    }
+
+    atomic<bool> done(false);
+    thread writer([&]() {
+        for (uint64_t i = 0; not done; i = (i + 1) % num_pages) {
+            bh_mem_signal_attach(churn.page(i), churn.page(i), page_size, nullptr);
+            bh_mem_signal_detach(churn.page(i));
+        }
+    });
+    vector<thread> threads;
+    atomic<uint64_t> sum(0);
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            // Each thread touches all pages starting at a different page
+            uint64_t local = 0;
+            for (uint64_t i = 0; i < num_pages; ++i) {
+                const uint64_t p = (i + t * num_pages / num_threads) % num_pages;
+                local += static_cast<volatile char*>(pages.page(p))[p % page_size];
+            }
+            sum += local;
+        });
+    }
+    for (thread &t: threads) {
+        t.join();
+    }
+    done = true;
+    writer.join();
+
+    check_equal(sum, 0, name, "the sum of the touched pages");
+    check_equal(num_wrong_faults, 0, name, "the number of faults dispatched with a wrong address");
+    for (uint64_t i = 0; i < num_pages; ++i) {
+        check(faults[i] >= 1, name, "the fault of page " + to_string(i) + " wasn't dispatched");
+        bh_mem_signal_detach(pages.page(i));
+    }
+    protected_pages = nullptr;
+    num_faults = nullptr;
+}
+
+// The data of the lazy segments (nullptr makes the data zero) and the number of calls of `fetch()`
+const double *source_data = nullptr;
+atomic<uint64_t> num_fetches(0);
+
+// The source of the lazy segments
+void *fetch(void *segment_idx) {
+    ++num_fetches;
+    return const_cast<double*>(source_data);
+}
+
+// Returns the number of resident pages of 'pages'
+uint64_t num_resident(const Pages &pages) {
+    vector<unsigned char> vec(pages.num_pages);
+    if (mincore(pages.data, pages.num_pages * page_size, vec.data()) != 0) {
+        throw runtime_error("mincore() failed");
+    }
+    uint64_t ret = 0;
+    for (unsigned char v: vec) {
+        ret += v & 1;
+    }
+    return ret;
+}
+
+// Touching one element of a large lazy segment copies the touched page only, and populating the segment copies
+// the remaining pages. The segment isn't a whole number of pages, and a segment without source data is zero.
+void lazy_faults() {
+    const string name = "lazy_faults";
+    if (not bh_mem_signal_lazy_enabled()) {
+        cout << "bh_test_mem_signal: skipping " << name << " since lazy memory segments are disabled" << endl;
+        return;
+    }
+    const uint64_t num_pages = 4096;
+    const uint64_t nelem = (num_pages * page_size - 24) / sizeof(double);
+    vector<double> data(nelem);
+    for (uint64_t i = 0; i < nelem; ++i) {
+        data[i] = i;
+    }
+    source_data = data.data();
+    num_fetches = 0;
+
+    Pages pages(num_pages);
+    double *array = reinterpret_cast<double*>(pages.data);
+    check(bh_mem_signal_attach_lazy(array, array, nelem * sizeof(double), &fetch) != 0, name,
+          "could not attach the lazy segment");
+    check_equal(num_fetches, 0, name, "the number of fetches before the first touch");
+
+    // Touching one element fetches the source and copies its page only
+    const uint64_t mid = nelem / 2;
+    check(static_cast<volatile double*>(array)[mid] == mid, name, "the touched element is wrong");
+    check_equal(num_fetches, 1, name, "the number of fetches after the first touch");
+    check(num_resident(pages) < num_pages / 16, name, "the whole segment is copied on the first touch");
+
+    // A write and a read of other pages don't fetch the source again
+    array[1] = -1;
+    check(static_cast<volatile double*>(array)[nelem - 1] == nelem - 1, name, "the last element is wrong");
+    check_equal(num_fetches, 1, name, "the number of fetches after touching other pages");
+
+    // Populating copies the untouched pages and keeps the written element
+    bh_mem_signal_populate(array);
+    check_equal(num_resident(pages), num_pages, name, "the number of resident pages after populating");
+    uint64_t num_wrong = 0;
+    for (uint64_t i = 0; i < nelem; ++i) {
+        num_wrong += array[i] == (i == 1 ? -1.0 : i) ? 0 : 1;
+    }
+    check_equal(num_wrong, 0, name, "the number of wrong elements after populating");
+    check_equal(num_fetches, 1, name, "the number of fetches after populating");
+    bh_mem_signal_detach(array);
+
+    // Without source data, the touched pages are zero
+    source_data = nullptr;
+    Pages zeros(num_pages);
+    array = reinterpret_cast<double*>(zeros.data);
+    check(bh_mem_signal_attach_lazy(array, array, nelem * sizeof(double), &fetch) != 0, name,
+          "could not attach the zero segment");
+    check(static_cast<volatile double*>(array)[mid] == 0, name, "the touched element of the zero segment is wrong");
+    check_equal(num_fetches, 2, name, "the number of fetches of the zero segment");
+    check(num_resident(zeros) < num_pages / 16, name, "the whole zero segment is copied on the first touch");
+    bh_mem_signal_detach(array);
+}
+}
+
+int main() {
+    setenv("BH_MEM_LAZY", "1", 0);
+    bh_mem_signal_init();
+    try {
+        concurrent_lookup();
+        concurrent_faults();
+        lazy_faults();
+    } catch (const std::exception &e) {
+        cerr << "bh_test_mem_signal: " << e.what() << endl;
+        return 1;
+    }
+    bh_mem_signal_shutdown();
+    return report();
+}
@@ -0,0 +1,274 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* bh_test_filter_bccon: tests of the `reuse` pass of the bccon filter, which lets temporary arrays share storage.
+ *
+ * Each flush is built twice on its own arrays. The pass rewrites one of them, which must share the storage of the
+ * expected temporaries only, and the interpreter executes both. The synced arrays must be equal.
+ */
+
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <bh_ir.hpp>
+#include <jitk/instruction.hpp>
+#include <jitk/interpreter.hpp>
+
+#include <contracter.hpp>
+
+#include "util.hpp"
+
+using namespace bohrium;
+using namespace bohrium::test;
+using namespace std;
+
+namespace {
+
+// A flush, which owns its base arrays
+class Flush {
+public:
+    vector<bh_instruction> instrs;
+    vector<bh_base*> syncs;
+
+    ~Flush() {
+        for (const auto &base: _bases) {
+            bh_data_free(base.get());
+        }
+    }
+
+    // Returns a new base array
+    bh_base *newBase(bh_type type, int64_t nelem) {
+        _bases.emplace_back(new bh_base());
+        _bases.back()->type = type;
+        _bases.back()->nelem = nelem;
+        return _bases.back().get();
+    }
+
+    // Returns a new input array of 'nelem' float64 elements, which is initialized to 0, 1, 2, ...
+    bh_base *newInput(int64_t nelem) {
+        bh_base *ret = newBase(bh_type::FLOAT64, nelem);
+        bh_data_malloc(ret);
+        for (int64_t i = 0; i < nelem; ++i) {
+            static_cast<double *>(ret->data)[i] = i;
+        }
+        return ret;
+    }
+
+    // Returns a new base array, which is synced
+    bh_base *newSync(bh_type type, int64_t nelem) {
+        syncs.push_back(newBase(type, nelem));
+        return syncs.back();
+    }
+
+private:
+    vector<unique_ptr<bh_base> > _bases;
+};
+
+// The temporary arrays of a test case, which identify the arrays that the pass renames
+typedef vector<bh_base*> Temps;
+
+// A test case appends the instructions of a flush to the given flush and returns its temporary arrays
+typedef Temps (*Case)(Flush &flush);
+
+// Execute 'instrs' one instruction at a time like `EngineCPU::executeInterpreter()`
+void interpret(vector<bh_instruction> &instrs) {
+    set<bh_base*> frees;
+    const vector<bh_instruction*> instr_list = jitk::remove_non_computed_system_instr(instrs, frees);
+    for (bh_base *base: frees) {
+        bh_data_free(base);
+    }
+    jitk::interpret(instr_list);
+    for (const bh_instruction *instr: instr_list) {
+        if (instr->opcode == BH_FREE) {
+            bh_data_free(instr->operand[0].base);
+        }
+    }
+}
+
+template <typename T>
+bool equal_typed(const bh_base *a, const bh_base *b) {
+    const T *x = static_cast<const T *>(a->data);
+    const T *y = static_cast<const T *>(b->data);
+    if (x == nullptr or y == nullptr) {
+        return false;
+    }
+    for (int64_t i = 0; i < a->nelem; ++i) {
+        if (x[i] != y[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool equal(const bh_base *a, const bh_base *b) {
+    switch (a->type) {
+        case bh_type::FLOAT32: return equal_typed<float>(a, b);
+        case bh_type::FLOAT64: return equal_typed<double>(a, b);
+        default:
+            throw runtime_error("equal(): unsupported type");
+    }
+}
+
+// Returns true when an instruction in 'instrs' accesses 'base' (BH_NONE accesses nothing)
+bool referenced(const vector<bh_instruction> &instrs, const bh_base *base) {
+    for (const bh_instruction &instr: instrs) {
+        if (instr.opcode == BH_NONE) {
+            continue;
+        }
+        for (const bh_view &view: instr.operand) {
+            if (not bh_is_constant(&view) and view.base == base) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Build the flush of 'test_case' twice, let the pass rewrite one of them, and compare their synced arrays.
+// 'shared[i]' is true when the i'th temporary array must hand over its storage to another array.
+void test_flush(const string &name, Case test_case, const vector<bool> &shared) {
+    Flush original, rewritten;
+    test_case(original);
+    const Temps temps = test_case(rewritten);
+    check_equal(temps.size(), shared.size(), name, "the number of temporaries");
+
+    BhIR bhir(rewritten.instrs, set<bh_base*>(rewritten.syncs.begin(), rewritten.syncs.end()));
+    filter::bccon::Contracter(false, false, false, false, false, false, true).reuse(bhir);
+
+    uint64_t num_shared = 0;
+    for (size_t i = 0; i < temps.size() and i < shared.size(); ++i) {
+        const bool is_shared = not referenced(bhir.instr_list, temps[i]);
+        num_shared += is_shared ? 1 : 0;
+        check(is_shared == shared[i], name, "the temporary " + to_string(i) + (shared[i] ? " isn't" : " is") +
+                                            " sharing its storage");
+    }
+    uint64_t num_removed_frees = 0;
+    for (const bh_instruction &instr: bhir.instr_list) {
+        num_removed_frees += instr.opcode == BH_NONE ? 1 : 0;
+    }
+    check_equal(num_removed_frees, num_shared, name, "the number of removed BH_FREE");
+
+    interpret(original.instrs);
+    interpret(bhir.instr_list);
+    for (size_t i = 0; i < original.syncs.size(); ++i) {
+        check(equal(rewritten.syncs[i], original.syncs[i]), name, "sync " + to_string(i) + " differs");
+    }
+}
+
+/* The test cases */
+
+const int64_t m = 10, n = m * m;
+
+// Two temporaries whose live ranges follow each other: the second uses the storage of the first
+Temps sequential(Flush &f) {
+    bh_base *x = f.newInput(n);
+    bh_base *t1 = f.newBase(bh_type::FLOAT64, n);
+    bh_base *t2 = f.newBase(bh_type::FLOAT64, n);
+    bh_base *y1 = f.newSync(bh_type::FLOAT64, m);
+    bh_base *y2 = f.newSync(bh_type::FLOAT64, m);
+    f.instrs = {
+        make_instr(BH_MULTIPLY, {make_view(t1, {m, m}), make_view(x, {m, m})}, 2.0),
+        make_instr(BH_ADD_REDUCE, {make_view(y1, {m}), make_view(t1, {m, m})}, int64_t(1)),
+        make_free(t1),
+        make_instr(BH_ADD, {make_view(t2, {m, m}), make_view(x, {m, m})}, 1.0),
+        make_instr(BH_ADD_REDUCE, {make_view(y2, {m}), make_view(t2, {m, m})}, int64_t(0)),
+        make_free(t2)
+    };
+    return {t1, t2};
+}
+
+// Two temporaries that are live at the same time, which must never share storage. The second hands over its storage
+// to a later temporary.
+Temps overlapping(Flush &f) {
+    bh_base *x = f.newInput(n);
+    bh_base *t1 = f.newBase(bh_type::FLOAT64, n);
+    bh_base *t2 = f.newBase(bh_type::FLOAT64, n);
+    bh_base *t3 = f.newBase(bh_type::FLOAT64, n);
+    bh_base *y1 = f.newSync(bh_type::FLOAT64, m);
+    bh_base *y2 = f.newSync(bh_type::FLOAT64, m);
+    bh_base *y3 = f.newSync(bh_type::FLOAT64, m);
+    f.instrs = {
+        make_instr(BH_MULTIPLY, {make_view(t1, {m, m}), make_view(x, {m, m})}, 2.0),
+        make_instr(BH_ADD, {make_view(t2, {m, m}), make_view(x, {m, m})}, 1.0),
+        make_instr(BH_ADD_REDUCE, {make_view(y1, {m}), make_view(t1, {m, m})}, int64_t(1)),
+        make_instr(BH_ADD_REDUCE, {make_view(y2, {m}), make_view(t2, {m, m})}, int64_t(0)),
+        make_free(t1),
+        make_free(t2),
+        make_instr(BH_SUBTRACT, {make_view(t3, {m, m}), make_view(x, {m, m}, 0, {1, m})}, 1.0),
+        make_instr(BH_ADD_REDUCE, {make_view(y3, {m}), make_view(t3, {m, m})}, int64_t(1)),
+        make_free(t3)
+    };
+    return {t1, t2, t3};
+}
+
+// An elementwise output takes over the storage of a temporary that dies at the same instruction, but not of a
+// temporary that is read later
+Temps in_place(Flush &f) {
+    bh_base *x = f.newInput(n);
+    bh_base *t1 = f.newBase(bh_type::FLOAT64, n);
+    bh_base *t2 = f.newBase(bh_type::FLOAT64, n);
+    bh_base *y1 = f.newSync(bh_type::FLOAT64, n);
+    bh_base *y2 = f.newSync(bh_type::FLOAT64, m);
+    f.instrs = {
+        make_instr(BH_MULTIPLY, {make_view(t1, {m, m}), make_view(x, {m, m})}, 2.0),
+        make_instr(BH_ADD, {make_view(t2, {m, m}), make_view(x, {m, m})}, 1.0),
+        bh_instruction(BH_MULTIPLY, {make_view(y1, {m, m}), make_view(t2, {m, m}), make_view(t1, {m, m})}),
+        make_instr(BH_ADD_REDUCE, {make_view(y2, {m}), make_view(t2, {m, m})}, int64_t(1)),
+        make_free(t1),
+        make_free(t2)
+    };
+    return {t1, t2};
+}
+
+// Temporaries that are read through a view that doesn't match the output, or that differ in type or size from the
+// later arrays, keep their storage
+Temps mismatch(Flush &f) {
+    bh_base *x = f.newInput(n);
+    bh_base *t1 = f.newBase(bh_type::FLOAT64, n);
+    bh_base *t2 = f.newBase(bh_type::FLOAT32, n);
+    bh_base *t3 = f.newBase(bh_type::FLOAT64, n - 1);
+    bh_base *y1 = f.newSync(bh_type::FLOAT64, n - 1);
+    bh_base *y2 = f.newSync(bh_type::FLOAT32, m);
+    bh_base *y3 = f.newSync(bh_type::FLOAT64, 1);
+    f.instrs = {
+        make_instr(BH_MULTIPLY, {make_view(t1, {n}), make_view(x, {n})}, 2.0),
+        make_instr(BH_ADD, {make_view(y1, {n - 1}), make_view(t1, {n - 1}, 1)}, 1.0),
+        make_free(t1),
+        bh_instruction(BH_IDENTITY, {make_view(t2, {n}), make_view(x, {n})}),
+        make_instr(BH_ADD_REDUCE, {make_view(y2, {m}), make_view(t2, {m, m})}, int64_t(0)),
+        make_free(t2),
+        bh_instruction(BH_IDENTITY, {make_view(t3, {n - 1}), make_view(x, {n - 1})}),
+        make_instr(BH_ADD_REDUCE, {make_view(y3, {1}), make_view(t3, {n - 1})}, int64_t(0)),
+        make_free(t3)
+    };
+    return {t1, t2, t3};
+}
+}
+
+int main() {
+    test_flush("sequential", sequential, {true, false});
+    test_flush("overlapping", overlapping, {false, true, false});
+    test_flush("in_place", in_place, {true, false});
+    test_flush("mismatch", mismatch, {false, false, false});
+    return report();
+}
@@ -0,0 +1,212 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* bh_test_jitk_fuser: tests of the greedy and the optimal fuser.
+ *
+ * Small fixed flushes are fused by `graph::greedy()`, `graph::optimal()`, `fuser_greedy()`, and `fuser_optimal()`.
+ * The number of kernels and their total cost (see `graph::block_cost()`) are compared with the expected values and
+ * with a reference greedy merging, which is the simple implementation of `graph::greedy()` that finds all fusible
+ * edges and merges the greatest weight edge one at a time.
+ *
+ * The config of the first component in the current stack is used (see BH_STACK and BH_CONFIG).
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <set>
+
+#include <bh_config_parser.hpp>
+#include <jitk/fuser.hpp>
+#include <jitk/graph.hpp>
+#include <jitk/codegen_util.hpp>
+
+#include "util.hpp"
+
+using namespace bohrium;
+using namespace bohrium::test;
+using namespace std;
+
+namespace {
+
+// The number of kernels and their total cost
+struct Fusion {
+    uint64_t kernels = 0;
+    uint64_t cost = 0;
+
+    void add(const jitk::Block &block) {
+        kernels += block.isSystemOnly() ? 0 : 1;
+        cost += jitk::graph::block_cost(block);
+    }
+};
+
+Fusion fusion_of(const vector<jitk::Block> &block_list) {
+    Fusion ret;
+    for (const jitk::Block &block: block_list) {
+        ret.add(block);
+    }
+    return ret;
+}
+
+// The reference greedy merging of 'dag'
+Fusion reference_greedy(jitk::graph::DAG dag) {
+    using namespace jitk::graph;
+    vector<bool> removed(boost::num_vertices(dag), false);
+    while (true) {
+        // Find the fusible edges and remove the transitive edges
+        vector<Edge> fusibles;
+        auto edges = boost::edges(dag);
+        for (auto it = edges.first; it != edges.second;) {
+            const Edge e = *it; ++it; // NB: we iterate here because boost::remove_edge() invalidates 'it'
+            const Vertex v1 = boost::source(e, dag);
+            const Vertex v2 = boost::target(e, dag);
+            if (path_exist(v1, v2, dag, true)) {
+                boost::remove_edge(e, dag);
+            } else if (jitk::mergeable(dag[v1], dag[v2], false)) {
+                fusibles.push_back(e);
+            }
+        }
+        if (fusibles.empty()) {
+            break;
+        }
+        // Merge the first edge of the greatest weight
+        Edge greatest = fusibles.front();
+        uint64_t greatest_weight = weight(dag[boost::source(greatest, dag)], dag[boost::target(greatest, dag)]);
+        for (const Edge &e: fusibles) {
+            const uint64_t w = weight(dag[boost::source(e, dag)], dag[boost::target(e, dag)]);
+            if (w > greatest_weight) {
+                greatest = e;
+                greatest_weight = w;
+            }
+        }
+        const Vertex b = boost::target(greatest, dag);
+        merge_vertices(dag, boost::source(greatest, dag), b, false);
+        removed[b] = true;
+    }
+    Fusion ret;
+    BOOST_FOREACH(Vertex v, boost::vertices(dag)) {
+        if (not removed[v]) {
+            ret.add(dag[v]);
+        }
+    }
+    return ret;
+}
+
+// Fuse the flush 'instrs', which reads the arrays in 'inputs', and check the number of kernels and their total cost
+// of the greedy fusion and the optimal fusion
+void test_flush(const ConfigParser &config, const string &name, vector<bh_instruction> instrs,
+                const set<bh_base *> &inputs, Fusion greedy, Fusion optimal) {
+    // Like `EngineCPU::handleExecution()` and `jitk::get_block_list()`
+    vector<bh_instruction *> instr_list;
+    for (bh_instruction &instr: instrs) {
+        instr.origin_id = instr_list.size();
+        instr_list.push_back(&instr);
+    }
+    jitk::util_set_constructor_flag(instr_list, inputs);
+    const vector<jitk::Block> pre_fused = jitk::pre_fuser_lossy(instr_list);
+
+    const Fusion reference = reference_greedy(jitk::graph::from_block_list(pre_fused));
+    check_equal(reference.kernels, greedy.kernels, name, "the number of kernels of the reference greedy merging");
+    check_equal(reference.cost, greedy.cost, name, "the cost of the reference greedy merging");
+
+    {
+        jitk::graph::DAG dag = jitk::graph::from_block_list(pre_fused);
+        jitk::graph::greedy(dag, false);
+        const Fusion fusion = fusion_of(jitk::graph::fill_block_list(dag));
+        check_equal(fusion.kernels, greedy.kernels, name, "the number of kernels of graph::greedy()");
+        check_equal(fusion.cost, greedy.cost, name, "the cost of graph::greedy()");
+    }
+    {
+        jitk::graph::DAG dag = jitk::graph::from_block_list(pre_fused);
+        check(jitk::graph::optimal(dag, false, 10000), name, "graph::optimal() didn't complete the search");
+        const Fusion fusion = fusion_of(jitk::graph::fill_block_list(dag));
+        check_equal(fusion.kernels, optimal.kernels, name, "the number of kernels of graph::optimal()");
+        check_equal(fusion.cost, optimal.cost, name, "the cost of graph::optimal()");
+    }
+
+    // The fusers fuse the nested levels as well, which never changes the number of kernels
+    vector<jitk::Block> block_list = pre_fused;
+    jitk::fuser_greedy(config, block_list, false);
+    const Fusion fused_greedy = fusion_of(block_list);
+    check_equal(fused_greedy.kernels, greedy.kernels, name, "the number of kernels of fuser_greedy()");
+    check(fused_greedy.cost <= greedy.cost, name, "fuser_greedy() is costlier than graph::greedy()");
+
+    block_list = pre_fused;
+    jitk::fuser_optimal(config, block_list, false);
+    const Fusion fused_optimal = fusion_of(block_list);
+    check(fused_optimal.cost <= fused_greedy.cost, name, "fuser_optimal() is costlier than fuser_greedy()");
+    check(fused_optimal.cost <= optimal.cost, name, "fuser_optimal() is costlier than graph::optimal()");
+}
+}
+
+int main() {
+    const ConfigParser config(0);
+    const int64_t n = 1000;
+    const uint64_t size = n * 8; // The size of a vector of 'n' float64 elements
+
+    // Elementwise operations of the same shape, which both fusions merge into one kernel where 't' is temporary
+    {
+        bh_base x, t, y, z;
+        for (bh_base *base: {&x, &t, &y, &z}) {
+            base->type = bh_type::FLOAT64;
+            base->nelem = n;
+        }
+        vector<bh_instruction> instrs = {
+            make_instr(BH_MULTIPLY, {make_view(&t, {n}), make_view(&x, {n})}, 2.0),
+            make_instr(BH_ADD, {make_view(&y, {n}), make_view(&t, {n})}, 1.0),
+            make_free(&t),
+            make_instr(BH_ADD, {make_view(&z, {n}), make_view(&x, {n})}, 1.0)
+        };
+        Fusion fusion;
+        fusion.kernels = 1;
+        fusion.cost = 3 * size; // (x, y, z)
+        test_flush(config, "elementwise", std::move(instrs), {&x}, fusion, fusion);
+    }
+
+    // A reduction of the rows of 'm' followed by vector operations, and an elementwise operation on 'm'. The greedy
+    // fusion merges along the edges only thus the independent operations on 'm' end up in two kernels.
+    {
+        bh_base m, m2, r, t, out;
+        for (bh_base *base: {&m, &m2}) {
+            base->type = bh_type::FLOAT64;
+            base->nelem = n * n;
+        }
+        for (bh_base *base: {&r, &t, &out}) {
+            base->type = bh_type::FLOAT64;
+            base->nelem = n;
+        }
+        vector<bh_instruction> instrs = {
+            make_instr(BH_ADD_REDUCE, {make_view(&r, {n}), make_view(&m, {n, n})}, int64_t(1)),
+            make_instr(BH_MULTIPLY, {make_view(&m2, {n, n}), make_view(&m, {n, n})}, 0.5),
+            bh_instruction(BH_MAXIMUM, {make_view(&t, {n}), make_view(&r, {n}), make_view(&r, {n})}),
+            make_free(&r),
+            make_instr(BH_ADD, {make_view(&out, {n}), make_view(&t, {n})}, 1.0),
+            make_free(&t)
+        };
+        Fusion greedy, optimal;
+        greedy.kernels = 2;
+        greedy.cost = (3 * n + 1) * size; // (m, out) and (m, m2)
+        optimal.kernels = 1;
+        optimal.cost = (2 * n + 1) * size; // (m, m2, out)
+        test_flush(config, "reduction", std::move(instrs), {&m}, greedy, optimal);
+    }
+
+    return report();
+}
@@ -0,0 +1,506 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* bh_test_jitk_interpreter: tests of the interpreter against the compiled kernels.
+ *
+ * Each flush is executed three times on its own arrays: by the kernels of the OpenMP component, one instruction at a
+ * time by the interpreter (like `EngineCPU::executeInterpreter()`), and one fused block at a time by the interpreter
+ * (like `EngineCPU::executeFallback()`, where the temporary arrays of the blocks are contracted). The synced arrays of
+ * the interpreter must equal the synced arrays of the kernels.
+ *
+ * The config of the OpenMP component in the current stack is used (see BH_STACK and BH_CONFIG).
+ */
+
+#include <cmath>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <bh_config_parser.hpp>
+#include <bh_ir.hpp>
+#include <jitk/apply_fusion.hpp>
+#include <jitk/fuser_cache.hpp>
+#include <jitk/instruction.hpp>
+#include <jitk/interpreter.hpp>
+#include <jitk/statistics.hpp>
+
+#include <engine_openmp.hpp>
+
+#include "util.hpp"
+
+using namespace bohrium;
+using namespace bohrium::test;
+using namespace std;
+
+namespace {
+
+// A flush of a test case, which owns its base arrays
+class Flush {
+public:
+    vector<bh_instruction> instrs;
+    vector<bh_base*> inputs; // The arrays initialized by `fill()` before the flush is executed
+    vector<bh_base*> syncs;  // The arrays compared after the flush is executed
+
+    ~Flush() {
+        for (const auto &base: _bases) {
+            bh_data_free(base.get());
+        }
+    }
+
+    // Returns a new base array
+    bh_base *newBase(bh_type type, int64_t nelem) {
+        _bases.emplace_back(new bh_base());
+        _bases.back()->type = type;
+        _bases.back()->nelem = nelem;
+        return _bases.back().get();
+    }
+
+    // Returns a new base array, which is initialized by `fill()`
+    bh_base *newInput(bh_type type, int64_t nelem) {
+        inputs.push_back(newBase(type, nelem));
+        return inputs.back();
+    }
+
+    // Returns a new base array, which is synced
+    bh_base *newSync(bh_type type, int64_t nelem) {
+        syncs.push_back(newBase(type, nelem));
+        return syncs.back();
+    }
+
+private:
+    vector<unique_ptr<bh_base> > _bases;
+};
+
+// A test case appends the instructions of a flush and its arrays to the given flush
+typedef void (*Case)(Flush &flush);
+
+/* Initialization and comparison of the arrays */
+
+// The i'th element of an input array: small values of both signs (except for unsigned types)
+template <typename T>
+T input_value(int64_t i) {
+    if (is_same<T, bool>::value) {
+        return static_cast<T>(i % 3 == 0);
+    } else if (is_floating_point<T>::value) {
+        return static_cast<T>((((i * 7) % 23) - 11) * 0.37);
+    } else if (is_signed<T>::value) {
+        return static_cast<T>(((i * 7) % 23) - 11);
+    } else {
+        return static_cast<T>((i * 7) % 23);
+    }
+}
+
+template <typename T>
+void fill_typed(bh_base *base) {
+    T *data = static_cast<T *>(base->data);
+    for (int64_t i = 0; i < base->nelem; ++i) {
+        data[i] = input_value<T>(i);
+    }
+}
+
+// Allocate and initialize the input array 'base'
+void fill(bh_base *base) {
+    bh_data_malloc(base);
+    switch (base->type) {
+        case bh_type::BOOL:    fill_typed<bool>(base);     break;
+        case bh_type::INT8:    fill_typed<int8_t>(base);   break;
+        case bh_type::INT16:   fill_typed<int16_t>(base);  break;
+        case bh_type::INT32:   fill_typed<int32_t>(base);  break;
+        case bh_type::INT64:   fill_typed<int64_t>(base);  break;
+        case bh_type::UINT8:   fill_typed<uint8_t>(base);  break;
+        case bh_type::UINT16:  fill_typed<uint16_t>(base); break;
+        case bh_type::UINT32:  fill_typed<uint32_t>(base); break;
+        case bh_type::UINT64:  fill_typed<uint64_t>(base); break;
+        case bh_type::FLOAT32: fill_typed<float>(base);    break;
+        case bh_type::FLOAT64: fill_typed<double>(base);   break;
+        default:
+            throw runtime_error("fill(): unsupported type");
+    }
+}
+
+// Returns true when 'a' and 'b' are equal, which for floats means equal to the last few digits
+template <typename T>
+bool element_equal(T a, T b) {
+    if (not is_floating_point<T>::value or a == b) {
+        return a == b;
+    }
+    const double x = static_cast<double>(a), y = static_cast<double>(b);
+    if (std::isnan(x) or std::isnan(y)) {
+        return std::isnan(x) and std::isnan(y);
+    }
+    return std::fabs(x - y) <= 1e-6 * std::max(1.0, std::max(std::fabs(x), std::fabs(y)));
+}
+
+template <typename T>
+void compare_typed(const bh_base *result, const bh_base *expected, const string &name, const string &what) {
+    const T *res = static_cast<const T *>(result->data);
+    const T *exp = static_cast<const T *>(expected->data);
+    if (res == nullptr or exp == nullptr) {
+        check(false, name, what + " wasn't computed");
+        return;
+    }
+    for (int64_t i = 0; i < result->nelem; ++i) {
+        if (not element_equal(res[i], exp[i])) {
+            stringstream ss;
+            ss << what << "[" << i << "] is " << +res[i] << " but the kernel computed " << +exp[i];
+            check(false, name, ss.str());
+            return;
+        }
+    }
+}
+
+// Compare the array 'result' with the array 'expected' of the kernels
+void compare(const bh_base *result, const bh_base *expected, const string &name, const string &what) {
+    switch (result->type) {
+        case bh_type::BOOL:    compare_typed<bool>(result, expected, name, what);     break;
+        case bh_type::INT8:    compare_typed<int8_t>(result, expected, name, what);   break;
+        case bh_type::INT16:   compare_typed<int16_t>(result, expected, name, what);  break;
+        case bh_type::INT32:   compare_typed<int32_t>(result, expected, name, what);  break;
+        case bh_type::INT64:   compare_typed<int64_t>(result, expected, name, what);  break;
+        case bh_type::UINT8:   compare_typed<uint8_t>(result, expected, name, what);  break;
+        case bh_type::UINT16:  compare_typed<uint16_t>(result, expected, name, what); break;
+        case bh_type::UINT32:  compare_typed<uint32_t>(result, expected, name, what); break;
+        case bh_type::UINT64:  compare_typed<uint64_t>(result, expected, name, what); break;
+        case bh_type::FLOAT32: compare_typed<float>(result, expected, name, what);    break;
+        case bh_type::FLOAT64: compare_typed<double>(result, expected, name, what);   break;
+        default:
+            throw runtime_error("compare(): unsupported type");
+    }
+}
+
+/* The executions of a flush */
+
+// Execute 'flush' using the kernels of 'engine' like `execute()` of the OpenMP component
+void execute_kernels(EngineOpenMP &engine, Flush &flush) {
+    BhIR bhir(flush.instrs, set<bh_base*>(flush.syncs.begin(), flush.syncs.end()));
+    engine.handleExecution(&bhir);
+}
+
+// Execute 'flush' one instruction at a time like `EngineCPU::executeInterpreter()`
+void execute_instructions(Flush &flush) {
+    set<bh_base*> frees;
+    const vector<bh_instruction*> instr_list = jitk::remove_non_computed_system_instr(flush.instrs, frees);
+    for (bh_base *base: frees) {
+        bh_data_free(base);
+    }
+    check(jitk::interpretable(instr_list), "", "the flush isn't interpretable");
+    jitk::interpret(instr_list);
+    for (const bh_instruction *instr: instr_list) {
+        if (instr->opcode == BH_FREE) {
+            bh_data_free(instr->operand[0].base);
+        }
+    }
+}
+
+// Execute the fused blocks of 'flush' one at a time like `EngineCPU::executeFallback()`.
+// Returns the number of temporary arrays of the blocks, which a kernel would contract.
+uint64_t execute_blocks(EngineOpenMP &engine, const ConfigParser &config, Flush &flush) {
+    set<bh_base*> frees;
+    vector<bh_instruction*> instr_list = jitk::remove_non_computed_system_instr(flush.instrs, frees);
+    for (bh_base *base: frees) {
+        bh_data_free(base);
+    }
+    engine.setConstructorFlag(instr_list);
+    jitk::Statistics stat(false, config);
+    jitk::FuseCache fcache(stat);
+    uint64_t num_temps = 0;
+    for (const jitk::Block &block: jitk::get_block_list(instr_list, config, fcache, stat, false)) {
+        jitk::interpret(vector<jitk::Block>{block});
+        num_temps += block.getLoop().getAllTemps().size();
+        for (bh_base *base: block.getLoop().getAllFrees()) {
+            bh_data_free(base);
+        }
+    }
+    return num_temps;
+}
+
+// Execute the flush of 'test_case' using the kernels and the interpreter and compare the synced arrays.
+// When 'contracted' is true, the fused blocks must have temporary arrays.
+void test_flush(EngineOpenMP &engine, const ConfigParser &config, const string &name, Case test_case,
+                bool contracted = false) {
+    Flush kernels, instructions, blocks;
+    for (Flush *flush: {&kernels, &instructions, &blocks}) {
+        test_case(*flush);
+        for (bh_base *base: flush->inputs) {
+            fill(base);
+        }
+    }
+    execute_kernels(engine, kernels);
+    execute_instructions(instructions);
+    const uint64_t num_temps = execute_blocks(engine, config, blocks);
+    check(not contracted or num_temps > 0, name, "the fused blocks have no temporary arrays");
+
+    for (size_t i = 0; i < kernels.syncs.size(); ++i) {
+        compare(instructions.syncs[i], kernels.syncs[i], name, "instructions: sync " + to_string(i));
+        compare(blocks.syncs[i], kernels.syncs[i], name, "blocks: sync " + to_string(i));
+    }
+}
+
+/* The test cases */
+
+// Appends 'out = opcode(operands...)' where 'out' is a new synced array of 'type' and 'shape'
+void append(Flush &flush, bh_opcode opcode, bh_type type, const vector<int64_t> &shape, vector<bh_view> operands) {
+    int64_t nelem = 1;
+    for (int64_t s: shape) {
+        nelem *= s;
+    }
+    operands.insert(operands.begin(), make_view(flush.newSync(type, nelem), shape));
+    flush.instrs.emplace_back(opcode, std::move(operands));
+}
+
+// Like `append()` where the last operand is the constant 'value'
+template <typename T>
+void append(Flush &flush, bh_opcode opcode, bh_type type, const vector<int64_t> &shape, vector<bh_view> operands,
+            T value) {
+    append(flush, opcode, type, shape, std::move(operands));
+    bh_view constant;
+    bh_flag_constant(&constant);
+    flush.instrs.back().operand.push_back(constant);
+    flush.instrs.back().constant = bh_constant(value);
+}
+
+// The elementwise operations on floats, which includes comparisons and conversions
+void float_elementwise(Flush &f) {
+    const int64_t n = 101;
+    const bh_view a = make_view(f.newInput(bh_type::FLOAT64, n), {n});
+    const bh_view b = make_view(f.newInput(bh_type::FLOAT64, n), {n});
+    const bh_type t = bh_type::FLOAT64;
+    for (bh_opcode opcode: {BH_ADD, BH_SUBTRACT, BH_MULTIPLY, BH_MAXIMUM, BH_MINIMUM, BH_MOD, BH_REMAINDER,
+                            BH_ARCTAN2}) {
+        append(f, opcode, t, {n}, {a, b});
+    }
+    // The inputs have zeros thus the quotients and the square roots have infinities and NaNs
+    append(f, BH_DIVIDE, t, {n}, {a, b});
+    const bh_view quotient = make_view(f.syncs.back(), {n});
+    append(f, BH_SQRT, t, {n}, {a});
+    const bh_view root = make_view(f.syncs.back(), {n});
+    append(f, BH_POWER, t, {n}, {a}, 2.0);
+    append(f, BH_SUBTRACT, t, {n}, {a}, 1.5);
+    for (bh_opcode opcode: {BH_ABSOLUTE, BH_SIGN, BH_EXP, BH_EXPM1, BH_LOG, BH_LOG1P, BH_SIN, BH_COS,
+                            BH_TAN, BH_TANH, BH_ARCTAN, BH_FLOOR, BH_CEIL, BH_TRUNC, BH_RINT}) {
+        append(f, opcode, t, {n}, {a});
+    }
+    for (bh_opcode opcode: {BH_GREATER, BH_GREATER_EQUAL, BH_LESS, BH_LESS_EQUAL, BH_EQUAL, BH_NOT_EQUAL}) {
+        append(f, opcode, bh_type::BOOL, {n}, {a, b});
+    }
+    append(f, BH_LESS_EQUAL, bh_type::BOOL, {n}, {a}, 0.74);
+    append(f, BH_ISNAN, bh_type::BOOL, {n}, {root});
+    append(f, BH_ISINF, bh_type::BOOL, {n}, {quotient});
+    append(f, BH_ISFINITE, bh_type::BOOL, {n}, {quotient});
+    append(f, BH_IDENTITY, bh_type::INT32, {n}, {a});
+    append(f, BH_IDENTITY, bh_type::BOOL, {n}, {a});
+    append(f, BH_IDENTITY, bh_type::FLOAT32, {n}, {a});
+    append(f, BH_IDENTITY, t, {n}, {}, -3.25);
+}
+
+// The elementwise operations on integers and booleans, which includes Python's integer division and remainder
+void integer_elementwise(Flush &f) {
+    const int64_t n = 101;
+    const bh_view a = make_view(f.newInput(bh_type::INT64, n), {n});
+    const bh_view b = make_view(f.newInput(bh_type::INT64, n), {n});
+    const bh_type t = bh_type::INT64;
+
+    // The divisors are never zero: 'd = |b| + 1' and 'nd = -d'
+    bh_base *abs_b = f.newBase(t, n), *d = f.newBase(t, n), *nd = f.newBase(t, n);
+    f.instrs.emplace_back(BH_ABSOLUTE, vector<bh_view>{make_view(abs_b, {n}), b});
+    f.instrs.push_back(make_instr(BH_ADD, {make_view(d, {n}), make_view(abs_b, {n})}, int64_t(1)));
+    f.instrs.push_back(make_free(abs_b));
+    f.instrs.push_back(make_instr(BH_MULTIPLY, {make_view(nd, {n}), make_view(d, {n})}, int64_t(-1)));
+    for (bh_base *divisor: {d, nd}) {
+        for (bh_opcode opcode: {BH_DIVIDE, BH_REMAINDER, BH_MOD}) {
+            append(f, opcode, t, {n}, {a, make_view(divisor, {n})});
+        }
+    }
+    f.instrs.push_back(make_free(d));
+    f.instrs.push_back(make_free(nd));
+    for (bh_opcode opcode: {BH_ADD, BH_SUBTRACT, BH_MULTIPLY, BH_MAXIMUM, BH_MINIMUM, BH_BITWISE_AND,
+                            BH_BITWISE_OR, BH_BITWISE_XOR}) {
+        append(f, opcode, t, {n}, {a, b});
+    }
+    append(f, BH_GREATER, bh_type::BOOL, {n}, {a, b});
+    append(f, BH_EQUAL, bh_type::BOOL, {n}, {a, b});
+    append(f, BH_POWER, t, {n}, {a}, int64_t(3));
+    for (bh_opcode opcode: {BH_ABSOLUTE, BH_SIGN, BH_INVERT}) {
+        append(f, opcode, t, {n}, {a});
+    }
+    append(f, BH_IDENTITY, bh_type::FLOAT64, {n}, {a});
+    append(f, BH_IDENTITY, bh_type::INT8, {n}, {a});
+
+    // The shifts of unsigned integers by 0 to 7 bits
+    const bh_view u = make_view(f.newInput(bh_type::UINT32, n), {n});
+    bh_base *bits = f.newBase(bh_type::UINT32, n);
+    f.instrs.push_back(make_instr(BH_BITWISE_AND, {make_view(bits, {n}), u}, uint32_t(7)));
+    append(f, BH_LEFT_SHIFT, bh_type::UINT32, {n}, {u, make_view(bits, {n})});
+    append(f, BH_RIGHT_SHIFT, bh_type::UINT32, {n}, {u, make_view(bits, {n})});
+    f.instrs.push_back(make_free(bits));
+    append(f, BH_ADD, bh_type::UINT8, {n}, {make_view(f.newInput(bh_type::UINT8, n), {n})}, uint8_t(250));
+
+    // The booleans
+    const bh_view p = make_view(f.newInput(bh_type::BOOL, n), {n});
+    const bh_view q = make_view(f.newInput(bh_type::BOOL, n), {n}, 1, {1});
+    for (bh_opcode opcode: {BH_LOGICAL_AND, BH_LOGICAL_OR, BH_LOGICAL_XOR, BH_MULTIPLY, BH_ADD, BH_BITWISE_XOR,
+                            BH_LEFT_SHIFT}) {
+        append(f, opcode, bh_type::BOOL, {n - 1}, {make_view(p.base, {n - 1}), q});
+    }
+    for (bh_opcode opcode: {BH_LOGICAL_NOT, BH_INVERT, BH_ABSOLUTE, BH_SIGN}) {
+        append(f, opcode, bh_type::BOOL, {n}, {p});
+    }
+}
+
+// The reductions and accumulations over the different axes
+void reductions(Flush &f) {
+    const int64_t rows = 13, cols = 17;
+    const bh_view m = make_view(f.newInput(bh_type::FLOAT64, rows * cols), {rows, cols});
+    const bh_view mi = make_view(f.newInput(bh_type::INT32, rows * cols), {rows, cols});
+    const bh_view ml = make_view(f.newInput(bh_type::INT64, rows * cols), {rows, cols});
+    const bh_view mb = make_view(f.newInput(bh_type::BOOL, rows * cols), {rows, cols});
+    const bh_view cube = make_view(f.newInput(bh_type::FLOAT64, 5 * 6 * 7), {5, 6, 7});
+    const bh_view vec = make_view(f.newInput(bh_type::INT64, rows), {rows});
+
+    append(f, BH_ADD_REDUCE, bh_type::FLOAT64, {cols}, {m}, int64_t(0));
+    append(f, BH_ADD_REDUCE, bh_type::FLOAT64, {rows}, {m}, int64_t(1));
+    append(f, BH_MAXIMUM_REDUCE, bh_type::INT32, {cols}, {mi}, int64_t(0));
+    append(f, BH_MINIMUM_REDUCE, bh_type::INT32, {rows}, {mi}, int64_t(1));
+    append(f, BH_BITWISE_XOR_REDUCE, bh_type::INT64, {rows}, {ml}, int64_t(1));
+    append(f, BH_BITWISE_OR_REDUCE, bh_type::INT64, {cols}, {ml}, int64_t(0));
+    append(f, BH_LOGICAL_OR_REDUCE, bh_type::BOOL, {rows}, {mb}, int64_t(1));
+    append(f, BH_LOGICAL_AND_REDUCE, bh_type::BOOL, {cols}, {mb}, int64_t(0));
+    append(f, BH_ADD_REDUCE, bh_type::FLOAT64, {5, 7}, {cube}, int64_t(1));
+    append(f, BH_MAXIMUM_REDUCE, bh_type::FLOAT64, {5, 6}, {cube}, int64_t(2));
+    append(f, BH_ADD_REDUCE, bh_type::INT64, {1}, {vec}, int64_t(0));
+    append(f, BH_MULTIPLY_REDUCE, bh_type::INT64, {1}, {make_view(vec.base, {5})}, int64_t(0));
+    append(f, BH_ADD_ACCUMULATE, bh_type::FLOAT64, {rows, cols}, {m}, int64_t(1));
+    append(f, BH_ADD_ACCUMULATE, bh_type::INT32, {rows, cols}, {mi}, int64_t(0));
+    append(f, BH_MULTIPLY_ACCUMULATE, bh_type::INT64, {5}, {make_view(vec.base, {5})}, int64_t(0));
+}
+
+// RANGE and the gathers and scatters using a permutation of the indexes
+void range_gather_scatter(Flush &f) {
+    const int64_t n = 97;
+    const bh_view a = make_view(f.newInput(bh_type::FLOAT64, n), {n});
+    append(f, BH_RANGE, bh_type::UINT64, {n}, {});
+    append(f, BH_RANGE, bh_type::INT32, {7, 9}, {});
+    const bh_view range = make_view(f.syncs[0], {n});
+
+    // The permutation 'idx = (range * 7) % n' and the mask 'a > 0'
+    bh_base *idx = f.newBase(bh_type::UINT64, n), *mask = f.newBase(bh_type::BOOL, n);
+    f.instrs.push_back(make_instr(BH_MULTIPLY, {make_view(idx, {n}), range}, uint64_t(7)));
+    f.instrs.push_back(make_instr(BH_MOD, {make_view(idx, {n}), make_view(idx, {n})}, uint64_t(n - 3)));
+    f.instrs.push_back(make_instr(BH_GREATER, {make_view(mask, {n}), a}, 0.0));
+
+    append(f, BH_GATHER, bh_type::FLOAT64, {n}, {a, make_view(idx, {n})});
+    // A gather from a view that starts at the fourth element
+    append(f, BH_GATHER, bh_type::FLOAT64, {n}, {make_view(a.base, {n - 3}, 3), make_view(idx, {n})});
+    append(f, BH_IDENTITY, bh_type::FLOAT64, {n}, {}, 0.0);
+    f.instrs.emplace_back(BH_SCATTER, vector<bh_view>{make_view(f.syncs.back(), {n}), a, make_view(idx, {n})});
+    append(f, BH_IDENTITY, bh_type::FLOAT64, {n}, {}, -1.0);
+    f.instrs.emplace_back(BH_COND_SCATTER, vector<bh_view>{make_view(f.syncs.back(), {n - 3}, 3), a,
+                                                           make_view(idx, {n}), make_view(mask, {n})});
+    f.instrs.push_back(make_free(idx));
+    f.instrs.push_back(make_free(mask));
+}
+
+// Views that start at non-zero offsets, have negative strides, are transposed, and broadcast
+void views(Flush &f) {
+    const int64_t n = 8;
+    bh_base *a = f.newInput(bh_type::FLOAT64, n * n);
+    const bh_view m = make_view(a, {n, n});
+    const bh_view flat = make_view(a, {n * n});
+    const bh_view reversed = make_view(a, {n * n}, n * n - 1, {-1});
+    const bh_view m_reversed = make_view(a, {n, n}, n * n - 1, {-n, -1});
+    const bh_view m_transposed = make_view(a, {n, n}, 0, {1, n});
+    const bh_type t = bh_type::FLOAT64;
+
+    append(f, BH_ADD, t, {n * n}, {flat, reversed});
+    append(f, BH_MULTIPLY, t, {n * n - 5}, {make_view(a, {n * n - 5}, 5), make_view(a, {n * n - 5}, 0)});
+    append(f, BH_SUBTRACT, t, {n, n}, {m, m_transposed});
+    append(f, BH_ADD, t, {n, n}, {m_reversed, make_view(a, {n, n}, n - 1, {-1, n})});
+    // Broadcasts of a row and a column
+    append(f, BH_SUBTRACT, t, {n, n}, {m, make_view(a, {n, n}, 3, {0, 1})});
+    append(f, BH_DIVIDE, t, {n, n}, {make_view(a, {n, n}, 2 * n, {1, 0}), m_transposed});
+    // Every second element backwards, starting at the last element
+    append(f, BH_MAXIMUM, t, {n * n / 2}, {make_view(a, {n * n / 2}, n * n - 1, {-2}),
+                                           make_view(a, {n * n / 2}, 1, {2})});
+    // Reductions of views with negative strides and views that are transposed
+    append(f, BH_ADD_REDUCE, t, {n}, {m_reversed}, int64_t(1));
+    append(f, BH_MINIMUM_REDUCE, t, {n}, {m_transposed}, int64_t(1));
+    append(f, BH_ADD_ACCUMULATE, t, {n, n}, {m_reversed}, int64_t(0));
+
+    // Outputs that start at non-zero offsets and have negative strides
+    bh_base *out = f.newSync(t, n * n + 3);
+    f.instrs.push_back(make_instr(BH_IDENTITY, {make_view(out, {n * n + 3})}, 0.0));
+    f.instrs.emplace_back(BH_IDENTITY, vector<bh_view>{make_view(out, {n * n}, n * n + 2, {-1}), flat});
+    f.instrs.emplace_back(BH_ADD, vector<bh_view>{make_view(out, {n, n / 2}, 1, {n, 2}),
+                                                  make_view(out, {n, n / 2}, 1, {n, 2}),
+                                                  make_view(a, {n, n / 2}, n * n - 1, {-n, -2})});
+}
+
+// Chains of operations where the intermediate arrays are temporary thus contracted by the fused kernels
+void contracted_temporaries(Flush &f) {
+    const int64_t rows = 16, cols = 33;
+    const bh_type t = bh_type::FLOAT64;
+    const bh_view a = make_view(f.newInput(t, rows * cols), {rows, cols});
+    const bh_view b = make_view(f.newInput(t, rows * cols), {rows, cols});
+
+    bh_base *t1 = f.newBase(t, rows * cols), *t2 = f.newBase(t, rows * cols), *t3 = f.newBase(t, rows * cols);
+    f.instrs.push_back(make_instr(BH_MULTIPLY, {make_view(t1, {rows, cols}), a}, 2.0));
+    f.instrs.emplace_back(BH_ADD, vector<bh_view>{make_view(t2, {rows, cols}), make_view(t1, {rows, cols}), b});
+    f.instrs.push_back(make_free(t1));
+    f.instrs.emplace_back(BH_SIN, vector<bh_view>{make_view(t3, {rows, cols}), make_view(t2, {rows, cols})});
+    f.instrs.push_back(make_free(t2));
+    append(f, BH_ADD, t, {rows, cols}, {make_view(t3, {rows, cols}), a});
+    // A reduction of a temporary array
+    append(f, BH_ADD_REDUCE, t, {rows}, {make_view(t3, {rows, cols})}, int64_t(1));
+    f.instrs.push_back(make_free(t3));
+
+    // A temporary integer array that is both written and read in place
+    bh_base *t4 = f.newBase(bh_type::INT64, rows * cols);
+    f.instrs.emplace_back(BH_IDENTITY, vector<bh_view>{make_view(t4, {rows, cols}), b});
+    f.instrs.push_back(make_instr(BH_MULTIPLY, {make_view(t4, {rows, cols}), make_view(t4, {rows, cols})},
+                                  int64_t(3)));
+    append(f, BH_MAXIMUM_REDUCE, bh_type::INT64, {cols}, {make_view(t4, {rows, cols})}, int64_t(0));
+    f.instrs.push_back(make_free(t4));
+}
+}
+
+int main() {
+    // The kernels must be compiled and executed rather than interpreted
+    setenv("BH_OPENMP_ASYNC_COMPILE", "false", 1);
+    setenv("BH_OPENMP_INTERPRETER_THRESHOLD", "0", 1);
+
+    try {
+        const unique_ptr<ConfigParser> config = find_component("openmp");
+        jitk::Statistics stat(false, *config);
+        EngineOpenMP engine(*config, stat);
+
+        test_flush(engine, *config, "float_elementwise", float_elementwise);
+        test_flush(engine, *config, "integer_elementwise", integer_elementwise);
+        test_flush(engine, *config, "reductions", reductions);
+        test_flush(engine, *config, "range_gather_scatter", range_gather_scatter);
+        test_flush(engine, *config, "views", views);
+        test_flush(engine, *config, "contracted_temporaries", contracted_temporaries, true);
+    } catch (const std::exception &e) {
+        cerr << "bh_test_jitk_interpreter: " << e.what() << endl;
+        return 1;
+    }
+    return report();
+}
@@ -0,0 +1,295 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* bh_test_jitk_kernel_store: tests of the persistent kernel store (the `cache_dir`).
+ *
+ * - Forked processes look up, compile (under the compile lock), and publish the same kernels concurrently.
+ * - A store recovers from an index that is truncated in the middle of a line.
+ * - The least recently used kernels are evicted when the store exceeds its size limits.
+ *
+ * Each test uses a new store in the temporary directory, which is removed afterwards.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <jitk/kernel_store.hpp>
+
+#include "util.hpp"
+
+using namespace bohrium;
+using namespace bohrium::test;
+using namespace std;
+namespace fs = boost::filesystem;
+
+namespace {
+
+// The content of the kernel 'filename', which makes torn or mixed up files detectable
+string content(const string &filename, size_t repeat = 100) {
+    string ret;
+    for (size_t i = 0; i < repeat; ++i) {
+        ret += filename + "\n";
+    }
+    return ret;
+}
+
+string read_file(const fs::path &path) {
+    ifstream file(path.string(), ifstream::binary);
+    stringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+void publish(jitk::KernelStore &store, const string &filename, size_t repeat = 100) {
+    const string data = content(filename, repeat);
+    store.publish(data.data(), data.size(), filename);
+}
+
+// Returns the kernels in the store at 'dir', which are the files except the index, locks, and temporary files
+set<string> kernel_files(const fs::path &dir) {
+    set<string> ret;
+    for (fs::directory_iterator it(dir), end; it != end; ++it) {
+        const string filename = it->path().filename().string();
+        if (fs::is_regular_file(it->path()) and filename[0] != '.' and filename != "index" and
+            filename != "index.lock") {
+            ret.insert(filename);
+        }
+    }
+    return ret;
+}
+
+// Returns the temporary files in the store at 'dir'
+set<string> tmp_files(const fs::path &dir) {
+    set<string> ret;
+    for (fs::directory_iterator it(dir), end; it != end; ++it) {
+        const string filename = it->path().filename().string();
+        if (filename[0] == '.') {
+            ret.insert(filename);
+        }
+    }
+    return ret;
+}
+
+// Returns the kernels in the index of the store at 'dir', which is well-formed after a compaction
+set<string> index_files(const fs::path &dir) {
+    set<string> ret;
+    ifstream file((dir / "index").string());
+    string filename;
+    uint64_t bytes, last_use;
+    while (file >> filename >> bytes >> last_use) {
+        ret.insert(filename);
+    }
+    return ret;
+}
+
+// Returns 'names' as a string, e.g. "{a, b}"
+string str(const set<string> &names) {
+    stringstream ss;
+    ss << "{";
+    for (auto it = names.begin(); it != names.end(); ++it) {
+        ss << (it == names.begin() ? "" : ", ") << *it;
+    }
+    ss << "}";
+    return ss.str();
+}
+
+/* The tests */
+
+// Processes that miss the same kernel at the same time compile it once like `EngineOpenMP::getFunction()`, and the
+// kernels they publish at the same time are never torn
+void concurrent_publish() {
+    const string name = "concurrent_publish";
+    const int num_procs = 8, num_kernels = 32;
+    TmpDir tmp;
+    const fs::path dir = tmp.path / "store";
+    const fs::path log = tmp.path / "compiled";
+
+    vector<pid_t> children;
+    for (int p = 0; p < num_procs; ++p) {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            int failures = 0;
+            {
+                jitk::KernelStore store(dir, -1, -1);
+                const int fd = ::open(log.string().c_str(), O_WRONLY | O_APPEND | O_CREAT, 0666);
+                for (int i = 0; i < num_kernels; ++i) {
+                    // The kernels that all processes compile, which they start in different orders
+                    const string shared = "shared" + to_string((i + p * 5) % num_kernels) + ".so";
+                    {
+                        const auto lock = store.lock(shared);
+                        if (not store.lookup(shared)) {
+                            publish(store, shared);
+                            const string line = shared + "\n";
+                            failures += write(fd, line.data(), line.size()) == static_cast<ssize_t>(line.size()) ? 0 : 1;
+                        }
+                    }
+                    failures += read_file(store.path(shared)) == content(shared) ? 0 : 1;
+
+                    // The kernels that all processes publish without the compile lock
+                    const string racy = "racy" + to_string(i % 4) + ".so";
+                    publish(store, racy);
+                    failures += read_file(store.path(racy)) == content(racy) ? 0 : 1;
+
+                    // The kernels of this process only
+                    publish(store, "proc" + to_string(p) + "_" + to_string(i) + ".so");
+                }
+                ::close(fd);
+            }
+            _exit(failures == 0 ? 0 : 1);
+        }
+        children.push_back(pid);
+    }
+    for (pid_t pid: children) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        check(WIFEXITED(status) and WEXITSTATUS(status) == 0, name, "a child process read a torn kernel");
+    }
+
+    // Each shared kernel was compiled exactly once
+    map<string, int> compiled;
+    {
+        ifstream file(log.string());
+        string filename;
+        while (file >> filename) {
+            ++compiled[filename];
+        }
+    }
+    check_equal(compiled.size(), num_kernels, name, "the number of compiled shared kernels");
+    for (const auto &kernel: compiled) {
+        check_equal(kernel.second, 1, name, "the number of compilations of " + kernel.first);
+    }
+
+    // All kernels are published in full and indexed
+    const set<string> files = kernel_files(dir);
+    check_equal(files.size(), num_kernels + 4 + num_procs * num_kernels, name, "the number of kernels");
+    for (const string &filename: files) {
+        check(read_file(dir / filename) == content(filename), name, filename + " is torn");
+    }
+    check(tmp_files(dir).empty(), name, "temporary files are left behind: " + str(tmp_files(dir)));
+    const set<string> indexed = index_files(dir);
+    check(indexed == files, name, "the index " + str(indexed) + " doesn't match the kernels");
+}
+
+// A store recovers from an index that is truncated in the middle of a line, e.g. when a process crashed while
+// appending to the index, and a line that another process appended right after the truncated line
+void truncated_index() {
+    const string name = "truncated_index";
+    TmpDir dir;
+    {
+        jitk::KernelStore store(dir.path, -1, -1);
+        for (int i = 0; i < 10; ++i) {
+            publish(store, "k" + to_string(i) + ".so");
+        }
+    }
+    // The last line of the index is truncated right after the first digit of the size of 'k9.so'
+    const fs::path index = dir.path / "index";
+    const string text = read_file(index);
+    const size_t last_line = text.rfind("k9.so ");
+    check(last_line != string::npos, name, "k9.so isn't in the index");
+    fs::resize_file(index, last_line + string("k9.so 1").size());
+
+    {
+        jitk::KernelStore store(dir.path, -1, -1);
+        publish(store, "k10.so"); // Its line is appended to the truncated line
+        publish(store, "k11.so");
+        for (int i = 0; i < 12; ++i) {
+            const string filename = "k" + to_string(i) + ".so";
+            check(store.lookup(filename), name, filename + " isn't found");
+        }
+    }
+    // A store that exceeds its limits compacts the index, which must cover all the kernels including the
+    // kernels of the torn line
+    {
+        jitk::KernelStore store(dir.path, 20, -1);
+        for (int i = 12; i < 22; ++i) {
+            publish(store, "k" + to_string(i) + ".so");
+        }
+    }
+    const set<string> files = kernel_files(dir.path);
+    const set<string> indexed = index_files(dir.path);
+    check_equal(files.size(), 20, name, "the number of kernels after the compaction");
+    check(indexed == files, name, "the index " + str(indexed) + " doesn't match the kernels " + str(files));
+}
+
+// The least recently used kernels are evicted when the store exceeds its limit of bytes or files
+void eviction() {
+    const string name = "eviction";
+    TmpDir dir;
+    const size_t repeat = 200; // Each kernel is 200 lines of 5 bytes
+    const uint64_t kernel_bytes = content("k0.so", repeat).size();
+    {
+        // Ten kernels that were used long ago, 'k0.so' first and 'k9.so' last
+        ofstream file((dir.path / "index").string());
+        for (int i = 0; i < 10; ++i) {
+            const string filename = "k" + to_string(i) + ".so";
+            ofstream((dir.path / filename).string(), ofstream::binary) << content(filename, repeat);
+            file << filename << " " << kernel_bytes << " " << 1000 + i << "\n";
+        }
+    }
+
+    // A new kernel exceeds the limit of five and a half kernels thus the six oldest kernels are evicted
+    {
+        jitk::KernelStore store(dir.path, -1, kernel_bytes * 11 / 2);
+        publish(store, "n0.so", repeat);
+    }
+    set<string> expect = {"k6.so", "k7.so", "k8.so", "k9.so", "n0.so"};
+    check(kernel_files(dir.path) == expect, name, "the kernels are " + str(kernel_files(dir.path)) + " but should be " +
+                                                  str(expect));
+    check(index_files(dir.path) == expect, name, "the index is " + str(index_files(dir.path)));
+
+    // A lookup makes 'k6.so' the most recently used thus 'k7.so', 'k8.so', and 'k9.so' are evicted when
+    // a new kernel exceeds the limit of three kernels
+    {
+        jitk::KernelStore store(dir.path, -1, -1);
+        check(store.lookup("k6.so"), name, "k6.so isn't found");
+        check(not store.lookup("k0.so"), name, "the evicted k0.so is found");
+    }
+    {
+        jitk::KernelStore store(dir.path, 3, -1);
+        publish(store, "n1.so", repeat);
+    }
+    expect = {"k6.so", "n0.so", "n1.so"};
+    check(kernel_files(dir.path) == expect, name, "the kernels are " + str(kernel_files(dir.path)) + " but should be " +
+                                                  str(expect));
+    check(index_files(dir.path) == expect, name, "the index is " + str(index_files(dir.path)));
+}
+}
+
+int main() {
+    try {
+        concurrent_publish();
+        truncated_index();
+        eviction();
+    } catch (const std::exception &e) {
+        cerr << "bh_test_jitk_kernel_store: " << e.what() << endl;
+        return 1;
+    }
+    return report();
+}
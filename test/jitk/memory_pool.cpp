@@ -0,0 +1,203 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* bh_test_jitk_memory_pool: tests of the memory pool of `bh_memory_malloc()` and `bh_memory_free()`.
+ *
+ * - Freed blocks are reused by allocations of the same number of pages only.
+ * - The pool retains at most `memory_pool_max` bytes.
+ * - The blocks that exceed `memory_pool_trim` bytes are trimmed, and reused blocks keep their content otherwise.
+ * - The profiling statistics report the counters of the pool.
+ *
+ * The pool is shared by the whole process thus the tests check the changes of the counters.
+ */
+
+#include <unistd.h>
+
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include <bh_config_parser.hpp>
+#include <bh_memory.h>
+#include <jitk/statistics.hpp>
+
+#include "util.hpp"
+
+using namespace bohrium;
+using namespace bohrium::test;
+using namespace std;
+
+namespace {
+
+const int64_t page = sysconf(_SC_PAGESIZE);
+
+// Configure and empty the pool
+void reset_pool(int64_t max_bytes, int64_t trim_bytes) {
+    bh_memory_pool_config(0, -1);
+    bh_memory_pool_config(max_bytes, trim_bytes);
+}
+
+/* The tests */
+
+// A freed block is reused by an allocation that maps the same number of pages only
+void size_classes() {
+    const string name = "size_classes";
+    reset_pool(16 * page, -1);
+    const bh_memory_pool_stats before = bh_memory_pool_get_stats();
+
+    void *a = bh_memory_malloc(3 * page - 100);
+    bh_memory_free(a, 3 * page - 100);
+    check_equal(bh_memory_pool_get_stats().bytes_retained, 3 * page, name, "the retained bytes");
+
+    // Neither fewer nor more pages reuse the block
+    void *b = bh_memory_malloc(2 * page);
+    void *c = bh_memory_malloc(3 * page + 1);
+    check(b != a and c != a, name, "a block of another size class is reused");
+
+    void *d = bh_memory_malloc(3 * page);
+    check(d == a, name, "the block of the same size class isn't reused");
+
+    const bh_memory_pool_stats after = bh_memory_pool_get_stats();
+    check_equal(after.hits - before.hits, 1, name, "the number of hits");
+    check_equal(after.misses - before.misses, 3, name, "the number of misses");
+    check_equal(after.bytes_retained, 0, name, "the retained bytes after the reuse");
+    check_equal(after.max_bytes_retained, 3 * page, name, "the maximum retained bytes");
+
+    bh_memory_free(b, 2 * page);
+    bh_memory_free(c, 3 * page + 1);
+    bh_memory_free(d, 3 * page);
+    check_equal(bh_memory_pool_get_stats().bytes_retained, 9 * page, name, "the retained bytes after the frees");
+}
+
+// The pool retains at most `max_bytes` thus the blocks that don't fit are unmapped
+void max_bytes() {
+    const string name = "max_bytes";
+    reset_pool(16 * page, -1);
+    const bh_memory_pool_stats before = bh_memory_pool_get_stats();
+
+    void *a = bh_memory_malloc(10 * page);
+    void *b = bh_memory_malloc(10 * page);
+    void *c = bh_memory_malloc(6 * page);
+    bh_memory_free(a, 10 * page);
+    bh_memory_free(b, 10 * page); // Doesn't fit
+    bh_memory_free(c, 6 * page);
+    check_equal(bh_memory_pool_get_stats().bytes_retained, 16 * page, name, "the retained bytes");
+
+    // Only one of the two blocks of ten pages is reused
+    void *d = bh_memory_malloc(10 * page);
+    void *e = bh_memory_malloc(10 * page);
+    check(d == a, name, "the retained block isn't reused");
+    check(e != a, name, "the retained block is reused twice");
+    const bh_memory_pool_stats after = bh_memory_pool_get_stats();
+    check_equal(after.hits - before.hits, 1, name, "the number of hits");
+    check_equal(after.misses - before.misses, 4, name, "the number of misses");
+    check_equal(after.bytes_retained, 6 * page, name, "the retained bytes after the reuse");
+    check_equal(after.max_bytes_retained, 16 * page, name, "the maximum retained bytes");
+    bh_memory_free(d, 10 * page);
+    bh_memory_free(e, 10 * page);
+
+    // Disabling the pool releases the retained blocks
+    bh_memory_pool_config(0, -1);
+    check_equal(bh_memory_pool_get_stats().bytes_retained, 0, name, "the retained bytes of a disabled pool");
+    void *f = bh_memory_malloc(6 * page);
+    bh_memory_free(f, 6 * page);
+    check_equal(bh_memory_pool_get_stats().bytes_retained, 0, name, "the retained bytes of a disabled pool");
+}
+
+// The blocks beyond the first `trim_bytes` in the pool are trimmed whereas the untrimmed blocks keep their content
+void trimming() {
+    const string name = "trimming";
+    reset_pool(16 * page, 4 * page);
+
+    void *blocks[3];
+    for (int i = 0; i < 3; ++i) {
+        blocks[i] = bh_memory_malloc(2 * page);
+        memset(blocks[i], i + 1, 2 * page);
+    }
+    for (void *block: blocks) {
+        bh_memory_free(block, 2 * page);
+    }
+    bh_memory_pool_stats stats = bh_memory_pool_get_stats();
+    check_equal(stats.bytes_retained, 6 * page, name, "the retained bytes");
+    check_equal(stats.bytes_trimmed, 2 * page, name, "the trimmed bytes");
+
+    // The last freed block is reused first, which is the trimmed block. When freed again, it is trimmed again
+    // since the two untrimmed blocks are still in the pool.
+    void *a = bh_memory_malloc(2 * page);
+    check(a == blocks[2], name, "the last freed block isn't reused first");
+    check_equal(bh_memory_pool_get_stats().bytes_trimmed, 0, name, "the trimmed bytes after reusing the trimmed block");
+    bh_memory_free(a, 2 * page);
+    check_equal(bh_memory_pool_get_stats().bytes_trimmed, 2 * page, name, "the trimmed bytes after the free");
+
+    // Reusing an untrimmed block leaves room for an untrimmed block
+    a = bh_memory_malloc(2 * page);
+    void *b = bh_memory_malloc(2 * page);
+    check(b == blocks[1], name, "the untrimmed block isn't reused");
+    bool content = true;
+    for (int64_t i = 0; i < 2 * page; ++i) {
+        content = content and static_cast<char *>(b)[i] == 2;
+    }
+    check(content, name, "the untrimmed block lost its content");
+    bh_memory_free(a, 2 * page);
+    stats = bh_memory_pool_get_stats();
+    check_equal(stats.bytes_retained, 4 * page, name, "the retained bytes after the reuse");
+    check_equal(stats.bytes_trimmed, 0, name, "the trimmed bytes after the reuse");
+    bh_memory_free(b, 2 * page);
+
+    // Without trimming, no block is trimmed
+    reset_pool(16 * page, -1);
+    for (int i = 0; i < 3; ++i) {
+        blocks[i] = bh_memory_malloc(2 * page);
+    }
+    for (void *block: blocks) {
+        bh_memory_free(block, 2 * page);
+    }
+    check_equal(bh_memory_pool_get_stats().bytes_trimmed, 0, name, "the trimmed bytes when trimming is disabled");
+}
+
+// The profiling statistics report the counters of the pool
+void statistics(const ConfigParser &config) {
+    const string name = "statistics";
+    reset_pool(16 * page, -1);
+    void *a = bh_memory_malloc(page);
+    bh_memory_free(a, page);
+    a = bh_memory_malloc(page);
+
+    jitk::Statistics stat(true, config);
+    stringstream ss;
+    stat.pprint("test", ss);
+    const bh_memory_pool_stats pool = bh_memory_pool_get_stats();
+    check_equal(stat.memory_pool_hits, pool.hits, name, "the hits");
+    check_equal(stat.memory_pool_misses, pool.misses, name, "the misses");
+    check_equal(stat.memory_pool_retained, pool.bytes_retained, name, "the retained bytes");
+    check_equal(stat.memory_pool_max_retained, pool.max_bytes_retained, name, "the maximum retained bytes");
+    check(ss.str().find("Memory pool hits:") != string::npos, name, "the hits aren't printed");
+    bh_memory_free(a, page);
+}
+}
+
+int main() {
+    const ConfigParser config(0);
+    size_classes();
+    max_bytes();
+    trimming();
+    statistics(config);
+    return report();
+}
@@ -0,0 +1,211 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* bh_test_jitk_persistent_cache: tests of the persistent fuse and codegen caches.
+ *
+ * The caches save their entries in a kernel store, which new caches of a later process (a new store of the same
+ * directory) load. The loaded entries must give the same block list and source as the saved entries, and entries
+ * saved with another salt (another configuration) must never be loaded.
+ *
+ * The config of the first component in the current stack is used (see BH_STACK and BH_CONFIG).
+ */
+
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <bh_config_parser.hpp>
+#include <jitk/apply_fusion.hpp>
+#include <jitk/codegen_cache.hpp>
+#include <jitk/codegen_util.hpp>
+#include <jitk/fuser_cache.hpp>
+#include <jitk/kernel_store.hpp>
+
+#include "util.hpp"
+
+using namespace bohrium;
+using namespace bohrium::test;
+using namespace std;
+
+namespace {
+
+// A flush of new arrays where 'value' is the value of the constants. The flush has a temporary array, a reduction,
+// and views with a non-zero start and a negative stride.
+class Flush {
+public:
+    static constexpr int64_t n = 100;
+    bh_base x, t, m, r, y;
+    vector<bh_instruction> instrs;
+
+    explicit Flush(double value) {
+        for (bh_base *base: {&x, &t, &m, &r, &y}) {
+            base->type = bh_type::FLOAT64;
+            base->nelem = n;
+            base->data = nullptr;
+        }
+        m.nelem = n * n;
+        instrs = {
+            make_instr(BH_MULTIPLY, {make_view(&t, {n}), make_view(&x, {n})}, value),
+            make_instr(BH_ADD_REDUCE, {make_view(&r, {n}), make_view(&m, {n, n})}, int64_t(1)),
+            bh_instruction(BH_ADD, {make_view(&y, {n - 1}), make_view(&t, {n - 1}, 1),
+                                    make_view(&r, {n - 1}, n - 1, {-1})}),
+            make_free(&t),
+            make_free(&r),
+            make_instr(BH_SUBTRACT, {make_view(&y, {n / 2}, 0, {2}), make_view(&y, {n / 2}, 1, {2})}, value)
+        };
+    }
+
+    Flush(const Flush &) = delete;
+
+    // Returns the fused block list of this flush using 'fcache'
+    vector<jitk::Block> fuse(const ConfigParser &config, jitk::FuseCache &fcache, jitk::Statistics &stat) {
+        vector<bh_instruction *> instr_list;
+        for (bh_instruction &instr: instrs) {
+            instr_list.push_back(&instr);
+        }
+        jitk::util_set_constructor_flag(instr_list, set<bh_base *>{&x, &m});
+        return jitk::get_block_list(instr_list, config, fcache, stat, false);
+    }
+};
+
+string str(const vector<jitk::Block> &block_list) {
+    stringstream ss;
+    ss << block_list;
+    return ss.str();
+}
+
+// Returns the symbol table of 'block_list' like `EngineCPU::handleExecution()`
+jitk::SymbolTable symbols_of(const vector<jitk::Block> &block_list) {
+    vector<jitk::InstrPtr> all_instr;
+    set<bh_base *> all_non_temps;
+    for (const jitk::Block &block: block_list) {
+        block.getAllInstr(all_instr);
+        block.getLoop().getAllNonTemps(all_non_temps);
+    }
+    return jitk::SymbolTable(all_instr, all_non_temps, false, true, true, true);
+}
+
+/* The tests */
+
+// A fuse cache entry saved by one process is loaded by a later process where the flush has new arrays and constants
+void fuse_cache(const ConfigParser &config) {
+    const string name = "fuse_cache";
+    const uint64_t salt = 42;
+    TmpDir dir;
+    {
+        jitk::Statistics stat(false, config);
+        jitk::KernelStore store(dir.path, -1, -1);
+        jitk::FuseCache fcache(stat);
+        fcache.persist(store, salt);
+        Flush flush(1.0);
+        flush.fuse(config, fcache, stat);
+        check_equal(stat.fuser_cache_misses, 1, name, "the number of misses of the first process");
+    }
+
+    // The expected block list is the block list of a cache that isn't persistent
+    Flush flush(2.0);
+    string expect;
+    {
+        jitk::Statistics stat(false, config);
+        jitk::FuseCache fcache(stat);
+        expect = str(flush.fuse(config, fcache, stat));
+    }
+
+    jitk::Statistics stat(false, config);
+    jitk::KernelStore store(dir.path, -1, -1);
+    jitk::FuseCache fcache(stat);
+    fcache.persist(store, salt);
+    const string loaded = str(flush.fuse(config, fcache, stat));
+    check_equal(stat.fuser_cache_misses, 0, name, "the number of misses of the second process");
+    check_equal(stat.fuser_cache_loads, 1, name, "the number of loads of the second process");
+    check(loaded == expect, name, "the loaded block list:\n" + loaded + "\nshould be:\n" + expect);
+
+    // The second lookup hits the entry in memory
+    const string cached = str(flush.fuse(config, fcache, stat));
+    check_equal(stat.fuser_cache_loads, 1, name, "the number of loads after the second lookup");
+    check(cached == expect, name, "the cached block list:\n" + cached + "\nshould be:\n" + expect);
+
+    // Another configuration misses the entry
+    jitk::Statistics other_stat(false, config);
+    jitk::FuseCache other(other_stat);
+    other.persist(store, salt + 1);
+    const string fused = str(flush.fuse(config, other, other_stat));
+    check_equal(other_stat.fuser_cache_misses, 1, name, "the number of misses of another salt");
+    check_equal(other_stat.fuser_cache_loads, 0, name, "the number of loads of another salt");
+    check(fused == expect, name, "the fused block list:\n" + fused + "\nshould be:\n" + expect);
+}
+
+// A codegen cache entry saved by one process is loaded by a later process
+void codegen_cache(const ConfigParser &config) {
+    const string name = "codegen_cache";
+    const uint64_t salt = 42;
+    const string source = "// The source of the kernel\n";
+    TmpDir dir;
+    uint64_t codegen_hash;
+    {
+        jitk::Statistics stat(false, config);
+        jitk::KernelStore store(dir.path, -1, -1);
+        jitk::FuseCache fcache(stat);
+        jitk::CodegenCache cache(stat);
+        cache.persist(store, salt);
+        Flush flush(1.0);
+        const vector<jitk::Block> block_list = flush.fuse(config, fcache, stat);
+        const jitk::SymbolTable symbols = symbols_of(block_list);
+        const auto lookup = cache.get(block_list, symbols);
+        check(lookup.first == nullptr, name, "the first process hits");
+        codegen_hash = lookup.second;
+        cache.insert(source, block_list, symbols);
+    }
+
+    jitk::Statistics stat(false, config);
+    jitk::KernelStore store(dir.path, -1, -1);
+    jitk::FuseCache fcache(stat);
+    Flush flush(2.0);
+    const vector<jitk::Block> block_list = flush.fuse(config, fcache, stat);
+    const jitk::SymbolTable symbols = symbols_of(block_list);
+    {
+        jitk::CodegenCache cache(stat);
+        cache.persist(store, salt);
+        const auto lookup = cache.get(block_list, symbols);
+        check(lookup.first != nullptr and *lookup.first == source, name, "the loaded source is wrong");
+        check_equal(lookup.second, codegen_hash, name, "the codegen hash of the loaded source");
+        check_equal(stat.codegen_cache_loads, 1, name, "the number of loads of the second process");
+
+        // Another variant of the kernel misses the entry
+        check(cache.get(block_list, symbols, 1).first == nullptr, name, "another variant hits");
+    }
+    {
+        // Another configuration misses the entry
+        jitk::CodegenCache cache(stat);
+        cache.persist(store, salt + 1);
+        check(cache.get(block_list, symbols).first == nullptr, name, "another salt hits");
+        check_equal(stat.codegen_cache_loads, 1, name, "the number of loads of another salt");
+    }
+}
+}
+
+int main() {
+    const ConfigParser config(0);
+    fuse_cache(config);
+    codegen_cache(config);
+    return report();
+}
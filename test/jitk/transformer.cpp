@@ -0,0 +1,404 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* bh_test_jitk_transformer: tests of the transformers that restructure the loops of a block.
+ *
+ * - `tile()` splits the second dimension of a stencil into an outermost loop over tiles and a loop within a tile,
+ *   and gives the columns that don't fill a tile a block of their own.
+ * - `push_unit_strides_inwards()` makes the dimension where most bytes are moved with unit stride the innermost loop,
+ *   e.g. of `a.T + b.T`, and keeps the order of the other loops.
+ *
+ * The transformed blocks must have the expected loops and views, and they must compute the same elements as the
+ * original block, i.e. each instruction accesses the same tuples of elements. Blocks that the transformers don't
+ * apply to, e.g. blocks with sweeps or sliding views, must be left alone.
+ */
+
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <jitk/block.hpp>
+#include <jitk/transformer.hpp>
+
+#include "util.hpp"
+
+using namespace bohrium;
+using namespace bohrium::test;
+using namespace std;
+
+namespace {
+
+// The base arrays of a test, which are float64 arrays of 'nelem' elements
+class Bases {
+public:
+    bh_base *operator()(int64_t nelem) {
+        _bases.emplace_back(new bh_base());
+        _bases.back()->type = bh_type::FLOAT64;
+        _bases.back()->nelem = nelem;
+        _bases.back()->data = nullptr;
+        return _bases.back().get();
+    }
+
+private:
+    vector<unique_ptr<bh_base> > _bases;
+};
+
+// Returns the block of the perfect loop nest of 'instrs'
+jitk::Block block_of(const vector<bh_instruction> &instrs) {
+    vector<jitk::InstrPtr> instr_list;
+    for (const bh_instruction &instr: instrs) {
+        instr_list.push_back(make_shared<bh_instruction>(instr));
+    }
+    return jitk::create_nested_block(instr_list);
+}
+
+// Returns a copy of 'view' that slides one element along the first dimension each iteration
+bh_view sliding(bh_view view) {
+    view.slide = {1};
+    view.slide_dim = {0};
+    view.slide_dim_shape_change = {0};
+    view.slide_dim_stride = {view.stride[0]};
+    view.slide_dim_shape = {view.shape[0]};
+    return view;
+}
+
+string str(const vector<jitk::Block> &block_list) {
+    stringstream ss;
+    ss << block_list;
+    return ss.str();
+}
+
+// Returns the sizes of the loops of 'block' from the outermost loop to the innermost loop
+vector<int64_t> loop_sizes(const jitk::Block &block) {
+    vector<int64_t> ret;
+    const jitk::Block *b = &block;
+    while (not b->isInstr()) {
+        ret.push_back(b->getLoop().size);
+        b = &b->getLoop()._block_list[0];
+    }
+    return ret;
+}
+
+string str(const vector<int64_t> &sizes) {
+    stringstream ss;
+    ss << "(";
+    for (int64_t size: sizes) {
+        ss << size << ",";
+    }
+    ss << ")";
+    return ss.str();
+}
+
+// Returns the element offsets of 'view' in row-major order of its dimensions
+vector<int64_t> offsets(const bh_view &view) {
+    vector<int64_t> ret{view.start};
+    for (int64_t d = 0; d < view.ndim; ++d) {
+        vector<int64_t> next;
+        for (int64_t offset: ret) {
+            for (int64_t i = 0; i < view.shape[d]; ++i) {
+                next.push_back(offset + i * view.stride[d]);
+            }
+        }
+        ret = std::move(next);
+    }
+    return ret;
+}
+
+// Returns the tuples of elements that each instruction of 'block_list' accesses, i.e. the element offsets of
+// the operands of each iteration. An instruction that is split over several blocks gets the tuples of all blocks.
+vector<set<vector<int64_t> > > accesses(const vector<jitk::Block> &block_list) {
+    vector<set<vector<int64_t> > > ret;
+    for (const jitk::Block &block: block_list) {
+        const vector<jitk::InstrPtr> instr_list = block.getAllInstr();
+        ret.resize(max(ret.size(), instr_list.size()));
+        for (size_t i = 0; i < instr_list.size(); ++i) {
+            vector<vector<int64_t> > operands;
+            for (const bh_view &view: instr_list[i]->operand) {
+                if (not bh_is_constant(&view)) {
+                    operands.push_back(offsets(view));
+                }
+            }
+            for (size_t j = 0; j < operands[0].size(); ++j) {
+                vector<int64_t> tuple;
+                for (const vector<int64_t> &operand: operands) {
+                    tuple.push_back(operand[j]);
+                }
+                ret[i].insert(tuple);
+            }
+        }
+    }
+    return ret;
+}
+
+// Check that the transformed 'block_list' computes the same elements as 'original'
+void check_accesses(const vector<jitk::Block> &block_list, const jitk::Block &original, const string &name) {
+    check(accesses(block_list) == accesses({original}), name, "the transformed blocks compute other elements");
+}
+
+/* The tests of `tile()` */
+
+// A 2D stencil of the 'n' x 'n' array 'x' where 'y' is the output and 't' is a temporary array
+vector<bh_instruction> stencil(Bases &bases, int64_t n, bh_base **t = nullptr) {
+    bh_base *x = bases(n * n);
+    bh_base *y = bases(n * n);
+    bh_base *tmp = bases((n - 2) * (n - 2));
+    if (t != nullptr) {
+        *t = tmp;
+    }
+    const int64_t m = n - 2;
+    vector<bh_instruction> ret = {
+        bh_instruction(BH_ADD, {make_view(tmp, {m, m}), make_view(x, {m, m}, 1, {n, 1}),
+                                make_view(x, {m, m}, 2 * n + 1, {n, 1})}),
+        bh_instruction(BH_ADD, {make_view(y, {m, m}, n + 1, {n, 1}), make_view(tmp, {m, m}),
+                                make_view(x, {m, m}, n, {n, 1})}),
+        make_free(tmp)
+    };
+    ret[0].constructor = true;
+    return ret;
+}
+
+// The second dimension of a stencil is split into tiles, and the rest of the columns get a block of their own
+void tile_stencil() {
+    const string name = "tile_stencil";
+    const int64_t n = 100, m = n - 2;
+    Bases bases;
+    bh_base *t;
+    const jitk::Block original = block_of(stencil(bases, n, &t));
+    // The tiles are 32 columns when three rows of the tiles of 'x' and 'y' fit in the cache
+    const uint64_t cache_bytes = 3 * 32 * 2 * 8;
+    vector<jitk::Block> block_list{original};
+    jitk::tile(block_list, cache_bytes);
+
+    check_equal(block_list.size(), 2, name, "the number of blocks");
+    if (block_list.size() != 2) {
+        return;
+    }
+    const vector<int64_t> tiled_sizes{m / 32, m, 32}, rest_sizes{m, m % 32};
+    check(loop_sizes(block_list[0]) == tiled_sizes, name, "the loops of the tiles are " +
+                                                          str(loop_sizes(block_list[0])));
+    check(loop_sizes(block_list[1]) == rest_sizes, name, "the loops of the rest are " + str(loop_sizes(block_list[1])));
+
+    // The view of a tile steps 32 columns between the tiles
+    const bh_view &view = block_list[0].getAllInstr()[0]->operand[2];
+    check(view.ndim == 3 and view.start == 2 * n + 1 and view.stride[0] == 32 and view.stride[1] == n and
+          view.stride[2] == 1 and view.shape[2] == 32, name, "the tiled view is " + view.pprint(false));
+    const bh_view &rest = block_list[1].getAllInstr()[0]->operand[2];
+    check(rest.ndim == 2 and rest.start == 2 * n + 1 + m / 32 * 32 and rest.shape[1] == m % 32, name,
+          "the view of the rest is " + rest.pprint(false));
+
+    // Both blocks free the temporary array, which thus stays temporary in both
+    for (const jitk::Block &block: block_list) {
+        check(block.getLoop().getAllTemps().count(t) == 1, name, "the temporary array isn't temporary in all blocks");
+    }
+    check_accesses(block_list, original, name);
+}
+
+// Columns that fill all tiles need no block of their own, and the number of tiles is at least 'min_tiles'
+void tile_exact() {
+    const string name = "tile_exact";
+    const int64_t n = 66, m = n - 2;
+    Bases bases;
+    const jitk::Block original = block_of(stencil(bases, n));
+    for (uint64_t min_tiles: {1, 4}) {
+        vector<jitk::Block> block_list{original};
+        jitk::tile(block_list, 3 * 32 * 2 * 8, min_tiles);
+
+        check_equal(block_list.size(), 1, name, "the number of blocks");
+        const int64_t tile_size = min_tiles == 1 ? 32 : m / 4;
+        const vector<int64_t> sizes{m / tile_size, m, tile_size};
+        check(loop_sizes(block_list[0]) == sizes, name, "the loops of the tiles are " +
+                                                        str(loop_sizes(block_list[0])));
+        check_accesses(block_list, original, name);
+    }
+}
+
+// Blocks that don't reuse rows, whose rows fit in the cache, or that have sweeps or sliding views are left alone
+void tile_left_alone() {
+    const string name = "tile_left_alone";
+    const int64_t n = 100, m = n - 2;
+    const uint64_t cache_bytes = 3 * 32 * 2 * 8;
+    Bases bases;
+    bh_base *x = bases(n * n);
+    bh_base *y = bases(n * n);
+    bh_base *r = bases(n);
+
+    vector<pair<string, vector<bh_instruction> > > cases;
+    cases.emplace_back("no reuse", vector<bh_instruction>{
+        make_instr(BH_ADD, {make_view(y, {n, n}), make_view(x, {n, n})}, 1.0)
+    });
+    cases.emplace_back("a sweep", vector<bh_instruction>{
+        bh_instruction(BH_ADD, {make_view(y, {m, m}), make_view(x, {m, m}, 1, {n, 1}),
+                                make_view(x, {m, m}, 2 * n + 1, {n, 1})}),
+        make_instr(BH_ADD_REDUCE, {make_view(r, {m}), make_view(y, {m, m})}, int64_t(1))
+    });
+    vector<bh_instruction> slides = stencil(bases, n);
+    slides[0].operand[1] = sliding(slides[0].operand[1]);
+    cases.emplace_back("a sliding view", slides);
+
+    for (const auto &c: cases) {
+        const vector<jitk::Block> original{block_of(c.second)};
+        vector<jitk::Block> block_list = original;
+        jitk::tile(block_list, cache_bytes);
+        check(str(block_list) == str(original), name, "the block with " + c.first + " is tiled");
+    }
+
+    // A stencil whose rows fit in the cache
+    const vector<jitk::Block> original{block_of(stencil(bases, n))};
+    vector<jitk::Block> block_list = original;
+    jitk::tile(block_list, 1 << 20);
+    check(str(block_list) == str(original), name, "the stencil that fits in the cache is tiled");
+}
+
+/* The tests of `push_unit_strides_inwards()` */
+
+// Returns the transposed view of the 'shape[1]' x 'shape[0]' array 'base' thus the view has unit stride
+// in the first dimension
+bh_view transposed(bh_base *base, const vector<int64_t> &shape) {
+    return make_view(base, shape, 0, {1, shape[0]});
+}
+
+// The loops of `c = a.T + b.T` are interchanged, which makes the views of 'a' and 'b' unit stride in the innermost
+// loop, whereas `c = a.T + b` keeps its loops since 'b' and 'c' are unit stride in the innermost loop already
+void unit_strides_transposed() {
+    const string name = "unit_strides_transposed";
+    const int64_t r = 6, s = 10;
+    Bases bases;
+    bh_base *a = bases(r * s);
+    bh_base *b = bases(r * s);
+    bh_base *c = bases(r * s);
+    {
+        const jitk::Block original = block_of({
+            bh_instruction(BH_ADD, {make_view(c, {r, s}), transposed(a, {r, s}), transposed(b, {r, s})})
+        });
+        vector<jitk::Block> block_list{original};
+        jitk::push_unit_strides_inwards(block_list);
+
+        check_equal(block_list.size(), 1, name, "the number of blocks");
+        const vector<int64_t> sizes{s, r};
+        check(loop_sizes(block_list[0]) == sizes, name, "the loops are " + str(loop_sizes(block_list[0])));
+        const bh_instruction &instr = *block_list[0].getAllInstr()[0];
+        check(instr.operand[1].stride[1] == 1 and instr.operand[2].stride[1] == 1, name,
+              "the innermost loop of a.T + b.T has stride " + to_string(instr.operand[1].stride[1]));
+        check(instr.operand[0].stride[0] == 1 and instr.operand[0].stride[1] == s, name,
+              "the output is " + instr.operand[0].pprint(false));
+        check_accesses(block_list, original, name);
+    }
+    {
+        const vector<jitk::Block> original{block_of({
+            bh_instruction(BH_ADD, {make_view(c, {r, s}), transposed(a, {r, s}), make_view(b, {r, s})})
+        })};
+        vector<jitk::Block> block_list = original;
+        jitk::push_unit_strides_inwards(block_list);
+        check(str(block_list) == str(original), name, "the loops of a.T + b are interchanged");
+    }
+}
+
+// The unit stride dimension of a 3D nest becomes innermost whereas the other two loops keep their order
+void unit_strides_3d() {
+    const string name = "unit_strides_3d";
+    const int64_t p = 4, q = 5, r = 6;
+    Bases bases;
+    bh_base *a = bases(p * q * r);
+    bh_base *b = bases(p * q * r);
+    // 'a' and 'b' are column-major arrays
+    const vector<int64_t> shape{p, q, r}, column_major{1, p, p * q};
+    const jitk::Block original = block_of({
+        bh_instruction(BH_MULTIPLY, {make_view(a, shape, 0, column_major), make_view(a, shape, 0, column_major),
+                                     make_view(b, shape, 0, column_major)})
+    });
+    vector<jitk::Block> block_list{original};
+    jitk::push_unit_strides_inwards(block_list);
+
+    const vector<int64_t> sizes{q, r, p};
+    check(loop_sizes(block_list[0]) == sizes, name, "the loops are " + str(loop_sizes(block_list[0])));
+    const bh_view &view = block_list[0].getAllInstr()[0]->operand[0];
+    check(view.stride[0] == p and view.stride[1] == p * q and view.stride[2] == 1, name,
+          "the output is " + view.pprint(false));
+    check_accesses(block_list, original, name);
+}
+
+// Temporary arrays never reach memory thus only the bytes of 'a' and 'c' count, which are unit stride in
+// the outer loop, although the many views of the temporary arrays are unit stride in the inner loop
+void unit_strides_temps() {
+    const string name = "unit_strides_temps";
+    const int64_t r = 6, s = 10;
+    Bases bases;
+    bh_base *a = bases(r * s);
+    bh_base *c = bases(r * s);
+    bh_base *t = bases(r * s);
+    bh_base *u = bases(r * s);
+    vector<bh_instruction> instrs = {
+        make_instr(BH_MULTIPLY, {make_view(t, {r, s}), transposed(a, {r, s})}, 2.0),
+        bh_instruction(BH_MULTIPLY, {make_view(u, {r, s}), make_view(t, {r, s}), make_view(t, {r, s})}),
+        bh_instruction(BH_ADD, {transposed(c, {r, s}), make_view(u, {r, s}), make_view(t, {r, s})}),
+        make_free(t),
+        make_free(u)
+    };
+    instrs[0].constructor = true;
+    instrs[1].constructor = true;
+    const jitk::Block original = block_of(instrs);
+    vector<jitk::Block> block_list{original};
+    jitk::push_unit_strides_inwards(block_list);
+
+    const vector<int64_t> sizes{s, r};
+    check(loop_sizes(block_list[0]) == sizes, name, "the loops are " + str(loop_sizes(block_list[0])));
+    check(block_list[0].getLoop().getAllTemps() == set<bh_base *>({t, u}), name,
+          "the temporary arrays aren't temporary after the interchange");
+    check_accesses(block_list, original, name);
+}
+
+// Blocks with sweeps or sliding views are left alone
+void unit_strides_left_alone() {
+    const string name = "unit_strides_left_alone";
+    const int64_t r = 6, s = 10;
+    Bases bases;
+    bh_base *a = bases(r * s);
+    bh_base *b = bases(r * s);
+    bh_base *c = bases(r * s);
+
+    vector<pair<string, vector<bh_instruction> > > cases;
+    cases.emplace_back("a sweep", vector<bh_instruction>{
+        make_instr(BH_ADD_REDUCE, {make_view(c, {r}), transposed(a, {r, s})}, int64_t(1))
+    });
+    cases.emplace_back("a sliding view", vector<bh_instruction>{
+        bh_instruction(BH_ADD, {make_view(c, {r, s}), sliding(transposed(a, {r, s})), transposed(b, {r, s})})
+    });
+    for (const auto &cs: cases) {
+        const vector<jitk::Block> original{block_of(cs.second)};
+        vector<jitk::Block> block_list = original;
+        jitk::push_unit_strides_inwards(block_list);
+        check(str(block_list) == str(original), name, "the loops of the block with " + cs.first +
+                                                      " are interchanged");
+    }
+}
+}
+
+int main() {
+    tile_stencil();
+    tile_exact();
+    tile_left_alone();
+    unit_strides_transposed();
+    unit_strides_3d();
+    unit_strides_temps();
+    unit_strides_left_alone();
+    return report();
+}
@@ -0,0 +1,135 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+/* Helper functions of the C++ tests (bh_test_*) */
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <bh_config_parser.hpp>
+#include <bh_instruction.hpp>
+
+namespace bohrium {
+namespace test {
+
+// The number of failed checks, which the tests return as the exit code
+inline int &num_failures() {
+    static int ret = 0;
+    return ret;
+}
+
+// Report a failed check of 'what' in the test 'name' unless 'condition' is true
+inline void check(bool condition, const std::string &name, const std::string &what) {
+    if (not condition) {
+        std::cerr << "FAILED: " << name << ": " << what << std::endl;
+        ++num_failures();
+    }
+}
+
+inline void check_equal(uint64_t value, uint64_t expected, const std::string &name, const std::string &what) {
+    check(value == expected, name, what + " is " + std::to_string(value) + " but should be " +
+                                   std::to_string(expected));
+}
+
+// Print the number of failed checks and returns the exit code of the test
+inline int report() {
+    if (num_failures() > 0) {
+        std::cerr << num_failures() << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}
+
+// Returns a view of 'base' with 'shape' that starts at 'start'. Without 'stride', the view is row-major contiguous.
+inline bh_view make_view(bh_base *base, const std::vector<int64_t> &shape, int64_t start = 0,
+                         std::vector<int64_t> stride = {}) {
+    if (stride.empty()) {
+        stride.resize(shape.size());
+        int64_t s = 1;
+        for (int64_t i = shape.size() - 1; i >= 0; --i) {
+            stride[i] = s;
+            s *= shape[i];
+        }
+    }
+    bh_view ret;
+    ret.base = base;
+    ret.start = start;
+    ret.ndim = shape.size();
+    for (size_t i = 0; i < shape.size(); ++i) {
+        ret.shape[i] = shape[i];
+        ret.stride[i] = stride[i];
+    }
+    return ret;
+}
+
+// Returns an instruction where the last operand is the constant 'value'
+template <typename T>
+bh_instruction make_instr(bh_opcode opcode, std::vector<bh_view> operands, T value) {
+    bh_view constant;
+    bh_flag_constant(&constant);
+    operands.push_back(constant);
+    bh_instruction ret(opcode, std::move(operands));
+    ret.constant = bh_constant(value);
+    return ret;
+}
+
+inline bh_instruction make_free(bh_base *base) {
+    return bh_instruction(BH_FREE, {make_view(base, {base->nelem})});
+}
+
+// A new and empty directory in the temporary directory, which is removed on destruction
+class TmpDir {
+public:
+    const boost::filesystem::path path;
+
+    TmpDir() : path(boost::filesystem::temp_directory_path() /
+                    boost::filesystem::unique_path("bh_test_jitk_%%%%-%%%%-%%%%")) {
+        boost::filesystem::create_directories(path);
+    }
+
+    ~TmpDir() {
+        boost::system::error_code ec;
+        boost::filesystem::remove_all(path, ec);
+    }
+};
+
+// Returns the config of the component named 'name' in the current stack
+inline std::unique_ptr<ConfigParser> find_component(const std::string &name) {
+    for (int stack_level = 0; ; ++stack_level) {
+        std::unique_ptr<ConfigParser> config;
+        try {
+            config.reset(new ConfigParser(stack_level));
+        } catch (const ConfigError &) {
+            throw std::runtime_error("the current stack has no '" + name + "' component (see BH_STACK)");
+        }
+        if (config->getName() == name) {
+            return config;
+        }
+    }
+}
+
+} // test
+} // bohrium
@@ -0,0 +1,27 @@
+class test_device_memory:
+    """ Touch more arrays than fit within a small device memory budget (see BH_OPENCL_DEVICE_MEMORY_BUDGET), which
+        evicts the least recently used arrays to the host and copies them back to the device when used again """
+    def init(self):
+        # Eight arrays of 2 MB each where each flush uses two or three of them
+        cmd = "n = %d; arrays = [M.arange(n, dtype=np.float64) * i for i in range(8)]\n" % (2 ** 18)
+        yield cmd
+
+    def test_round_robin(self, cmd):
+        cmd += "for _ in range(2):\n"
+        cmd += "    for i in range(len(arrays)):\n"
+        cmd += "        arrays[i] += arrays[(i + 1) % len(arrays)]\n"
+        cmd += "        FLUSH\n"
+        cmd += "res = arrays[0]\n"
+        cmd += "for a in arrays[1:]: res = res + a\n"
+        return cmd.replace("FLUSH", "pass"), cmd.replace("FLUSH", "bh.flush()")
+
+    def test_partial_writes(self, cmd):
+        # The evicted arrays are partially overwritten, which the copy back to the device must keep
+        cmd += "for i in range(len(arrays)):\n"
+        cmd += "    arrays[i][1::2] = arrays[-1 - i][::2] * 2\n"
+        cmd += "    FLUSH\n"
+        cmd += "for i in reversed(range(len(arrays))):\n"
+        cmd += "    arrays[i][n // 2:] -= arrays[(i + 3) % len(arrays)][:n // 2]\n"
+        cmd += "    FLUSH\n"
+        cmd += "res = M.concatenate(arrays)\n"
+        return cmd.replace("FLUSH", "pass"), cmd.replace("FLUSH", "bh.flush()")
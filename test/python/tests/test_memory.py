@@ -0,0 +1,24 @@
+class test_numpy_view:
+    def init(self):
+        # Both smaller and larger than a page
+        for size in (10, 4096, 100000):
+            yield "a = M.arange(%d, dtype=M.float64); b = a[1:]; " % size
+
+    def test_write_back(self, cmd):
+        cmd_np = cmd + "n = a; "
+        cmd_bh = cmd + "n = a.view(np.ndarray); "
+        cmd = "n[::2] = -1; a += 1; res = a"
+        return cmd_np + cmd, cmd_bh + cmd
+
+    def test_alias(self, cmd):
+        cmd_np = cmd + "n = a; "
+        cmd_bh = cmd + "n = a.view(np.ndarray); "
+        cmd = "b *= 2; n[1] += n[2]; b += 1; res = n.copy()"
+        return cmd_np + cmd, cmd_bh + cmd
+
+    def test_round_trips(self, cmd):
+        cmd_np = cmd + "n = a\n"
+        cmd_bh = cmd + "n = a.view(np.ndarray)\n"
+        cmd = "for i in range(3): n[i::3] += i; b *= 2\n"
+        cmd += "res = a"
+        return cmd_np + cmd, cmd_bh + cmd
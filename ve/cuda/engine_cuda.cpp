@@ -65,9 +65,6 @@ EngineCUDA::EngineCUDA(const ConfigParser &config, jitk::Statistics &stat) :
     // Let's make sure that the directories exist
     jitk::create_directories(tmp_src_dir);
     jitk::create_directories(tmp_bin_dir);
-    if (not cache_bin_dir.empty()) {
-        jitk::create_directories(cache_bin_dir);
-    }
 
     // Write the compilation hash
     compilation_hash = util::hash(info());
@@ -87,32 +84,10 @@ EngineCUDA::EngineCUDA(const ConfigParser &config, jitk::Statistics &stat) :
 EngineCUDA::~EngineCUDA() {
     cuCtxDetach(context);
 
-    // Move JIT kernels to the cache dir
-    if (not cache_bin_dir.empty()) {
-        try {
-            for (const auto &kernel: _functions) {
-                const fs::path src = tmp_bin_dir / jitk::hash_filename(compilation_hash, kernel.first, ".cubin");
-                if (fs::exists(src)) {
-                    const fs::path dst = cache_bin_dir / jitk::hash_filename(compilation_hash, kernel.first, ".cubin");
-                    if (not fs::exists(dst)) {
-                        fs::copy_file(src, dst);
-                    }
-                }
-            }
-        } catch (const boost::filesystem::filesystem_error &e) {
-            cout << "Warning: couldn't write CUDA kernels to disk to " << cache_bin_dir
-                 << ". " << e.what() << endl;
-        }
-    }
-
     // File clean up
     if (not verbose) {
         fs::remove_all(tmp_src_dir);
     }
-
-    if (cache_file_max != -1 and not cache_bin_dir.empty()) {
-        util::remove_old_files(cache_bin_dir, cache_file_max);
-    }
 }
 
 pair<tuple<uint32_t, uint32_t, uint32_t>, tuple<uint32_t, uint32_t, uint32_t> >
@@ -150,14 +125,15 @@ CUfunction EngineCUDA::getFunction(const string &source, const std::string &func
         return _functions.at(hash);
     }
 
-    fs::path binfile = cache_bin_dir / jitk::hash_filename(compilation_hash, hash, ".cubin");
+    const string filename = jitk::hash_filename(compilation_hash, hash, ".cubin");
+    fs::path binfile = kernel_store.path(filename);
 
     // If the binary file of the kernel doesn't exist we create it
-    if (verbose or cache_bin_dir.empty() or not fs::exists(binfile)) {
+    if (verbose or not kernel_store.lookup(filename)) {
         ++stat.kernel_cache_misses;
 
         // We create the binary file in the tmp dir
-        binfile = tmp_bin_dir / jitk::hash_filename(compilation_hash, hash, ".cubin");
+        binfile = tmp_bin_dir / filename;
 
         // Write the source file and compile it (reading from disk)
         // TODO: make nvcc read directly from stdin
@@ -170,6 +146,11 @@ CUfunction EngineCUDA::getFunction(const string &source, const std::string &func
                                                        kernel_filename, verbose);
             compiler.compile(binfile.string(), srcfile.string());
         }
+        try {
+            kernel_store.publish(binfile, filename);
+        } catch (const boost::filesystem::filesystem_error &e) {
+            cout << "Warning: couldn't write CUDA kernel to the cache dir. " << e.what() << endl;
+        }
         /* else {
             // Pipe the source directly into the compiler thus no source file is written
             compiler.compile(binfile.string(), source.c_str(), source.size());
@@ -109,6 +109,11 @@ public:
         buffers.erase(base);
     }
 
+    // Returns true when 'base' has a buffer on the device
+    bool isOnDevice(bh_base *base) const override {
+        return buffers.find(base) != buffers.end();
+    }
+
     // Retrieve a single buffer
     template <typename T>
     CUdeviceptr *getBuffer(T &base) {
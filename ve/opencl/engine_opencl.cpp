@@ -154,42 +154,10 @@ EngineOpenCL::EngineOpenCL(const ConfigParser &config, jitk::Statistics &stat) :
 }
 
 EngineOpenCL::~EngineOpenCL() {
-    // Move JIT kernels to the cache dir
-    if (not cache_bin_dir.empty()) {
-        for (const auto &kernel: _programs) {
-            const fs::path dst = cache_bin_dir / jitk::hash_filename(compilation_hash, kernel.first, ".clbin");
-            if (not fs::exists(dst)) {
-                cl_uint ndevs;
-                kernel.second.getInfo(CL_PROGRAM_NUM_DEVICES, &ndevs);
-                if (ndevs > 1) {
-                    cout << "OpenCL warning: too many devices for caching." << endl;
-                    return;
-                }
-                size_t bin_sizes[1];
-                kernel.second.getInfo(CL_PROGRAM_BINARY_SIZES, bin_sizes);
-                if (bin_sizes[0] == 0) {
-                    cout << "OpenCL warning: no caching since the binary isn't available for the device." << endl;
-                } else {
-                    // Get the CL_PROGRAM_BINARIES and write it to a file
-                    vector<unsigned char> bin(bin_sizes[0]);
-                    unsigned char *bin_list[1] = {&bin[0]};
-                    kernel.second.getInfo(CL_PROGRAM_BINARIES, bin_list);
-                    ofstream binfile(dst.string(), ofstream::out | ofstream::binary);
-                    binfile.write((const char*)&bin[0], bin.size());
-                    binfile.close();
-                }
-            }
-        }
-    }
-
     // File clean up
     if (not verbose) {
         fs::remove_all(tmp_src_dir);
     }
-
-    if (cache_file_max != -1 and not cache_bin_dir.empty()) {
-        util::remove_old_files(cache_bin_dir, cache_file_max);
-    }
 }
 
 pair<cl::NDRange, cl::NDRange> EngineOpenCL::NDRanges(const vector<uint64_t> &thread_stack) const {
@@ -217,6 +185,30 @@ pair<cl::NDRange, cl::NDRange> EngineOpenCL::NDRanges(const vector<uint64_t> &th
     }
 }
 
+void EngineOpenCL::publishBinary(const cl::Program &program, const std::string &filename) {
+    cl_uint ndevs;
+    program.getInfo(CL_PROGRAM_NUM_DEVICES, &ndevs);
+    if (ndevs > 1) {
+        cout << "OpenCL warning: too many devices for caching." << endl;
+        return;
+    }
+    size_t bin_sizes[1];
+    program.getInfo(CL_PROGRAM_BINARY_SIZES, bin_sizes);
+    if (bin_sizes[0] == 0) {
+        cout << "OpenCL warning: no caching since the binary isn't available for the device." << endl;
+        return;
+    }
+    // Get the CL_PROGRAM_BINARIES and write it to the cache dir
+    vector<unsigned char> bin(bin_sizes[0]);
+    unsigned char *bin_list[1] = {&bin[0]};
+    program.getInfo(CL_PROGRAM_BINARIES, bin_list);
+    try {
+        kernel_store.publish((const char*)&bin[0], bin.size(), filename);
+    } catch (const std::exception &e) {
+        cout << "Warning: couldn't write OpenCL kernel to the cache dir. " << e.what() << endl;
+    }
+}
+
 cl::Program EngineOpenCL::getFunction(const string &source) {
     uint64_t hash = util::hash(source);
     ++stat.kernel_cache_lookups;
@@ -226,11 +218,13 @@ cl::Program EngineOpenCL::getFunction(const string &source) {
         return _programs.at(hash);
     }
 
-    fs::path binfile = cache_bin_dir / jitk::hash_filename(compilation_hash, hash, ".clbin");
+    const string filename = jitk::hash_filename(compilation_hash, hash, ".clbin");
+    const fs::path binfile = kernel_store.path(filename);
     cl::Program program;
 
     // If the binary file of the kernel doesn't exist we compile the source
-    if (verbose or cache_bin_dir.empty() or not fs::exists(binfile)) {
+    const bool compile_source = verbose or not kernel_store.lookup(filename);
+    if (compile_source) {
         ++stat.kernel_cache_misses;
         std::string source_filename = jitk::hash_filename(compilation_hash, hash, ".cl");
         stat.addKernel(source_filename);
@@ -273,6 +267,9 @@ cl::Program EngineOpenCL::getFunction(const string &source) {
         cerr << "Error building: " << endl << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) << endl;
         throw;
     }
+    if (compile_source and kernel_store.enabled()) {
+        publishBinary(program, filename);
+    }
     _programs[hash] = program;
     return program;
 }
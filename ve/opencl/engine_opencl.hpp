@@ -60,6 +60,8 @@ private:
     std::map<bh_base*, std::unique_ptr<cl::Buffer>> buffers;
     // Return a kernel function based on the given 'source'
     cl::Program getFunction(const std::string &source);
+    // Publish the binary of 'program' as 'filename' in the cache dir
+    void publishBinary(const cl::Program &program, const std::string &filename);
 
 public:
     EngineOpenCL(const ConfigParser &config, jitk::Statistics &stat);
@@ -88,6 +90,11 @@ public:
     // Delete a buffer
     void delBuffer(bh_base* &base) override;
 
+    // Returns true when 'base' has a buffer on the device
+    bool isOnDevice(bh_base *base) const override {
+        return buffers.find(base) != buffers.end();
+    }
+
     void writeKernel(const jitk::Block &block,
                      const jitk::SymbolTable &symbols,
                      const std::vector<uint64_t> &thread_stack,
@@ -0,0 +1,149 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef VE_OPENMP_WITH_LIBTCC
+#include <libtcc.h>
+#endif
+
+#include "compiler_libtcc.hpp"
+
+using namespace std;
+
+namespace bohrium {
+
+CompilerLibTCC::CompilerLibTCC(const string &cmd_template, bool verbose) : verbose(verbose) {
+    if (not available()) {
+        throw runtime_error("VE-OPENMP: Bohrium was build without libtcc support");
+    }
+    stringstream ss(cmd_template);
+    string token;
+    while (ss >> token) {
+        if (token.size() <= 2 or token[0] != '-') {
+            continue;
+        }
+        const string value = token.substr(2);
+        switch (token[1]) {
+            case 'I':
+                include_paths.push_back(value);
+                break;
+            case 'L':
+                library_paths.push_back(value);
+                break;
+            case 'l':
+                libraries.push_back(value);
+                break;
+            case 'D': {
+                const size_t eq = value.find('=');
+                if (eq == string::npos) {
+                    defines.push_back(make_pair(value, string()));
+                } else {
+                    defines.push_back(make_pair(value.substr(0, eq), value.substr(eq + 1)));
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+bool CompilerLibTCC::compatible(const string &source, int num_threads) {
+    if (source.find("#include <complex.h>") != string::npos or source.find("#include <tgmath.h>") != string::npos) {
+        return false;
+    }
+    return num_threads <= 1 or source.find("#pragma omp parallel") == string::npos;
+}
+
+#ifdef VE_OPENMP_WITH_LIBTCC
+
+namespace {
+// Ignore compile errors, the caller falls back to the regular compiler
+void silent_error(void *, const char *) {}
+}
+
+CompilerLibTCC::~CompilerLibTCC() {
+    for (void *state: states) {
+        tcc_delete(static_cast<TCCState *>(state));
+    }
+}
+
+bool CompilerLibTCC::available() {
+    return true;
+}
+
+void *CompilerLibTCC::compile(const string &source, const string &func_name) {
+    TCCState *state = tcc_new();
+    if (state == nullptr) {
+        throw runtime_error("VE-OPENMP: tcc_new() failed");
+    }
+    if (not verbose) {
+        tcc_set_error_func(state, nullptr, silent_error);
+    }
+    tcc_set_output_type(state, TCC_OUTPUT_MEMORY);
+    for (const string &path: include_paths) {
+        tcc_add_include_path(state, path.c_str());
+    }
+    for (const auto &define: defines) {
+        tcc_define_symbol(state, define.first.c_str(), define.second.c_str());
+    }
+    for (const string &path: library_paths) {
+        tcc_add_library_path(state, path.c_str());
+    }
+
+    bool success = tcc_compile_string(state, source.c_str()) == 0;
+    for (size_t i = 0; success and i < libraries.size(); ++i) {
+        success = tcc_add_library(state, libraries[i].c_str()) == 0;
+    }
+#ifdef TCC_RELOCATE_AUTO // Older versions of libtcc (<= 0.9.27) take the memory location as argument
+    success = success and tcc_relocate(state, TCC_RELOCATE_AUTO) >= 0;
+#else
+    success = success and tcc_relocate(state) >= 0;
+#endif
+    void *func = success ? tcc_get_symbol(state, func_name.c_str()) : nullptr;
+    if (func == nullptr) {
+        if (verbose) {
+            cout << "libtcc couldn't compile " << func_name << ", using the compiler command instead" << endl;
+        }
+        tcc_delete(state);
+        return nullptr;
+    }
+    states.push_back(state);
+    return func;
+}
+
+#else
+
+CompilerLibTCC::~CompilerLibTCC() {}
+
+bool CompilerLibTCC::available() {
+    return false;
+}
+
+void *CompilerLibTCC::compile(const string &, const string &) {
+    return nullptr;
+}
+
+#endif
+
+} // bohrium
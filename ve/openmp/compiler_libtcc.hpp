@@ -0,0 +1,74 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace bohrium {
+
+/**
+ * An in-process compiler that uses libtcc (TinyCC) to compile C99 source code directly into memory.
+ * No compiler process is forked, no shared library is written to disk, and no dlopen() is needed.
+ *
+ * Notice, TinyCC doesn't support OpenMP, complex numbers, or optimizations thus it trades execution
+ * performance for compile latency. Kernels that libtcc cannot compile must use the regular `jitk::Compiler`.
+ */
+class CompilerLibTCC {
+public:
+    /**
+     *  The include paths, library paths, libraries, and macro definitions (i.e. the -I, -L, -l, -D options)
+     *  are extracted from 'cmd_template', which is the `compiler_cmd` of the regular compiler.
+     */
+    CompilerLibTCC(const std::string &cmd_template, bool verbose);
+
+    ~CompilerLibTCC();
+
+    CompilerLibTCC(const CompilerLibTCC &) = delete;
+    CompilerLibTCC &operator=(const CompilerLibTCC &) = delete;
+
+    /**
+     *  Compile 'source' and return a pointer to the function 'func_name' or nullptr when
+     *  libtcc fails to compile 'source'. The function is valid for the lifetime of this object.
+     */
+    void *compile(const std::string &source, const std::string &func_name);
+
+    /**
+     *  Returns true when libtcc compiles 'source' into a kernel that computes the same as the regular compiler.
+     *  That isn't the case when 'source' uses <complex.h> or <tgmath.h>, or when it has parallel loops and
+     *  OpenMP uses more than one thread since libtcc ignores the OpenMP pragmas.
+     */
+    static bool compatible(const std::string &source, int num_threads);
+
+    /** Returns true when Bohrium was build with libtcc support */
+    static bool available();
+
+private:
+    bool verbose;
+    std::vector<std::string> include_paths;
+    std::vector<std::string> library_paths;
+    std::vector<std::string> libraries;
+    std::vector<std::pair<std::string, std::string> > defines;
+
+    // The libtcc states that hold the code of the compiled functions
+    std::vector<void *> states;
+};
+
+} // bohrium
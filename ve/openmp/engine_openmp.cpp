@@ -25,6 +25,10 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <map>
 #include <iomanip>
 #include <dlfcn.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include <jitk/codegen_util.hpp>
 #include <jitk/compiler.hpp>
 #include <jitk/fuser_cache.hpp>
@@ -33,6 +37,7 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <thread>
 
 #include <bh_util.hpp>
+#include <bh_memory.h>
 #include "engine_openmp.hpp"
 #include "openmp_util.hpp"
 
@@ -41,29 +46,84 @@ namespace fs = boost::filesystem;
 
 namespace bohrium {
 
+namespace {
+// Returns the maximum number of threads of the parallel loops of the kernels, which is one without OpenMP
+int max_threads() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+// Write the pages of the new array `base` using the static partitioning of the `#pragma omp parallel for` of the
+// kernels. Thus, the OS places the pages on the NUMA node of the thread that computes them (first-touch policy).
+void first_touch(bh_base *base) {
+#ifdef _OPENMP
+    const int64_t page_size = sysconf(_SC_PAGESIZE);
+    const int64_t npages = (bh_base_size(base) + page_size - 1) / page_size;
+    if (npages < max_threads()) {
+        return; // Not worth the threads
+    }
+    char *data = static_cast<char *>(base->data);
+    #pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < npages; ++i) {
+        data[i * page_size] = 0;
+    }
+#endif
+}
+}
+
 EngineOpenMP::EngineOpenMP(const ConfigParser &config, jitk::Statistics &stat) :
     EngineCPU(config, stat),
-    compiler(config.get<string>("compiler_cmd"), verbose, config.file_dir.string())
+    compiler(config.get<string>("compiler_cmd"), verbose, config.file_dir.string()),
+    first_touch_pages(config.defaultGet<bool>("first_touch", false))
 {
     compilation_hash = util::hash(compiler.cmd_template);
+
+    const string hugepages = config.defaultGet<string>("hugepages", "none");
+    const int64_t hugepages_threshold = config.defaultGet<int64_t>("hugepages_threshold", 2) * 1024 * 1024;
+    if (hugepages == "none") {
+        bh_memory_hugepages_config(BH_HUGEPAGES_NONE, hugepages_threshold);
+    } else if (hugepages == "transparent") {
+        bh_memory_hugepages_config(BH_HUGEPAGES_TRANSPARENT, hugepages_threshold);
+    } else if (hugepages == "explicit") {
+        bh_memory_hugepages_config(BH_HUGEPAGES_EXPLICIT, hugepages_threshold);
+    } else {
+        throw runtime_error("VE-OPENMP: unknown hugepages '" + hugepages + "'");
+    }
+
+    const string backend = config.defaultGet<string>("compiler_backend", "command");
+    if (backend == "libtcc") {
+        if (CompilerLibTCC::available()) {
+            _libtcc.reset(new CompilerLibTCC(compiler.cmd_template, verbose));
+            if (max_threads() > 1) {
+                cout << "Warning: kernels compiled by libtcc execute single-threaded, thus libtcc only compiles "
+                        "kernels without parallel loops and the compiler command compiles the rest" << endl;
+            }
+        } else {
+            cout << "Warning: VE-OPENMP was build without libtcc, using the compiler command instead" << endl;
+        }
+    } else if (backend != "command") {
+        throw runtime_error("VE-OPENMP: unknown compiler_backend '" + backend + "'");
+    }
+
+    if (async_compile or parallel_compile) {
+        unsigned int num_threads = config.defaultGet<unsigned int>("compile_threads", 0);
+        if (num_threads == 0) {
+            num_threads = std::thread::hardware_concurrency();
+        }
+        _compile_pool.reset(new jitk::ThreadPool(num_threads));
+    }
 }
 
 EngineOpenMP::~EngineOpenMP() {
-    // Move JIT kernels to the cache dir
-    if (not cache_bin_dir.empty()) {
+    // Wait for the background compilations to finish, which also publish the kernels to the cache dir
+    for (const auto &kernel: _pending) {
         try {
-            for (const auto &kernel: _functions) {
-                const fs::path src = tmp_bin_dir / jitk::hash_filename(compilation_hash, kernel.first, ".so");
-                if (fs::exists(src)) {
-                    const fs::path dst = cache_bin_dir / jitk::hash_filename(compilation_hash, kernel.first, ".so");
-                    if (not fs::exists(dst)) {
-                        fs::copy_file(src, dst);
-                    }
-                }
-            }
-        } catch (const boost::filesystem::filesystem_error &e) {
-            cout << "Warning: couldn't write JIT kernels to disk to " << cache_bin_dir
-                 << ". " << e.what() << endl;
+            kernel.second.compiled.get();
+        } catch (const std::exception &e) {
+            cout << "Warning: background compilation failed. " << e.what() << endl;
         }
     }
 
@@ -72,10 +132,6 @@ EngineOpenMP::~EngineOpenMP() {
         fs::remove_all(tmp_src_dir);
     }
 
-    if (cache_file_max != -1 and not cache_bin_dir.empty()) {
-        util::remove_old_files(cache_bin_dir, cache_file_max);
-    }
-
     // If this cleanup is enabled, the application segfaults
     // on destruction of the EngineOpenMP class.
     //
@@ -100,7 +156,64 @@ EngineOpenMP::~EngineOpenMP() {
     // }
 }
 
-KernelFunction EngineOpenMP::getFunction(const string &source, const std::string &func_name) {
+EngineOpenMP::PendingKernel EngineOpenMP::compileKernel(const std::string &source, uint64_t hash) {
+    ++stat.kernel_cache_misses;
+
+    // We create the binary file in the tmp dir
+    const string filename = jitk::hash_filename(compilation_hash, hash, ".so");
+    const fs::path binfile = tmp_bin_dir / filename;
+
+    // Write the source file and compile it (reading from disk)
+    // NB: this is a nice debug option, but will hurt performance
+    fs::path srcfile;
+    if (verbose) {
+        std::string source_filename = jitk::hash_filename(compilation_hash, hash, ".c");
+        stat.addKernel(source_filename);
+        srcfile = jitk::write_source2file(source, tmp_src_dir, source_filename, true);
+    }
+
+    function<void()> job = [this, source, filename, binfile, srcfile]() {
+        // Other processes that miss the same kernel wait for us, and we might have to wait for them
+        const unique_ptr<jitk::KernelStore::Lock> lock = kernel_store.lock(filename);
+        if (not verbose and kernel_store.lookup(filename)) {
+            return; // Another process published the kernel while we waited
+        }
+        if (srcfile.empty()) {
+            // Pipe the source directly into the compiler thus no source file is written
+            compiler.compile(binfile.string(), source.c_str(), source.size());
+        } else {
+            compiler.compile(binfile.string(), srcfile.string());
+        }
+        try {
+            kernel_store.publish(binfile, filename);
+        } catch (const boost::filesystem::filesystem_error &e) {
+            cout << "Warning: couldn't write JIT kernel to the cache dir. " << e.what() << endl;
+        }
+    };
+
+    if (_compile_pool) {
+        return PendingKernel{_compile_pool->submit(std::move(job)), binfile};
+    }
+    // Without background threads, we compile right away. Notice, a compile error is stored in the future.
+    packaged_task<void()> task(std::move(job));
+    task();
+    return PendingKernel{task.get_future().share(), binfile};
+}
+
+void EngineOpenMP::compileAhead(const std::string &source) {
+    const uint64_t hash = util::hash(source);
+    // Notice, libtcc compiles fast enough that we simply compile on demand
+    if (not _compile_pool or (_libtcc and CompilerLibTCC::compatible(source, max_threads())) or
+        util::exist(_functions, hash) or util::exist(_pending, hash)) {
+        return;
+    }
+    if (not verbose and kernel_store.lookup(jitk::hash_filename(compilation_hash, hash, ".so"))) {
+        return; // The kernel will be loaded from the cache dir
+    }
+    _pending.insert(make_pair(hash, compileKernel(source, hash)));
+}
+
+KernelFunction EngineOpenMP::getFunction(const string &source, const std::string &func_name, bool allow_fallback) {
     uint64_t hash = util::hash(source);
     ++stat.kernel_cache_lookups;
 
@@ -109,31 +222,54 @@ KernelFunction EngineOpenMP::getFunction(const string &source, const std::string
         return _functions.at(hash);
     }
 
-    fs::path binfile = cache_bin_dir / jitk::hash_filename(compilation_hash, hash, ".so");
+    // Is the function being compiled in the background?
+    auto pending = _pending.find(hash);
 
-    // If the binary file of the kernel doesn't exist we create it
-    if (verbose or cache_bin_dir.empty() or not fs::exists(binfile)) {
-        ++stat.kernel_cache_misses;
-
-        // We create the binary file in the tmp dir
-        binfile = tmp_bin_dir / jitk::hash_filename(compilation_hash, hash, ".so");
+    // Let's try the in-process compiler, which returns nullptr when it cannot compile 'source'
+    if (_libtcc and pending == _pending.end() and CompilerLibTCC::compatible(source, max_threads())) {
+        void *func = _libtcc->compile(source, func_name);
+        if (func != nullptr) {
+            ++stat.kernel_cache_misses;
+            *(void **) (&_functions[hash]) = func;
+            return _functions.at(hash);
+        }
+    }
 
-        // Write the source file and compile it (reading from disk)
-        // NB: this is a nice debug option, but will hurt performance
-        if (verbose) {
-            std::string source_filename = jitk::hash_filename(compilation_hash, hash, ".c");
-            stat.addKernel(source_filename);
-            fs::path srcfile = jitk::write_source2file(source, tmp_src_dir, source_filename, true);
-            compiler.compile(binfile.string(), srcfile.string());
-        } else {
-            // Pipe the source directly into the compiler thus no source file is written
-            compiler.compile(binfile.string(), source.c_str(), source.size());
+    if (pending == _pending.end()) {
+        // If the binary file of the kernel exist in the cache dir, we use it
+        const string filename = jitk::hash_filename(compilation_hash, hash, ".so");
+        if (not verbose and kernel_store.lookup(filename)) {
+            const KernelFunction func = loadFunction(hash, kernel_store.path(filename), func_name);
+            if (func != nullptr) {
+                return func;
+            }
+            // Another process evicted the kernel after our lookup thus we compile it like any other cache miss
         }
+        pending = _pending.insert(make_pair(hash, compileKernel(source, hash))).first;
     }
 
+    // Let the caller fall back to the interpreter while we wait
+    if (allow_fallback and not jitk::is_ready(pending->second.compiled)) {
+        return nullptr;
+    }
+    const PendingKernel kernel = pending->second;
+    _pending.erase(pending);
+    kernel.compiled.get(); // Re-throws compile errors
+    if (fs::exists(kernel.binfile)) {
+        return loadFunction(hash, kernel.binfile, func_name);
+    }
+    // Another process compiled the kernel, which might also have been evicted again
+    const KernelFunction func = loadFunction(hash, kernel_store.path(kernel.binfile.filename().string()), func_name);
+    return func != nullptr ? func : getFunction(source, func_name, false);
+}
+
+KernelFunction EngineOpenMP::loadFunction(uint64_t hash, const fs::path &binfile, const std::string &func_name) {
     // Load the shared library
     void *lib_handle = dlopen(binfile.string().c_str(), RTLD_NOW);
     if (lib_handle == nullptr) {
+        if (not fs::exists(binfile)) {
+            return nullptr; // The file was removed (e.g. evicted from the cache dir) before we could load it
+        }
         cerr << "Cannot load library: " << dlerror() << endl;
         throw runtime_error("VE-OPENMP: Cannot load library");
     }
@@ -153,39 +289,75 @@ KernelFunction EngineOpenMP::getFunction(const string &source, const std::string
 }
 
 
-void EngineOpenMP::execute(const std::string &source,
+bool EngineOpenMP::execute(const std::string &source,
                            uint64_t codegen_hash,
                            const std::vector<bh_base*> &non_temps,
                            const std::vector<const bh_view*> &offset_strides,
-                           const std::vector<const bh_instruction*> &constants) {
-    // Notice, we use a "pure" hash of `source` to make sure that the `source_filename` always
-    // corresponds to `source` even if `codegen_hash` is buggy.
-    uint64_t hash = util::hash(source);
-    std::string source_filename = jitk::hash_filename(compilation_hash, hash, ".c");
-
+                           const std::set<jitk::InstrPtr, jitk::Constant_less> &constants,
+                           bool allow_fallback) {
     // Make sure all arrays are allocated
     for (bh_base *base: non_temps) {
-        bh_data_malloc(base);
+        if (first_touch_pages and base->data == nullptr) {
+            bh_data_malloc(base);
+            first_touch(base);
+        } else {
+            bh_data_malloc(base);
+        }
     }
 
-    // Compile the kernel
-    auto tbuild = chrono::steady_clock::now();
-    string func_name; { stringstream t; t << "launcher_" << codegen_hash; func_name = t.str(); }
-    KernelFunction func = getFunction(source, func_name);
-    assert(func != nullptr);
-    stat.time_compile += chrono::steady_clock::now() - tbuild;
+    // Find the launcher of the kernel or create it the first time the kernel is launched.
+    // Since the source in the codegen cache never changes, the launcher of the same source is reused without
+    // comparing or hashing the source.
+    Launcher *launcher = nullptr;
+    {
+        auto it = _launchers.find(codegen_hash);
+        if (it != _launchers.end() and it->second.source == &source) {
+            launcher = &it->second;
+            assert(launcher->source_hash == util::hash(source));
+        }
+    }
+    if (launcher != nullptr) {
+        ++stat.kernel_cache_lookups;
+        if (launcher->stat_generation != stat.generation) { // The statistics has been reset
+            launcher->kernel_stat = &stat.time_per_kernel[jitk::hash_filename(compilation_hash, launcher->source_hash,
+                                                                              ".c")];
+            launcher->stat_generation = stat.generation;
+        }
+    } else {
+        // Notice, we use a "pure" hash of `source` to make sure that the `source_filename` always
+        // corresponds to `source` even if `codegen_hash` is buggy.
+        const uint64_t hash = util::hash(source);
+        std::string source_filename = jitk::hash_filename(compilation_hash, hash, ".c");
+
+        // Compile the kernel
+        auto tbuild = chrono::steady_clock::now();
+        string func_name; { stringstream t; t << "launcher_" << codegen_hash; func_name = t.str(); }
+        KernelFunction func = getFunction(source, func_name, allow_fallback);
+        stat.time_compile += chrono::steady_clock::now() - tbuild;
+        if (func == nullptr) {
+            assert(allow_fallback);
+            return false; // The kernel is still being compiled
+        }
+        launcher = &_launchers[codegen_hash];
+        launcher->func = func;
+        launcher->source = &source;
+        launcher->source_hash = hash;
+        launcher->kernel_stat = &stat.time_per_kernel[source_filename];
+        launcher->stat_generation = stat.generation;
+    }
 
     // Create a 'data_list' of data pointers
-    vector<void*> data_list;
-    data_list.reserve(non_temps.size());
+    // NB: the buffers of the launcher keep their capacity thus they only allocate at the first launch
+    vector<void*> &data_list = launcher->data_list;
+    data_list.clear();
     for(bh_base *base: non_temps) {
         assert(base->data != NULL);
         data_list.push_back(base->data);
     }
 
     // And the offset-and-strides
-    vector<uint64_t> offset_and_strides;
-    offset_and_strides.reserve(offset_strides.size());
+    vector<uint64_t> &offset_and_strides = launcher->offset_and_strides;
+    offset_and_strides.clear();
     for (const bh_view *view: offset_strides) {
         const uint64_t t = (uint64_t) view->start;
         offset_and_strides.push_back(t);
@@ -196,19 +368,19 @@ void EngineOpenMP::execute(const std::string &source,
     }
 
     // And the constants
-    vector<bh_constant_value> constant_arg;
-    constant_arg.reserve(constants.size());
-    for (const bh_instruction* instr: constants) {
+    vector<bh_constant_value> &constant_arg = launcher->constant_arg;
+    constant_arg.clear();
+    for (const jitk::InstrPtr &instr: constants) {
         constant_arg.push_back(instr->constant.value);
     }
 
     auto start_exec = chrono::steady_clock::now();
     // Call the launcher function, which will execute the kernel
-    func(&data_list[0], &offset_and_strides[0], &constant_arg[0]);
+    launcher->func(data_list.data(), offset_and_strides.data(), constant_arg.data());
     auto texec = chrono::steady_clock::now() - start_exec;
     stat.time_exec += texec;
-    stat.time_per_kernel[source_filename].register_exec_time(texec);
-
+    launcher->kernel_stat->register_exec_time(texec);
+    return true;
 }
 
 void EngineOpenMP::setConstructorFlag(std::vector<bh_instruction*> &instr_list) {
@@ -309,19 +481,39 @@ void EngineOpenMP::writeKernel(const std::vector<jitk::Block> &block_list,
                                const jitk::SymbolTable &symbols,
                                const std::vector<bh_base*> &kernel_temps,
                                uint64_t codegen_hash,
-                               std::stringstream &ss) {
+                               std::stringstream &ss,
+                               const jitk::KernelRepeat *repeat) {
+
+    // libtcc doesn't support complex numbers and <tgmath.h> thus we leave them out when possible, which is when
+    // no operand is complex or float32 (<math.h> computes float32 math functions in double precision)
+    bool with_complex = true;
+    if (_libtcc) {
+        with_complex = false;
+        for (const jitk::Block &block: block_list) {
+            for (const jitk::InstrPtr &instr: block.getAllInstr()) {
+                for (size_t i = 0; i < instr->operand.size(); ++i) {
+                    const bh_type type = instr->operand_type(static_cast<int>(i));
+                    if (bh_type_is_complex(type) or type == bh_type::FLOAT32) {
+                        with_complex = true;
+                    }
+                }
+            }
+        }
+    }
 
     // Write the need includes
     ss << "#include <stdint.h>\n";
     ss << "#include <stdlib.h>\n";
     ss << "#include <stdbool.h>\n";
-    ss << "#include <complex.h>\n";
-    ss << "#include <tgmath.h>\n";
+    if (with_complex) {
+        ss << "#include <complex.h>\n";
+        ss << "#include <tgmath.h>\n";
+    }
     ss << "#include <math.h>\n";
     if (symbols.useRandom()) { // Write the random function
         ss << "#include <kernel_dependencies/random123_openmp.h>\n";
     }
-    writeUnionType(ss); // We always need to declare the union of all constant data types
+    writeUnionType(ss, with_complex); // We always need to declare the union of all constant data types
     ss << "\n";
 
     // Write the header of the execute function
@@ -338,9 +530,34 @@ void EngineOpenMP::writeKernel(const std::vector<jitk::Block> &block_list,
     }
     ss << "\n";
 
+    if (repeat != nullptr) {
+        util::spaces(ss, 4);
+        ss << "for (uint64_t r = 0; r < " << repeat->nrepeats << "; ++r) {\n";
+    }
     for(const jitk::Block &block: block_list) {
         writeLoopBlock(symbols, nullptr, block.getLoop(), {}, false, ss);
     }
+    if (repeat != nullptr) {
+        // Check the repeat condition
+        if (repeat->condition != nullptr) {
+            util::spaces(ss, 8);
+            ss << "if (!a" << symbols.baseID(repeat->condition) << "[0]) break;\n";
+        }
+        // Slide the offsets like `slide_views()` does, which wraps around the size of the sliding dimension
+        for (const bh_view *view: repeat->slides) {
+            const size_t id = symbols.offsetStridesID(*view);
+            for (size_t i = 0; i < view->slide.size(); ++i) {
+                const int64_t change = view->slide[i] * view->slide_dim_stride[i];
+                const int64_t max_rel_idx = view->slide_dim_stride[i] * view->slide_dim_shape[i];
+                util::spaces(ss, 8);
+                ss << "{const int64_t rel_idx = (int64_t)(vo" << id << " % " << max_rel_idx << ") + " << change
+                   << "; vo" << id << " += rel_idx < 0 ? " << change + max_rel_idx << " : (rel_idx >= "
+                   << max_rel_idx << " ? " << change - max_rel_idx << " : " << change << ");}\n";
+            }
+        }
+        util::spaces(ss, 4);
+        ss << "}\n";
+    }
 
     // Write frees of the kernel temporaries
     ss << "\n";
@@ -404,6 +621,8 @@ std::string EngineOpenMP::info() const {
     ss << "OpenMP:"                                                        << "\n";
     ss << "  Hardware threads: " << std::thread::hardware_concurrency()    << "\n";
     ss << "  JIT Command: \"" << compiler.cmd_template << "\"\n";
+    ss << "  In-process compiler: " << (_libtcc ? "libtcc" : "none") << "\n";
+    ss << "  Async compile: " << (_compile_pool ? _compile_pool->size() : 0) << " threads" << "\n";
     return ss.str();
 }
 
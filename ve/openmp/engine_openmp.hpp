@@ -23,6 +23,9 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <iostream>
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <memory>
+#include <future>
 #include <boost/filesystem.hpp>
 
 #include <bh_config_parser.hpp>
@@ -32,9 +35,12 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <jitk/fuser_cache.hpp>
 #include <jitk/codegen_util.hpp>
 #include <jitk/codegen_cache.hpp>
+#include <jitk/thread_pool.hpp>
 
 #include <jitk/engines/engine_cpu.hpp>
 
+#include "compiler_libtcc.hpp"
+
 namespace bohrium {
 
 typedef void (*KernelFunction)(void* data_list[], uint64_t offset_strides[], bh_constant_value constants[]);
@@ -47,19 +53,65 @@ private:
     // The compiler to use when function doesn't exist
     const jitk::Compiler compiler;
 
-    // Return a kernel function based on the given 'source' and the name of the kernel function
-    KernelFunction getFunction(const std::string &source, const std::string &func_name);
+    // Write the pages of new arrays in parallel before the kernel (see `first_touch` in the config)
+    const bool first_touch_pages;
+
+    // The in-process compiler, which is only used when `compiler_backend = libtcc`
+    std::unique_ptr<CompilerLibTCC> _libtcc;
+
+    // A kernel that is being compiled in the background
+    struct PendingKernel {
+        std::shared_future<void> compiled;
+        boost::filesystem::path binfile;
+    };
+    std::map<uint64_t, PendingKernel> _pending;
+
+    // A kernel that has been launched before, which makes the following launches cheap: the source is hashed, and
+    // the kernel function and the statistics are looked up, once and the argument buffers are reused thus a launch
+    // allocates nothing.
+    struct Launcher {
+        KernelFunction func;
+        // The source in the codegen cache, which the launcher is reused for, and the hash of the source
+        const std::string *source;
+        uint64_t source_hash;
+        // The statistics of the kernel in `stat.time_per_kernel` and the generation of `stat` it points into
+        jitk::KernelStats *kernel_stat;
+        uint64_t stat_generation;
+        std::vector<void*> data_list;
+        std::vector<uint64_t> offset_and_strides;
+        std::vector<bh_constant_value> constant_arg;
+    };
+    // Launchers by codegen hash
+    std::unordered_map<uint64_t, Launcher> _launchers;
+
+    // The background compile threads, which is only used when `async_compile` or `parallel_compile` is enabled
+    // NB: declared last thus the threads are joined before the other members are destroyed
+    std::unique_ptr<jitk::ThreadPool> _compile_pool;
+
+    // Return a kernel function based on the given 'source' and the name of the kernel function.
+    // If 'allow_fallback' is true, nullptr is returned while the kernel is being compiled in the background.
+    KernelFunction getFunction(const std::string &source, const std::string &func_name, bool allow_fallback);
+
+    // Start the compilation of 'source' where 'hash' is the hash of 'source'
+    PendingKernel compileKernel(const std::string &source, uint64_t hash);
+
+    // Load the kernel function 'func_name' from the shared library 'binfile'.
+    // Returns nullptr when 'binfile' doesn't exist, e.g. when another process evicted it from the cache dir.
+    KernelFunction loadFunction(uint64_t hash, const boost::filesystem::path &binfile, const std::string &func_name);
 
 public:
     EngineOpenMP(const ConfigParser &config, jitk::Statistics &stat);
 
     ~EngineOpenMP();
 
-    void execute(const std::string &source,
+    bool execute(const std::string &source,
                  uint64_t codegen_hash,
                  const std::vector<bh_base*> &non_temps,
                  const std::vector<const bh_view*> &offset_strides,
-                 const std::vector<const bh_instruction*> &constants) override;
+                 const std::set<jitk::InstrPtr, jitk::Constant_less> &constants,
+                 bool allow_fallback) override;
+
+    void compileAhead(const std::string &source) override;
 
     void setConstructorFlag(std::vector<bh_instruction*> &instr_list) override;
 
@@ -67,7 +119,8 @@ public:
                      const jitk::SymbolTable &symbols,
                      const std::vector<bh_base*> &kernel_temps,
                      uint64_t codegen_hash,
-                     std::stringstream &ss) override;
+                     std::stringstream &ss,
+                     const jitk::KernelRepeat *repeat = nullptr) override;
 
      // Writing the OpenMP header, which include "parallel for" and "simd"
     void writeHeader(const jitk::SymbolTable &symbols,
@@ -89,8 +142,9 @@ public:
     const std::string writeType(bh_type dtype) override;
 
 private:
-    // Writes the union of C99 types that can make up a constant
-    inline void writeUnionType(std::stringstream& out) {
+    // Writes the union of C99 types that can make up a constant.
+    // Notice, the union has the same size without the complex types because of `r123_t`.
+    inline void writeUnionType(std::stringstream& out, bool with_complex) {
         out << "\ntypedef struct { uint64_t x, y; } r123_t" << ";\n";
         out << "union dtype {\n";
         util::spaces(out, 4); out << writeType(bh_type::BOOL)       << " " << bh_type_text(bh_type::BOOL)       << ";\n";
@@ -104,8 +158,10 @@ private:
         util::spaces(out, 4); out << writeType(bh_type::UINT64)     << " " << bh_type_text(bh_type::UINT64)     << ";\n";
         util::spaces(out, 4); out << writeType(bh_type::FLOAT32)    << " " << bh_type_text(bh_type::FLOAT32)    << ";\n";
         util::spaces(out, 4); out << writeType(bh_type::FLOAT64)    << " " << bh_type_text(bh_type::FLOAT64)    << ";\n";
-        util::spaces(out, 4); out << writeType(bh_type::COMPLEX64)  << " " << bh_type_text(bh_type::COMPLEX64)  << ";\n";
-        util::spaces(out, 4); out << writeType(bh_type::COMPLEX128) << " " << bh_type_text(bh_type::COMPLEX128) << ";\n";
+        if (with_complex) {
+            util::spaces(out, 4); out << writeType(bh_type::COMPLEX64)  << " " << bh_type_text(bh_type::COMPLEX64)  << ";\n";
+            util::spaces(out, 4); out << writeType(bh_type::COMPLEX128) << " " << bh_type_text(bh_type::COMPLEX128) << ";\n";
+        }
         util::spaces(out, 4); out << writeType(bh_type::R123)       << " " << bh_type_text(bh_type::R123)       << ";\n";
         out << "};\n";
     }
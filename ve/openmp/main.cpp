@@ -134,6 +134,11 @@ Impl::~Impl() {
 }
 
 void Impl::execute(BhIR *bhir) {
+    // When possible, a single kernel executes all the iterations
+    if (engine.handleRepeatedExecution(*this, bhir)) {
+        return;
+    }
+
     bh_base *cond = bhir->getRepeatCondition();
 
     for (uint64_t i = 0; i < bhir->getNRepeats(); ++i) {
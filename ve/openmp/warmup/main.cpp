@@ -0,0 +1,152 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* bh_openmp_warmup: compiles the kernels of recorded BhIR traces ahead of time.
+ *
+ * The BhIRs of the traces go through the regular fuser and code generator of the OpenMP component
+ * in the current stack (see BH_STACK and BH_CONFIG) but instead of being executed, the kernels are
+ * compiled in parallel and published to the `cache_dir` of the component. Thus, a later execution of
+ * the traced application finds all its kernels in the kernel cache.
+ */
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+
+#include <bh_config_parser.hpp>
+#include <bh_trace.hpp>
+#include <jitk/statistics.hpp>
+
+#include "../engine_openmp.hpp"
+
+using namespace bohrium;
+using namespace std;
+
+namespace {
+
+// Returns the config of the component named 'name' in the current stack
+unique_ptr<ConfigParser> find_component(const string &name) {
+    for (int stack_level = 0; ; ++stack_level) {
+        unique_ptr<ConfigParser> config;
+        try {
+            config.reset(new ConfigParser(stack_level));
+        } catch (const ConfigError &) {
+            throw runtime_error("the current stack has no '" + name + "' component (see BH_STACK)");
+        }
+        if (config->getName() == name) {
+            return config;
+        }
+    }
+}
+
+// Warm up the kernels of 'bhir' like `execute()` of the OpenMP component would execute it
+void warmup(EngineOpenMP &engine, BhIR *bhir, set<bh_base*> &computed) {
+    // When possible, a single kernel executes all the iterations
+    if (engine.handleRepeatedWarmup(bhir, computed)) {
+        return;
+    }
+
+    // The first two iterations of a repeated BhIR differ since the arrays of the first iteration are computed.
+    // Notice, sliding views are not recorded in traces thus the remaining iterations are identical.
+    const uint64_t iterations = std::min<uint64_t>(bhir->getNRepeats(), 2);
+    for (uint64_t i = 0; i < iterations; ++i) {
+        // Extension methods are executed by themselves thus they split the instruction list
+        vector<bh_instruction> instr_list;
+        for (const bh_instruction &instr: bhir->instr_list) {
+            if (instr.opcode >= BH_MAX_OPCODE_ID) {
+                BhIR b(std::move(instr_list), bhir->getSyncs());
+                engine.handleWarmup(&b, computed);
+                instr_list.clear(); // Notice, it is legal to clear a moved vector.
+                computed.insert(instr.operand[0].base);
+            } else {
+                instr_list.push_back(instr);
+            }
+        }
+        BhIR b(std::move(instr_list), bhir->getSyncs());
+        engine.handleWarmup(&b, computed);
+    }
+}
+
+void usage(const char *name) {
+    cout << "Usage: " << name << " [-j <threads>] <trace>...\n\n"
+         << "Compiles the kernels of the BhIR traces into the kernel cache of the OpenMP component.\n"
+         << "  -j <threads>  number of concurrent compilations (default: `compile_threads` of the config)" << endl;
+}
+}
+
+int main(int argc, char *argv[]) {
+    vector<string> traces;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 and i + 1 < argc) {
+            // Notice, config options can be overwritten with environment variables
+            setenv("BH_OPENMP_COMPILE_THREADS", argv[++i], 1);
+        } else if (strcmp(argv[i], "-h") == 0 or strcmp(argv[i], "--help") == 0) {
+            usage(argv[0]);
+            return 0;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            traces.push_back(argv[i]);
+        }
+    }
+    if (traces.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+    // The kernels are compiled by the background threads of `parallel_compile`
+    setenv("BH_OPENMP_PARALLEL_COMPILE", "true", 1);
+
+    try {
+        const unique_ptr<ConfigParser> config = find_component("openmp");
+        if (config->defaultGet<boost::filesystem::path>("cache_dir", "").empty()) {
+            throw runtime_error("the `cache_dir` of the OpenMP component is disabled");
+        }
+        if (config->defaultGet<string>("compiler_backend", "command") != "command") {
+            throw runtime_error("the `compiler_backend` of the OpenMP component doesn't use the kernel cache");
+        }
+
+        jitk::Statistics stat(*config);
+        uint64_t num_bhirs = 0;
+        {
+            EngineOpenMP engine(*config, stat);
+            for (const string &trace: traces) {
+                TraceReader reader(trace);
+                set<bh_base*> computed;
+                vector<bh_base*> data_recv;
+                while (unique_ptr<BhIR> bhir = reader.read(false, data_recv)) {
+                    // Arrays that had data when recorded are regarded as computed
+                    computed.insert(data_recv.begin(), data_recv.end());
+                    warmup(engine, bhir.get(), computed);
+                    ++num_bhirs;
+                }
+            }
+            // Notice, the destructor of the engine waits for the compilations to finish
+        }
+        cout << "Warmed up " << num_bhirs << " BhIRs: " << stat.kernel_cache_lookups << " kernels of which "
+             << stat.kernel_cache_misses << " were compiled" << endl;
+    } catch (const std::exception &e) {
+        cerr << argv[0] << ": " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}